@@ -0,0 +1,918 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+//
+// Polylib 性能計測プログラム。
+// 合成メッシュ(緯度経度分割した球面)とexamples/dataのファイルを用いて、
+// 以下の処理時間を計測し、1計測1行のJSON(JSON Lines)で出力する。
+//  - load           STL/OBJ(アスキー/バイナリ)読み込み (TriMeshIO::load)
+//  - import         読み込み+重複頂点削除 (TriMesh::import)
+//  - weld           頂点配列からの三角形作成+重複頂点削除 (TriMesh::init)
+//  - build          KD木構築 (TriMesh::build)
+//  - search_bbox    矩形領域検索
+//  - search_nearest 重心による最近傍検索
+//  - search_surface 面上の最近点検索
+//  - reorder        三角形順をシャッフルした合成メッシュの空間充填曲線による並べ替え
+//                   (TriMesh::reorder)。並べ替え後に上記3種の検索も計測する。
+//  - bin_search     格子の全セルについてセル毎の矩形領域検索 (TriMesh::search)
+//  - bin            格子の全セルの三角形一覧を一括作成 (TriangleBins::build)
+//  - move           PolygonGroup::move (頂点移動)
+//  - rebuild        PolygonGroup::rebuild_polygons (移動後のKD木再構築)
+// MPI版では上記に加え、以下を計測する。各計測値は全rankの最大値。
+//  - load_rank0     rank0読み込み+分配
+//  - move_rebuild   Polylib::move (頂点移動+KD木再構築)
+//  - migrate        migrate
+//  - gather         rank0への収集+保存 (save_rank0、カレントディレクトリに出力)
+//
+// usage: polylib_bench [options]
+//  -n <div>     合成メッシュの分割数(既定128、三角形数=4*div*(div-1))
+//  -q <num>     検索クエリ数(既定10000)
+//  -d <dist>    クエリ分布 uniform|surface|cluster (既定uniform)
+//  -w <ratio>   矩形領域検索の半幅(メッシュ対角長に対する比、既定0.02)
+//  -r <num>     繰り返し数(既定5)
+//  -s <num>     move/migrateのステップ数(既定4)
+//  -D <dir>     入力データのディレクトリ(既定examples/data)
+//  -t <dir>     一時ファイルのディレクトリ(既定.)
+//  -o <file>    出力ファイル(既定 標準出力)
+//  -b <list>    計測対象(カンマ区切り、既定all)
+//               load,weld,build,search,reorder,bin,move,load_rank0,migrate,gather
+//
+// MPI版の実行例:
+//  $ mpirun -np 4 ./polylib_bench -n 256 -o bench.json
+//
+
+#ifdef POLYLIB_BENCH_MPI
+#include "mpi.h"
+#include "MPIPolylib.h"
+#endif
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "Polylib.h"
+#include "polygons/TriMesh.h"
+#include "polygons/VertexList.h"
+#include "polygons/VertKDT.h"
+#include "file_io/TriMeshIO.h"
+#include "util/poly_time.h"
+#include "util/SpaceFillingCurve.h"
+#include "util/TriangleBins.h"
+
+#ifndef POLYLIB_BENCH_DATA
+#define POLYLIB_BENCH_DATA "data"
+#endif
+
+using namespace std;
+using namespace PolylibNS;
+
+////////////////////////////////////////////////////////////////////////////
+// 計測条件と結果出力
+////////////////////////////////////////////////////////////////////////////
+
+struct BenchOption {
+	int				ndiv;
+	int				nquery;
+	std::string		dist;
+	double			width;
+	int				repeat;
+	int				nstep;
+	std::string		data_dir;
+	std::string		tmp_dir;
+	std::string		out_file;
+	std::string		targets;
+
+	BenchOption() : ndiv(128), nquery(10000), dist("uniform"), width(0.02),
+		repeat(5), nstep(4), data_dir(POLYLIB_BENCH_DATA), tmp_dir("."),
+		targets("all") {}
+
+	bool enabled( const std::string& name ) const {
+		if( targets == "all" ) return true;
+		std::string list = "," + targets + ",";
+		return list.find( "," + name + "," ) != std::string::npos;
+	}
+};
+
+static int g_rank = 0;
+static int g_nprocs = 1;
+static std::ostream* g_out = &cout;
+
+static double wall_time()
+{
+#ifdef POLYLIB_BENCH_MPI
+	return MPI_Wtime();
+#else
+	double usr, sys, total;
+	getrusage_sec( &usr, &sys, &total );
+	return total;
+#endif
+}
+
+#ifdef POLYLIB_BENCH_MPI
+// 全rankの最大値
+static double reduce_max( double t )
+{
+	double tmax;
+	MPI_Allreduce( &t, &tmax, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD );
+	return tmax;
+}
+#endif
+
+static int num_threads()
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+static std::string json_escape( const std::string& s )
+{
+	std::string r;
+	for( size_t i=0; i<s.size(); i++ ) {
+		if( s[i] == '"' || s[i] == '\\' ) r += '\\';
+		r += s[i];
+	}
+	return r;
+}
+
+///
+/// 計測結果1件をJSON 1行で出力する。
+///
+///  @param[in] bench	計測名
+///  @param[in] mesh	メッシュ名
+///  @param[in] ntri	三角形数
+///  @param[in] param	計測条件(クエリ分布、ファイル形式等)
+///  @param[in] count	1回の計測で処理した要素数(クエリ数等)。0の場合は出力しない。
+///  @param[in] times	各回の計測時間[秒]
+///  @param[in] extra	追加の数値項目(名前と値)
+///
+static void report(
+	const std::string&	bench,
+	const std::string&	mesh,
+	size_t				ntri,
+	const std::string&	param,
+	size_t				count,
+	const std::vector<double>& times,
+	const std::map<std::string,double>& extra = std::map<std::string,double>()
+	)
+{
+	if( g_rank != 0 || times.empty() ) return;
+
+	double tmin = times[0], tmax = times[0], tsum = 0.0;
+	for( size_t i=0; i<times.size(); i++ ) {
+		tmin = std::min( tmin, times[i] );
+		tmax = std::max( tmax, times[i] );
+		tsum += times[i];
+	}
+	std::ostringstream os;
+	os.precision( 9 );
+	os << "{\"bench\":\"" << json_escape(bench) << "\""
+		<< ",\"mesh\":\"" << json_escape(mesh) << "\""
+		<< ",\"ntri\":" << ntri
+		<< ",\"param\":\"" << json_escape(param) << "\""
+		<< ",\"nprocs\":" << g_nprocs
+		<< ",\"nthreads\":" << num_threads()
+		<< ",\"real\":" << sizeof(PL_REAL)
+		<< ",\"repeat\":" << times.size()
+		<< ",\"min_sec\":" << tmin
+		<< ",\"mean_sec\":" << tsum / times.size()
+		<< ",\"max_sec\":" << tmax;
+	if( count > 0 ) {
+		os << ",\"count\":" << count
+			<< ",\"min_usec_per_item\":" << tmin / count * 1.0e6;
+	}
+	std::map<std::string,double>::const_iterator it;
+	for( it = extra.begin(); it != extra.end(); it++ ) {
+		os << ",\"" << json_escape(it->first) << "\":" << it->second;
+	}
+	os << "}";
+	*g_out << os.str() << endl;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// メッシュ・クエリの生成
+////////////////////////////////////////////////////////////////////////////
+
+///
+/// 半径1の球面を緯度経度分割した三角形を、頂点非共有の座標リスト
+/// (三角形数*9個)として作成する。
+///
+static void make_sphere(
+	int						ndiv,
+	std::vector<PL_REAL>&	vertlist,
+	std::vector<int>&		idlist,
+	std::vector<int>&		exidlist
+	)
+{
+	vertlist.clear(); idlist.clear(); exidlist.clear();
+	int id = 0;
+	for( int j=0; j<ndiv; j++ ) {
+		double t0 = M_PI * j / ndiv, t1 = M_PI * (j+1) / ndiv;
+		for( int i=0; i<2*ndiv; i++ ) {
+			double p0 = M_PI * i / ndiv, p1 = M_PI * (i+1) / ndiv;
+			double p[4][3] = {
+				{ sin(t0)*cos(p0), sin(t0)*sin(p0), cos(t0) },
+				{ sin(t1)*cos(p0), sin(t1)*sin(p0), cos(t1) },
+				{ sin(t1)*cos(p1), sin(t1)*sin(p1), cos(t1) },
+				{ sin(t0)*cos(p1), sin(t0)*sin(p1), cos(t0) } };
+			int tri[2][3] = { {0,1,2}, {0,2,3} };
+			for( int k=0; k<2; k++ ) {
+				// 極の縮退三角形は除く
+				if( (j == 0 && k == 1) || (j == ndiv-1 && k == 0) ) continue;
+				for( int c=0; c<3; c++ ) {
+					for( int a=0; a<3; a++ ) vertlist.push_back( p[tri[k][c]][a] );
+				}
+				idlist.push_back( id );
+				exidlist.push_back( id );
+				id++;
+			}
+		}
+	}
+}
+
+/// [0,1)の一様乱数
+static double urand()
+{
+	return rand() / ( (double)RAND_MAX + 1.0 );
+}
+
+/// 標準正規乱数(Box-Muller)
+static double nrand()
+{
+	double u1 = urand() + 1.0e-12, u2 = urand();
+	return sqrt( -2.0 * log(u1) ) * cos( 2.0 * M_PI * u2 );
+}
+
+/// 三角形上の一様乱数点
+static Vec3<PL_REAL> random_point_on( const PrivateTriangle* tri )
+{
+	double a = urand(), b = urand();
+	if( a + b > 1.0 ) { a = 1.0 - a; b = 1.0 - b; }
+	Vertex** v = tri->get_vertex();
+	Vec3<PL_REAL> p;
+	for( int i=0; i<3; i++ ) {
+		p[i] = (1.0-a-b) * (*v[0])[i] + a * (*v[1])[i] + b * (*v[2])[i];
+	}
+	return p;
+}
+
+///
+/// 検索クエリ点を作成する。
+///  uniform : メッシュbboxを10%広げた領域内の一様分布
+///  surface : 面上の一様な点を法線方向に対角長の1%以内でずらした点
+///  cluster : 面上の8点を中心とした正規分布(標準偏差は対角長の2%)
+///
+static void make_queries(
+	const std::vector<PrivateTriangle*>&	trias,
+	const BBox&								bbox,
+	const std::string&						dist,
+	int										nquery,
+	std::vector< Vec3<PL_REAL> >&			queries
+	)
+{
+	queries.clear();
+	if( trias.empty() ) return;
+	Vec3<PL_REAL> size = bbox.max - bbox.min;
+	double diag = size.length();
+	srand( 12345 );
+
+	if( dist == "surface" ) {
+		for( int i=0; i<nquery; i++ ) {
+			const PrivateTriangle* t = trias[ rand() % trias.size() ];
+			Vec3<PL_REAL> p = random_point_on( t );
+			double off = ( 2.0 * urand() - 1.0 ) * 0.01 * diag;
+			queries.push_back( p + t->get_normal() * off );
+		}
+	}
+	else if( dist == "cluster" ) {
+		Vec3<PL_REAL> center[8];
+		for( int c=0; c<8; c++ ) center[c] = random_point_on( trias[ rand() % trias.size() ] );
+		double sigma = 0.02 * diag;
+		for( int i=0; i<nquery; i++ ) {
+			const Vec3<PL_REAL>& c = center[ i % 8 ];
+			queries.push_back( Vec3<PL_REAL>(
+				c.x + sigma * nrand(), c.y + sigma * nrand(), c.z + sigma * nrand() ) );
+		}
+	}
+	else {
+		for( int i=0; i<nquery; i++ ) {
+			Vec3<PL_REAL> p;
+			for( int a=0; a<3; a++ ) {
+				p[a] = bbox.min[a] - 0.05 * size[a] + 1.1 * size[a] * urand();
+			}
+			queries.push_back( p );
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////
+// 計測
+////////////////////////////////////////////////////////////////////////////
+
+///
+/// ファイル読み込み(load)と、読み込み+重複頂点削除(import)を計測する。
+///
+static void bench_load_file(
+	const BenchOption&	opt,
+	const std::string&	mesh,
+	const std::string&	fname,
+	const std::string&	param
+	)
+{
+	std::string fmt = TriMeshIO::input_file_format( fname );
+	if( fmt.empty() ) return;
+	std::map<std::string, std::string> fmap;
+	fmap.insert( std::map<std::string, std::string>::value_type( fname, fmt ) );
+
+	std::vector<double> t_load, t_import;
+	size_t ntri = 0;
+	for( int r=0; r<opt.repeat; r++ ) {
+		VertKDT* vkdt = new VertKDT( 10 );
+		VertexList* vlist = new VertexList( vkdt, 1.0e-10 );
+		std::vector<PrivateTriangle*> trias;
+		double t0 = wall_time();
+		POLYLIB_STAT ret = TriMeshIO::load( vlist, &trias, fmap );
+		t_load.push_back( wall_time() - t0 );
+		ntri = trias.size();
+		for( size_t i=0; i<trias.size(); i++ ) delete trias[i];
+		delete vlist;
+		delete vkdt;
+		if( ret != PLSTAT_OK ) {
+			PL_ERROSH << "[ERROR]polylib_bench:can't load " << fname << std::endl;
+			return;
+		}
+
+		TriMesh tm( 1.0e-10 );
+		t0 = wall_time();
+		tm.import( fmap );
+		t_import.push_back( wall_time() - t0 );
+	}
+	report( "load", mesh, ntri, param, ntri, t_load );
+	report( "import", mesh, ntri, param, ntri, t_import );
+}
+
+///
+/// 合成メッシュを各形式で書き出し、読み込みを計測する。
+///
+static void bench_load_synthetic(
+	const BenchOption&	opt,
+	const std::string&	mesh,
+	TriMesh&			tm
+	)
+{
+	const char* fmts[4][2] = {
+		{ "stl_a", "stla" }, { "stl_b", "stlb" }, { "obj_a", "obj" }, { "obj_b", "obj" } };
+	for( int f=0; f<4; f++ ) {
+		std::string fname = opt.tmp_dir + "/polylib_bench_" + fmts[f][0] + "." + fmts[f][1];
+		if( TriMeshIO::save( tm.get_vtx_list(), tm.get_tri_list(), fname, fmts[f][0] ) != PLSTAT_OK ) {
+			PL_ERROSH << "[ERROR]polylib_bench:can't save " << fname << std::endl;
+			continue;
+		}
+		bench_load_file( opt, mesh, fname, fmts[f][0] );
+		remove( fname.c_str() );
+	}
+}
+
+///
+/// examples/data のファイルの読み込み・重複頂点削除・KD木構築を計測する。
+///
+static void bench_data_files( const BenchOption& opt )
+{
+	const char* files[] = {
+		"sphere.stl", "car.stl", "tower.stl", "blade1.stl", "cube.obj", NULL };
+	for( int i=0; files[i] != NULL; i++ ) {
+		std::string fname = opt.data_dir + "/" + files[i];
+		std::ifstream ifs( fname.c_str() );
+		if( !ifs ) continue;
+		ifs.close();
+		std::string fmt = TriMeshIO::input_file_format( fname );
+		bench_load_file( opt, files[i], fname, fmt );
+
+		if( opt.enabled("build") ) {
+			std::map<std::string, std::string> fmap;
+			fmap.insert( std::map<std::string, std::string>::value_type( fname, fmt ) );
+			TriMesh tm( 1.0e-10 );
+			tm.import( fmap );
+			std::vector<double> t_build;
+			for( int r=0; r<opt.repeat; r++ ) {
+				double t0 = wall_time();
+				tm.build();
+				t_build.push_back( wall_time() - t0 );
+			}
+			report( "build", files[i], tm.get_tri_list()->size(), "", 0, t_build );
+		}
+	}
+}
+
+/// ID順比較(三角形の並びによらず同じクエリを作るため)
+static bool tria_id_less( const PrivateTriangle* l, const PrivateTriangle* r )
+{
+	return l->get_id() < r->get_id();
+}
+
+///
+/// 検索を計測する。
+///
+///  @param[in] suffix	paramに付加する文字列
+///
+static void bench_search(
+	const BenchOption&	opt,
+	const std::string&	mesh,
+	TriMesh&			tm,
+	const std::string&	suffix = ""
+	)
+{
+	const std::vector<PrivateTriangle*>& trias = *tm.get_tri_list();
+	BBox bbox = tm.get_bbox();
+	std::vector<PrivateTriangle*> sorted( trias );
+	std::sort( sorted.begin(), sorted.end(), tria_id_less );
+	std::vector< Vec3<PL_REAL> > queries;
+	make_queries( sorted, bbox, opt.dist, opt.nquery, queries );
+	if( queries.empty() ) return;
+	double half = opt.width * (bbox.max - bbox.min).length();
+	std::string param = opt.dist + suffix;
+
+	// 矩形領域検索
+	std::vector<double> times;
+	double nhit = 0.0;
+	for( int r=0; r<opt.repeat; r++ ) {
+		nhit = 0.0;
+		double t0 = wall_time();
+		for( size_t i=0; i<queries.size(); i++ ) {
+			BBox q;
+			q.init();
+			q.add( queries[i] - Vec3<PL_REAL>(half, half, half) );
+			q.add( queries[i] + Vec3<PL_REAL>(half, half, half) );
+			const std::vector<PrivateTriangle*>* hit = tm.search( &q, false );
+			nhit += hit->size();
+			delete hit;
+		}
+		times.push_back( wall_time() - t0 );
+	}
+	std::map<std::string,double> extra;
+	extra["hits_per_query"] = nhit / queries.size();
+	extra["half_width"] = half;
+	report( "search_bbox", mesh, trias.size(), param, queries.size(), times, extra );
+
+	// 重心による最近傍検索
+	times.clear();
+	for( int r=0; r<opt.repeat; r++ ) {
+		double t0 = wall_time();
+		for( size_t i=0; i<queries.size(); i++ ) tm.search_nearest( queries[i] );
+		times.push_back( wall_time() - t0 );
+	}
+	report( "search_nearest", mesh, trias.size(), param, queries.size(), times );
+
+	// 面上の最近点検索
+	times.clear();
+	for( int r=0; r<opt.repeat; r++ ) {
+		double t0 = wall_time();
+		for( size_t i=0; i<queries.size(); i++ ) {
+			tm.search_nearest_surface( queries[i], NULL, NULL );
+		}
+		times.push_back( wall_time() - t0 );
+	}
+	report( "search_surface", mesh, trias.size(), param, queries.size(), times );
+}
+
+///
+/// 三角形の順をシャッフルした合成メッシュ(ファイル順が空間的に散らばった
+/// 場合を模擬)について、空間充填曲線による並べ替えの時間と、
+/// 並べ替えなし/Morton/Hilbertそれぞれでの検索時間を計測する。
+///
+static void bench_reorder(
+	const BenchOption&			opt,
+	const std::string&			mesh,
+	const std::vector<PL_REAL>&	vertlist,
+	const std::vector<int>&		idlist,
+	const std::vector<int>&		exidlist
+	)
+{
+	int ntri = idlist.size();
+	std::vector<int> perm( ntri );
+	for( int i=0; i<ntri; i++ ) perm[i] = i;
+	srand( 4321 );
+	for( int i=ntri-1; i>0; i-- ) std::swap( perm[i], perm[ rand() % (i+1) ] );
+	std::vector<PL_REAL> svert( vertlist.size() );
+	std::vector<int> sid( ntri ), sexid( ntri );
+	for( int i=0; i<ntri; i++ ) {
+		for( int k=0; k<9; k++ ) svert[i*9+k] = vertlist[ perm[i]*9+k ];
+		sid[i] = idlist[ perm[i] ];
+		sexid[i] = exidlist[ perm[i] ];
+	}
+
+	const SpaceFillingCurve::Type types[3] = {
+		SpaceFillingCurve::SFC_NONE, SpaceFillingCurve::SFC_MORTON, SpaceFillingCurve::SFC_HILBERT };
+	for( int c=0; c<3; c++ ) {
+		std::string name = SpaceFillingCurve::name( types[c] );
+		TriMesh tm( 1.0e-10 );
+		std::vector<double> t_reorder;
+		for( int r=0; r<opt.repeat; r++ ) {
+			tm.init( &svert[0], &sid[0], &sexid[0], 0, 0, 0, ntri );
+			// init()で三角形リストはID順になるので、シャッフルした順に戻す
+			// (合成メッシュのIDは0からの連番)
+			std::vector<PrivateTriangle*>* tl = tm.get_tri_list();
+			std::vector<PrivateTriangle*> shuffled( ntri );
+			for( int i=0; i<ntri; i++ ) shuffled[i] = (*tl)[ sid[i] ];
+			tl->swap( shuffled );
+			double t0 = wall_time();
+			tm.reorder( types[c] );
+			t_reorder.push_back( wall_time() - t0 );
+		}
+		tm.build();
+		if( types[c] != SpaceFillingCurve::SFC_NONE ) {
+			report( "reorder", mesh, ntri, name, ntri, t_reorder );
+		}
+		bench_search( opt, mesh, tm, ",shuffled," + name );
+	}
+}
+
+///
+/// メッシュを外包する格子(各軸BENCH_BIN_DIVセル)の全セルについて、
+/// セル毎の矩形領域検索と、TriangleBinsによる一括作成(外包矩形/厳密判定)を計測する。
+///
+#define BENCH_BIN_DIV 32
+static void bench_bin(
+	const BenchOption&	opt,
+	const std::string&	mesh,
+	TriMesh&			tm
+	)
+{
+	const std::vector<PrivateTriangle*>& trias = *tm.get_tri_list();
+	std::vector<Triangle*> tlist( trias.begin(), trias.end() );
+	BBox bbox = tm.get_bbox();
+	CellGrid grid;
+	grid.m_origin = bbox.min;
+	grid.m_cell_size = ( bbox.max - bbox.min ) / (PL_REAL)BENCH_BIN_DIV;
+	for( int a=0; a<3; a++ ) grid.m_dims[a] = BENCH_BIN_DIV;
+	size_t ncell = (size_t)BENCH_BIN_DIV * BENCH_BIN_DIV * BENCH_BIN_DIV;
+	std::ostringstream os;
+	os << BENCH_BIN_DIV << "^3";
+	std::string param = os.str();
+
+	// セル毎の矩形領域検索
+	std::vector<double> times;
+	double nentry = 0.0;
+	for( int r=0; r<opt.repeat; r++ ) {
+		nentry = 0.0;
+		double t0 = wall_time();
+		for( int k=0; k<BENCH_BIN_DIV; k++ ) {
+			for( int j=0; j<BENCH_BIN_DIV; j++ ) {
+				for( int i=0; i<BENCH_BIN_DIV; i++ ) {
+					Vec3<PL_REAL> cmin = grid.m_origin + Vec3<PL_REAL>(
+						i*grid.m_cell_size[0], j*grid.m_cell_size[1], k*grid.m_cell_size[2] );
+					BBox q;
+					q.init();
+					q.add( cmin );
+					q.add( cmin + grid.m_cell_size );
+					const std::vector<PrivateTriangle*>* hit = tm.search( &q, false );
+					nentry += hit->size();
+					delete hit;
+				}
+			}
+		}
+		times.push_back( wall_time() - t0 );
+	}
+	std::map<std::string,double> extra;
+	extra["entries"] = nentry;
+	report( "bin_search", mesh, trias.size(), param, ncell, times, extra );
+
+	// 一括作成
+	for( int exact=0; exact<2; exact++ ) {
+		TriangleBins bins;
+		times.clear();
+		for( int r=0; r<opt.repeat; r++ ) {
+			double t0 = wall_time();
+			bins.build( grid, tlist, exact != 0 );
+			times.push_back( wall_time() - t0 );
+		}
+		extra.clear();
+		extra["entries"] = bins.get_indices().size();
+		extra["memory"] = bins.memory_size();
+		report( "bin", mesh, trias.size(), param + ( exact ? ",exact" : ",bbox" ),
+			ncell, times, extra );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:BenchGroup
+/// move()で全頂点をx方向へ平行移動するグループ。
+/// 移動量はshift*m_delta_tで、ステップ毎に符号を反転しメッシュを往復させる。
+///
+////////////////////////////////////////////////////////////////////////////
+class BenchGroup : public PolygonGroup {
+public:
+	BenchGroup( PL_REAL shift ) : PolygonGroup( 1.0e-10 ), m_shift( shift ) {
+		m_movable = true;
+	}
+
+	POLYLIB_STAT move( PolylibMoveParams& params ) {
+		PL_REAL dx = m_shift * params.m_delta_t;
+		if( params.m_current_step % 2 != 0 ) dx = -dx;
+		std::vector<Vertex*>* vlist = m_polygons->get_vtx_list()->get_vertex_lists_mod();
+		for( size_t i=0; i<vlist->size(); i++ ) (*(*vlist)[i])[0] += dx;
+		m_need_rebuild = true;
+		return PLSTAT_OK;
+	}
+
+private:
+	PL_REAL m_shift;
+};
+
+///
+/// move(頂点移動)と、その後のrebuild_polygons(KD木再構築)を計測する。非MPI版のみ。
+///
+static void bench_move(
+	const BenchOption&			opt,
+	const std::string&			mesh,
+	const std::vector<PL_REAL>&	vertlist,
+	const std::vector<int>&		idlist,
+	const std::vector<int>&		exidlist
+	)
+{
+#ifndef POLYLIB_BENCH_MPI
+	Polylib* pl = Polylib::get_instance();
+	BenchGroup* pg = new BenchGroup( 0.01 );
+	pg->set_name( "polylib_bench_move" );
+	pl->add_pg_list( pg );
+	int ntri = idlist.size();
+	pg->init( &vertlist[0], &idlist[0], &exidlist[0], 0, 0, 0, ntri );
+
+	std::vector<double> t_move, t_rebuild;
+	for( int s=0; s<opt.nstep; s++ ) {
+		PolylibMoveParams params;
+		params.m_current_step = s;
+		params.m_next_step = s+1;
+		params.m_delta_t = 1.0;
+		double t0 = wall_time();
+		pg->move( params );
+		t_move.push_back( wall_time() - t0 );
+
+		t0 = wall_time();
+		pg->rebuild_polygons();
+		t_rebuild.push_back( wall_time() - t0 );
+	}
+	report( "move", mesh, ntri, "", ntri, t_move );
+	report( "rebuild", mesh, ntri, "", ntri, t_rebuild );
+#endif
+}
+
+#ifdef POLYLIB_BENCH_MPI
+////////////////////////////////////////////////////////////////////////////
+// MPI版の計測
+////////////////////////////////////////////////////////////////////////////
+
+///
+/// 領域[-2,2]^3をx方向にnprocs分割した領域を自rankの計算領域とする。
+///
+static POLYLIB_STAT init_parallel( MPIPolylib* pl, double* slab )
+{
+	const unsigned int nx = 16, nyz = 64;
+	*slab = 4.0 / g_nprocs;
+	PL_REAL bpos[3] = { (PL_REAL)(-2.0 + g_rank * (*slab)), -2.0, -2.0 };
+	unsigned int bbsize[3] = { nx, nyz, nyz };
+	unsigned int gcsize[3] = { 1, 1, 1 };
+	PL_REAL dx[3] = { (PL_REAL)(*slab / nx), (PL_REAL)(4.0 / nyz), (PL_REAL)(4.0 / nyz) };
+	return pl->init_parallel_info( MPI_COMM_WORLD, bpos, bbsize, gcsize, dx );
+}
+
+///
+/// rank0での読み込みと分配(load_rank0)を計測する。
+/// 合成メッシュをバイナリSTLで書き出し、繰り返し毎に別名のグループとして読み込む。
+///
+static void bench_load_rank0(
+	const BenchOption&	opt,
+	const std::string&	mesh,
+	MPIPolylib*			pl,
+	TriMesh&			tm
+	)
+{
+	std::string stl = opt.tmp_dir + "/polylib_bench_rank0.stlb";
+	std::string config = opt.tmp_dir + "/polylib_bench_rank0.tp";
+	if( g_rank == 0 ) {
+		TriMeshIO::save( tm.get_vtx_list(), tm.get_tri_list(), stl, TriMeshIO::FMT_STL_B );
+		std::ofstream ofs( config.c_str() );
+		ofs << "Polylib {" << std::endl;
+		for( int r=0; r<opt.repeat; r++ ) {
+			ofs << "  bench_load" << r << " {" << std::endl
+				<< "    filepath = \"" << stl << "\"" << std::endl
+				<< "  }" << std::endl;
+		}
+		ofs << "}" << std::endl;
+	}
+	MPI_Barrier( MPI_COMM_WORLD );
+
+	// 設定ファイルは全グループを読むため、1回の読み込み時間を繰り返し数で割る
+	double t0 = wall_time();
+	POLYLIB_STAT ret = pl->load_rank0( config );
+	double t = reduce_max( wall_time() - t0 );
+	int ng = ( ret != PLSTAT_OK ), ng_all;
+	MPI_Allreduce( &ng, &ng_all, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD );
+	if( ng_all ) {
+		PL_ERROSH << "[ERROR]polylib_bench:load_rank0() failed." << std::endl;
+	}
+	else {
+		std::vector<double> times( 1, t / opt.repeat );
+		report( "load_rank0", mesh, tm.get_tri_list()->size(), "stl_b",
+			tm.get_tri_list()->size(), times );
+	}
+	if( g_rank == 0 ) {
+		remove( stl.c_str() );
+		remove( config.c_str() );
+	}
+}
+
+///
+/// move+migrate と gather(save_rank0)を計測する。
+/// rank0が全三角形を持つ状態から最初のmigrateで分配し、以降はステップ毎に
+/// 領域幅の半分だけx方向へ往復させる。
+///
+static void bench_migrate(
+	const BenchOption&			opt,
+	const std::string&			mesh,
+	MPIPolylib*					pl,
+	double						slab,
+	const std::vector<PL_REAL>&	vertlist,
+	const std::vector<int>&		idlist,
+	const std::vector<int>&		exidlist
+	)
+{
+	BenchGroup* pg = new BenchGroup( 0.5 * slab );
+	pg->set_name( "polylib_bench_migrate" );
+	pl->add_pg_list( pg );
+	int ntri = ( g_rank == 0 ) ? idlist.size() : 0;
+	pg->init( ntri ? &vertlist[0] : NULL, ntri ? &idlist[0] : NULL,
+		ntri ? &exidlist[0] : NULL, 0, 0, 0, ntri );
+
+	// 移動量0のmoveで移動除外三角形を決めてから分配する
+	PolylibMoveParams params0;
+	params0.m_current_step = 0;
+	params0.m_next_step = 0;
+	params0.m_delta_t = 0.0;
+	if( pl->move( params0 ) != PLSTAT_OK || pl->migrate() != PLSTAT_OK ) {
+		PL_ERROSH << "[ERROR]polylib_bench:migrate() failed." << std::endl;
+		return;
+	}
+
+	if( opt.enabled("migrate") ) {
+		std::vector<double> t_move, t_migrate;
+		for( int s=0; s<opt.nstep; s++ ) {
+			PolylibMoveParams params;
+			params.m_current_step = s;
+			params.m_next_step = s+1;
+			params.m_delta_t = 1.0;
+			MPI_Barrier( MPI_COMM_WORLD );
+			double t0 = wall_time();
+			pl->move( params );
+			double t1 = wall_time();
+			pl->migrate();
+			double t2 = wall_time();
+			t_move.push_back( reduce_max( t1 - t0 ) );
+			t_migrate.push_back( reduce_max( t2 - t1 ) );
+		}
+		std::map<std::string,double> extra;
+		extra["shift"] = 0.5 * slab;
+		report( "move_rebuild", mesh, idlist.size(), "", 0, t_move, extra );
+		report( "migrate", mesh, idlist.size(), "", 0, t_migrate, extra );
+	}
+
+	if( opt.enabled("gather") ) {
+		std::vector<double> t_gather;
+		for( int r=0; r<opt.repeat; r++ ) {
+			std::string config;
+			MPI_Barrier( MPI_COMM_WORLD );
+			double t0 = wall_time();
+			pl->save_rank0( &config, "stl_b", "bench" );
+			t_gather.push_back( reduce_max( wall_time() - t0 ) );
+		}
+		report( "gather", mesh, idlist.size(), "save_rank0,stl_b", 0, t_gather );
+	}
+}
+#endif // POLYLIB_BENCH_MPI
+
+////////////////////////////////////////////////////////////////////////////
+
+static void usage()
+{
+	if( g_rank != 0 ) return;
+	cerr << "usage: polylib_bench [-n div] [-q nquery] [-d uniform|surface|cluster]"
+		<< " [-w ratio] [-r repeat] [-s nstep] [-D datadir] [-t tmpdir]"
+		<< " [-o file] [-b list]" << endl;
+}
+
+int main( int argc, char** argv )
+{
+#ifdef POLYLIB_BENCH_MPI
+	MPI_Init( &argc, &argv );
+	MPI_Comm_rank( MPI_COMM_WORLD, &g_rank );
+	MPI_Comm_size( MPI_COMM_WORLD, &g_nprocs );
+#endif
+
+	BenchOption opt;
+	for( int i=1; i<argc; i++ ) {
+		std::string a = argv[i];
+		if( i+1 >= argc || a.size() != 2 || a[0] != '-' ) {
+			usage();
+			return 1;
+		}
+		std::string v = argv[++i];
+		switch( a[1] ) {
+		case 'n': opt.ndiv = atoi( v.c_str() ); break;
+		case 'q': opt.nquery = atoi( v.c_str() ); break;
+		case 'd': opt.dist = v; break;
+		case 'w': opt.width = atof( v.c_str() ); break;
+		case 'r': opt.repeat = std::max( 1, atoi( v.c_str() ) ); break;
+		case 's': opt.nstep = std::max( 1, atoi( v.c_str() ) ); break;
+		case 'D': opt.data_dir = v; break;
+		case 't': opt.tmp_dir = v; break;
+		case 'o': opt.out_file = v; break;
+		case 'b': opt.targets = v; break;
+		default: usage(); return 1;
+		}
+	}
+
+	std::ofstream ofs;
+	if( g_rank == 0 && !opt.out_file.empty() ) {
+		ofs.open( opt.out_file.c_str() );
+		if( !ofs ) {
+			cerr << "can't open " << opt.out_file << endl;
+			return 1;
+		}
+		g_out = &ofs;
+	}
+
+	// 合成メッシュ
+	std::ostringstream os;
+	os << "sphere" << opt.ndiv;
+	std::string mesh = os.str();
+	std::vector<PL_REAL> vertlist;
+	std::vector<int> idlist, exidlist;
+	make_sphere( opt.ndiv, vertlist, idlist, exidlist );
+	int ntri = idlist.size();
+
+	TriMesh tm( 1.0e-10 );
+	std::vector<double> t_weld, t_build;
+	for( int r=0; r<opt.repeat; r++ ) {
+		double t0 = wall_time();
+		tm.init( &vertlist[0], &idlist[0], &exidlist[0], 0, 0, 0, ntri );
+		t_weld.push_back( wall_time() - t0 );
+		t0 = wall_time();
+		tm.build();
+		t_build.push_back( wall_time() - t0 );
+	}
+	if( opt.enabled("weld") ) report( "weld", mesh, ntri, "", ntri, t_weld );
+	if( opt.enabled("build") ) report( "build", mesh, ntri, "", ntri, t_build );
+
+	// 計測は非MPI版では全て、MPI版ではrank0のみで行う
+	if( g_rank == 0 ) {
+		if( opt.enabled("load") ) {
+			bench_load_synthetic( opt, mesh, tm );
+			bench_data_files( opt );
+		}
+		if( opt.enabled("search") ) bench_search( opt, mesh, tm );
+		if( opt.enabled("reorder") ) bench_reorder( opt, mesh, vertlist, idlist, exidlist );
+		if( opt.enabled("bin") ) bench_bin( opt, mesh, tm );
+		if( opt.enabled("move") ) bench_move( opt, mesh, vertlist, idlist, exidlist );
+	}
+
+#ifdef POLYLIB_BENCH_MPI
+	MPIPolylib* pl = MPIPolylib::get_instance();
+	double slab;
+	if( init_parallel( pl, &slab ) != PLSTAT_OK ) {
+		PL_ERROSH << "[ERROR]polylib_bench:init_parallel_info() failed." << std::endl;
+		MPI_Abort( MPI_COMM_WORLD, 1 );
+	}
+	if( opt.enabled("load_rank0") ) bench_load_rank0( opt, mesh, pl, tm );
+	if( opt.enabled("migrate") || opt.enabled("gather") ) {
+		bench_migrate( opt, mesh, pl, slab, vertlist, idlist, exidlist );
+	}
+	MPI_Finalize();
+#endif
+
+	return 0;
+}
@@ -133,4 +133,22 @@ macro(precision)
     message("FATAL ERROR : Invalid floating type : ${real_type}")
     message("@@@@@@@@@@@")
   ENDIF()
+
+  # 幾何判定の演算型
+  if(calc_type STREQUAL "OFF")
+  # nothing, default is double
+  set(calc_type "double")
+
+  elseif(calc_type STREQUAL "double")
+  # nothing
+
+  elseif(calc_type STREQUAL "real")
+    ADD_DEFINITIONS(-D_CALC_IS_REAL_)
+    set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -D_CALC_IS_REAL_")
+
+  else() # neither 'double' nor 'real'
+    message("@@@@@@@@@@@")
+    message("FATAL ERROR : Invalid predicate type : ${calc_type}")
+    message("@@@@@@@@@@@")
+  ENDIF()
 endmacro()
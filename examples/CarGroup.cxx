@@ -24,7 +24,6 @@ CarGroup::CarGroup(){
 	this->m_polygons	= new TriMesh();
 	this->m_movable	= false;
 	this->m_need_rebuild = false;
-	this->m_trias_before_move = NULL;
 }
 
 CarGroup::CarGroup(PL_REAL tolerance){
@@ -33,7 +32,6 @@ CarGroup::CarGroup(PL_REAL tolerance){
 	this->m_polygons	= new TriMesh(tolerance);
 	this->m_movable	= false;
 	this->m_need_rebuild = false;
-	this->m_trias_before_move = NULL;
 	this->m_tolerance=tolerance;
 }
 
@@ -115,6 +113,12 @@ POLYLIB_STAT CarGroup::move(PolylibMoveParams& params){
 	PL_DBGOSH << "CarGroup::move() move_pos."<< move_pos <<std::endl;
 #endif // DEBUG
 
+	// 剛体インスタンシングが有効なら変換の更新だけで済む (KD木の再構築不要)
+	if (this->is_rigid_instanced()) {
+		this->apply_rigid_motion(NULL, Vec3<PL_REAL>(0.0, -move_pos, 0.0));
+		return PLSTAT_OK;
+	}
+
 	std::vector<Vertex*>* vertexlist;
 	vertexlist=this->m_polygons->get_vtx_list()->get_vertex_lists_mod();
 
@@ -0,0 +1,219 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+//
+// 読み込みキャッシュ(PolygonGroup::set_cache_dir())の試験。
+//  - 初回の読み込みでキャッシュが作られること(ミス)
+//  - 同じ入力ファイルではキャッシュから読み込まれること(ヒット)。
+//    入力ファイルをサイズ・更新時刻を変えずに書き換え、読み込んだ座標が
+//    書き換え前のものであることで確認する
+//  - 入力ファイルの更新時刻・サイズが変わるとキャッシュを使わないこと
+//  - 壊れたキャッシュファイル(切り詰め、内容の破損)を使わないこと
+//
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include "Polylib.h"
+#include "file_io/TriMeshIO.h"
+
+using namespace std;
+using namespace PolylibNS;
+
+static const char* CACHE_DIR = "test_mesh_cache_dir";
+static const char* STL_FILE = "test_mesh_cache.stl";
+
+// 原点をoffだけずらした格子をバイナリSTLで書き出す
+static void write_stl( int n, PL_REAL off )
+{
+	std::vector<PL_REAL> coords;
+	std::vector<int> index;
+	for( int j=0; j<=n; j++ ) {
+		for( int i=0; i<=n; i++ ) {
+			coords.push_back( off + i );
+			coords.push_back( j );
+			coords.push_back( 0.1*i*j );
+		}
+	}
+	for( int j=0; j<n; j++ ) {
+		for( int i=0; i<n; i++ ) {
+			int a = j*(n+1) + i;
+			int t[6] = { a, a+1, a+n+1, a+1, a+n+2, a+n+1 };
+			for( int k=0; k<6; k++ ) index.push_back( t[k] );
+		}
+	}
+	TriMesh tm;
+	tm.init_indexed( &coords[0], (int)coords.size()/3, &index[0], (int)index.size()/3, NULL, NULL );
+	TriMeshIO::save( tm.get_vtx_list(), tm.get_tri_list(), STL_FILE, TriMeshIO::FMT_STL_B );
+}
+
+static void set_mtime( time_t t )
+{
+	struct utimbuf ut;
+	ut.actime = t;
+	ut.modtime = t;
+	utime( STL_FILE, &ut );
+}
+
+// キャッシュディレクトリ内のファイル名
+static std::vector<std::string> cache_files()
+{
+	std::vector<std::string> files;
+	DIR* dir = opendir( CACHE_DIR );
+	if( dir == NULL ) return files;
+	struct dirent* ent;
+	while( ( ent = readdir( dir ) ) != NULL ) {
+		std::string name = ent->d_name;
+		if( name.size() > 4 && name.substr( name.size()-4 ) == ".plc" ) {
+			files.push_back( std::string(CACHE_DIR) + "/" + name );
+		}
+	}
+	closedir( dir );
+	return files;
+}
+
+static void remove_cache_files()
+{
+	std::vector<std::string> files = cache_files();
+	for( size_t i=0; i<files.size(); i++ ) remove( files[i].c_str() );
+}
+
+// グループを読み込み、三角形数と最小x座標を返す
+static POLYLIB_STAT load_group( int* ntri, PL_REAL* xmin )
+{
+	PolygonGroup pg( 1.0e-6 );
+	pg.set_name( "cache" );
+	std::map<std::string, std::string> fmap;
+	fmap[STL_FILE] = TriMeshIO::FMT_STL_B;
+	pg.set_file_name( fmap );
+	pg.set_cache_dir( CACHE_DIR );
+	POLYLIB_STAT ret = pg.load_stl_file( 1.0 );
+	if( ret != PLSTAT_OK ) return ret;
+
+	std::vector<PrivateTriangle*>* tl = pg.get_triangles();
+	*ntri = (int)tl->size();
+	*xmin = 1.0e30;
+	for( size_t t=0; t<tl->size(); t++ ) {
+		Vertex** v = (*tl)[t]->get_vertex();
+		for( int c=0; c<3; c++ ) *xmin = std::min( *xmin, (*v[c])[0] );
+	}
+
+	// KD木も使えること
+	BBox bbox( *xmin - 0.5, -0.5, -1.0, *xmin + 0.5, 0.5, 1.0 );
+	std::vector<PrivateTriangle*> hit;
+	if( pg.search( &bbox, false, &hit ) != PLSTAT_OK || hit.empty() ) return PLSTAT_NG;
+	return PLSTAT_OK;
+}
+
+static int check(
+	const char*		title,
+	int				expect_ntri,
+	PL_REAL			expect_xmin,
+	size_t			expect_nfiles
+	)
+{
+	int ntri = 0;
+	PL_REAL xmin = 0;
+	POLYLIB_STAT ret = load_group( &ntri, &xmin );
+	size_t nfiles = cache_files().size();
+	bool ok = ( ret == PLSTAT_OK && ntri == expect_ntri &&
+		fabs( xmin - expect_xmin ) < 1.0e-6 && nfiles == expect_nfiles );
+	cout << title << ": ntri=" << ntri << " xmin=" << xmin << " cache files=" << nfiles
+		<< ( ok ? " OK" : " NG" ) << endl;
+	return ok ? 0 : 1;
+}
+
+// キャッシュファイルを壊す。truncateは切り詰め、それ以外は後半を0xffで上書き
+static void corrupt_cache( bool truncate )
+{
+	std::vector<std::string> files = cache_files();
+	for( size_t i=0; i<files.size(); i++ ) {
+		std::fstream fs( files[i].c_str(), std::ios::in | std::ios::out | std::ios::binary );
+		fs.seekg( 0, std::ios::end );
+		long size = (long)fs.tellg();
+		if( truncate ) {
+			fs.close();
+			if( ::truncate( files[i].c_str(), size/2 ) != 0 ) cout << "truncate failed" << endl;
+		}
+		else {
+			fs.seekp( size/2 );
+			std::vector<char> garbage( size - size/2, (char)0xff );
+			fs.write( &garbage[0], garbage.size() );
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int nerr = 0;
+	mkdir( CACHE_DIR, 0755 );
+	remove_cache_files();
+
+	const int n = 20;
+	const int ntri = 2*n*n;
+	const time_t t0 = 1500000000;
+
+	// ミス: キャッシュを作成
+	write_stl( n, 0.0 );
+	set_mtime( t0 );
+	nerr += check( "miss", ntri, 0.0, 1 );
+
+	// ヒット: サイズ・更新時刻が同じなら書き換え前の内容が読まれる
+	write_stl( n, 100.0 );
+	set_mtime( t0 );
+	nerr += check( "hit", ntri, 0.0, 1 );
+
+	// 更新時刻の変更: キャッシュを使わず、新しいキャッシュを作る
+	set_mtime( t0 + 10 );
+	nerr += check( "mtime changed", ntri, 100.0, 2 );
+	nerr += check( "mtime changed (hit)", ntri, 100.0, 2 );
+
+	// サイズの変更(更新時刻は同じ)
+	write_stl( n+1, 100.0 );
+	set_mtime( t0 + 10 );
+	nerr += check( "size changed", 2*(n+1)*(n+1), 100.0, 3 );
+
+	// 壊れたキャッシュは使わずに入力ファイルから読み込む
+	remove_cache_files();
+	write_stl( n, 0.0 );
+	set_mtime( t0 );
+	nerr += check( "rebuild", ntri, 0.0, 1 );
+	corrupt_cache( true );
+	nerr += check( "truncated cache", ntri, 0.0, 1 );
+	corrupt_cache( false );
+	nerr += check( "broken cache", ntri, 0.0, 1 );
+	nerr += check( "rewritten cache (hit)", ntri, 0.0, 1 );
+
+	remove_cache_files();
+	rmdir( CACHE_DIR );
+	remove( STL_FILE );
+
+	if( nerr != 0 ) {
+		cout << "FAILED: " << nerr << " errors" << endl;
+		return 1;
+	}
+	cout << "PASS" << endl;
+	return 0;
+}
@@ -0,0 +1,219 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+//
+// グループ間の三角形の組の検索(search_nearest_pair()、search_pairs_within())
+// を全ての組の総当たりと比較する試験。
+//  - 凹凸のある2つの面の最短距離と組が総当たりと一致すること
+//  - 平行な2つの面(同じ距離の組が多数ある)で、IDの最も小さい組が
+//    スレッド数によらず選ばれること
+//  - 剛体インスタンシングのグループ(回転・並進あり)でも総当たりと一致すること
+//  - 距離以内の組の数が総当たりと一致すること
+//
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "Polylib.h"
+#include "polygons/PrivateTriangle.h"
+
+using namespace std;
+using namespace PolylibNS;
+
+static int nerr = 0;
+
+static void check( bool ok, const char* what )
+{
+	if( !ok ) {
+		cerr << "NG: " << what << endl;
+		nerr++;
+	}
+}
+
+// n x nの格子の面を三角形の頂点座標の並びで作る。
+// z = z0 + amp*sin(x)*cos(y)、IDはid0から逆順
+static void make_sheet( int n, PL_REAL ox, PL_REAL z0, PL_REAL amp, int id0,
+	vector<PL_REAL>& vert, vector<int>& ids, vector<int>& exids )
+{
+	vert.clear();
+	ids.clear();
+	exids.clear();
+	for( int j=0; j<n; j++ ) {
+		for( int i=0; i<n; i++ ) {
+			PL_REAL p[4][3];
+			for( int k=0; k<4; k++ ) {
+				PL_REAL x = ox + (i + (k==1||k==2)) * 0.25;
+				PL_REAL y = (j + (k>=2)) * 0.25;
+				p[k][0] = x;
+				p[k][1] = y;
+				p[k][2] = z0 + amp*sin(3*x)*cos(2*y);
+			}
+			int f[2][3] = { {0,1,2}, {0,2,3} };
+			for( int t=0; t<2; t++ ) {
+				for( int k=0; k<3; k++ ) {
+					for( int c=0; c<3; c++ ) vert.push_back( p[f[t][k]][c] );
+				}
+				ids.push_back( id0 + 2*n*n - (int)ids.size() );
+				exids.push_back( 0 );
+			}
+		}
+	}
+}
+
+static void init_group( PolygonGroup& pg, int n, PL_REAL ox, PL_REAL z0, PL_REAL amp, int id0 )
+{
+	vector<PL_REAL> vert;
+	vector<int> ids, exids;
+	make_sheet( n, ox, z0, amp, id0, vert, ids, exids );
+	pg.init( &vert[0], &ids[0], &exids[0], 0, 0, 0, (unsigned int)ids.size() );
+}
+
+// 三角形の頂点のワールド座標
+static void world_coords( const PolygonGroup& pg, const PrivateTriangle* t, PL_CALC_REAL c[9] )
+{
+	Vertex** v = t->get_vertex();
+	for( int k=0; k<3; k++ ) {
+		Vec3<PL_REAL> p = pg.to_world_pos( Vec3<PL_REAL>( (*v[k])[0], (*v[k])[1], (*v[k])[2] ) );
+		for( int d=0; d<3; d++ ) c[k*3+d] = p[d];
+	}
+}
+
+// 総当たりの最短距離の組(同じ距離ではIDの小さい組)と、距離lim以内の組の数
+static void brute_force( PolygonGroup& a, PolygonGroup& b, PL_CALC_REAL lim,
+	PL_CALC_REAL* d2_min, int* id_a, int* id_b, int* nwithin )
+{
+	const vector<PrivateTriangle*>* ta = a.get_triangles();
+	const vector<PrivateTriangle*>* tb = b.get_triangles();
+	vector<PL_CALC_REAL> cb( tb->size()*9 );
+	for( size_t j=0; j<tb->size(); j++ ) world_coords( b, (*tb)[j], &cb[j*9] );
+
+	*d2_min = -1;
+	*nwithin = 0;
+	for( size_t i=0; i<ta->size(); i++ ) {
+		PL_CALC_REAL ca[9];
+		world_coords( a, (*ta)[i], ca );
+		int ia = (*ta)[i]->get_id();
+		for( size_t j=0; j<tb->size(); j++ ) {
+			PL_CALC_REAL d2 = tri_tri_dist2( ca, &cb[j*9] );
+			int ib = (*tb)[j]->get_id();
+			if( d2 <= lim*lim ) (*nwithin)++;
+			if( *d2_min < 0 || d2 < *d2_min ||
+				( d2 == *d2_min && ( ia < *id_a || ( ia == *id_a && ib < *id_b ) ) ) ) {
+				*d2_min = d2;
+				*id_a = ia;
+				*id_b = ib;
+			}
+		}
+	}
+}
+
+static void compare( PolygonGroup& a, PolygonGroup& b, PL_CALC_REAL lim,
+	PL_CALC_REAL tol, bool check_ids, const char* name )
+{
+	PL_CALC_REAL d2;
+	int ia = -1, ib = -1, nwithin;
+	brute_force( a, b, lim, &d2, &ia, &ib, &nwithin );
+
+	TrianglePair p;
+	check( a.search_nearest_pair( &b, &p ) == PLSTAT_OK, name );
+	check( p.tri_a != 0 && p.tri_b != 0, name );
+	if( p.tri_a == 0 || p.tri_b == 0 ) return;
+	if( fabs( p.dist2 - d2 ) > tol ) {
+		cerr << name << ": dist2 " << p.dist2 << " brute force " << d2 << endl;
+		nerr++;
+	}
+	if( check_ids && ( p.tri_a->get_id() != ia || p.tri_b->get_id() != ib ) ) {
+		cerr << name << ": pair " << p.tri_a->get_id() << "," << p.tri_b->get_id()
+			<< " brute force " << ia << "," << ib << endl;
+		nerr++;
+	}
+
+	vector<TrianglePair> pairs;
+	check( a.search_pairs_within( &b, (PL_REAL)lim, &pairs ) == PLSTAT_OK, name );
+	if( (int)pairs.size() != nwithin ) {
+		cerr << name << ": pairs within " << pairs.size() << " brute force " << nwithin << endl;
+		nerr++;
+	}
+}
+
+int main( int argc, char** argv )
+{
+	// 凹凸のある2つの面
+	{
+		PolygonGroup a( 1e-10 ), b( 1e-10 );
+		init_group( a, 16, 0, 0, 0.3, 0 );
+		init_group( b, 16, 0.6, 0.8, -0.25, 10000 );
+		compare( a, b, 0.5, 0, true, "bumpy" );
+	}
+
+	// 平行な2つの面。重なる全ての組が同じ距離になる
+	{
+		PolygonGroup a( 1e-10 ), b( 1e-10 );
+		init_group( a, 16, 0, 0, 0, 0 );
+		init_group( b, 16, 1, 0.5, 0, 10000 );
+		compare( a, b, 0.5, 0, true, "parallel" );
+
+		int nthread = 1;
+#ifdef _OPENMP
+		nthread = omp_get_max_threads();
+#endif
+		TrianglePair p0;
+		a.search_nearest_pair( &b, &p0 );
+		for( int nt=1; nt<=nthread+1; nt++ ) {
+#ifdef _OPENMP
+			omp_set_num_threads( nt );
+#endif
+			for( int r=0; r<4; r++ ) {
+				TrianglePair p;
+				a.search_nearest_pair( &b, &p );
+				check( p.tri_a == p0.tri_a && p.tri_b == p0.tri_b, "parallel: tie-break" );
+			}
+		}
+#ifdef _OPENMP
+		omp_set_num_threads( nthread );
+#endif
+	}
+
+	// 剛体インスタンシングのグループ
+	{
+		PolygonGroup a( 1e-10 ), b( 1e-10 );
+		init_group( a, 16, 0, 0, 0.3, 0 );
+		init_group( b, 16, 0.6, 0.8, -0.25, 10000 );
+		a.set_rigid_instancing( true );
+		PL_REAL th = 0.2;
+		PL_REAL rot[9] = { (PL_REAL)cos(th), 0, (PL_REAL)sin(th),
+			0, 1, 0,
+			(PL_REAL)-sin(th), 0, (PL_REAL)cos(th) };
+		a.apply_rigid_motion( rot, Vec3<PL_REAL>( 0.3, 0.1, -0.2 ) );
+		compare( a, b, 0.5, 1e-5, false, "rigid a" );
+		compare( b, a, 0.5, 1e-5, false, "rigid b" );
+
+		b.set_rigid_instancing( true );
+		b.apply_rigid_motion( NULL, Vec3<PL_REAL>( -0.2, 0.4, 0.1 ) );
+		compare( a, b, 0.5, 1e-5, false, "rigid a,b" );
+	}
+
+	if( nerr != 0 ) {
+		cout << "FAILED: " << nerr << " errors" << endl;
+		return 1;
+	}
+	cout << "PASS" << endl;
+	return 0;
+}
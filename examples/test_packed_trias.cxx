@@ -0,0 +1,173 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+//
+// migrate用圧縮形式(TriaCodec)のベンチマーク。
+// 緯度経度分割した球面の三角形を従来形式/圧縮形式で詰めた時のバイト数、
+// 符号化/復号時間、座標誤差を計測し、指定帯域での転送時間短縮量を見積もる。
+//
+//  usage: test_packed_trias [分割数(既定256)] [許容誤差(既定1e-5)] [帯域GB/s(既定1.0)]
+//
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include "Polylib.h"
+#include "polygons/TriaCodec.h"
+#include "util/poly_time.h"
+
+using namespace std;
+using namespace PolylibNS;
+
+static double wall_time()
+{
+	double usr, sys, total;
+	getrusage_sec( &usr, &sys, &total );
+	return total;
+}
+
+int main(int argc, char** argv)
+{
+	int ndiv = (argc > 1) ? atoi(argv[1]) : 256;
+	PL_REAL error_bound = (argc > 2) ? atof(argv[2]) : 1.0e-5;
+	double bandwidth = ((argc > 3) ? atof(argv[3]) : 1.0) * 1.0e9;
+	const int nrepeat = 10;
+
+	// 半径1の球面を緯度経度分割(頂点は三角形間で共有)
+	std::vector<Vertex*> verts;
+	for( int j=0; j<=ndiv; j++ ) {
+		double th = M_PI * j / ndiv;
+		for( int i=0; i<2*ndiv; i++ ) {
+			double ph = M_PI * i / ndiv;
+			verts.push_back( new Vertex( sin(th)*cos(ph), sin(th)*sin(ph), cos(th) ) );
+		}
+	}
+	std::vector<PrivateTriangle*> trias;
+	int id = 0;
+	for( int j=0; j<ndiv; j++ ) {
+		for( int i=0; i<2*ndiv; i++ ) {
+			int i1 = (i+1) % (2*ndiv);
+			Vertex* v[3];
+			v[0] = verts[ j*2*ndiv+i ];
+			v[1] = verts[ (j+1)*2*ndiv+i ];
+			v[2] = verts[ (j+1)*2*ndiv+i1 ];
+			trias.push_back( new PrivateTriangle( v, id, id/2 ) );
+			id++;
+			v[1] = verts[ (j+1)*2*ndiv+i1 ];
+			v[2] = verts[ j*2*ndiv+i1 ];
+			trias.push_back( new PrivateTriangle( v, id, id/2 ) );
+			id++;
+		}
+	}
+
+	BBox frame;
+	frame.init();
+	frame.add( Vec3<PL_REAL>(-1.0, -1.0, -1.0) );
+	frame.add( Vec3<PL_REAL>( 1.0,  1.0,  1.0) );
+
+	// 従来形式 (pack_trias/pack_tria_ids/pack_tria_exids相当)
+	std::vector<PL_REAL> raw_trias;
+	std::vector<int> raw_ids, raw_exids;
+	double t0 = wall_time();
+	for( int r=0; r<nrepeat; r++ ) {
+		raw_trias.clear(); raw_ids.clear(); raw_exids.clear();
+		for( size_t i=0; i<trias.size(); i++ ) {
+			Vertex** vlist = trias[i]->get_vertex();
+			for( int j=0; j<3; j++ ) {
+				for( int k=0; k<3; k++ ) raw_trias.push_back( (*vlist[j])[k] );
+			}
+			raw_ids.push_back( trias[i]->get_id() );
+			raw_exids.push_back( trias[i]->get_exid() );
+		}
+	}
+	double t_raw = (wall_time() - t0) / nrepeat;
+
+	// 圧縮形式
+	TriaCodec codec( error_bound );
+	std::vector<unsigned char> buf;
+	t0 = wall_time();
+	for( int r=0; r<nrepeat; r++ ) {
+		codec.begin( frame );
+		codec.add_group( 0, &trias );
+		if( codec.encode( &buf ) != PLSTAT_OK ) {
+			cerr << "encode failed" << endl;
+			return 1;
+		}
+	}
+	double t_enc = (wall_time() - t0) / nrepeat;
+
+	std::vector<TriaCodecGroup> groups;
+	t0 = wall_time();
+	for( int r=0; r<nrepeat; r++ ) {
+		if( TriaCodec::decode( &buf[0], buf.size(), &groups ) != PLSTAT_OK ) {
+			cerr << "decode failed" << endl;
+			return 1;
+		}
+	}
+	double t_dec = (wall_time() - t0) / nrepeat;
+
+	// 復号結果の検証
+	std::vector<PL_REAL> dec_trias;
+	groups[0].expand_trias( &dec_trias );
+	double max_err = 0.0, max_abs = 0.0;
+	for( size_t i=0; i<raw_trias.size(); i++ ) {
+		max_err = std::max( max_err, (double)fabs( dec_trias[i] - raw_trias[i] ) );
+		max_abs = std::max( max_abs, (double)fabs( raw_trias[i] ) );
+	}
+
+	// 許容誤差は量子化幅の半分と、復号値をPL_REALへ丸める分(1ulp)
+	double step = 2.0 * (double)error_bound;
+	double tolerance = 0.5 * step * ( 1.0 + 1.0e-12 )
+		+ max_abs * std::numeric_limits<PL_REAL>::epsilon();
+	bool ids_ok = ( groups[0].m_ids == raw_ids && groups[0].m_exids == raw_exids );
+
+	size_t raw_bytes = codec.raw_size();
+	size_t packed_bytes = buf.size();
+	double t_raw_total = t_raw + raw_bytes / bandwidth;
+	double t_packed_total = t_enc + t_dec + packed_bytes / bandwidth;
+
+	cout << "trias          = " << trias.size() << endl;
+	cout << "vertices       = " << verts.size() << endl;
+	cout << "error_bound    = " << error_bound << endl;
+	cout << "max_error      = " << max_err << endl;
+	cout << "tolerance      = " << tolerance << endl;
+	cout << "ids_match      = " << (ids_ok ? "yes" : "no") << endl;
+	cout << "raw_bytes      = " << raw_bytes << endl;
+	cout << "packed_bytes   = " << packed_bytes << endl;
+	cout << "ratio          = " << (double)raw_bytes / packed_bytes << endl;
+	cout << "raw_pack_sec   = " << t_raw << endl;
+	cout << "encode_sec     = " << t_enc << endl;
+	cout << "decode_sec     = " << t_dec << endl;
+	cout << "bandwidth_GBps = " << bandwidth * 1.0e-9 << endl;
+	cout << "raw_total_sec  = " << t_raw_total << endl;
+	cout << "packed_total_sec = " << t_packed_total << endl;
+	cout << "saved_sec      = " << t_raw_total - t_packed_total << endl;
+	// これより低い帯域なら圧縮形式の方が速い
+	double t_extra = t_enc + t_dec - t_raw;
+	if( t_extra > 0.0 ) {
+		cout << "breakeven_GBps = " << (raw_bytes - packed_bytes) / t_extra * 1.0e-9 << endl;
+	}
+
+	for( size_t i=0; i<trias.size(); i++ ) delete trias[i];
+	for( size_t i=0; i<verts.size(); i++ ) delete verts[i];
+
+	// 許容誤差を超えたら失敗
+	if( !ids_ok || max_err > tolerance ) return 1;
+	return 0;
+}
@@ -0,0 +1,190 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+//
+// 剛体インスタンシング(PolygonGroup::set_rigid_instancing())の試験。
+//  - 剛体移動後にinit()等やload_stl_file()でメッシュを置き換えると、与えた
+//    座標がそのままワールド座標になること(保留中の変換が二重に掛からないこと)
+//  - 剛体移動後にadd_dvertex()で追加した三角形と既存の三角形が、どちらも
+//    ワールド座標で正しい位置にあること
+//  - 遅延読み込みのグループでは、読み込み前に設定した変換が読み込んだ
+//    メッシュに適用されること
+//
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include "Polylib.h"
+#include "polygons/PrivateTriangle.h"
+#include "file_io/TriMeshIO.h"
+
+using namespace std;
+using namespace PolylibNS;
+
+static const char* STL_FILE = "test_rigid_instancing.stl";
+
+static int nerr = 0;
+
+static void check( bool ok, const char* what )
+{
+	if( !ok ) {
+		cerr << "NG: " << what << endl;
+		nerr++;
+	}
+}
+
+// x0を左下の頂点とする三角形1つ
+static void make_tria( PL_REAL x0, vector<PL_REAL>& vert )
+{
+	PL_REAL v[9] = { x0, 0, 0,  x0+1, 0, 0,  x0, 1, 0 };
+	vert.assign( v, v+9 );
+}
+
+// 全頂点のワールド座標でのxの最小値
+static PL_REAL world_min_x( PolygonGroup& pg )
+{
+	vector<PrivateTriangle*>* tris = pg.get_triangles();
+	PL_REAL xmin = 1e30;
+	for( size_t i=0; i<tris->size(); i++ ) {
+		Vertex** v = (*tris)[i]->get_vertex();
+		for( int k=0; k<3; k++ ) {
+			Vec3<PL_REAL> p = pg.to_world_pos( *v[k] );
+			if( p[0] < xmin ) xmin = p[0];
+		}
+	}
+	return xmin;
+}
+
+// 位置posの最近点までの距離
+static PL_REAL nearest_dist( PolygonGroup& pg, const Vec3<PL_REAL>& pos )
+{
+	PL_REAL d2 = -1;
+	if( pg.search_nearest_surface( pos, NULL, NULL, &d2 ) == NULL ) return -1;
+	return sqrt( d2 );
+}
+
+// 三角形を1つ持ち、x方向に10移動したグループ
+static void init_moved( PolygonGroup& pg )
+{
+	vector<PL_REAL> vert;
+	make_tria( 2, vert );
+	int id = 0, exid = 0;
+	pg.init( &vert[0], &id, &exid, 0, 0, 0, 1 );
+	pg.set_rigid_instancing( true );
+	PL_REAL rot[9] = { 1, 0, 0,  0, 1, 0,  0, 0, 1 };
+	pg.set_rigid_transform( rot, Vec3<PL_REAL>( 10, 0, 0 ) );
+}
+
+static void test_reinit()
+{
+	vector<PL_REAL> vert;
+	make_tria( 2, vert );
+	int id = 0, exid = 0;
+
+	{
+		PolygonGroup pg( 1e-10 );
+		init_moved( pg );
+		check( fabs( world_min_x( pg ) - 12 ) < 1e-5, "moved: x=12" );
+		pg.init( &vert[0], &id, &exid, 0, 0, 0, 1 );
+		check( fabs( world_min_x( pg ) - 2 ) < 1e-5, "init(vertlist): x=2" );
+		check( nearest_dist( pg, Vec3<PL_REAL>( 2.2, 0.2, 0 ) ) < 1e-5, "init(vertlist): search" );
+	}
+	{
+		PolygonGroup src( 1e-10 ), pg( 1e-10 );
+		src.init( &vert[0], &id, &exid, 0, 0, 0, 1 );
+		init_moved( pg );
+		pg.init( src.get_triangles(), true );
+		check( fabs( world_min_x( pg ) - 2 ) < 1e-5, "init(tri_list): x=2" );
+	}
+	{
+		PolygonGroup pg( 1e-10 );
+		init_moved( pg );
+		pg.prepare_DVertex( 1, 0 );
+		int index[3] = { 0, 1, 2 };
+		PL_REAL scalar[3] = { 1, 2, 3 };
+		pg.init_dvertex_indexed( &vert[0], 3, index, 1, NULL, NULL, scalar, NULL );
+		check( fabs( world_min_x( pg ) - 2 ) < 1e-5, "init_dvertex_indexed(): x=2" );
+	}
+	{
+		TriMesh tm;
+		int index[3] = { 0, 1, 2 };
+		tm.init_indexed( &vert[0], 3, index, 1, NULL, NULL );
+		TriMeshIO::save( tm.get_vtx_list(), tm.get_tri_list(), STL_FILE, TriMeshIO::FMT_STL_B );
+
+		map<string,string> fmap;
+		fmap[STL_FILE] = TriMeshIO::input_file_format( STL_FILE );
+		PolygonGroup pg( 1e-10 );
+		init_moved( pg );
+		pg.set_file_name( fmap );
+		pg.load_stl_file( 1.0 );
+		check( fabs( world_min_x( pg ) - 2 ) < 1e-5, "load_stl_file(): x=2" );
+
+		// 遅延読み込みでは、読み込み前の変換が読み込んだメッシュに掛かる
+		PolygonGroup pd( 1e-10 );
+		pd.set_file_name( fmap );
+		pd.defer_load( false, ID_BIN, 1.0 );
+		pd.set_rigid_instancing( true );
+		PL_REAL rot[9] = { 1, 0, 0,  0, 1, 0,  0, 0, 1 };
+		pd.set_rigid_transform( rot, Vec3<PL_REAL>( 10, 0, 0 ) );
+		check( pd.load_deferred() == PLSTAT_OK, "deferred: load" );
+		check( fabs( world_min_x( pd ) - 12 ) < 1e-5, "deferred: x=12" );
+		check( nearest_dist( pd, Vec3<PL_REAL>( 12.2, 0.2, 0 ) ) < 1e-5, "deferred: search" );
+		remove( STL_FILE );
+	}
+}
+
+static void test_add_dvertex()
+{
+	PolygonGroup pg( 1e-10 );
+	pg.prepare_DVertex( 1, 0 );
+	vector<PL_REAL> vert;
+	make_tria( 2, vert );
+	int index[3] = { 0, 1, 2 };
+	PL_REAL scalar[3] = { 1, 2, 3 };
+	pg.init_dvertex_indexed( &vert[0], 3, index, 1, NULL, NULL, scalar, NULL );
+	pg.set_rigid_instancing( true );
+	PL_REAL rot[9] = { 1, 0, 0,  0, 1, 0,  0, 0, 1 };
+	pg.set_rigid_transform( rot, Vec3<PL_REAL>( 10, 0, 0 ) );
+
+	// ワールド座標x=20に三角形を追加
+	vector<PL_REAL> add;
+	make_tria( 20, add );
+	int id = 1, exid = 0;
+	pg.add_dvertex( &add[0], &id, &exid, scalar, NULL, 0, 0, 0, 0, 0, 1, 1, 0 );
+	pg.rebuild_polygons();
+
+	check( pg.get_triangles()->size() == 2, "add_dvertex: 2 triangles" );
+	check( fabs( world_min_x( pg ) - 12 ) < 1e-5, "add_dvertex: existing x=12" );
+	check( nearest_dist( pg, Vec3<PL_REAL>( 12.2, 0.2, 0 ) ) < 1e-5, "add_dvertex: search existing" );
+	check( nearest_dist( pg, Vec3<PL_REAL>( 20.2, 0.2, 0 ) ) < 1e-5, "add_dvertex: search added" );
+}
+
+int main( int argc, char** argv )
+{
+	test_reinit();
+	test_add_dvertex();
+
+	if( nerr != 0 ) {
+		cout << "FAILED: " << nerr << " errors" << endl;
+		return 1;
+	}
+	cout << "PASS" << endl;
+	return 0;
+}
@@ -0,0 +1,236 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+//
+// 稜線表とシェル(TriangleAdjacency)の試験。
+//  - 離れた2つの閉じた四面体: シェル数2、両方閉じている、境界・向き違い稜線なし
+//  - 開いた面(2x2の格子): シェル数1、閉じていない、境界稜線は外周の8本
+//  - 1面だけ裏返した四面体: シェル数1、閉じていない、境界稜線なし、
+//    向き違い稜線は裏返した面の3辺
+//  - 以上を1つのメッシュにまとめた場合のシェル毎の判定
+//
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <utility>
+#include "Polylib.h"
+
+using namespace std;
+using namespace PolylibNS;
+
+static int nerr = 0;
+
+static void check( bool ok, const char* what )
+{
+	if( !ok ) {
+		cerr << "NG: " << what << endl;
+		nerr++;
+	}
+}
+
+// 外向きに揃った四面体を追加する
+static void add_tet( vector<PL_REAL>& coords, vector<int>& index,
+	PL_REAL ox, bool flip_last )
+{
+	int v0 = (int)coords.size()/3;
+	PL_REAL p[4][3] = { {0,0,0}, {1,0,0}, {0,1,0}, {0,0,1} };
+	for( int i=0; i<4; i++ ) {
+		coords.push_back( p[i][0]+ox );
+		coords.push_back( p[i][1] );
+		coords.push_back( p[i][2] );
+	}
+	int f[4][3] = { {0,2,1}, {0,1,3}, {0,3,2}, {1,2,3} };
+	if( flip_last ) {
+		f[3][1] = 3;
+		f[3][2] = 2;
+	}
+	for( int i=0; i<4; i++ ) {
+		for( int k=0; k<3; k++ ) index.push_back( v0+f[i][k] );
+	}
+}
+
+// 2x2の格子の開いた面を追加する
+static void add_sheet( vector<PL_REAL>& coords, vector<int>& index, PL_REAL ox )
+{
+	int v0 = (int)coords.size()/3;
+	for( int j=0; j<=2; j++ ) {
+		for( int i=0; i<=2; i++ ) {
+			coords.push_back( ox+i );
+			coords.push_back( j );
+			coords.push_back( 0 );
+		}
+	}
+	for( int j=0; j<2; j++ ) {
+		for( int i=0; i<2; i++ ) {
+			int a = v0 + j*3 + i;
+			index.push_back( a );   index.push_back( a+1 ); index.push_back( a+4 );
+			index.push_back( a );   index.push_back( a+4 ); index.push_back( a+3 );
+		}
+	}
+}
+
+// 稜線の頂点番号の組(小,大)
+static pair<int,int> edge_key( const TriangleAdjacency& adj, int e )
+{
+	int a, b;
+	adj.edge_vertices( e, &a, &b );
+	return a < b ? make_pair( a, b ) : make_pair( b, a );
+}
+
+static bool build( TriMesh& tm, TriangleAdjacency& adj,
+	const vector<PL_REAL>& coords, const vector<int>& index )
+{
+	if( tm.init_indexed( &coords[0], (int)coords.size()/3,
+			&index[0], (int)index.size()/3, NULL, NULL ) != PLSTAT_OK ) return false;
+	if( adj.build( tm.get_vtx_list(), tm.get_tri_list() ) != PLSTAT_OK ) return false;
+	adj.label_shells();
+	return true;
+}
+
+static void test_closed_tets()
+{
+	vector<PL_REAL> coords;
+	vector<int> index;
+	add_tet( coords, index, 0, false );
+	add_tet( coords, index, 3, false );
+
+	TriMesh tm;
+	TriangleAdjacency adj;
+	check( build( tm, adj, coords, index ), "tets: build" );
+	check( adj.num_shells() == 2, "tets: num_shells == 2" );
+	for( int s=0; s<adj.num_shells(); s++ ) {
+		check( adj.is_shell_closed( s ), "tets: shell closed" );
+		check( adj.shell_num_triangles( s ) == 4, "tets: shell has 4 triangles" );
+	}
+	vector<int> edges;
+	adj.boundary_edges( &edges );
+	check( edges.empty(), "tets: no boundary edges" );
+	adj.misoriented_edges( &edges );
+	check( edges.empty(), "tets: no misoriented edges" );
+	check( adj.is_closed(), "tets: is_closed" );
+}
+
+static void test_open_sheet()
+{
+	vector<PL_REAL> coords;
+	vector<int> index;
+	add_sheet( coords, index, 0 );
+
+	TriMesh tm;
+	TriangleAdjacency adj;
+	check( build( tm, adj, coords, index ), "sheet: build" );
+	check( adj.num_shells() == 1, "sheet: num_shells == 1" );
+	if( adj.num_shells() == 1 ) {
+		check( !adj.is_shell_closed( 0 ), "sheet: shell open" );
+	}
+	check( !adj.is_closed(), "sheet: !is_closed" );
+
+	// 外周の稜線(中央の頂点4を含まず、両端が同じ辺上にある)
+	vector<int> edges;
+	adj.boundary_edges( &edges );
+	check( edges.size() == 8, "sheet: 8 boundary edges" );
+	for( size_t i=0; i<edges.size(); i++ ) {
+		pair<int,int> k = edge_key( adj, edges[i] );
+		int ai = k.first%3, aj = k.first/3, bi = k.second%3, bj = k.second/3;
+		bool on_side = ( ai == bi && ( ai == 0 || ai == 2 ) ) ||
+			( aj == bj && ( aj == 0 || aj == 2 ) );
+		check( on_side, "sheet: boundary edge on perimeter" );
+	}
+	adj.misoriented_edges( &edges );
+	check( edges.empty(), "sheet: no misoriented edges" );
+}
+
+static void test_flipped_face()
+{
+	vector<PL_REAL> coords;
+	vector<int> index;
+	add_tet( coords, index, 0, true );
+
+	TriMesh tm;
+	TriangleAdjacency adj;
+	check( build( tm, adj, coords, index ), "flipped: build" );
+	check( adj.num_shells() == 1, "flipped: num_shells == 1" );
+	if( adj.num_shells() == 1 ) {
+		check( !adj.is_shell_closed( 0 ), "flipped: shell not closed" );
+	}
+	check( !adj.is_closed(), "flipped: !is_closed" );
+
+	vector<int> edges;
+	adj.boundary_edges( &edges );
+	check( edges.empty(), "flipped: no boundary edges" );
+
+	// 裏返した面(頂点1,2,3)の3辺
+	adj.misoriented_edges( &edges );
+	check( edges.size() == 3, "flipped: 3 misoriented edges" );
+	set< pair<int,int> > expect;
+	expect.insert( make_pair( 1, 2 ) );
+	expect.insert( make_pair( 1, 3 ) );
+	expect.insert( make_pair( 2, 3 ) );
+	for( size_t i=0; i<edges.size(); i++ ) {
+		check( expect.count( edge_key( adj, edges[i] ) ) == 1,
+			"flipped: misoriented edge on flipped face" );
+	}
+}
+
+static void test_mixed()
+{
+	vector<PL_REAL> coords;
+	vector<int> index;
+	add_tet( coords, index, 0, false );		// 三角形 0-3
+	add_sheet( coords, index, 3 );			// 三角形 4-11
+	add_tet( coords, index, 7, true );		// 三角形 12-15
+	add_tet( coords, index, 10, false );	// 三角形 16-19
+
+	TriMesh tm;
+	TriangleAdjacency adj;
+	check( build( tm, adj, coords, index ), "mixed: build" );
+	check( adj.num_shells() == 4, "mixed: num_shells == 4" );
+	if( adj.num_shells() != 4 ) return;
+
+	// シェル番号は最小の三角形番号の順
+	int first[4] = { 0, 4, 12, 16 };
+	int ntri[4] = { 4, 8, 4, 4 };
+	bool closed[4] = { true, false, false, true };
+	for( int s=0; s<4; s++ ) {
+		check( adj.get_shell( first[s] ) == s, "mixed: shell order" );
+		check( adj.shell_num_triangles( s ) == ntri[s], "mixed: shell triangles" );
+		check( adj.is_shell_closed( s ) == closed[s], "mixed: shell closed" );
+	}
+	check( !adj.is_closed(), "mixed: !is_closed" );
+
+	vector<int> edges;
+	adj.boundary_edges( &edges );
+	check( edges.size() == 8, "mixed: 8 boundary edges" );
+	adj.misoriented_edges( &edges );
+	check( edges.size() == 3, "mixed: 3 misoriented edges" );
+}
+
+int main( int argc, char** argv )
+{
+	test_closed_tets();
+	test_open_sheet();
+	test_flipped_face();
+	test_mixed();
+
+	if( nerr != 0 ) {
+		cout << "FAILED: " << nerr << " errors" << endl;
+		return 1;
+	}
+	cout << "PASS" << endl;
+	return 0;
+}
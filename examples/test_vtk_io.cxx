@@ -0,0 +1,194 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+//
+// VTKレガシー形式(アスキー/バイナリ)とVTU形式の保存・読み込みの往復試験。
+// 連番でない三角形ID、頂点スカラー・ベクトルを持つメッシュを保存し、
+// TriMeshIO::load_indexed()で読み戻して三角形の頂点座標、ID、頂点データを比較する。
+// レガシー形式はIDを出力しないので、読み戻したIDが振り直されることを確認する。
+//
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include "Polylib.h"
+#include "polygons/DVertex.h"
+#include "file_io/TriMeshIO.h"
+
+using namespace std;
+using namespace PolylibNS;
+
+// 格子状の三角形メッシュ。頂点は三角形間で共有する
+static void make_grid(
+	int					n,
+	std::vector<PL_REAL>	*coords,
+	std::vector<int>		*index,
+	std::vector<int>		*ids,
+	std::vector<int>		*exids,
+	std::vector<PL_REAL>	*scalars,
+	std::vector<PL_REAL>	*vectors
+	)
+{
+	for( int j=0; j<=n; j++ ) {
+		for( int i=0; i<=n; i++ ) {
+			PL_REAL x = 0.25*i, y = 0.5*j, z = 0.125*i*j;
+			coords->push_back(x); coords->push_back(y); coords->push_back(z);
+			scalars->push_back( x + 2*y );
+			vectors->push_back(y); vectors->push_back(z); vectors->push_back(x);
+		}
+	}
+	for( int j=0; j<n; j++ ) {
+		for( int i=0; i<n; i++ ) {
+			int a = j*(n+1) + i;
+			int t[2][3] = { { a, a+1, a+n+1 }, { a+1, a+n+2, a+n+1 } };
+			for( int k=0; k<2; k++ ) {
+				for( int c=0; c<3; c++ ) index->push_back( t[k][c] );
+				int ntri = (int)ids->size();
+				ids->push_back( 1000 + 7*ntri );
+				exids->push_back( ntri % 5 );
+			}
+		}
+	}
+}
+
+// 三角形の頂点座標(とIDを使う場合はID)が一致するか
+static int compare_mesh(
+	const std::string&		fmt,
+	TriMesh&				src,
+	const VtkMesh&			mesh,
+	bool					with_id,
+	bool					with_data
+	)
+{
+	std::vector<PrivateTriangle*>* tl = src.get_tri_list();
+	int nerr = 0;
+	if( mesh.ntri() != (int)tl->size() ) {
+		cout << fmt << ": ntri " << mesh.ntri() << " != " << tl->size() << endl;
+		return 1;
+	}
+	if( with_id ) {
+		if( mesh.ids.size() != tl->size() || mesh.exids.size() != tl->size() ) {
+			cout << fmt << ": id/exid arrays are missing" << endl;
+			return 1;
+		}
+	}
+	else if( !mesh.ids.empty() ) {
+		cout << fmt << ": unexpected id array" << endl;
+		nerr++;
+	}
+	if( with_data && ( mesh.nscalar != 1 || mesh.nvector != 1 ) ) {
+		cout << fmt << ": nscalar=" << mesh.nscalar << " nvector=" << mesh.nvector << endl;
+		return 1;
+	}
+
+	for( size_t t=0; t<tl->size(); t++ ) {
+		PrivateTriangle* tri = (*tl)[t];
+		if( with_id && ( mesh.ids[t] != tri->get_id() || mesh.exids[t] != tri->get_exid() ) ) {
+			cout << fmt << ": triangle " << t << " id " << mesh.ids[t] << " != " << tri->get_id() << endl;
+			nerr++;
+		}
+		Vertex** v = tri->get_vertex();
+		for( int c=0; c<3; c++ ) {
+			int iv = mesh.index[t*3+c];
+			for( int k=0; k<3; k++ ) {
+				if( fabs( mesh.coords[iv*3+k] - (*v[c])[k] ) > 1e-6 ) nerr++;
+			}
+			if( with_data ) {
+				DVertex* dv = dynamic_cast<DVertex*>( v[c] );
+				PL_REAL s = dv->get_scalar( 0 );
+				Vec3<PL_REAL> w;
+				dv->get_vector( 0, &w );
+				if( fabs( mesh.scalars[iv] - s ) > 1e-6 ) nerr++;
+				for( int k=0; k<3; k++ ) {
+					if( fabs( mesh.vectors[iv*3+k] - w[k] ) > 1e-6 ) nerr++;
+				}
+			}
+		}
+	}
+	if( nerr != 0 ) cout << fmt << ": " << nerr << " mismatches" << endl;
+	return nerr;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<PL_REAL> coords, scalars, vectors;
+	std::vector<int> index, ids, exids;
+	make_grid( 8, &coords, &index, &ids, &exids, &scalars, &vectors );
+	int nvert = (int)coords.size() / 3;
+	int ntri = (int)index.size() / 3;
+
+	TriMesh src;
+	src.prepare_DVertex( 1, 1 );
+	if( src.init_dvertex_indexed( &coords[0], nvert, &index[0], ntri,
+			&ids[0], &exids[0], &scalars[0], &vectors[0], false ) != PLSTAT_OK ) {
+		cout << "init_dvertex_indexed failed" << endl;
+		return 1;
+	}
+
+	const std::string fmts[3] = { TriMeshIO::FMT_VTK_A, TriMeshIO::FMT_VTK_B, TriMeshIO::FMT_VTU };
+	const std::string fnames[3] = { "test_vtk_io_a.vtk", "test_vtk_io_b.vtk", "test_vtk_io.vtu" };
+	int nerr = 0;
+	for( int f=0; f<3; f++ ) {
+		if( TriMeshIO::save( src.get_vtx_list(), src.get_tri_list(), fnames[f], fmts[f] ) != PLSTAT_OK ) {
+			cout << fmts[f] << ": save failed" << endl;
+			nerr++;
+			continue;
+		}
+		std::string fmt = TriMeshIO::input_file_format( fnames[f] );
+		if( fmt != fmts[f] ) {
+			cout << fmts[f] << ": detected as " << fmt << endl;
+			nerr++;
+		}
+		VtkMesh mesh;
+		if( TriMeshIO::load_indexed( fnames[f], fmts[f], &mesh ) != PLSTAT_OK ) {
+			cout << fmts[f] << ": load_indexed failed" << endl;
+			nerr++;
+			continue;
+		}
+		bool vtu = ( fmts[f] == TriMeshIO::FMT_VTU );
+		nerr += compare_mesh( fmts[f], src, mesh, vtu, true );
+
+		// 読み戻したメッシュからTriMeshを作る。レガシー形式はIDが0から振り直される
+		TriMesh dst;
+		if( dst.init_indexed( &mesh.coords[0], mesh.nvert(), &mesh.index[0], mesh.ntri(),
+				mesh.ids.empty() ? NULL : &mesh.ids[0],
+				mesh.exids.empty() ? NULL : &mesh.exids[0] ) != PLSTAT_OK ) {
+			cout << fmts[f] << ": init_indexed failed" << endl;
+			nerr++;
+			continue;
+		}
+		std::vector<PrivateTriangle*>* tl = dst.get_tri_list();
+		for( size_t t=0; t<tl->size(); t++ ) {
+			int expect = vtu ? ids[t] : (int)t;
+			if( (*tl)[t]->get_id() != expect ) {
+				cout << fmts[f] << ": reloaded triangle " << t << " id " << (*tl)[t]->get_id()
+					<< " != " << expect << endl;
+				nerr++;
+				break;
+			}
+		}
+		remove( fnames[f].c_str() );
+	}
+
+	if( nerr != 0 ) {
+		cout << "FAILED: " << nerr << " errors" << endl;
+		return 1;
+	}
+	cout << "PASS" << endl;
+	return 0;
+}
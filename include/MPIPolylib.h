@@ -28,6 +28,7 @@
 #include "groups/PolygonGroup.h"
 #include "polygons/DVertexTriangle.h"
 #include "polygons/DVertex.h"
+#include "polygons/TriaCodec.h"
 #include "file_io/TriMeshIO.h"
 
 // MPI通信用メッセージタグ
@@ -40,6 +41,7 @@
 #define MPITAG_TRIA_NDATA			7
 #define MPITAG_TRIA_SCALAR			8
 #define MPITAG_TRIA_VECTOR			9
+#define MPITAG_PACKED_TRIAS			10
 
 //#define PL_MPI_REAL MPI_DOUBLE
 #ifdef PL_REAL_FLOAT
@@ -220,9 +222,14 @@ public:
 	///   polylib_config_ランク番号_付加文字列.tpp
 	/// STL/OBJファイル命名規則は以下の通り
 	///   ポリゴングループ名称_ランク番号_付加文字列.拡張子
+	/// "vtu"の場合は、rank0がリーフグループ毎に各rankのピースをまとめた
+	///   ポリゴングループ名称_付加文字列.pvtu
+	/// も書き出す(三角形データのrank0への集約は行わない)。一覧には
+	/// ピースを出力したrankだけを載せ、どのrankにも三角形が無いグループの
+	/// .pvtuは出力しない。
 	///
 	/// @param[out] p_config_filename	設定ファイル名返却用stringインスタンスへのポインタ
-	/// @param[in] stl_format	STL/OBJファイルフォーマット。 "stl_a":アスキー形式　"stl_b":バイナリ形式 "obj_a":アスキー形式　"obj_b","obj_bb":バイナリ形式,"obj_bb"は、頂点法線付き。
+	/// @param[in] stl_format	STL/OBJファイルフォーマット。 "stl_a":アスキー形式　"stl_b":バイナリ形式 "obj_a":アスキー形式　"obj_b","obj_bb":バイナリ形式,"obj_bb"は、頂点法線付き。"vtu":VTK XML形式。
 	/// @param[in]  extend				ファイル名に付加する文字列。省略可。省略
 	///									した場合は、付加文字列として本メソッド呼
 	///									び出し時の年月日時分秒(YYYYMMDD24hhmmss)
@@ -238,6 +245,32 @@ public:
 		ID_FORMAT	id_format = ID_BIN
 		);
 
+	///
+	/// 全rank並列でのデータの非同期保存。
+	/// save_parallel()と同じファイルを出力するが、各rankはポリゴンデータを
+	/// 複製した時点で戻り、STL/OBJファイルとIDファイルはバックグラウンドの
+	/// スレッドで書き出す。設定ファイルと"vtu"の.pvtuは戻る前に書き出す。
+	/// 完了の確認はsave_async_busy()、save_async_wait()で行う。
+	/// 全rankで呼び出すこと。
+	///
+	/// @param[out] p_config_filename	設定ファイル名返却用stringインスタンスへのポインタ
+	/// @param[in] stl_format	save_parallel()参照。
+	/// @param[in] extend		save_parallel()参照。
+	/// @param[in] id_format	三角形IDファイルの出力形式。
+	/// @param[in] block		いずれかのrankで前回の非同期保存が実行中の場合、
+	///							true:終了を待ってから保存する。
+	///							false:全rankで保存せずにPLSTAT_SAVE_BUSYを返す。
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT
+		save_parallel_async(
+		std::string *p_config_filename,
+		std::string stl_format,
+		std::string extend = "",
+		ID_FORMAT	id_format = ID_BIN,
+		bool		block = true
+		);
+
 	///
 	/// ポリゴン座標の移動。
 	/// 本クラスインスタンス配下の全PolygonGroupのmoveメソッドが呼び出される。
@@ -254,12 +287,85 @@ public:
 	/// ポリゴンデータのPE間移動。
 	/// 本クラスインスタンス配下の全PolygonGroupのポリゴンデータについて、
 	/// moveメソッドにより移動した三角形ポリゴン情報を隣接PE間でやり取りする。
+	/// DVertexを持つ移動可能なグループは、圧縮形式を用いて頂点のスカラー/
+	/// ベクター値も送る(圧縮形式未設定時は座標も無損失)。グループ毎の送信形式は
+	/// update_migration_format()で決めたものを用いる。
 	///
 	/// @return	POLYLIB_STATで定義される値が返る。
 	///
 	POLYLIB_STAT
 		migrate();
 
+	///
+	/// migrate()およびrank0からの分配で用いる三角形送受信形式の設定。
+	/// 圧縮形式では頂点座標を送信先gcell bboxを基準に量子化し、
+	/// 共有頂点の一括送信とIDの差分符号化を行う(TriaCodec参照)。
+	/// @attention 全rankで同じ値を指定すること。
+	///
+	/// @param[in] flag			true:圧縮形式 false:従来形式
+	/// @param[in] error_bound	頂点座標の許容誤差。0の場合は座標を量子化しない。
+	///							ポリゴングループの頂点同一性判定基準値より
+	///							小さい値を推奨。
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT
+		set_packed_transfer(
+		bool flag,
+		PL_REAL error_bound = 1.0e-6
+		);
+
+	///
+	/// 圧縮形式が有効かどうかを返す。
+	///
+	bool is_packed_transfer() const { return m_packed_transfer; }
+
+	///
+	/// migrate()のグループ毎の送信形式を決める。いずれかのrankでDVertexを持つ
+	/// 移動可能なグループは圧縮形式で送る。load_rank0()、load_parallel()の後と、
+	/// 初回のmigrate()で自動的に呼ばれる。
+	/// @attention 全rankで呼ぶこと(MPI_Allreduceを1回行う)。読み込み後に
+	///				make_DVertex_PolygonGroup()やset_movable()でグループの構成を
+	///				変えた場合は、次のmigrate()の前に呼ぶこと。
+	///
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT
+		update_migration_format();
+
+	///
+	/// 圧縮形式での送信統計を返す。値は自rankでの累計。
+	///
+	/// @param[out] raw_bytes		従来形式で送った場合のバイト数
+	/// @param[out] packed_bytes	実際に送信したバイト数
+	/// @param[out] codec_time		符号化/復号に要した時間(秒)
+	///
+	void get_packed_transfer_stats(
+		size_t* raw_bytes,
+		size_t* packed_bytes,
+		double* codec_time
+		) const;
+
+	///
+	/// 圧縮形式での送信統計をクリアする。
+	///
+	void reset_packed_transfer_stats();
+
+	///
+	/// 計測結果(PolylibProfiler)を全rankで集計してrank0で出力する。
+	/// フェーズ時間とカウンタはMPIのリダクションで最小/最大/合計を求め、
+	/// 隣接PE別の送受信バイト数とイベントはrank0へ集めて出力する。
+	/// @attention 全rankで呼ぶこと。
+	///
+	/// @param[in] json_file	JSON出力ファイル名
+	/// @param[in] trace_file	Chrome trace出力ファイル名。空文字列の場合は出力しない。
+	/// @return	POLYLIB_STATで定義される値が返る。rank0での出力結果が全rankに返る。
+	///
+	POLYLIB_STAT
+		write_profile(
+		const std::string& json_file,
+		const std::string& trace_file = ""
+		);
+
 	///
 	/// m_myprocの内容をget
 	/// @return 自PE領域情報
@@ -271,9 +377,59 @@ public:
 	///
 	/// @return 利用中のメモリ量(byte)
 	///
-	unsigned int used_memory_size();
+	unsigned long long used_memory_size();
+
+	///
+	/// MPIPolylibが利用中のメモリ量を構造別に返す。
+	/// Polylib::memory_usage()の内訳にPE領域情報と移動除外リストを
+	/// 通信用領域として加える。
+	///
+	/// @param[out] p_groups	グループごとの内訳。NULL可。
+	/// @return 自PEの内訳(byte)
+	///
+	PolylibMemoryUsage memory_usage(
+		std::vector<std::pair<std::string, PolylibMemoryUsage> >* p_groups = NULL
+		);
+
+	///
+	/// 全PEのメモリ利用量を集計する。全rankで呼び出すこと。
+	/// 結果は全rankに返る。
+	///
+	/// @param[out] p_min		項目ごとのPE間最小値。NULL可。
+	/// @param[out] p_max		項目ごとのPE間最大値。NULL可。
+	/// @param[out] p_sum		項目ごとの全PE合計。NULL可。
+	/// @param[out] p_groups	グループごとの全PE合計。NULL可。
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT
+		reduce_memory_usage(
+		PolylibMemoryUsage* p_min,
+		PolylibMemoryUsage* p_max,
+		PolylibMemoryUsage* p_sum,
+		std::vector<std::pair<std::string, PolylibMemoryUsage> >* p_groups = NULL
+		);
 
 protected:
+	///
+	/// save_parallel()の本体。
+	///
+	/// @param[out] p_config_filename	設定ファイル名返却用stringインスタンスへのポインタ
+	/// @param[in] stl_format	save_parallel()参照。
+	/// @param[in] extend		save_parallel()参照。
+	/// @param[in] id_format	三角形IDファイルの出力形式。
+	/// @param[out] snapshot	NULL以外の場合、STL/OBJファイルとIDファイルは
+	///							出力せず、出力内容の複製を追加する(非同期保存用)。
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT
+		save_parallel_files(
+		std::string *p_config_filename,
+		std::string stl_format,
+		std::string extend,
+		ID_FORMAT	id_format,
+		std::vector<CheckpointPiece*>	*snapshot
+		);
+
 	///
 	/// コンストラクタ。
 	/// singletonのため非公開。本クラスインスタンス取得にはget_instance()を利用する。
@@ -334,12 +490,72 @@ protected:
 	///
 	/// @param[in,out] p_vec 情報追加先ベクタ
 	/// @param[in] p_trias グループ内三角形リスト
+	/// @param[in] p_pg 三角形の属するグループ。剛体インスタンシングのグループは
+	///				頂点座標をワールド座標系に変換して追加する。NULL可。
 	/// @return	POLYLIB_STATで定義される値が返る。
 	///
 	POLYLIB_STAT
 		pack_trias(
 		std::vector<PL_REAL>* p_vec,
-		const std::vector<PrivateTriangle*>* p_trias
+		const std::vector<PrivateTriangle*>* p_trias,
+		const PolygonGroup* p_pg = NULL
+		);
+
+	///
+	/// 指定rankの領域へ送る三角形を圧縮形式で送信。
+	/// p_trias_listはm_pg_listと同じ並びのグループ毎三角形リスト。
+	///
+	/// @param[in] p_proc		送信先PE担当領域情報
+	/// @param[in] p_trias_list	グループ毎三角形リスト(要素NULL可)
+	/// @param[out] p_buf		送信バッファ。非同期送信時は完了まで保持すること。
+	/// @param[out] p_req		非同期送信時のリクエスト。NULLなら同期送信。
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT
+		send_packed_trias(
+		ParallelInfo* p_proc,
+		const std::vector<const std::vector<PrivateTriangle*>*>& p_trias_list,
+		std::vector<unsigned char>* p_buf,
+		MPI_Request* p_req
+		);
+
+	///
+	/// migrate()でグループを圧縮形式で送るかを返す。
+	/// 圧縮形式が有効な場合と、update_migration_format()でDVertexを持つと
+	/// 判定された場合にtrue。全rankで同じ値となる。
+	///
+	/// @param[in] index	m_pg_list内の添字
+	/// @return	圧縮形式で送る場合true
+	///
+	bool
+		use_packed_migration( size_t index ) const;
+
+	///
+	/// 圧縮形式の三角形情報を受信して復号。
+	///
+	/// @param[in] rank			送信元rank
+	/// @param[out] p_groups	グループ単位の復号結果
+	/// @param[out] p_size		受信バイト数(NULL可)
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT
+		recv_packed_trias(
+		int rank,
+		std::vector<TriaCodecGroup>* p_groups,
+		size_t* p_size = NULL
+		);
+
+	///
+	/// 復号した三角形情報を各ポリゴングループへ追加(migrate用)。
+	/// 共有頂点は頂点1つにつきVertexを1つだけ生成する。
+	/// DVertexのデータを持つグループはDVertex,DVertexTriangleとして復元する。
+	///
+	/// @param[in] groups	グループ単位の復号結果
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT
+		add_packed_trias(
+		const std::vector<TriaCodecGroup>& groups
 		);
 
 	///
@@ -490,6 +706,24 @@ protected:
 
 	/// 自プロセスが利用するコミュニケーター
 	MPI_Comm m_mycomm;
+
+	/// 三角形送受信に圧縮形式を用いるか
+	bool m_packed_transfer;
+
+	/// 圧縮形式の頂点座標許容誤差
+	PL_REAL m_packed_error_bound;
+
+	/// migrate()でDVertexのデータごと送るグループ(m_pg_listと同じ並び)
+	std::vector<char> m_dvertex_migration;
+
+	/// 圧縮形式の統計: 従来形式換算バイト数
+	size_t m_packed_raw_bytes;
+
+	/// 圧縮形式の統計: 送信バイト数
+	size_t m_packed_bytes;
+
+	/// 圧縮形式の統計: 符号化/復号時間(秒)
+	double m_packed_time;
 };
 
 
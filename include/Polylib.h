@@ -27,20 +27,19 @@
 #include "polygons/DVertexTriangle.h"
 #include "groups/PolygonGroup.h"
 #include "groups/PolygonGroupFactory.h"
+#include "groups/NearestQuerySession.h"
 #include "common/PolylibStat.h"
 #include "common/PolylibCommon.h"
+#include "common/PolylibMemoryUsage.h"
 #include "common/BBox.h"
 #include "common/Vec3.h"
+#include "util/TriangleBins.h"
+#include "polygons/TriangleAdjacency.h"
+#include "polygons/TrianglePair.h"
 
 #include "TextParser.h"
 #include "polyVersion.h"
 
-//#define TIME_MEASURE
-#ifdef TIME_MEASURE
-#include <stdio.h>
-#include <time.h>
-#endif // TIME_MEASURE
-
 #ifdef WIN32
 #include <stdio.h>
 #include <time.h>
@@ -52,6 +51,8 @@ using namespace Vec3class;
 namespace PolylibNS {
 
 class VertKDT;
+class CheckpointWriter;
+struct CheckpointPiece;
 
 ////////////////////////////////////////////////////////////////////////////
 ///
@@ -153,6 +154,98 @@ public:
 		PL_REAL				scale = 1.0
 		);
 
+	///
+	/// load()でリーフグループを並列に読み込むスレッド数の設定。
+	/// ファイル読み込み、頂点の併合、KD木の構築をグループ単位で並列に行う。
+	/// 三角形IDはグループ毎に付けるので、結果は逐次の読み込みと同じになる。
+	/// OpenMP無効時は常に逐次に読み込む。
+	///
+	///  @param[in] nthreads	スレッド数。1:逐次(デフォルト)。
+	///							0:OpenMPの最大スレッド数。
+	///  @attention	PolygonGroupを継承してload_stl_file()、load_id_file()を
+	///				再定義している場合は、再定義した処理がスレッド安全であること。
+	///
+	void set_load_threads(
+		int					nthreads
+		);
+
+	///
+	/// 並列読み込みのスレッド数を取得。
+	///
+	int get_load_threads() const {
+		return m_load_threads;
+	}
+
+	///
+	/// load()でリーフグループを遅延読み込みにするかの設定。
+	/// 有効にすると、load()はグループツリーとファイル名、外接矩形ファイル
+	/// (ポリゴンファイル名+".bbox")の矩形だけを登録し、ポリゴンファイルの
+	/// 読み込みとKD木の構築は、各グループの三角形を最初に参照した時点か
+	/// prefetch()で行う。外接矩形が分かっているグループは、検索範囲と
+	/// 交差しない矩形検索では読み込まれない。
+	///
+	///  @param[in] lazy	true:遅延読み込み / false:load()で全て読み込む(デフォルト)。
+	///  @attention	移動対象のグループはmove()の前に読み込まれる。save()は全グループを
+	///				読み込んでから保存する。外接矩形ファイルはsave_bbox_index()で作成する。
+	///
+	void set_lazy_load(
+		bool				lazy
+		) {
+		m_lazy_load = lazy;
+	}
+
+	///
+	/// 遅延読み込みの設定を取得。
+	///
+	bool get_lazy_load() const {
+		return m_lazy_load;
+	}
+
+	///
+	/// 遅延読み込み中のグループを先に読み込む。
+	/// group_nameで指定したグループと、その子孫のリーフグループを読み込む。
+	/// set_load_threads()のスレッド数でグループ単位に並列に読み込む。
+	///
+	///  @param[in] group_name	グループ名。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT prefetch(
+		std::string			group_name
+		);
+
+	///
+	/// 全リーフグループの外接矩形ファイル(ポリゴンファイル名+".bbox")を作成する。
+	/// 遅延読み込みのload()は、このファイルの矩形でグループの読み込みを省く。
+	///
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention	遅延読み込み中のグループは読み込んでから矩形を求める。
+	///
+	POLYLIB_STAT save_bbox_index();
+
+	///
+	/// 読み込み結果のキャッシュディレクトリの設定。
+	/// 設定すると、load()は入力ファイル(パス・サイズ・更新時刻)と読み込み条件
+	/// (縮尺、頂点同一性の基準値、KD木の最大要素数等)が一致するキャッシュが
+	/// あればそこから頂点・三角形とKD木を復元し、無ければ読み込んだ結果を
+	/// キャッシュに保存する。キャッシュはmmap()して読み込む。
+	///
+	///  @param[in] dir	キャッシュディレクトリ(作成済みであること)。
+	///					空文字列でキャッシュを使わない(デフォルト)。
+	///  @attention	同じディレクトリを複数のプロセスで共有してよい。
+	///
+	void set_cache_dir(
+		std::string			dir
+		) {
+		m_cache_dir = dir;
+	}
+
+	///
+	/// キャッシュディレクトリを取得。
+	///
+	std::string get_cache_dir() const {
+		return m_cache_dir;
+	}
+
 	///
 	/// PolygoGroupツリー、三角形ポリゴン情報の保存。
 	/// グループツリーの情報を設定ファイルへ出力。三角形ポリゴン情報をSTL
@@ -175,6 +268,43 @@ public:
 		std::string			extend = ""
 		);
 
+	///
+	/// PolygoGroupツリー、三角形ポリゴン情報の非同期保存。
+	/// save()と同じファイルを出力するが、三角形ポリゴン情報を複製した時点で戻り、
+	/// STLファイルはバックグラウンドのスレッドで出力する。設定ファイルは
+	/// 戻る前に出力する。戻った後は三角形ポリゴンを移動・変更してよい。
+	///
+	///	 @param[out] p_config_name	保存した設定ファイル名の返却用。
+	///  @param[in]	 stl_format		save()参照。
+	///  @param[in]	 extend			save()参照。
+	///  @param[in]	 block			前回の非同期保存が実行中の場合、
+	///								true:終了を待ってから保存する。
+	///								false:保存せずにPLSTAT_SAVE_BUSYを返す。
+	///  @return	POLYLIB_STATで定義される値が返る。STLファイル出力の結果は
+	///				save_async_wait()で取得する。
+	///  @attention	STLファイル出力が終わるまでは、設定ファイルを読み込まないこと。
+	///
+	POLYLIB_STAT save_async(
+		std::string			*p_config_name,
+		std::string			stl_format,
+		std::string			extend = "",
+		bool				block = true
+		);
+
+	///
+	/// 非同期保存が実行中かどうかを返す。待たずに戻る。
+	///
+	///  @return	true:実行中 / false:終了済みまたは未開始。
+	///
+	bool save_async_busy() const;
+
+	///
+	/// 非同期保存の終了を待ち、最後に開始した保存の結果を返す。
+	///
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT save_async_wait();
+
 	///
 	/// 三角形ポリゴン座標の移動。
 	/// 本クラスインスタンス配下の全PolygonGroupのmoveメソッドが呼び出される。
@@ -263,6 +393,106 @@ public:
 		const Vec3<PL_REAL>&    pos
 		) const;
 
+	///
+	/// 2つのグループ(それぞれの子孫を含む)の間で交差する三角形の組を求める。
+	/// リーフグループの組毎にKD木の二重木探索で求める。
+	///
+	///  @param[in]  group_a	グループ名。
+	///  @param[in]  group_b	相手のグループ名。
+	///  @param[out] pairs		三角形の組(末尾に追加)。tri_aがgroup_aの三角形。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT search_intersecting_pairs(
+		std::string					group_a,
+		std::string					group_b,
+		std::vector<TrianglePair>	*pairs
+		) const;
+
+	///
+	/// 2つのグループ(それぞれの子孫を含む)の間で距離がdist以下の三角形の
+	/// 組を求める。
+	///
+	///  @param[in]  group_a	グループ名。
+	///  @param[in]  group_b	相手のグループ名。
+	///  @param[in]  dist		距離(0以上)。
+	///  @param[out] pairs		三角形の組(末尾に追加)。tri_aがgroup_aの三角形。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT search_pairs_within(
+		std::string					group_a,
+		std::string					group_b,
+		PL_REAL						dist,
+		std::vector<TrianglePair>	*pairs
+		) const;
+
+	///
+	/// 2つのグループ(それぞれの子孫を含む)の間の最短距離と、その距離の
+	/// 三角形の組を求める。
+	///
+	///  @param[in]  group_a	グループ名。
+	///  @param[in]  group_b	相手のグループ名。
+	///  @param[out] pair		最も近い組。三角形が無い場合tri_aが0。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT search_nearest_pair(
+		std::string					group_a,
+		std::string					group_b,
+		TrianglePair				*pair
+		) const;
+
+	///
+	/// 読み取り専用の複製(スナップショット)の取得。
+	/// group_nameで指定されたグループとその子孫グループのうち、複製を
+	/// 公開しているもの(PolygonGroup::set_snapshot())の複製への参照を返す。
+	/// 複製はmove()/rebuild_polygons()と並行して、ロックなしで検索できる。
+	///
+	///  @param[in]  group_name	グループ名。
+	///  @param[out] handles	複製へのハンドルのリスト(末尾に追加)。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention 複製はハンドルを保持している間は解放されない。
+	///
+	POLYLIB_STAT acquire_snapshots(
+		std::string							group_name,
+		std::vector<PolygonSnapshotHandle>	*handles
+		) const;
+
+	///
+	/// 直交格子の全セルについて、セルと重なる三角形ポリゴンの一覧を一括作成する。
+	/// セル毎にsearch_polygons()を呼び出す代わりに用いる。
+	///
+	///  @param[in]  grid			格子。
+	///  @param[out] bins			セル毎の三角形ポリゴンの一覧(CSR形式)。
+	///  @param[in]  group_names	対象グループ名のリスト。各グループの子孫も対象。
+	///								NULLの場合は全グループ。
+	///  @param[in]  exact			true:三角形とセルの交差を厳密に判定。
+	///								false:三角形を外包する矩形で判定。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention 一覧の三角形ポリゴンは、削除不可。
+	///
+	POLYLIB_STAT bin_polygons(
+		const CellGrid&					grid,
+		TriangleBins					*bins,
+		const std::vector<std::string>	*group_names = NULL,
+		bool							exact = false
+		) const;
+
+	///
+	/// 計算領域(ガイドセルを含む)のボクセルについて、ボクセルと重なる
+	/// 三角形ポリゴンの一覧を一括作成する。
+	///
+	///  @param[in]  area			計算領域情報。
+	///  @param[out] bins			セル毎の三角形ポリゴンの一覧(CSR形式)。
+	///  @param[in]  group_names	対象グループ名のリスト。NULLの場合は全グループ。
+	///  @param[in]  exact			true:三角形とセルの交差を厳密に判定。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT bin_polygons(
+		const CalcAreaInfo&				area,
+		TriangleBins					*bins,
+		const std::vector<std::string>	*group_names = NULL,
+		bool							exact = false
+		) const;
+
 	///
 	/// 引数のグループ名が既存グループと重複しないかチェック。
 	///
@@ -332,7 +562,19 @@ public:
 	///
 	/// @return 利用中のメモリ量(byte)
 	///
-	unsigned int used_memory_size();
+	unsigned long long used_memory_size();
+
+	///
+	/// Polylibが利用中のメモリ量を構造別(頂点、三角形、KD木ノード、
+	/// KD木要素、DVertexフィールド、その他)に返す。
+	///
+	/// @param[out] p_groups	グループごとの内訳(グループのフルパス名と利用量の対、
+	///							グループリストの順)。NULL可。
+	/// @return 全体の内訳(byte)
+	///
+	PolylibMemoryUsage memory_usage(
+		std::vector<std::pair<std::string, PolylibMemoryUsage> >* p_groups = NULL
+		);
 
 	///
 	/// グループの取得。
@@ -388,6 +630,37 @@ public:
 
 
 
+	///
+	/// 頂点配列と三角形の頂点番号配列から、DVertexを持つポリゴングループの
+	/// 三角形を一括で作成し、KD木を構築する。既存の三角形は破棄される。
+	/// add_DVertex_Triangle()とfinalize_DVertex()の組み合わせより高速。
+	///
+	/// @param[in] name		ポリゴングループ名称
+	/// @param[in] coords	頂点座標(x,y,zの順にnvert*3個)
+	/// @param[in] nvert	頂点数
+	/// @param[in] index	三角形の頂点番号(ntri*3個、0で開始)
+	/// @param[in] ntri		三角形数
+	/// @param[in] idlist	三角形のid(ntri個)。NULLの場合は0からの連番。重複は不可。
+	/// @param[in] exidlist	三角形のユーザ定義id(ntri個)。NULLの場合は0。
+	/// @param[in] scalarlist	スカラーデータ(頂点毎にnscalar個)。NULL可。
+	/// @param[in] vectorlist	ベクターデータ(頂点毎にnvector*3個)。NULL可。
+	/// @param[in] weld		trueの場合、作成後に重複頂点を削除する。
+	/// @return	POLYLIB_STATで定義される値が返る。
+	/// @attention make_DVertex_PolygonGroup()でグループを作成しておくこと。
+	///
+	POLYLIB_STAT init_DVertex_PolygonGroup(std::string name,
+		const PL_REAL* coords,
+		const int nvert,
+		const int* index,
+		const int ntri,
+		const int* idlist = NULL,
+		const int* exidlist = NULL,
+		const PL_REAL* scalarlist = NULL,
+		const PL_REAL* vectorlist = NULL,
+		const bool weld = false);
+
+
+
 protected:
 	///
 	/// コンストラクタ
@@ -452,6 +725,23 @@ protected:
 		PL_REAL		scale = 1.0
 		);
 
+	///
+	/// リーフグループ1つのSTLファイル(必要であればIDファイルも)の読み込み。
+	/// load_polygons()から、並列読み込み時は複数スレッドで同時に呼ばれる。
+	///
+	///  @param[in] pg				リーフグループ。
+	///  @param[in] with_id_file	load_polygons()参照。
+	///  @param[in]	id_format		三角形IDファイルの入力形式。
+	///  @param[in]	scale			頂点座標の縮尺。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT load_leaf_group(
+		PolygonGroup	*pg,
+		bool			with_id_file,
+		ID_FORMAT		id_format,
+		PL_REAL			scale
+		);
+
 	///
 	/// 設定ファイルの保存。
 	/// メモリに展開しているグループツリー情報から設定ファイルを生成する。
@@ -529,6 +819,8 @@ protected:
 	///	 @param[in]	 extend			ファイ名に付加される文字列。
 	///	 @param[in]	 stl_format		STLファイルフォーマット指定。
 	///  @param[in]	 id_format		三角形IDファイルの出力形式。
+	///  @param[out] snapshot		NULL以外の場合、STLファイルとIDファイルは出力
+	///								せず、出力内容の複製を追加する(非同期保存用)。
 	///  @return	POLYLIB_STATで定義される値が返る。
 	///  @attention	ファイル名命名規約は次の通り。
 	///			定義ファイル : polylib_config_ランク番号_付加文字.xml。
@@ -541,7 +833,48 @@ protected:
 		int				maxrank,
 		std::string		extend,
 		std::string		stl_format,
-		ID_FORMAT		id_format
+		ID_FORMAT		id_format,
+		std::vector<CheckpointPiece*>	*snapshot = NULL
+		);
+
+	///
+	/// save()の本体。
+	///
+	///	 @param[out] p_config_name	保存した設定ファイル名の返却用。
+	///  @param[in]	 stl_format		save()参照。
+	///  @param[in]	 extend			save()参照。
+	///  @param[out] snapshot		NULL以外の場合、STLファイルは出力せず、
+	///								出力内容の複製を追加する(非同期保存用)。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT save_files(
+		std::string			*p_config_name,
+		std::string			stl_format,
+		std::string			extend,
+		std::vector<CheckpointPiece*>	*snapshot
+		);
+
+	///
+	/// 非同期保存の複製を作成する前に、前回の非同期保存の終了を待つ。
+	///
+	///  @param[in]	 block			false:実行中であれば待たずにPLSTAT_SAVE_BUSYを返す。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT prepare_checkpoint(
+		bool			block
+		);
+
+	///
+	/// 複製したデータの非同期保存を開始する。statがPLSTAT_OK以外の場合は
+	/// 複製を破棄してstatを返す。
+	///
+	///  @param[in]	 stat			複製の作成結果。
+	///  @param[in,out] snapshot	保存するデータ。所有権は移る。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT start_checkpoint(
+		POLYLIB_STAT					stat,
+		std::vector<CheckpointPiece*>	*snapshot
 		);
 
 	///
@@ -610,6 +943,17 @@ private:
 		std::vector<PolygonGroup*>	*pg
 		) const;
 
+	///
+	/// グループとその子孫のうち、リーフグループを抽出する。
+	///  @param[in]  group_name	グループ名。
+	///  @param[out] leaves		リーフグループのリスト。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT leaf_groups(
+		const std::string&			group_name,
+		std::vector<PolygonGroup*>	*leaves
+		) const;
+
 
 protected:
 	//=======================================================================
@@ -631,6 +975,18 @@ protected:
 	///   頂点を同一視する場合の基準値
 	PL_REAL m_distance_tolerance;
 
+	/// 非同期保存(未使用時はNULL)
+	CheckpointWriter*	m_checkpoint;
+
+	/// load()でリーフグループを並列に読み込むスレッド数
+	int					m_load_threads;
+
+	/// load()でリーフグループを遅延読み込みにするか？
+	bool				m_lazy_load;
+
+	/// 読み込み結果のキャッシュディレクトリ
+	std::string			m_cache_dir;
+
 };
 
 
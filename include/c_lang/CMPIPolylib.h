@@ -182,7 +182,7 @@ POLYLIB_STAT mpipolylib_show_group_info(char* group_name);
 ///
 /// @return 利用中のメモリ量(byte)
 ///
-unsigned int mpipolylib_used_memory_size();
+unsigned long long mpipolylib_used_memory_size();
 
 
 
@@ -129,7 +129,7 @@ POLYLIB_STAT polylib_show_group_info(char* group_name);
 ///
 ///
 ///
-unsigned int polylib_used_memory_size();
+unsigned long long polylib_used_memory_size();
 
 #ifdef __cplusplus
 } // extern "C" or extern
@@ -19,6 +19,7 @@
 #define bbox_h
 
 #include <algorithm>
+#include <limits>
 #include <list>
 #include "PolylibCommon.h"
 #include "common/Vec2.h"
@@ -79,6 +80,51 @@ public:
 	///
 	bool crossed(const BBox& bbox) const ;
 
+	///
+	/// 演算型Cで点の包含判定を行う。
+	/// contain()はC=PL_CALC_REALとして呼ぶ。
+	/// @param[in] pos 試行する点(格納型Tは任意)
+	/// @return 含まれる場合はtrue。他はfalse。
+	///
+	template <typename C, typename T>
+	bool containAs(const Vec3<T>& pos) const {
+		return (C)min.x <= (C)pos.x && (C)pos.x <= (C)max.x &&
+			(C)min.y <= (C)pos.y && (C)pos.y <= (C)max.y &&
+			(C)min.z <= (C)pos.z && (C)pos.z <= (C)max.z;
+	}
+
+	///
+	/// 演算型CでBBoxとBBoxの交差判定を行う。
+	/// crossed()はC=PL_CALC_REALとして呼ぶ。
+	/// @param[in] bbox 試行するBBox
+	/// @return 交差する場合はtrue。他はfalse。
+	///
+	template <typename C>
+	bool crossedAs(const BBox& bbox) const {
+		if ((C)max.x < (C)bbox.min.x || (C)bbox.max.x < (C)min.x) return false;
+		if ((C)max.y < (C)bbox.min.y || (C)bbox.max.y < (C)min.y) return false;
+		if ((C)max.z < (C)bbox.min.z || (C)bbox.max.z < (C)min.z) return false;
+		return true;
+	}
+
+	///
+	/// 演算型Cで点からBBoxまでの距離の2乗を求める。
+	/// @param[in] pos 試行する点(格納型Tは任意)
+	/// @return 距離の2乗。内部の点は0、空のBBoxは型Cの最大値。
+	///
+	template <typename C, typename T>
+	C distance2As(const Vec3<T>& pos) const {
+		if (min.x > max.x) return std::numeric_limits<C>::max();
+		C d2 = 0;
+		for (int i = 0; i < 3; i++) {
+			C d = 0;
+			if ((C)pos[i] < (C)min[i])		d = (C)min[i] - (C)pos[i];
+			else if ((C)pos[i] > (C)max[i])	d = (C)pos[i] - (C)max[i];
+			d2 += d*d;
+		}
+		return d2;
+	}
+
 	///
 	/// BBoxとBBoxの重複領域の抽出を行う。
 	/// 自身の面と他方の辺との交差判定を行う。
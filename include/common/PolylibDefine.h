@@ -31,4 +31,18 @@
 #define PL_REAL float
 #endif
 
+/** 演算型の指定
+ * - 距離の比較や最近点の算出など、幾何判定を評価する実数型。
+ *   頂点・法線・KD木などの記憶型(PL_REAL)とは独立に選べる。
+ * - デフォルトでは、PL_CALC_REAL=double
+ *   (PL_REAL=floatで記憶量を抑えたまま、判定はdoubleで行う)
+ * - コンパイル時オプション-D_CALC_IS_REAL_を付与することで
+ *   PL_CALC_REAL=PL_REALになる
+ */
+#ifdef _CALC_IS_REAL_
+#define PL_CALC_REAL PL_REAL
+#else
+#define PL_CALC_REAL double
+#endif
+
 #endif // polylib_define_h
@@ -0,0 +1,131 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_memoryusage_h
+#define polylib_memoryusage_h
+
+#include <ostream>
+#include <string>
+
+namespace PolylibNS {
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// 構造体:PolylibMemoryUsage
+/// 利用中のメモリ量(byte)を構造別に保持する。
+/// std::vectorは要素数ではなく確保済み容量(capacity)で数えるため、
+/// 移動/PE間移動を繰り返した際の領域の増加も検出できる。
+///
+////////////////////////////////////////////////////////////////////////////
+struct PolylibMemoryUsage {
+	/// 項目数
+	enum { NUM_ITEMS = 7 };
+
+	/// 頂点(Vertex/DVertex本体と頂点リスト)
+	unsigned long long m_vertices;
+
+	/// 三角形(PrivateTriangle/DVertexTriangle本体と三角形リスト)
+	unsigned long long m_triangles;
+
+	/// KD木ノード(VTree/VertKDTのノードとノード内要素リスト)
+	unsigned long long m_tree_nodes;
+
+	/// KD木要素(VElement/VertKDTElem)
+	unsigned long long m_tree_elements;
+
+	/// DVertexのフィールド配列
+	unsigned long long m_fields;
+
+	/// PE間通信用の領域(PE領域情報、移動除外リスト)
+	unsigned long long m_comm_buffers;
+
+	/// その他(グループ、移動前座標の保存領域など)
+	unsigned long long m_other;
+
+	PolylibMemoryUsage() { clear(); }
+
+	///
+	/// 全項目を0にする。
+	///
+	void clear() {
+		m_vertices = m_triangles = m_tree_nodes = m_tree_elements = 0;
+		m_fields = m_comm_buffers = m_other = 0;
+	}
+
+	///
+	/// 合計を返す。
+	///
+	unsigned long long total() const {
+		return m_vertices + m_triangles + m_tree_nodes + m_tree_elements
+			+ m_fields + m_comm_buffers + m_other;
+	}
+
+	///
+	/// 項目を配列へ書き出す(MPIでの集計用)。
+	///
+	/// @param[out] p	NUM_ITEMS個の配列
+	///
+	void to_array( unsigned long long* p ) const {
+		p[0] = m_vertices;   p[1] = m_triangles;    p[2] = m_tree_nodes;
+		p[3] = m_tree_elements; p[4] = m_fields; p[5] = m_comm_buffers;
+		p[6] = m_other;
+	}
+
+	///
+	/// 配列から項目を設定する。
+	///
+	/// @param[in] p	NUM_ITEMS個の配列
+	///
+	void from_array( const unsigned long long* p ) {
+		m_vertices = p[0];   m_triangles = p[1];    m_tree_nodes = p[2];
+		m_tree_elements = p[3]; m_fields = p[4]; m_comm_buffers = p[5];
+		m_other = p[6];
+	}
+
+	PolylibMemoryUsage& operator+=( const PolylibMemoryUsage& u ) {
+		m_vertices      += u.m_vertices;
+		m_triangles     += u.m_triangles;
+		m_tree_nodes    += u.m_tree_nodes;
+		m_tree_elements += u.m_tree_elements;
+		m_fields        += u.m_fields;
+		m_comm_buffers  += u.m_comm_buffers;
+		m_other         += u.m_other;
+		return *this;
+	}
+
+	///
+	/// 内訳を1行で出力する。
+	///
+	/// @param[in] os		出力先
+	/// @param[in] label	行頭に付けるラベル
+	///
+	void print( std::ostream& os, const std::string& label ) const {
+		os << label
+			<< " total:"     << total()
+			<< " vertices:"  << m_vertices
+			<< " triangles:" << m_triangles
+			<< " tree_nodes:" << m_tree_nodes
+			<< " tree_elements:" << m_tree_elements
+			<< " fields:"    << m_fields
+			<< " comm:"      << m_comm_buffers
+			<< " other:"     << m_other << std::endl;
+	}
+};
+
+} //namespace PolylibNS
+
+#endif //polylib_memoryusage_h
@@ -46,6 +46,7 @@ PLSTAT_NODE_NOT_FIND,		///< KD木生成時に検索点が見つからなかっ
 PLSTAT_ROOT_NODE_NOT_EXIST,	///< KD木のルートノードが存在しない。
 PLSTAT_ARGUMENT_NULL,		///< 引数のメモリ確保が行われていない。
 PLSTAT_MPI_ERROR,			///< MPI関数がエラーを戻した。
+PLSTAT_SAVE_BUSY,			///< 前回の非同期保存が実行中である。
 // 以下は未使用
 //	PLSTAT_GROUP_UNMATCH,		///< グループ並びがランク0と一致しなかった。
 //	PLSTAT_UNkNOWN_ERROR,		///< 予期せぬエラー。
@@ -92,6 +93,7 @@ public:
 			else if (stat == PLSTAT_ROOT_NODE_NOT_EXIST) 	return "PLSTAT_ROOT_NODE_NOT_EXIST";
 			else if (stat == PLSTAT_ARGUMENT_NULL) 			return "PLSTAT_ARGUMENT_NULL";
 			else if (stat == PLSTAT_MPI_ERROR) 				return "PLSTAT_MPI_ERROR";
+			else if (stat == PLSTAT_SAVE_BUSY) 				return "PLSTAT_SAVE_BUSY";
 			else											return "UNKNOW_STATUS";
 	}
 };
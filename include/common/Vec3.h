@@ -264,6 +264,16 @@ inline T distance(const Vec3<T>& a, const Vec3<T>& b) {
 	return (a - b).length();
 }
 
+// @brief squared distance between a and b evaluated in type C
+//        (e.g. distanceSquaredAs<double>(a,b) for float vectors)
+template <typename C, typename T>
+inline C distanceSquaredAs(const Vec3<T>& a, const Vec3<T>& b) {
+	C dx = (C)a.x - (C)b.x;
+	C dy = (C)a.y - (C)b.y;
+	C dz = (C)a.z - (C)b.z;
+	return dx*dx + dy*dy + dz*dz;
+}
+
 // @brief compare length between a and b, if a<b return true
 inline bool lessVec3f(const Vec3f& a, const Vec3f& b)
 {
@@ -0,0 +1,136 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_checkpointwriter_h
+#define polylib_checkpointwriter_h
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+#include "common/PolylibStat.h"
+#include "common/PolylibCommon.h"
+#include "file_io/vtk.h"
+
+namespace PolylibNS {
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// 構造体:CheckpointPiece
+/// 非同期保存する1ポリゴングループ分のデータ。保存開始時に頂点・三角形・
+/// 頂点データを頂点番号形式で複製したもので、元のグループとは独立している。
+///
+////////////////////////////////////////////////////////////////////////////
+struct CheckpointPiece {
+	/// ポリゴンファイル名
+	std::string		fname;
+
+	/// ポリゴンファイルのフォーマット(TriMeshIO::FMT_*)
+	std::string		format;
+
+	/// IDファイル名。空の場合IDファイルは保存しない
+	std::string		id_fname;
+
+	/// IDファイルのフォーマット
+	ID_FORMAT		id_format;
+
+	/// 頂点・三角形・頂点データの複製
+	VtkMesh			mesh;
+
+	CheckpointPiece() : id_format(ID_BIN) {}
+};
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:CheckpointWriter
+/// CheckpointPieceのファイル保存をバックグラウンドのスレッドで行う。
+/// 同時に実行する保存は1つで、前の保存が終わるまで次の保存は開始しない。
+///
+////////////////////////////////////////////////////////////////////////////
+class CheckpointWriter {
+public:
+	///
+	/// コンストラクタ。
+	///
+	CheckpointWriter();
+
+	///
+	/// デストラクタ。実行中の保存があれば終了を待つ。
+	///
+	~CheckpointWriter();
+
+	///
+	/// 保存を開始する。piecesの所有権はCheckpointWriterに移り、piecesは空になる。
+	/// 前の保存が実行中であれば終了を待ってから開始する。
+	///
+	///  @param[in,out] pieces	保存するデータ。
+	///  @return	POLYLIB_STATで定義される値が返る。スレッドを作成できない
+	///				場合は、呼び出したスレッドで保存した結果が返る。
+	///
+	POLYLIB_STAT start(
+		std::vector<CheckpointPiece*>	&pieces
+		);
+
+	///
+	/// 保存が実行中かどうかを返す。待たずに戻る。
+	///
+	///  @return	true:実行中 / false:終了済みまたは未開始。
+	///
+	bool busy() const;
+
+	///
+	/// 実行中の保存の終了を待ち、最後に開始した保存の結果を返す。
+	///
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT wait();
+
+private:
+	///
+	/// スレッドの開始関数。
+	///
+	static void* run(void* arg);
+
+	///
+	/// 全データを保存し、最初に失敗した結果を返す。
+	///
+	POLYLIB_STAT write_all();
+
+	///
+	/// 保存済みのデータを破棄する。
+	///
+	void clear_pieces();
+
+	/// 保存スレッド
+	pthread_t						m_thread;
+
+	/// m_threadが終了待ち(join)前であればtrue
+	bool							m_joinable;
+
+	/// 保存スレッドが終了したら1
+	volatile int					m_done;
+
+	/// 最後に開始した保存の結果
+	POLYLIB_STAT					m_stat;
+
+	/// 保存するデータ
+	std::vector<CheckpointPiece*>	m_pieces;
+};
+
+} //namespace PolylibNS
+
+#endif //polylib_checkpointwriter_h
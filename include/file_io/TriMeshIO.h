@@ -73,6 +73,29 @@ public:
 		std::string 				fmt = ""
 		);
 
+	///
+	/// VTK/VTUファイルを頂点番号形式のまま読み込む。頂点の併合は行わない。
+	///
+	///  @param[in]  fname	ファイル名。
+	///  @param[in]  fmt	ファイルフォーマット。is_indexed_format()がtrueのもの。
+	///  @param[out] mesh	読み込んだメッシュ。
+	///  @param[in]  scale	頂点座標の縮尺。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	static POLYLIB_STAT load_indexed(
+		const std::string	&fname,
+		const std::string	&fmt,
+		VtkMesh				*mesh,
+		PL_REAL				scale = 1.0
+		);
+
+	///
+	/// load_indexed()で読み込めるフォーマットか？
+	///
+	static bool is_indexed_format(
+		const std::string &fmt
+		);
+
 	///
 	/// ファイル名を元に入力ファイルのフォーマットを取得する。
 	///
@@ -98,6 +121,7 @@ public:
 	static const std::string FMT_OBJ_BB;	///< binary
 	static const std::string FMT_VTK_A;	///< vtk ascii
 	static const std::string FMT_VTK_B;	///< vtk binary
+	static const std::string FMT_VTU;	///< vtk xml (unstructured grid)
 	static const std::string DEFAULT_FMT;	///< TrimeshIO.cxxで定義している値
 
 };
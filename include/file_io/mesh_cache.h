@@ -0,0 +1,188 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_mesh_cache_h
+#define polylib_mesh_cache_h
+
+#include <string>
+#include <cstddef>
+
+#include "common/PolylibCommon.h"
+#include "common/PolylibStat.h"
+#include "polygons/VTree.h"
+
+//
+// 読み込み済みメッシュ(頂点併合後の頂点番号形式)とKD木のキャッシュファイル。
+// ファイル中の位置は全て先頭からのオフセットで、ポインタを含まないので
+// mmap()した領域をそのまま参照できる。バイト順・実数型はマシンのもの。
+//
+
+namespace PolylibNS {
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// 構造体:MeshCacheView
+/// キャッシュの内容。書き込み時は保存するデータ、読み込み時はmmap()した
+/// 領域を指す。
+///
+////////////////////////////////////////////////////////////////////////////
+struct MeshCacheView {
+	/// 頂点数
+	int						nvert;
+
+	/// 三角形数
+	int						ntri;
+
+	/// KD木のノード数
+	int						nnode;
+
+	/// KD木の要素数
+	int						nelem;
+
+	/// KD木のリーフの最大要素数
+	int						max_elements;
+
+	/// 頂点座標(頂点数*3)
+	const PL_REAL*			coords;
+
+	/// 三角形の頂点番号(三角形数*3)
+	const int*				index;
+
+	/// 三角形ID(三角形数)
+	const int*				ids;
+
+	/// ユーザ定義ID(三角形数)
+	const int*				exids;
+
+	/// 三角形の法線(三角形数*3)
+	const PL_REAL*			normals;
+
+	/// 三角形の面積(三角形数)
+	const PL_REAL*			areas;
+
+	/// KD木のノード(行きがけ順)
+	const VTreeNodeImage*	nodes;
+
+	/// KD木の要素の三角形番号
+	const int*				elems;
+
+	/// 全三角形の外接矩形(min x,y,z、max x,y,z)
+	PL_REAL					bbox[6];
+
+	MeshCacheView();
+};
+
+///
+/// キャッシュファイルを書き出す。別名で書き出してから置き換えるので、
+/// 同じファイルを読み込み中のプロセスには影響しない。
+///
+///  @param[in] fname	ファイル名。
+///  @param[in] key		キャッシュのキー(入力ファイルの識別情報と読み込み条件)。
+///  @param[in] view	保存するデータ。
+///  @return	POLYLIB_STATで定義される値が返る。
+///
+POLYLIB_STAT mesh_cache_write(
+	const std::string&		fname,
+	const std::string&		key,
+	const MeshCacheView&	view
+	);
+
+///
+/// キャッシュのキーからキャッシュファイル名を作る。
+///
+///  @param[in] dir	キャッシュディレクトリ。
+///  @param[in] key	キャッシュのキー。
+///  @return	dir/plcache_<キーのハッシュ値>.plc
+///
+std::string mesh_cache_name(
+	const std::string&		dir,
+	const std::string&		key
+	);
+
+///
+/// 入力ファイルの識別情報("パス サイズ 更新時刻")を返す。
+///
+///  @param[in]  path		ファイルパス。
+///  @param[out] identity	識別情報。
+///  @return	ファイルの情報を取得できない場合false。
+///
+bool mesh_cache_file_identity(
+	const std::string&		path,
+	std::string*			identity
+	);
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:MeshCacheFile
+/// キャッシュファイルをmmap()して参照する。
+///
+////////////////////////////////////////////////////////////////////////////
+class MeshCacheFile {
+public:
+	MeshCacheFile();
+
+	///
+	/// デストラクタ。領域をmunmap()する。
+	///
+	~MeshCacheFile();
+
+	///
+	/// キャッシュファイルを開き、キーと内容を検査する。
+	///
+	///  @param[in] fname	ファイル名。
+	///  @param[in] key		キャッシュのキー。
+	///  @return	POLYLIB_STATで定義される値が返る。ファイルが無い、キーが
+	///				一致しない、内容が壊れている場合はPLSTAT_NG。
+	///
+	POLYLIB_STAT open(
+		const std::string&	fname,
+		const std::string&	key
+		);
+
+	///
+	/// 領域を解放する。
+	///
+	void close();
+
+	///
+	/// キャッシュの内容(open()後に有効)。
+	///
+	const MeshCacheView& view() const {
+		return m_view;
+	}
+
+private:
+	/// 内容の検査
+	bool validate() const;
+
+	/// mmap()した領域
+	void*			m_addr;
+
+	/// 領域のバイト数
+	size_t			m_size;
+
+	/// 内容
+	MeshCacheView	m_view;
+
+	// コピー禁止
+	MeshCacheFile( const MeshCacheFile& );
+	MeshCacheFile& operator=( const MeshCacheFile& );
+};
+
+} //namespace PolylibNS
+
+#endif //polylib_mesh_cache_h
@@ -0,0 +1,239 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_mesh_write_h
+#define polylib_mesh_write_h
+
+#include <ostream>
+#include <vector>
+#include <cstddef>
+
+#include "common/PolylibCommon.h"
+#include "common/PolylibStat.h"
+#include "polygons/PrivateTriangle.h"
+#include "polygons/VertexList.h"
+
+//
+// OBJ/STL/VTK出力の共通処理。
+// 頂点はVertexList上の番号で扱い(Vertex*からのmapを作らない)、
+// 出力はレコード(アスキーでは行)をブロック単位で並列に作成して、まとめて書き出す。
+//
+
+namespace PolylibNS {
+
+/// format_real()が書き出す最大文字数
+#define MESH_WRITE_REAL_LEN		16
+
+/// format_long()が書き出す最大文字数
+#define MESH_WRITE_LONG_LEN		21
+
+///
+/// 三角形の頂点番号の表を作成する。
+///
+///  @param[in]  vertex_list	頂点リスト。
+///  @param[in]  tri_list		三角形リスト。
+///  @param[out] tri_vidx		三角形毎の3頂点の番号(0から)。要素数は三角形数*3。
+///  @return	POLYLIB_STATで定義される値が返る。頂点リストに無い頂点を
+///				参照する三角形がある場合PLSTAT_NG。
+///
+POLYLIB_STAT mesh_vertex_index(
+	VertexList*							vertex_list,
+	const std::vector<PrivateTriangle*>		*tri_list,
+	std::vector<int>						*tri_vidx
+	);
+
+///
+/// 頂点法線(頂点を共有する三角形の面法線の和を正規化したもの)を求める。
+/// どの三角形にも使われない頂点は0ベクトル。
+///
+///  @param[in]  nvtx		頂点数。
+///  @param[in]  tri_list	三角形リスト。
+///  @param[in]  tri_vidx	mesh_vertex_index()で求めた頂点番号。
+///  @param[out] normals	頂点法線(x,y,zの順、要素数は頂点数*3)。
+///
+void mesh_vertex_normals(
+	size_t									nvtx,
+	const std::vector<PrivateTriangle*>		*tri_list,
+	const std::vector<int>					&tri_vidx,
+	std::vector<PL_REAL>					*normals
+	);
+
+///
+/// 実数を有効数字6桁で文字列化する。書式はprintf()の"%g"(SCIENTIFIC_OUT
+/// の場合は"%e")、すなわちstd::setprecision(6)のストリーム出力と同じ。
+/// 終端の'\0'は書き込まない。
+///
+///  @param[out] p	書き込み先(MESH_WRITE_REAL_LEN文字以上)。
+///  @param[in]  v	値。
+///  @return	書き込んだ文字の次の位置。
+///
+char* format_real( char* p, double v );
+
+///
+/// 整数を文字列化する。終端の'\0'は書き込まない。
+///
+///  @param[out] p	書き込み先(MESH_WRITE_LONG_LEN文字以上)。
+///  @param[in]  v	値。
+///  @return	書き込んだ文字の次の位置。
+///
+char* format_long( char* p, long v );
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:RecordFormatter
+/// write_records()で出力するレコード(アスキー出力では行、バイナリ出力では
+/// 固定長の組)の作成。
+///
+////////////////////////////////////////////////////////////////////////////
+class RecordFormatter {
+public:
+	virtual ~RecordFormatter() {}
+
+	///
+	/// 1レコードの最大バイト数(改行を含む)を返す。
+	///
+	virtual size_t max_length() const = 0;
+
+	///
+	/// i番目のレコードを作成する。複数スレッドから同時に呼ばれる。
+	///
+	///  @param[in]  i	レコード番号
+	///  @param[out] p	書き込み先(max_length()バイト以上)
+	///  @return	書き込んだバイトの次の位置。
+	///
+	virtual char* format( size_t i, char* p ) const = 0;
+};
+
+///
+/// n個のレコードを作成して書き出す。レコードをブロックに分けて並列に作成し、
+/// ブロック単位で順に書き出す。
+///
+///  @param[in,out] os		出力先。
+///  @param[in]     f		レコードの作成。
+///  @param[in]     n		レコード数。
+///  @return	書き込みに失敗した場合false。
+///
+bool write_records(
+	std::ostream&			os,
+	const RecordFormatter&	f,
+	size_t					n
+	);
+
+///
+/// 値をバイト列として書き込む。バイナリ出力のレコード作成に用いる。
+///
+///  @param[out] p		書き込み先。
+///  @param[in]  data	値。
+///  @param[in]  size	値のバイト数。
+///  @param[in]  inv	1:バイト順を反転する。
+///  @return	書き込んだバイトの次の位置。
+///
+char* put_bytes( char* p, const void* data, int size, int inv );
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:TextCoordFormatter
+/// 頂点座標の行 "<prefix>x y z\n" の作成。
+///
+////////////////////////////////////////////////////////////////////////////
+class TextCoordFormatter : public RecordFormatter {
+public:
+	///
+	///  @param[in] prefix	行頭の文字列("v "等)。
+	///  @param[in] vlist	頂点リスト。
+	///
+	TextCoordFormatter( const char* prefix, const std::vector<Vertex*>* vlist );
+	size_t max_length() const;
+	char* format( size_t i, char* p ) const;
+private:
+	const char*					m_prefix;
+	size_t						m_prefix_len;
+	const std::vector<Vertex*>*	m_vlist;
+};
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:TextArrayFormatter
+/// 実数配列のncomp個ずつの行 "<prefix>a b c\n" の作成。
+///
+////////////////////////////////////////////////////////////////////////////
+class TextArrayFormatter : public RecordFormatter {
+public:
+	///
+	///  @param[in] prefix	行頭の文字列("vn "等)。
+	///  @param[in] data	配列。
+	///  @param[in] ncomp	1行の値の数。
+	///
+	TextArrayFormatter( const char* prefix, const PL_REAL* data, int ncomp );
+	size_t max_length() const;
+	char* format( size_t i, char* p ) const;
+private:
+	const char*		m_prefix;
+	size_t			m_prefix_len;
+	const PL_REAL*	m_data;
+	int				m_ncomp;
+};
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:BinaryCoordFormatter
+/// 頂点座標3値のバイナリレコードの作成。
+///
+////////////////////////////////////////////////////////////////////////////
+class BinaryCoordFormatter : public RecordFormatter {
+public:
+	///
+	///  @param[in] vlist		頂点リスト。
+	///  @param[in] as_float	true:floatで出力。false:PL_REALで出力。
+	///  @param[in] inv			1:バイト順を反転する。
+	///
+	BinaryCoordFormatter( const std::vector<Vertex*>* vlist, bool as_float, int inv );
+	size_t max_length() const;
+	char* format( size_t i, char* p ) const;
+private:
+	const std::vector<Vertex*>*	m_vlist;
+	bool						m_as_float;
+	int							m_inv;
+};
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:BinaryArrayFormatter
+/// 実数配列のncomp個ずつのバイナリレコードの作成。
+///
+////////////////////////////////////////////////////////////////////////////
+class BinaryArrayFormatter : public RecordFormatter {
+public:
+	///
+	///  @param[in] data		配列。
+	///  @param[in] ncomp		1レコードの値の数。
+	///  @param[in] as_float	true:floatで出力。false:PL_REALで出力。
+	///  @param[in] inv			1:バイト順を反転する。
+	///
+	BinaryArrayFormatter( const PL_REAL* data, int ncomp, bool as_float, int inv );
+	size_t max_length() const;
+	char* format( size_t i, char* p ) const;
+private:
+	const PL_REAL*	m_data;
+	int				m_ncomp;
+	bool			m_as_float;
+	int				m_inv;
+};
+
+} //namespace PolylibNS
+
+#endif //polylib_mesh_write_h
@@ -139,9 +139,8 @@ bool is_stl_a(
 ///
 ///  @param[in] STLファイルのフルパス名。
 ///  @return	拡張子を除いた名称。
-///  @attention	戻り値のchar *は解放不要。
 ///
-char *stl_get_fname(
+std::string stl_get_fname(
 	std::string		path
 	);
 
@@ -150,9 +149,8 @@ char *stl_get_fname(
 ///
 ///  @param[in] STLファイルのフルパス名。
 ///  @return	拡張子。
-///  @attention	戻り値のchar *は解放不要。
 ///
-char *stl_get_ext(
+std::string stl_get_ext(
 	std::string		path
 	);
 
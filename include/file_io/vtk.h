@@ -44,6 +44,7 @@ namespace PolylibNS {
 
 ///
 /// VertexList, tri_listにから vtkアスキー形式に出力する。
+/// 三角形IDは出力しない(読み込み時に振り直される)。
 ///
 ///
 ///  @param[in] vertex_list 頂点リストの領域。
@@ -62,6 +63,7 @@ POLYLIB_STAT vtk_a_save(
 
 ///
 /// VertexList, tri_listにから vtkバイナリ形式に出力する。
+/// 三角形IDは出力しない(読み込み時に振り直される)。
 ///
 ///  @param[in] vertex_list 頂点リストの領域。
 ///  @param[in] tri_list　三角形ポリゴンリストの領域。
@@ -78,6 +80,176 @@ POLYLIB_STAT vtk_b_save(
 	std::string fname
 	);
 
+///
+/// VertexList, tri_listから VTK XML形式(.vtu)に出力する。
+/// 配列は全てAppendedData(raw、マシンのバイト順)に書き出す。
+/// 頂点データとしてDVertexのスカラー・ベクトルを、セルデータとして
+/// 三角形のid、exidを出力する。
+///
+///  @param[in] vertex_list 頂点リストの領域。
+///  @param[in] tri_list　三角形ポリゴンリストの領域。
+///  @param[in]	fname	　ファイル名。
+///  @param[in]	nscalar	　出力するスカラーデータ数。負の場合は頂点から求める。
+///  @param[in]	nvector	　出力するベクトルデータ数。負の場合は頂点から求める。
+///  @attention 並列出力で全ピースの配列を揃えるには、nscalar、nvectorを
+///				指定すること(三角形が無いピースは頂点から求められない)。
+///
+
+POLYLIB_STAT vtu_save(
+	VertexList* vertex_list,
+	std::vector<PrivateTriangle*> *tri_list,
+	std::string fname,
+	int nscalar = -1,
+	int nvector = -1
+	);
+
+///
+/// vtu_save()で出力したピースをまとめる VTK XML並列形式(.pvtu)の
+/// インデックスファイルを出力する。
+///
+///  @param[in]	fname	　ファイル名。
+///  @param[in]	pieces	　ピースのファイル名(fnameからの相対パス)。
+///  @param[in]	nscalar	　ピースのスカラーデータ数。
+///  @param[in]	nvector	　ピースのベクトルデータ数。
+///
+
+POLYLIB_STAT pvtu_save(
+	std::string fname,
+	const std::vector<std::string>& pieces,
+	int nscalar,
+	int nvector
+	);
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// 構造体:VtkMesh
+/// VTKファイルから読み込んだ三角形メッシュ(頂点番号形式)。
+/// 三角形以外のセルは読み飛ばす。頂点データは1成分の配列をスカラー、
+/// 3成分の配列をベクトルとしてファイル中の順に並べる。
+/// 非同期保存の複製(CheckpointPiece)にも用いる。
+///
+////////////////////////////////////////////////////////////////////////////
+struct VtkMesh {
+	/// 頂点座標(頂点数*3)
+	std::vector<PL_REAL>	coords;
+
+	/// 三角形の頂点番号(三角形数*3、0から)
+	std::vector<int>		index;
+
+	/// 三角形ID(セルデータ"id"。無い場合は空)
+	std::vector<int>		ids;
+
+	/// ユーザ定義ID(セルデータ"exid"。無い場合は空)
+	std::vector<int>		exids;
+
+	/// スカラーデータ数
+	int						nscalar;
+
+	/// ベクトルデータ数
+	int						nvector;
+
+	/// スカラーデータ(頂点毎にnscalar個、頂点数*nscalar個)
+	std::vector<PL_REAL>	scalars;
+
+	/// ベクトルデータ(頂点毎にnvector*3個、頂点数*nvector*3個)
+	std::vector<PL_REAL>	vectors;
+
+	VtkMesh() : nscalar(0), nvector(0) {}
+
+	/// 頂点数
+	int nvert() const { return (int)( coords.size() / 3 ); }
+
+	/// 三角形数
+	int ntri() const { return (int)( index.size() / 3 ); }
+};
+
+///
+/// VTKレガシー形式のファイルを読み込みバイナリかアスキーかを判定する。
+///
+///  @param[in] path ファイルパス。
+///  @return	true:アスキー形式 / false:バイナリ形式。
+///
+bool is_vtk_a(std::string path);
+
+///
+/// VTKレガシー形式(アスキー/バイナリ)のファイルを読み込む。
+/// DATASETはUNSTRUCTURED_GRIDとPOLYDATA(POLYGONSのみ)に対応する。
+/// バイナリのバイト順は規格のビッグエンディアンとvtk_b_save()の
+/// マシンのバイト順の両方を、セルの頂点数から判定する。
+///
+/// @attention vtk_a_save()、vtk_b_save()は三角形IDを出力しないので、
+///			セルデータ"id"が無いファイルの三角形IDは読み込み時に0から
+///			三角形数-1へ振り直される(警告を出力する)。IDを保存する場合は
+///			VTU形式かIDファイルを用いること。
+///
+///  @param[in]  fname	ファイル名。
+///  @param[out] mesh	読み込んだメッシュ。
+///  @param[in]  scale	頂点座標の縮尺。
+///  @return	POLYLIB_STATで定義される値が返る。
+///
+
+POLYLIB_STAT vtk_read(
+	std::string fname,
+	VtkMesh* mesh,
+	PL_REAL scale = 1.0
+	);
+
+///
+/// VTK XML形式(.vtu/.vtp)のファイルを読み込む。
+/// UnstructuredGridとPolyData(Polysのみ)に対応し、複数のPieceは1つに
+/// まとめる。配列はascii、binary(base64)、appended(raw/base64)に対応する。
+/// 圧縮された配列には対応しない。
+///
+///  @param[in]  fname	ファイル名。
+///  @param[out] mesh	読み込んだメッシュ。
+///  @param[in]  scale	頂点座標の縮尺。
+///  @return	POLYLIB_STATで定義される値が返る。
+///
+
+POLYLIB_STAT vtu_read(
+	std::string fname,
+	VtkMesh* mesh,
+	PL_REAL scale = 1.0
+	);
+
+///
+/// VTKレガシー形式のファイルを読み込み、vertex_list、tri_listに追加する。
+/// 頂点データは読み込まない。
+///
+///  @param[in,out] vertex_list 頂点リストの領域。
+///  @param[in,out] tri_list　三角形ポリゴンリストの領域。
+///  @param[in]	fname	　ファイル名。
+///  @param[in,out] total	三角形IDの通番。
+///  @param[in]	scale	　頂点座標の縮尺。
+///
+
+POLYLIB_STAT vtk_load(
+	VertexList* vertex_list,
+	std::vector<PrivateTriangle*> *tri_list,
+	std::string fname,
+	int *total,
+	PL_REAL scale = 1.0
+	);
+
+///
+/// VTK XML形式のファイルを読み込み、vertex_list、tri_listに追加する。
+/// 頂点データは読み込まない。
+///
+///  @param[in,out] vertex_list 頂点リストの領域。
+///  @param[in,out] tri_list　三角形ポリゴンリストの領域。
+///  @param[in]	fname	　ファイル名。
+///  @param[in,out] total	三角形IDの通番。
+///  @param[in]	scale	　頂点座標の縮尺。
+///
+
+POLYLIB_STAT vtu_load(
+	VertexList* vertex_list,
+	std::vector<PrivateTriangle*> *tri_list,
+	std::string fname,
+	int *total,
+	PL_REAL scale = 1.0
+	);
+
 } // end of namespace
 
 #endif //vtk_h
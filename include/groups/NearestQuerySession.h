@@ -0,0 +1,193 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_nearestquerysession_h
+#define polylib_nearestquerysession_h
+
+#include <string>
+#include <vector>
+
+#include "common/PolylibStat.h"
+#include "common/PolylibCommon.h"
+#include "common/Vec3.h"
+
+using namespace Vec3class;
+
+namespace PolylibNS {
+
+class Polylib;
+class PolygonGroup;
+class PrivateTriangle;
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:NearestQuerySession
+/// 同じ点の集合について、毎ステップ面上の最近点を検索するためのセッション。
+/// 点毎に前回の最近三角形を記憶し、その三角形までの現在の距離を上限として
+/// KD木を枝刈りしながら検索する。点の移動が小さければ、ほとんどのノードは
+/// 根の近くで枝刈りされる。
+/// 記憶した三角形は、そのグループの世代番号(PolygonGroup::get_tree_generation())
+/// が変わると(KD木の再構築、三角形の追加・削除)使わない。
+/// 剛体インスタンシングのグループは点をローカル座標系へ変換して検索し、
+/// 頂点への変換の反映(materialize_vertices())はしない。剛体移動では
+/// 世代番号が変わらないので、記憶した三角形をそのまま使える。
+///
+////////////////////////////////////////////////////////////////////////////
+class NearestQuerySession {
+public:
+	///
+	/// コンストラクタ。
+	///
+	NearestQuerySession();
+
+	///
+	/// 検索対象のグループと点数を設定し、記憶を消去する。
+	///
+	///  @param[in] pl			Polylib。
+	///  @param[in] group_name	グループ名。子孫のリーフグループが検索対象。
+	///  @param[in] npoints		点数。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention	グループの追加・削除をした場合は再度呼ぶこと。
+	///
+	POLYLIB_STAT init(
+		const Polylib		*pl,
+		const std::string&	group_name,
+		int					npoints
+		);
+
+	///
+	/// 全ての点の記憶を消去する。
+	///
+	void clear();
+
+	///
+	/// 点数を取得。
+	///
+	int num_points() const {
+		return (int)m_entries.size();
+	}
+
+	///
+	/// i番目の点の面上の最近点を検索する。
+	/// 異なる点であれば、複数スレッドから同時に呼んでよい。
+	/// 検索はグループのデータを書き換えない(剛体インスタンシングのグループも
+	/// ローカル座標系で検索する)が、遅延読み込みのグループは同時に呼ぶ前に
+	/// PolygonGroup::load_deferred()で読み込んでおくこと。
+	///
+	///  @param[in]  i		点の番号。
+	///  @param[in]  pos	点の位置。
+	///  @param[out] foot	面上の最近点(ワールド座標)。NULL可。
+	///  @param[out] bary	最近点の重心座標(頂点0,1,2の重み)。NULL可。
+	///  @param[out] dist2	最近点までの距離の2乗。NULL可。
+	///  @return	最近点を持つ三角形。三角形が無い場合NULL。
+	///
+	const PrivateTriangle* search(
+		int						i,
+		const Vec3<PL_REAL>&	pos,
+		Vec3<PL_REAL>*			foot = NULL,
+		PL_REAL					bary[3] = NULL,
+		PL_REAL*				dist2 = NULL
+		);
+
+	///
+	/// 全ての点の面上の最近点を並列に検索する。
+	///
+	///  @param[in]  pos	点の位置(点数*3)。
+	///  @param[out] tris	最近点を持つ三角形(点数)。
+	///  @param[out] foot	面上の最近点(点数*3)。NULL可。
+	///  @param[out] dist2	最近点までの距離の2乗(点数)。NULL可。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT search_all(
+		const PL_REAL			*pos,
+		const PrivateTriangle	**tris,
+		PL_REAL					*foot = NULL,
+		PL_REAL					*dist2 = NULL
+		);
+
+	///
+	/// 前回の三角形から始めた検索の数を取得。
+	///
+	long long num_warm_queries() const {
+		return m_nwarm;
+	}
+
+	///
+	/// 記憶が無い(または無効な)ため枝刈りなしで始めた検索の数を取得。
+	///
+	long long num_cold_queries() const {
+		return m_ncold;
+	}
+
+	///
+	/// 前回と同じ三角形が最近だった検索の数を取得。
+	///
+	long long num_same_results() const {
+		return m_nsame;
+	}
+
+	///
+	/// 検索数の統計を0にする。
+	///
+	void reset_stats();
+
+private:
+	/// 点毎の記憶
+	struct Entry {
+		/// 前回の最近三角形
+		const PrivateTriangle*	tri;
+
+		/// triのグループ(m_groupsの番号)
+		int						group;
+
+		/// 前回の検索時のグループの世代番号
+		unsigned long			generation;
+
+		Entry() : tri(0), group(-1), generation(0) {}
+	};
+
+	///
+	/// 1点の検索。統計はstatに加算する。
+	///
+	const PrivateTriangle* search_point(
+		int						i,
+		const Vec3<PL_REAL>&	pos,
+		Vec3<PL_REAL>*			foot,
+		PL_REAL					bary[3],
+		PL_REAL*				dist2,
+		long long				stat[3]
+		);
+
+	/// 検索対象のリーフグループ
+	std::vector<PolygonGroup*>	m_groups;
+
+	/// 点毎の記憶
+	std::vector<Entry>			m_entries;
+
+	/// 前回の三角形から始めた検索の数
+	long long					m_nwarm;
+
+	/// 枝刈りなしで始めた検索の数
+	long long					m_ncold;
+
+	/// 前回と同じ三角形が最近だった検索の数
+	long long					m_nsame;
+};
+
+} //namespace PolylibNS
+
+#endif //polylib_nearestquerysession_h
@@ -20,7 +20,11 @@
 
 #include "common/PolylibCommon.h"
 #include "common/PolylibStat.h"
+#include "common/PolylibMemoryUsage.h"
 #include "common/Vec3.h"
+#include "common/BBox.h"
+#include "util/SpaceFillingCurve.h"
+#include "polygons/PolygonSnapshot.h"
 #include "TextParser.h"
 #include <vector>
 #include <map>
@@ -35,10 +39,38 @@ class Polygons;
 class PolylibMoveParams;
 class PrivateTriangle;
 class DVertexTriangle;
+class DVertexManager;
 class BBox;
 class VertexList;
 class VertKDT;
 class VTree;
+class TriangleAdjacency;
+struct TrianglePair;
+struct CheckpointPiece;
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// 構造体:LeapCheckResult
+/// check_leaped()の結果。move()前後の頂点変位の統計と、隣接セルより遠くへ
+/// 移動した三角形のIDを保持する。
+///
+////////////////////////////////////////////////////////////////////////////
+struct LeapCheckResult {
+	/// 検査した頂点数。
+	size_t				m_num_vertices;
+
+	/// 隣接セルより遠くへ移動した頂点数。
+	size_t				m_num_leaped_vertices;
+
+	/// 頂点変位量の最大値。
+	PL_REAL				m_max_displacement;
+
+	/// 隣接セルより遠くへ移動した頂点を持つ三角形のID(昇順、重複なし)。
+	std::vector<int>	m_leaped_tria_ids;
+
+	LeapCheckResult() :
+		m_num_vertices(0), m_num_leaped_vertices(0), m_max_displacement(0.0) {}
+};
 
 ////////////////////////////////////////////////////////////////////////////
 ///
@@ -135,6 +167,38 @@ public:
 		const int n_vector
 		);
 
+	///
+	/// 頂点配列と三角形の頂点番号配列からDVertexを持つ三角形ポリゴンリストを
+	/// 一括で作成する。既存の三角形ポリゴンリストは破棄される。
+	/// 頂点は重複削除済みとして扱い、DVertexのデータは頂点番号順の
+	/// スロットへ直接書き込む。OpenMP有効時は頂点・三角形の生成をスレッド並列で行う。
+	///
+	///  @param[in] coords	頂点座標(x,y,zの順にnvert*3個)
+	///  @param[in] nvert	頂点数
+	///  @param[in] index	三角形の頂点番号(ntri*3個、0で開始)
+	///  @param[in] ntri	三角形数
+	///  @param[in] idlist	三角形のid(ntri個)。NULLの場合は0からの連番。
+	///                     重複は不可。三角形リストはid順に並べ替えられる。
+	///  @param[in] exidlist	三角形のユーザ定義id(ntri個)。NULLの場合は0。
+	///  @param[in] scalarlist	スカラーデータ(頂点毎にnscalar個、nvert*nscalar個)。NULL可。
+	///  @param[in] vectorlist	ベクターデータ(頂点毎にnvector*3個)。NULL可。
+	///  @param[in] weld	trueの場合、作成後に重複頂点を削除する。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention make_DVertex_PolygonGroup()等でDVertexのデータ構成を設定しておくこと。
+	///  @attention KD木も構築する。add_DVertex_Triangle()とfinalize_DVertex()の
+	///             組み合わせより高速。
+	///
+	POLYLIB_STAT init_dvertex_indexed(const PL_REAL* coords,
+		const int nvert,
+		const int* index,
+		const int ntri,
+		const int* idlist,
+		const int* exidlist,
+		const PL_REAL* scalarlist,
+		const PL_REAL* vectorlist,
+		const bool weld = false
+		);
+
 
 
 	///
@@ -243,6 +307,14 @@ public:
 
 	void finalize_DVertex();
 
+	//
+	/// DVertexのデータ構成(スカラー数、ベクター数)を返す。
+	///
+	///  @return	DVertexManager。DVertexを持たないグループの場合はNULL。
+	///
+
+	DVertexManager* get_DVM() const;
+
 
 
 	///
@@ -272,8 +344,75 @@ public:
 		ID_FORMAT		id_format
 		);
 
+	///
+	/// ポリゴンファイルの読み込みを最初の参照まで遅らせる(遅延読み込み)。
+	/// ファイル毎の外接矩形ファイル(ファイル名+".bbox")があれば読み込み、
+	/// 検索範囲と交差しない間は読み込まずに済ませる。外接矩形ファイルに
+	/// 記録したポリゴンファイルのサイズ・更新時刻が現在と異なる場合は使わない。
+	///
+	///  @param[in] with_id_file	三角形IDファイルも読み込むか？
+	///  @param[in] id_format		三角形IDファイルの入力形式。
+	///  @param[in] scale			頂点座標の縮尺。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention	読み込みはload_deferred()、または三角形・KD木を参照する
+	///				メソッドの呼び出し時に行われる。
+	///
+	POLYLIB_STAT defer_load(
+		bool			with_id_file,
+		ID_FORMAT		id_format,
+		PL_REAL			scale
+		);
+
+	///
+	/// 遅延読み込み中であれば、ポリゴンファイルを読み込みKD木を構築する。
+	/// 複数スレッドから同時に呼ばれても読み込みは1度だけ行われ、他のスレッドは
+	/// 読み込みの終了を待つ。異なるグループの読み込みは並行して行える。
+	///
+	///  @return	POLYLIB_STATで定義される値が返る。読み込みに失敗した場合は
+	///				以降も同じ値を返す。
+	///  @attention	load_stl_file()、load_id_file()を再定義している場合、その中から
+	///				自グループの三角形を参照するメソッドを呼ばないこと。
+	///
+	POLYLIB_STAT load_deferred() const;
+
+	///
+	/// 遅延読み込み中(未読み込み)かどうかを返す。
+	///
+	bool is_load_deferred() const;
+
+	///
+	/// 読み込み時のグループの外接矩形を、各ポリゴンファイルの外接矩形
+	/// ファイル(ファイル名+".bbox")に保存する。座標は縮尺を掛ける前の
+	/// ファイル上の値で、複数ファイルのグループでは全ファイルに同じ矩形を書く。
+	/// 2行目には、古い矩形を検出するためポリゴンファイルのパス、サイズ、
+	/// 更新時刻を書く。
+	///
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT save_bbox_index();
+
+	///
+	/// 読み込み結果のキャッシュディレクトリを設定する。
+	/// 設定するとload_stl_file()は、入力ファイルのパス・サイズ・更新時刻と
+	/// 縮尺等の読み込み条件が一致するキャッシュファイルがあれば、ファイルの
+	/// 読み込み、頂点の併合、KD木の構築を省いてキャッシュから復元する。
+	/// 無ければ通常どおり読み込み、結果をキャッシュに保存する。
+	///
+	///  @param[in] dir	キャッシュディレクトリ。空文字列でキャッシュを使わない。
+	///  @attention	DVertexを持つグループはキャッシュしない。
+	///
+	void set_cache_dir(
+		std::string		dir
+		);
+
+	///
+	/// キャッシュディレクトリを取得する。
+	///
+	std::string get_cache_dir() const;
+
 	///
 	/// TriMeshクラスが管理しているポリゴン情報をSTLファイルに出力する。
+	/// 三角形はID順に出力する(三角形リストの並びには依らない)。
 	/// TextParser 対応版
 	///  @param[in] rank_no	ファイル名に付加するランク番号。
 	///  @param[in] extend	ファイル名に付加する自由文字列。
@@ -289,9 +428,47 @@ public:
 		std::map<std::string,std::string>& stl_fname_map
 		);
 
+	///
+	/// 各rankがsave_stl_file()でVTU形式に出力したピースをまとめる
+	/// PVTUファイルを出力する。ファイル名は、階層化されたグループ名_自由文字列.pvtu。
+	/// 一覧にはranksのピースだけを載せる(三角形が無くピースを出力しなかった
+	/// ランクは含めない)。
+	///
+	///  @param[in] maxrank	最大ランク番号(ランク番号の桁数を決める)。
+	///  @param[in] ranks	ピースを出力したランク番号の一覧。
+	///  @param[in] extend	ファイル名に付加する自由文字列。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT save_pvtu_file(
+		int						maxrank,
+		const std::vector<int>&	ranks,
+		std::string				extend
+		);
+
+	///
+	/// save_stl_file()、save_id_file()で保存する内容を非同期保存用に複製する。
+	/// ファイル名はsave_stl_file()、save_id_file()と同じで、stl_fname_mapも
+	/// 同様に更新する。ファイルへの出力は行わない。
+	///
+	///  @param[in] rank_no	ファイル名に付加するランク番号。
+	///  @param[in] extend	ファイル名に付加する自由文字列。
+	///  @param[in] format	STLファイルフォーマット。
+	///  @param[in,out] stl_fname_map stl ファイル名とポリゴングループのパス
+	///  @param[out] piece	複製先。IDファイルのフォーマットは設定しない。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT snapshot_files(
+		std::string		rank_no,
+		std::string		extend,
+		std::string		format,
+		std::map<std::string,std::string>& stl_fname_map,
+		CheckpointPiece	*piece
+		);
+
 	///
 	/// 三角形ポリゴンIDファイルにポリゴンIDを出力する。IDファイル名は、
 	/// 階層化されたグループ名_ランク番号_自由文字列.id。
+	/// save_stl_file()と同じくID順に出力する。
 	///
 	///  @param[in] rank_no		ファイル名に付加するランク番号。
 	///  @param[in] extend		ファイル名に付加する自由文字列。
@@ -342,7 +519,8 @@ public:
 	///  @param[in] bbox	矩形領域。
 	///  @param[in]	every	true:3頂点が全て検索領域に含まれるものを抽出。
 	///  					false:1頂点でも検索領域に含まれるものを抽出。
-	///  @return	抽出したポリゴンリストのポインタ。
+	///  @return	抽出したポリゴンリストのポインタ。遅延読み込みに失敗した場合は
+	///				NULL(状態はload_deferred()で取得できる)。
 	///  @attention オーバーロードメソッドあり。
 	///
 	const std::vector<PrivateTriangle*>* search(
@@ -372,7 +550,8 @@ public:
 	///  @param[in] bbox	矩形領域。
 	///  @param[in]	every	true:3頂点が全て検索領域に含まれるものを抽出。
 	///  					false:1頂点でも検索領域に含まれるものを抽出。
-	///  @return	抽出したポリゴンリストのポインタ。
+	///  @return	抽出したポリゴンリストのポインタ。遅延読み込みに失敗した場合は
+	///				NULL(状態はload_deferred()で取得できる)。
 	///  @attention	オーバーロードメソッドあり。
 	///
 	const std::vector<PrivateTriangle*>* linear_search(
@@ -406,6 +585,132 @@ public:
 		const Vec3<PL_REAL>&    pos
 		) const;
 
+	///
+	/// KD木探索により、指定位置から面上の最近点(足)を持つポリゴンを厳密に検索する。
+	/// search_nearest()は重心で比較するが、こちらは三角形までの距離で比較する。
+	///
+	///  @param[in]  pos	指定位置
+	///  @param[out] foot	面上の最近点。NULL可。
+	///  @param[out] bary	最近点の重心座標(頂点0,1,2の重み)。NULL可。
+	///  @param[out] dist2	最近点までの距離の2乗。NULL可。
+	///  @return    検索されたポリゴン。ポリゴンが無い場合NULL。
+	///  @attention 移動後はrebuild_polygons()でKD木を再構築してから呼ぶこと。
+	///
+	const PrivateTriangle* search_nearest_surface(
+		const Vec3<PL_REAL>&	pos,
+		Vec3<PL_REAL>*			foot,
+		PL_REAL					bary[3] = NULL,
+		PL_REAL*				dist2 = NULL
+		) const;
+
+	///
+	/// search_nearest_surface()の、距離の2乗がbound2未満の三角形だけを検索する版。
+	/// 既知の三角形(前回の検索結果等)までの距離の2乗をbound2に与えると、
+	/// 始めから枝刈りして検索できる。
+	///
+	///  @param[in]  pos	指定位置
+	///  @param[in]  bound2	距離の2乗の上限。負の場合は制限しない。
+	///  @param[out] foot	面上の最近点。NULL可。
+	///  @param[out] bary	最近点の重心座標(頂点0,1,2の重み)。NULL可。
+	///  @param[out] dist2	最近点までの距離の2乗。NULL可。
+	///  @return    検索されたポリゴン。距離の2乗がbound2未満のポリゴンが
+	///				無い場合NULL。
+	///
+	const PrivateTriangle* search_nearest_surface_within(
+		const Vec3<PL_REAL>&	pos,
+		PL_CALC_REAL			bound2,
+		Vec3<PL_REAL>*			foot,
+		PL_REAL					bary[3] = NULL,
+		PL_REAL*				dist2 = NULL
+		) const;
+
+	///
+	/// KD木と三角形リストの世代番号を取得。KD木の構築、三角形の追加・削除の
+	/// 度に増える。検索結果の三角形へのポインタを保持する場合に、それが
+	/// 有効かどうかの判定に用いる。
+	///
+	///  @return	世代番号。
+	///  @attention	剛体インスタンシングのグループのmove()は三角形を
+	///				作り直さないので、世代番号は変わらない。
+	///
+	unsigned long get_tree_generation() const {
+		return m_tree_generation;
+	}
+
+	///
+	/// 相手のグループと交差(共有点を持つ)する三角形の組を、両グループの
+	/// KD木の二重木探索で求める。
+	///
+	///  @param[in]  other	相手のグループ(リーフグループ)。
+	///  @param[out] pairs	三角形の組(末尾に追加)。tri_aがこのグループの三角形。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention 移動後はrebuild_polygons()でKD木を再構築してから呼ぶこと
+	///				(剛体インスタンシングのグループは不要)。
+	///
+	POLYLIB_STAT search_intersecting_pairs(
+		const PolygonGroup			*other,
+		std::vector<TrianglePair>	*pairs
+		) const;
+
+	///
+	/// 相手のグループとの距離がdist以下の三角形の組を、両グループの
+	/// KD木の二重木探索で求める。
+	///
+	///  @param[in]  other	相手のグループ(リーフグループ)。
+	///  @param[in]  dist	距離(0以上)。
+	///  @param[out] pairs	三角形の組(末尾に追加)。dist2に距離の2乗が入る。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT search_pairs_within(
+		const PolygonGroup			*other,
+		PL_REAL						dist,
+		std::vector<TrianglePair>	*pairs
+		) const;
+
+	///
+	/// 相手のグループとの最短距離と、その距離の三角形の組を求める。
+	///
+	///  @param[in]  other	相手のグループ(リーフグループ)。
+	///  @param[out] pair	最も近い組。どちらかに三角形が無い場合tri_aが0。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT search_nearest_pair(
+		const PolygonGroup			*other,
+		TrianglePair				*pair
+		) const;
+
+	///
+	/// 複数の指定位置について面上の最近点を求め、その点でのDVertexの
+	/// スカラー/ベクター値を三角形頂点値の重心補間で求める。
+	/// 指定位置毎に独立なため、OpenMP有効時はスレッド並列で処理する。
+	///
+	///  @param[in]  points			指定位置(x,y,zの順にnpoints*3個)
+	///  @param[in]  npoints		指定位置数
+	///  @param[in]  scalar_index	補間するスカラーのインデックス(nscalar個)
+	///  @param[in]  nscalar		補間するスカラー数
+	///  @param[in]  vector_index	補間するベクターのインデックス(nvector個)
+	///  @param[in]  nvector		補間するベクター数
+	///  @param[out] scalars		補間値(指定位置毎にnscalar個、npoints*nscalar個)
+	///  @param[out] vectors		補間値(指定位置毎にnvector*3個、npoints*nvector*3個)
+	///  @param[out] foot			面上の最近点(npoints*3個)。NULL可。
+	///  @param[out] tri_id			最近点を含む三角形ID(npoints個)。NULL可。
+	///							ポリゴンが無い場合-1となり、補間値は0となる。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention DVertexを持つグループのみ。
+	///
+	POLYLIB_STAT interpolate_DVertex(
+		const PL_REAL*	points,
+		int				npoints,
+		const int*		scalar_index,
+		int				nscalar,
+		const int*		vector_index,
+		int				nvector,
+		PL_REAL*		scalars,
+		PL_REAL*		vectors,
+		PL_REAL*		foot = NULL,
+		int*			tri_id = NULL
+		) const;
+
 	///
 	/// PolygonGroupのフルパス名を取得する。
 	///
@@ -425,7 +730,7 @@ public:
 	///
 	///  @param[in]	neibour_bbox		隣接PE領域バウンディングボックス。
 	///  @param[in]	exclude_tria_ids	領域移動対象外三角形IDリスト。
-	///  @return	検索結果三角形リスト。
+	///  @return	検索結果三角形リスト。遅延読み込みに失敗した場合はNULL。
 	///
 	const std::vector<PrivateTriangle*>* search_outbounded(
 		BBox				neibour_bbox,
@@ -505,6 +810,207 @@ public:
 		int id
 		);
 
+	///
+	/// グループの三角形の稜線による隣接関係を作成し、連結成分(シェル)を
+	/// 番号付けする。境界稜線・非多様体稜線の検出やシェル毎の外接矩形は
+	/// adjから取得する。三角形番号はget_triangles()の添字。
+	///
+	///  @param[out] adj			隣接関係。
+	///  @param[in]  set_shell		true:三角形のm_shellにシェル番号を設定する。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention 三角形の追加・削除、KD木の再構築をするとadjは無効になる。
+	///
+	POLYLIB_STAT build_adjacency(
+		TriangleAdjacency	*adj,
+		bool				set_shell = true
+		);
+
+	//=======================================================================
+	// 剛体インスタンシング
+	//=======================================================================
+	///
+	/// 剛体インスタンシングの有効/無効を設定する。
+	/// 有効なグループは、KD木構築時の座標系(ローカル座標系)のメッシュとKD木を
+	/// 保持したまま、ローカル→ワールドの剛体変換だけをmove()で更新する。
+	/// 検索はクエリをローカル座標系へ変換して行うため、KD木の再構築は不要。
+	///
+	///  @param[in] flag	true:有効 / false:無効。
+	///  @attention 検索結果やget_triangles()の三角形の頂点座標・法線は
+	///				ローカル座標系の値。ワールド座標はto_world_pos()で求めるか、
+	///				materialize_vertices()で頂点へ反映する。
+	///				save、migrateでは自動的にワールド座標で出力・送信する。
+	///  @attention 無効化する時は、現在の変換を頂点へ反映してKD木を再構築する。
+	///  @attention init()等やload_stl_file()でメッシュを置き換えると、与えた座標を
+	///				ワールド座標とし、剛体変換は単位変換に戻る(遅延読み込みを除く)。
+	///
+	POLYLIB_STAT set_rigid_instancing(
+		bool flag
+		);
+
+	///
+	/// 剛体インスタンシングが有効か？
+	///
+	///  @return	true:有効。
+	///
+	bool is_rigid_instanced() const;
+
+	///
+	/// ローカル座標系からワールド座標系への剛体変換を設定する。
+	///  x_world = rot * x_local + trans
+	///
+	///  @param[in] rot		回転行列(3x3, 行優先)。
+	///  @param[in] trans	並進ベクトル。
+	///  @attention O(1)。頂点座標は materialize_vertices() まで更新されない。
+	///				剛体インスタンシングが無効なグループでは何もしない。
+	///
+	void set_rigid_transform(
+		const PL_REAL			rot[9],
+		const Vec3<PL_REAL>&	trans
+		);
+
+	///
+	/// 現在の剛体変換の後に、さらに剛体移動を合成する。
+	///  x_world' = rot * x_world + trans
+	///
+	///  @param[in] rot		回転行列(3x3, 行優先)。NULLなら単位行列。
+	///  @param[in] trans	並進ベクトル。
+	///  @attention O(1)。move()の実装から呼ぶことを想定。
+	///				剛体インスタンシングが無効なグループでは何もしない。
+	///
+	void apply_rigid_motion(
+		const PL_REAL			rot[9],
+		const Vec3<PL_REAL>&	trans
+		);
+
+	///
+	/// 現在の剛体変換を取得する。
+	///
+	///  @param[out] rot	回転行列(3x3, 行優先)。
+	///  @param[out] trans	並進ベクトル。
+	///
+	void get_rigid_transform(
+		PL_REAL			rot[9],
+		Vec3<PL_REAL>&	trans
+		) const;
+
+	///
+	/// 現在の剛体変換を取得する(double精度)。
+	///
+	///  @param[out] rt	回転行列(3x3, 行優先)と並進ベクトルの12要素。
+	///  @return	単位変換でなければtrue。
+	///
+	bool get_rigid_transform(
+		double	rt[12]
+		) const;
+
+	///
+	/// 剛体変換を頂点座標へ反映(実体化)し、ワールド座標系でKD木を再構築する。
+	/// 以後はワールド座標系がローカル座標系となり、変換は単位変換に戻る。
+	/// 検索からは呼ばれない。頂点座標を直接参照する前に明示的に呼ぶ。
+	///
+	///  @param[in] rebuild	false:KD木を再構築しない(要再構築のままとなるので、
+	///						三角形を追加した後等にrebuild_polygons()を呼ぶこと)。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention	変換が単位変換の場合は何もしない。KD木の再構築はO(n log n)。
+	///
+	POLYLIB_STAT materialize_vertices(
+		bool	rebuild = true
+		);
+
+	///
+	/// ローカル座標系の位置をワールド座標系に変換する。
+	///
+	///  @param[in] pos	ローカル座標系の位置(三角形の頂点座標等)。
+	///  @return	ワールド座標系の位置。
+	///
+	Vec3<PL_REAL> to_world_pos(
+		const Vec3<PL_REAL>&	pos
+		) const;
+
+	///
+	/// ワールド座標系の位置をローカル座標系に変換する。
+	///
+	///  @param[in] pos	ワールド座標系の位置。
+	///  @return	ローカル座標系の位置。
+	///
+	Vec3<PL_REAL> to_local_pos(
+		const Vec3<PL_REAL>&	pos
+		) const;
+
+	//=======================================================================
+	// 空間充填曲線による並べ替え
+	//=======================================================================
+	///
+	/// KD木構築(読み込み後、移動後、migrate後)の直前に、三角形と頂点を
+	/// 空間充填曲線に沿って並べ替えるかを設定する。
+	/// 設定ファイルでは reorder = "morton" | "hilbert" で指定する。
+	///
+	///  @param[in] type	曲線の種類。SFC_NONEで並べ替えない(既定)。
+	///  @attention 並べ替えると三角形のアドレスと三角形リストの順が変わる。
+	///				IDによる参照にはfind_triangle()を用いること。
+	///
+	void set_reorder(
+		SpaceFillingCurve::Type type
+		);
+
+	///
+	/// 並べ替えに用いる曲線の種類を取得。
+	///
+	SpaceFillingCurve::Type get_reorder() const;
+
+	///
+	/// IDを指定して三角形を取得する。
+	///
+	///  @param[in] id	三角形ID
+	///  @return	三角形。見つからない場合NULL。
+	///
+	PrivateTriangle* find_triangle(
+		int id
+		);
+
+	///
+	/// IDを指定して三角形を削除する。頂点は削除しない。
+	/// KD木はrebuild_polygons()で再構築される。
+	///
+	///  @param[in] id	三角形ID
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT remove_triangle(
+		int id
+		);
+
+	//=======================================================================
+	// 読み取り専用の複製(スナップショット)
+	//=======================================================================
+	///
+	/// KD木を構築するたびに、三角形とKD木の読み取り専用の複製を公開するかを
+	/// 設定する。設定ファイルでは snapshot = "true" で指定する。
+	/// 有効にすると、他のスレッドがmove()/rebuild_polygons()を実行している
+	/// 間も、acquire_snapshot()で得た複製に対してロックなしで検索できる。
+	/// 剛体インスタンシング時は、剛体変換を変更するたびに形状を共有した
+	/// 複製を公開する(頂点・三角形・KD木の複製は行わない)。
+	///
+	///  @param[in] enable	true:公開する。false:公開をやめる(既定)。
+	///  @attention 複製のぶんだけメモリを消費する。DVertexのデータは複製しない。
+	///
+	void set_snapshot(
+		bool enable
+		);
+
+	///
+	/// 複製を公開するかを取得。
+	///
+	bool get_snapshot() const;
+
+	///
+	/// 公開中の複製への参照を取得する。任意のスレッドから呼び出せる。
+	///
+	///  @return	ハンドル。公開されていない場合は無効なハンドル。
+	///  @attention 複製はハンドルを保持している間は解放されない。
+	///				複製の三角形は元の三角形とは別物で、アドレスは一致しない。
+	///
+	PolygonSnapshotHandle acquire_snapshot() const;
+
 	//=======================================================================
 	// Setter/Getter
 	//=======================================================================
@@ -608,6 +1114,7 @@ public:
 	/// Polygonクラスが管理する頂点リストを取得。
 	///
 	/// @return  頂点リスト
+	/// @attention 剛体インスタンシングのグループではローカル座標系の座標。
 	///
 	VertexList* get_vertexlist() ;
 
@@ -621,6 +1128,7 @@ public:
 	/// Polygonクラスが管理する三角形ポリゴンリストを取得。
 	///
 	/// @return 三角形ポリゴンリスト。
+	/// @attention 剛体インスタンシングのグループではローカル座標系の座標。
 	///
 	std::vector<PrivateTriangle*>* get_triangles();
 
@@ -670,11 +1178,20 @@ public:
 	int get_movable() ;
 
 	///
-	/// move()による移動前三角形一時保存リストの個数を取得。
+	/// move()による移動前頂点座標の一時保存数を取得。
+	///
+	///  @return 一時保存した頂点数。
+	///
+	size_t get_num_of_vertices_before_move();
+
+	///
+	/// グループが利用しているメモリ量を構造別に加算する。
+	/// ポリゴン(頂点、三角形、KD木、DVertexフィールド)と、グループ自身、
+	/// 移動前座標、剛体インスタンシング用座標を含む。子グループは含まない。
 	///
-	///  @return 一時保存リストサイズ。
+	///  @param[in,out]	p_usage	加算先
 	///
-	size_t get_num_of_trias_before_move();
+	virtual void memory_usage( PolylibMemoryUsage* p_usage ) const;
 
 	///
 	/// test function for Vertex test
@@ -719,32 +1236,30 @@ protected:
 
 	///
 	/// move()メソッド実行により、頂点が隣接セルよりも遠くへ移動した三角形情報
-	/// を報告（前処理）。
+	/// を報告（前処理）。頂点座標を連続したバッファへ保存する。
 	///
 	///  @return	POLYLIB_STATで定義される値が返る。
-	///  @attention 本メソッドはデバッグ用です。
-	///  			派生クラスでオーバーライドしたmove()メソッド内で、座標移動
+	///  @attention 派生クラスでオーバーライドしたmove()メソッド内で、座標移動
 	///				処理前に呼ぶこと。
 	///
 	POLYLIB_STAT init_check_leaped();
 
 	///
 	/// move()メソッド実行により、頂点が隣接セルよりも遠くへ移動した三角形情報
-	/// を報告（後処理）。該当する三角形について、以下の情報をcerrへ出力する。
-	///		・ポリゴングループID
-	///		・三角形ID
-	///		・移動前/後の頂点座標
+	/// を報告（後処理）。保存した移動前座標と現在の座標を一括で比較する。
 	///
-	///  @param[in] origin		計算領域起点座標
-	///  @param[in] cell_size	ボクセルサイズ
+	///  @param[in]  origin		計算領域起点座標
+	///  @param[in]  cell_size	ボクセルサイズ
+	///  @param[out] result		チェック結果。NULLの場合は違反があった時に
+	///							概要を PL_ERROSH へ出力する。
 	///  @return	POLYLIB_STATで定義される値が返る。
-	///  @attention	本メソッドはデバッグ用です。
-	///  			派生クラスでオーバーライドしたmove()メソッド内で、座標移動
-	///				処理後に呼ぶこと。
+	///  @attention	派生クラスでオーバーライドしたmove()メソッド内で、座標移動
+	///				処理後に呼ぶこと。OpenMP有効時はスレッド並列で処理する。
 	///
 	POLYLIB_STAT check_leaped(
 		Vec3<PL_REAL> origin,
-		Vec3<PL_REAL> cell_size
+		Vec3<PL_REAL> cell_size,
+		LeapCheckResult* result = NULL
 		);
 
 	///
@@ -763,6 +1278,104 @@ protected:
 		Vec3<PL_REAL> pos2
 		);
 
+	///
+	/// 剛体変換を単位変換に戻す。KD木構築直後に呼ぶ。
+	///
+	void reset_rigid_frame();
+
+	///
+	/// get_rigid_transform()で取得した剛体変換を設定し直す。
+	/// 遅延読み込みで、読み込み前に設定された変換を読み込んだメッシュに適用する。
+	///
+	///  @param[in] rt	回転行列(3x3, 行優先)と並進ベクトルの12要素。
+	///
+	void restore_rigid_transform(
+		const double	rt[12]
+		);
+
+	///
+	/// 剛体変換を頂点座標と法線へ反映し、単位変換に戻す。KD木は要再構築となる。
+	/// 三角形の追加、migrateでの送信等、頂点座標をワールド座標で扱う変更の前に呼ぶ。
+	///
+	void bake_rigid_transform();
+
+	///
+	/// save用に、頂点座標と法線を一時的にワールド座標系の値にする。
+	/// restore_local_coords()で元に戻すまで、三角形・頂点の増減はしないこと。
+	///
+	///  @param[out] local	ローカル座標(VertexListの順にx,y,z)の退避先。
+	///  @return	座標を書き換えた場合true。
+	///
+	bool apply_world_coords(
+		std::vector<PL_REAL>	*local
+		);
+
+	///
+	/// apply_world_coords()で退避したローカル座標に戻す。
+	///
+	///  @param[in] local	退避したローカル座標。
+	///
+	void restore_local_coords(
+		const std::vector<PL_REAL>&	local
+		);
+
+	///
+	/// ワールド座標系の矩形領域を、ローカル座標系で外包する矩形領域に変換する。
+	///
+	///  @param[in] bbox	ワールド座標系の矩形領域。
+	///  @return	ローカル座標系の矩形領域。
+	///
+	BBox to_local_bbox(
+		const BBox&	bbox
+		) const;
+
+	///
+	/// ローカル座標系の検索の候補から、ワールド座標系の矩形領域で判定し直した
+	/// 三角形を選ぶ。
+	///
+	///  @param[in]  bbox		ワールド座標系の矩形領域。
+	///  @param[in]  every		true:3頂点が全て領域内 / false:外接矩形が交差。
+	///  @param[in]  candidates	候補の三角形。
+	///  @param[out] tri_list	選んだ三角形(末尾に追加)。
+	///
+	void select_in_world(
+		const BBox&							bbox,
+		bool								every,
+		const std::vector<PrivateTriangle*>&	candidates,
+		std::vector<PrivateTriangle*>		*tri_list
+		) const;
+
+	///
+	/// KD木を構築(またはキャッシュから復元)した後の処理。剛体インスタンシングの
+	/// ローカル座標系の再設定と、読み取り専用の複製の公開を行う。
+	///
+	void tree_built();
+
+	///
+	/// 現在の三角形とKD木の読み取り専用の複製を、現在の剛体変換付きで公開する。
+	///
+	void publish_snapshot();
+
+	///
+	/// 剛体変換だけを変更した後に、公開中の複製と形状を共有し剛体変換だけが
+	/// 異なる複製を公開する。KD木が要再構築の場合は何もしない(構築時に公開される)。
+	///
+	void publish_moved_snapshot();
+
+	///
+	/// 相手のグループのローカル座標系から、このグループのローカル座標系への
+	/// 剛体変換を求める。
+	///
+	///  @param[in]  other	相手のグループ。
+	///  @param[out] rel	回転3x3(行優先)、並進3の12要素。
+	///  @return	どちらも恒等変換の場合NULL、
+	///				それ以外はrel。
+	///
+	const PL_CALC_REAL* relative_transform(
+		const PolygonGroup	*other,
+		PL_CALC_REAL		rel[12]
+		) const;
+
 
 
 
@@ -774,9 +1387,9 @@ private:
 	///  @param[in] rank_no	ファイル名に付加するランク番号。
 	///  @param[in] extend	ファイル名に付加する自由文字列。
 	///  @param[in] format	STLファイルフォーマット。
-	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @return	ファイル名。
 	///
-	char *mk_stl_fname(
+	std::string mk_stl_fname(
 		std::string		rank_no,
 		std::string		extend,
 		std::string		format
@@ -792,9 +1405,9 @@ private:
 	///  @param[in] extend	ファイル名に付加する自由文字列。
 	///  @param[in] format	STLファイルフォーマット。
 	///  @param[in,out] stl_fname_map stl ファイル名とポリゴングループのパス
-	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @return	ファイル名。
 	///
-	char *mk_stl_fname(
+	std::string mk_stl_fname(
 		std::string		rank_no,
 		std::string		extend,
 		std::string		*format,
@@ -807,20 +1420,33 @@ private:
 	///
 	///  @param[in] rank_no	ファイル名に付加するランク番号。
 	///  @param[in] extend	ファイル名に付加する自由文字列。
-	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @return	ファイル名。
 	///
-	char *mk_id_fname(
+	std::string mk_id_fname(
 		std::string		extend,
 		std::string		rank_no
 		);
 
 	///
 	/// 全PolygonGroupに一意のグループIDを作成する。
+	/// 複数スレッドから同時に呼び出してよい。
 	///
 	///  @return	グループID。
 	///
 	int create_global_id();
 
+	///
+	/// キャッシュのキー(入力ファイルの識別情報と読み込み条件)を作る。
+	///
+	///  @param[in]  scale	頂点座標の縮尺。
+	///  @param[out] key	キー。
+	///  @return	入力ファイルの情報を取得できない場合false。
+	///
+	bool make_cache_key(
+		PL_REAL			scale,
+		std::string		*key
+		) const;
+
 
 protected:
 	//=======================================================================
@@ -854,8 +1480,8 @@ protected:
 	/// KD木の再構築が必要か？
 	bool					m_need_rebuild;
 
-	/// move()による移動前三角形一時保存リスト。
-	std::vector<PrivateTriangle*>		*m_trias_before_move;
+	/// move()による移動前頂点座標(VertexListの順にx,y,zを連続格納)。
+	std::vector<PL_REAL>				m_coords_before_move;
 
 	/// ユーザ定義ラベル : (追加 2012.08.31)
 	std::string							m_label;
@@ -866,6 +1492,60 @@ protected:
 	///  頂点同一性チェックの判定基準 (追加 2013.09.03)
 	PL_REAL m_tolerance;
 
+	/// 剛体インスタンシングが有効か？
+	bool					m_rigid_instancing;
+
+	/// ローカル→ワールド剛体変換の回転行列(3x3, 行優先)。
+	double					m_rigid_rot[9];
+
+	/// ローカル→ワールド剛体変換の並進ベクトル。
+	double					m_rigid_trans[3];
+
+	/// 剛体変換が単位変換でないか？(頂点座標がワールド座標と異なるか)
+	bool					m_rigid_dirty;
+
+	/// 剛体変換が回転を含むか？(法線の再計算要否)
+	bool					m_rigid_rotated;
+
+	/// KD木構築前の並べ替えに用いる空間充填曲線。
+	SpaceFillingCurve::Type	m_reorder;
+
+	/// KD木構築後に読み取り専用の複製を公開するか？
+	bool					m_snapshot_enabled;
+
+	/// 公開中の読み取り専用の複製
+	PolygonSnapshotSlot		m_snapshot_slot;
+
+	/// 遅延読み込みの状態(0:読み込み済み、1:未読み込み、2:読み込み中)
+	mutable volatile int	m_load_state;
+
+	/// 遅延読み込みの結果
+	mutable POLYLIB_STAT	m_deferred_stat;
+
+	/// 遅延読み込みで三角形IDファイルも読み込むか？
+	bool					m_deferred_with_id;
+
+	/// 遅延読み込みの三角形IDファイルの入力形式
+	ID_FORMAT				m_deferred_id_format;
+
+	/// 遅延読み込み中のグループの外接矩形(外接矩形ファイルから)
+	BBox					m_deferred_bbox;
+
+	/// m_deferred_bboxが有効か？
+	bool					m_deferred_bbox_known;
+
+	/// 読み込み時の頂点座標の縮尺
+	PL_REAL					m_load_scale;
+
+	/// 読み込み時のグループの外接矩形
+	BBox					m_load_bbox;
+
+	/// 読み込み結果のキャッシュディレクトリ(空ならキャッシュしない)
+	std::string				m_cache_dir;
+
+	/// KD木と三角形リストの世代番号
+	unsigned long			m_tree_generation;
+
 private:
 	/// ユーザ定義id : (追加 2010.10.20)
 	int							m_id;
@@ -27,8 +27,6 @@
 
 using namespace Vec3class;
 
-class DVertexManager;
-
 namespace PolylibNS{
 
 ////////////////////////////////////////////////////////////////////////////
@@ -36,101 +34,67 @@ namespace PolylibNS{
 /// クラス:DVertex
 ///   polygon の頂点クラス。
 ///   Vertex   クラスを継承　任意の実数型のスカラーデータを保持できる。
-///
+///   データ本体はDVertexManagerのフィールド毎配列にあり、
+///   DVertexはその中の自身のスロット番号のみを持つ。
+///   生成・複製・破棄はスロットを確保・解放するため、同じDVertexManagerの
+///   DVertexを複数スレッドから同時に生成・破棄してはならない。
 ///
 ////////////////////////////////////////////////////////////////////////////
 
 class DVertex :public Vertex{
+	friend class DVertexManager;
 
 private:
-	PL_REAL* m_scalar;
-	std::vector<Vec3<PL_REAL>*>* m_vector;
 	DVertexManager* DVM_ptr;
 
+	/// DVertexManager内のスロット番号
+	int m_slot;
+
 public:
-	// DVertex(int nscaler,int nvector):m_scalar(NULL),m_vector(NULL){
-	//   if(m_scalar==NULL) m_scalar=new DT[nscaler];
-
-	//   if(m_vector==NULL) m_vector=new std::vector<DT>[nvector];
-	//   for(int i=0;i<nvector;++i){
-	// 	m_vector[i]=new std::vector<DT>;
-	//   }
-
-	DVertex(DVertexManager* DVM):m_scalar(NULL),m_vector(NULL),DVM_ptr(NULL){
-		//#define DEBUG
-#ifdef DEBUG
-		PL_DBGOSH << "DVertex::"<< __func__<< " in "<< std::endl;
-#endif //
-		if(DVM_ptr==NULL) DVM_ptr=DVM;
 
-#ifdef DEBUG
-		PL_DBGOSH << "DVertex::"<< __func__<< " 1 "<< std::endl;
-#endif //
-
-		if(DVM_ptr!=NULL) {
-#ifdef DEBUG
-			PL_DBGOSH << "DVertex::"<< __func__<< " 2 "<< std::endl;
-#endif //
-
-			if(m_scalar==NULL) m_scalar=new PL_REAL[DVM_ptr->nscalar()];
-#ifdef DEBUG
-			PL_DBGOSH << "DVertex::"<< __func__<< " 3 "<< std::endl;
-#endif //
-
-			if(m_vector==NULL) {
-#ifdef DEBUG
-				PL_DBGOSH << "DVertex::"<< __func__<< " 4 "<< std::endl;
-#endif //
-
-				m_vector=new std::vector<Vec3<PL_REAL>*>;
-#ifdef DEBUG
-				PL_DBGOSH << "DVertex::"<< __func__<< " 5 "<< std::endl;
-#endif //
-
-				for(int i=0;i<DVM_ptr->nvector();++i){
-					Vec3<PL_REAL>* tmp=new Vec3<PL_REAL>;
-					m_vector->push_back(tmp);
-				}
-#ifdef DEBUG
-				PL_DBGOSH << "DVertex::"<< __func__<< " 6 "<< std::endl;
-#endif //
-				//#undef DEBUG
-			}
-		}
+	DVertex(DVertexManager* DVM):DVM_ptr(NULL),m_slot(-1){
+		set_DVM(DVM);
 	}
 
+	DVertex():DVM_ptr(NULL),m_slot(-1){}
 
-	DVertex():m_scalar(NULL),m_vector(NULL),DVM_ptr(NULL){}
+	///
+	/// コピーコンストラクタ。同じDVertexManagerに新しいスロットを確保して
+	/// データを複製する。
+	///
+	DVertex(const DVertex& dv):Vertex(dv),DVM_ptr(NULL),m_slot(-1){
+		set_DVM(dv.DVM_ptr);
+		copy_data(dv);
+	}
 
-	void set_DVM(DVertexManager* DVM){
-		if(DVM_ptr==NULL) DVM_ptr=DVM;
-		if(DVM_ptr!=NULL) {
-			if(m_scalar==NULL) m_scalar=new PL_REAL[DVM_ptr->nscalar()];
-			if(m_vector==NULL) {
-				m_vector=new std::vector<Vec3<PL_REAL>*>;
-				for(int i=0;i<DVM_ptr->nvector();++i){
-					Vec3<PL_REAL>* tmp=new Vec3<PL_REAL>;
-					m_vector->push_back(tmp);
-				}
-			}
+	///
+	/// 代入。座標とデータを複製し、スロットは共有しない。
+	///
+	DVertex& operator=(const DVertex& dv){
+		if(this!=&dv){
+			Vertex::operator=(dv);
+			set_DVM(dv.DVM_ptr);
+			copy_data(dv);
 		}
+		return *this;
 	}
 
+	void set_DVM(DVertexManager* DVM){
+		if(DVM_ptr==NULL) DVM_ptr=DVM;
+		if(DVM_ptr!=NULL && m_slot<0) m_slot=DVM_ptr->alloc_slot();
+	}
 
 	~DVertex(){
-		if(m_scalar!=NULL){
-			delete[] m_scalar;
-			m_scalar=NULL;
-		}
-		if(m_vector!=NULL){
-			for(int i=0;i<DVM_ptr->nvector();++i){
-				delete (*m_vector)[i];
-			}
-			delete m_vector;
-			m_vector=NULL;
-		}
+		if(DVM_ptr!=NULL) DVM_ptr->free_slot(m_slot);
+		m_slot=-1;
 	}
 
+	///
+	/// DVertexManager内のスロット番号を返す。
+	/// DVertexManager::scalar_data()等の配列の添字として用いる。
+	///
+	int slot() const {return m_slot;}
+
 	/// スカラー値の登録
 	/// スカラー値を登録する。
 	///
@@ -144,7 +108,7 @@ public:
 				<<" wrong index for DVertex scalar data. index "
 				<< i << "  nscalar = "<<DVM_ptr->nscalar()<<std::endl;
 		} else {
-			m_scalar[i] = d;
+			DVM_ptr->scalar_data(i)[m_slot] = d;
 		}
 	}
 
@@ -161,7 +125,7 @@ public:
 			return 0.;
 		} else {
 
-			return m_scalar[i];
+			return DVM_ptr->scalar_data(i)[m_slot];
 		}
 	}
 
@@ -181,28 +145,45 @@ public:
 				<<" wrong index for DVertex scalar data. index "
 				<< i << "  nscalar = "<<DVM_ptr->nvector()<<std::endl;
 		} else {
-
-			Vec3<PL_REAL>* vector=new Vec3<PL_REAL>;
-			(*vector) = vec;
-			(*m_vector)[i]=vector;
+			PL_REAL* p = DVM_ptr->vector_data(i) + (size_t)m_slot*3;
+			p[0] = vec.x;
+			p[1] = vec.y;
+			p[2] = vec.z;
 		}
 	}
 	/// ベクター値の参照
 	///
 	/// @param[in] i i番目ベクトルのインデックス。0で開始。
 	/// @param[in] vec Vec3 ベクトル
-	void get_vector(const int i, Vec3<PL_REAL>* vec){
+	void get_vector(const int i, Vec3<PL_REAL>* vec) const {
 		if(i>=DVM_ptr->nvector()){
 			PL_ERROSH<< "error in DVertex " << __func__
 				<<" wrong index for DVertex vector data. index "
 				<< i << "  nvector = "<<DVM_ptr->nvector()<<std::endl;
 		} else {
-			(*vec)=*((*m_vector)[i]);
+			const PL_REAL* p = DVM_ptr->vector_data(i) + (size_t)m_slot*3;
+			vec->assign( p[0], p[1], p[2] );
 		}
 	}
 
 	DVertexManager* DVM(){return DVM_ptr;}
 
+private:
+	/// dvのデータを自身のスロットへ複製する。データ構成が同じ場合のみ。
+	void copy_data(const DVertex& dv){
+		if(DVM_ptr==NULL || dv.DVM_ptr==NULL || m_slot<0 || dv.m_slot<0) return;
+		if(DVM_ptr->nscalar()!=dv.DVM_ptr->nscalar() ||
+			DVM_ptr->nvector()!=dv.DVM_ptr->nvector()) return;
+		for(int i=0;i<DVM_ptr->nscalar();++i){
+			DVM_ptr->scalar_data(i)[m_slot]=dv.DVM_ptr->scalar_data(i)[dv.m_slot];
+		}
+		for(int i=0;i<DVM_ptr->nvector();++i){
+			PL_REAL* p=DVM_ptr->vector_data(i)+(size_t)m_slot*3;
+			const PL_REAL* q=dv.DVM_ptr->vector_data(i)+(size_t)dv.m_slot*3;
+			p[0]=q[0]; p[1]=q[1]; p[2]=q[2];
+		}
+	}
+
 };
 
 }
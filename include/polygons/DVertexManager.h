@@ -18,17 +18,32 @@
 #ifndef polylib_dvertex_manager_h
 #define polylib_dvertex_manager_h
 
+#include <vector>
+#include <cstddef>
 #include "common/Vec3.h"
+#include "common/PolylibCommon.h"
+#include "common/PolylibStat.h"
+#include "common/PolylibMemoryUsage.h"
 
 using namespace Vec3class;
 
 namespace PolylibNS{
 
+class DVertex;
+
 ////////////////////////////////////////////////////////////////////////////
 ///
 /// クラス:DVertexManager
-///   DVertex  のユーザー定義データ形式を保持します。
+///   DVertex  のユーザー定義データ形式とデータ本体を保持します。
+///   データはフィールド毎の連続配列(スカラーは1要素/頂点、ベクターは
+///   x,y,zの3要素/頂点)で持ち、各DVertexは配列中の自身の位置(スロット)
+///   のみを保持する。
+///   TriMeshの頂点重複削除後はスロット番号が頂点リストの並びと一致するため、
+///   頂点リスト順のデータを一括で読み書きできる。
 ///
+///   スロットの確保・解放(DVertexの生成・複製・破棄)と配列の再確保は
+///   排他制御しないので、同じDVertexManagerに対しては1スレッドから行うこと。
+///   確保済みスロットのデータの読み書きは、スロットが異なれば並列に行ってよい。
 ///
 ////////////////////////////////////////////////////////////////////////////
 class DVertexManager {
@@ -36,22 +51,146 @@ class DVertexManager {
 private:
 	int m_nscalar;
 	int m_nvector;
-	//    int m_size;
+
+	/// 使用中・未使用を含むスロット数
+	size_t m_nslot;
+
+	/// スカラーデータ(フィールド毎にm_nslot個)
+	std::vector< std::vector<PL_REAL> > m_scalar;
+
+	/// ベクターデータ(フィールド毎にm_nslot*3個)
+	std::vector< std::vector<PL_REAL> > m_vector;
+
+	/// 解放済みスロット番号
+	std::vector<int> m_free_slot;
+
 public:
-	//    DVertexManager():m_nscalar(0),m_nvector(0),m_size(8){};
-	DVertexManager():m_nscalar(0),m_nvector(0){};
-	// DVertexManager(int nscalar,int nvector,int size){
-	//   m_nscalar=nscalar;
-	//   m_nvector=nvector;
-	//   m_size=size;
-	// }
-	DVertexManager(int nscalar,int nvector){
+	DVertexManager():m_nscalar(0),m_nvector(0),m_nslot(0){};
+
+	DVertexManager(int nscalar,int nvector):m_nslot(0){
 		m_nscalar=nscalar;
 		m_nvector=nvector;
+		m_scalar.resize(nscalar);
+		m_vector.resize(nvector);
 	}
-	int nscalar(){return m_nscalar;}
-	int nvector(){return m_nvector;}
-	//int size(){return m_size;}
+
+	int nscalar() const {return m_nscalar;}
+	int nvector() const {return m_nvector;}
+
+	///
+	/// スロット数(配列長)を返す。未使用スロットを含む。
+	///
+	size_t nslot() const {return m_nslot;}
+
+	///
+	/// 使用中のスロット数を返す。
+	///
+	size_t size() const {return m_nslot - m_free_slot.size();}
+
+	///
+	/// 新しいスロットを確保する。データは0で初期化される。
+	///
+	/// @return スロット番号
+	/// @attention スレッドセーフではない。OpenMPの並列領域では呼ばず、
+	///            DVertexを先に逐次で生成してからデータを並列に設定すること。
+	///
+	int alloc_slot();
+
+	///
+	/// スロットを解放する。
+	///
+	/// @param[in] slot スロット番号
+	/// @attention スレッドセーフではない(alloc_slot()と同じ)。
+	///
+	void free_slot(int slot);
+
+	///
+	/// 配列を予約する。大量のDVertexを作成する前に呼ぶと再確保を減らせる。
+	///
+	/// @param[in] n 予約するスロット数
+	///
+	void reserve(size_t n);
+
+	///
+	/// スロットを詰め直し、order[k]のDVertexのスロット番号をkにする。
+	/// orderに含まれないスロットは破棄される。
+	///
+	/// @param[in] order このDVertexManagerに属するDVertexの並び
+	///
+	void repack(const std::vector<DVertex*>& order);
+
+	///
+	/// i番目のスカラーフィールドの先頭アドレス(nslot()個)。
+	/// alloc_slot(),reserve(),repack()で無効になる。
+	///
+	/// @param[in] i スカラーのインデックス。0で開始。
+	///
+	PL_REAL* scalar_data(int i) {
+		return m_scalar[i].empty() ? NULL : &m_scalar[i][0];
+	}
+	const PL_REAL* scalar_data(int i) const {
+		return m_scalar[i].empty() ? NULL : &m_scalar[i][0];
+	}
+
+	///
+	/// i番目のベクターフィールドの先頭アドレス(nslot()*3個、x,y,zの順)。
+	/// alloc_slot(),reserve(),repack()で無効になる。
+	///
+	/// @param[in] i ベクターのインデックス。0で開始。
+	///
+	PL_REAL* vector_data(int i) {
+		return m_vector[i].empty() ? NULL : &m_vector[i][0];
+	}
+	const PL_REAL* vector_data(int i) const {
+		return m_vector[i].empty() ? NULL : &m_vector[i][0];
+	}
+
+	///
+	/// i番目のスカラーフィールドをスロット順に一括設定する。
+	///
+	/// @param[in] i	スカラーのインデックス。0で開始。
+	/// @param[in] data	設定値(n個)
+	/// @param[in] n	設定数。nslot()以下。
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT set_scalar_array(int i, const PL_REAL* data, size_t n);
+
+	///
+	/// i番目のスカラーフィールドをスロット順に一括取得する。
+	///
+	/// @param[in]  i		スカラーのインデックス。0で開始。
+	/// @param[out] data	取得先(n個)
+	/// @param[in]  n		取得数。nslot()以下。
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT get_scalar_array(int i, PL_REAL* data, size_t n) const;
+
+	///
+	/// i番目のベクターフィールドをスロット順に一括設定する。
+	///
+	/// @param[in] i	ベクターのインデックス。0で開始。
+	/// @param[in] data	設定値(n*3個、x,y,zの順)
+	/// @param[in] n	設定するベクター数。nslot()以下。
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT set_vector_array(int i, const PL_REAL* data, size_t n);
+
+	///
+	/// i番目のベクターフィールドをスロット順に一括取得する。
+	///
+	/// @param[in]  i		ベクターのインデックス。0で開始。
+	/// @param[out] data	取得先(n*3個、x,y,zの順)
+	/// @param[in]  n		取得するベクター数。nslot()以下。
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT get_vector_array(int i, PL_REAL* data, size_t n) const;
+
+	///
+	/// フィールド配列の利用メモリ量(確保済み容量)をm_fieldsへ加算する。
+	///
+	/// @param[in,out] p_usage 加算先
+	///
+	void memory_usage(PolylibMemoryUsage* p_usage) const;
 
 };
 
@@ -45,6 +45,19 @@ public:
 		int		id
 		);
 
+	///
+	/// コンストラクタ。
+	///
+	/// @param[in] vertex_ptr	ポリゴンの頂点(DVertex)へのポインタ。
+	/// @param[in] id		三角形ポリゴンID。
+	/// @param[in] exid		三角形ポリゴンのユーザ定義ID。
+	///
+	DVertexTriangle(
+		DVertex*	vertex_ptr[3] ,
+		int		id,
+		int		exid
+		);
+
 	///
 	/// コンストラクタ。
 	///
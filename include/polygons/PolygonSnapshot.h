@@ -0,0 +1,382 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_polygonsnapshot_h
+#define polylib_polygonsnapshot_h
+
+#include <vector>
+
+#include "common/Vec3.h"
+#include "common/BBox.h"
+#include "common/PolylibStat.h"
+#include "common/PolylibCommon.h"
+#include "common/PolylibMemoryUsage.h"
+#include "polygons/Vertex.h"
+#include "polygons/PrivateTriangle.h"
+
+using namespace Vec3class;
+
+namespace PolylibNS {
+
+class VTree;
+class PolygonSnapshotGeometry;
+class PolygonSnapshotHandle;
+class PolygonSnapshotSlot;
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:PolygonSnapshot
+/// ある時点の三角形ポリゴンとKD木の読み取り専用の複製。
+/// 元の三角形はmove()で頂点座標が書き換えられ、migrate()等で削除されるため、
+/// 頂点・三角形は連続領域へ複製する。KD木は元のKD木の構造をそのまま写し、
+/// 複製に対して木を作り直すことはしない。
+/// 剛体インスタンシング時は複製の座標をローカル座標系のまま持ち、公開時点の
+/// 剛体変換で検索する。剛体変換だけが変わった場合は形状を共有した複製を作る。
+/// 参照カウントで管理され、PolygonSnapshotHandleを通じてのみ利用する。
+///
+////////////////////////////////////////////////////////////////////////////
+class PolygonSnapshot {
+public:
+	///
+	/// 三角形リストとそのKD木から複製を作成する。参照カウントは0。
+	///
+	///  @param[in] tri_list	複製元の三角形リスト。
+	///  @param[in] tree		tri_listから構築済みのKD木。NULLの場合は複製に対して構築する。
+	///  @param[in] max_elem	KD木のリーフノードが持つ最大要素数。
+	///  @param[in] rigid		剛体変換(回転行列9個、並進3個)。NULLの場合は単位変換。
+	///  @return	作成した複製。
+	///
+	static PolygonSnapshot* create(
+		const std::vector<PrivateTriangle*>	*tri_list,
+		const VTree							*tree,
+		int									max_elem,
+		const double						*rigid = NULL
+		);
+
+	///
+	/// 形状(頂点・三角形・KD木)を共有し、剛体変換だけが異なる複製を作成する。
+	/// 参照カウントは0。
+	///
+	///  @param[in] base	形状を共有する複製。
+	///  @param[in] rigid	剛体変換(回転行列9個、並進3個)。NULLの場合は単位変換。
+	///  @return	作成した複製。
+	///
+	static PolygonSnapshot* create_moved(
+		const PolygonSnapshot	*base,
+		const double			*rigid
+		);
+
+	///
+	/// デストラクタ。
+	///
+	~PolygonSnapshot();
+
+	///
+	/// KD木探索により、指定矩形領域に含まれる三角形ポリゴンを抽出する。
+	///
+	///  @param[in] bbox	検索範囲を示す矩形領域。
+	///  @param[in] every	true:3頂点が全て検索領域に含まれるものを抽出。
+	///						false:1頂点でも検索領域に含まれるものを抽出。
+	///  @return	抽出したポリゴンリストのポインタ。vectorは要削除。
+	///  @attention 三角形はハンドルを保持している間だけ有効。
+	///
+	std::vector<PrivateTriangle*>* search(
+		BBox	*bbox,
+		bool	every
+		) const;
+
+	///
+	/// KD木探索により、指定矩形領域に含まれる三角形ポリゴンを抽出する。
+	///
+	///  @param[in]		bbox		検索範囲を示す矩形領域。
+	///  @param[in]		every		true:3頂点が全て検索領域に含まれるものを抽出。
+	///								false:1頂点でも検索領域に含まれるものを抽出。
+	///  @param[in,out] tri_list	抽出した三角形ポリゴンリストへのポインタ。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT search(
+		BBox							*bbox,
+		bool							every,
+		std::vector<PrivateTriangle*>	*tri_list
+		) const;
+
+	///
+	/// KD木探索により、指定位置に最も近いポリゴンを検索する。
+	///
+	///  @param[in] pos	指定位置
+	///  @return	検索されたポリゴン。ポリゴンが無い場合NULL。
+	///
+	const PrivateTriangle* search_nearest(
+		const Vec3<PL_REAL>&	pos
+		) const;
+
+	///
+	/// KD木探索により、指定位置から面上の最近点を持つポリゴンを検索する。
+	///
+	///  @param[in]  pos	指定位置
+	///  @param[out] bary	最近点の重心座標。NULL可。
+	///  @param[out] dist2	最近点までの距離の2乗。NULL可。
+	///  @return	検索されたポリゴン。ポリゴンが無い場合NULL。
+	///
+	const PrivateTriangle* search_nearest_surface(
+		const Vec3<PL_REAL>&	pos,
+		PL_REAL					bary[3],
+		PL_REAL*				dist2
+		) const;
+
+	///
+	/// 複製した三角形リストを取得。頂点座標はローカル座標系。
+	///
+	const std::vector<PrivateTriangle*>* get_triangles() const;
+
+	///
+	/// 全三角形を外包するBoundingBox(ワールド座標系)を取得。
+	///
+	const BBox& get_bbox() const {
+		return m_bbox;
+	}
+
+	///
+	/// 剛体変換を取得する。
+	///
+	///  @param[out] rt	回転行列9個と並進3個。
+	///  @return	単位変換でない場合true。
+	///
+	bool get_rigid_transform(
+		double	rt[12]
+		) const;
+
+	///
+	/// 複製の頂点座標(ローカル座標系)をワールド座標系へ変換する。
+	///
+	///  @param[in] pos	ローカル座標
+	///  @return	ワールド座標
+	///
+	Vec3<PL_REAL> to_world_pos(
+		const Vec3<PL_REAL>&	pos
+		) const;
+
+	///
+	/// 世代番号を取得。公開されるたびに1ずつ増える。
+	///
+	unsigned long get_generation() const {
+		return m_generation;
+	}
+
+	///
+	/// 利用メモリ量を種類別に加算する。形状を共有する複製も重複して数える。
+	///
+	///  @param[in,out]	p_usage	加算先
+	///
+	void memory_usage( PolylibMemoryUsage* p_usage ) const;
+
+private:
+	friend class PolygonSnapshotHandle;
+	friend class PolygonSnapshotSlot;
+
+	///
+	/// コンストラクタ。create()を用いること。
+	///
+	///  @param[in] geom	共有する形状。参照カウントを1増やす。
+	///  @param[in] rigid	剛体変換。NULLの場合は単位変換。
+	///
+	PolygonSnapshot(
+		PolygonSnapshotGeometry	*geom,
+		const double			*rigid
+		);
+
+	/// コピー禁止
+	PolygonSnapshot( const PolygonSnapshot& );
+	PolygonSnapshot& operator=( const PolygonSnapshot& );
+
+	///
+	/// 参照カウントを1増やす。
+	///
+	void add_ref();
+
+	///
+	/// 参照カウントを1減らし、0になったら削除する。
+	///
+	void release();
+
+	///
+	/// ワールド座標をローカル座標系へ変換する。
+	///
+	Vec3<PL_REAL> to_local_pos(
+		const Vec3<PL_REAL>&	pos
+		) const;
+
+	//=======================================================================
+	// クラス変数
+	//=======================================================================
+	/// 共有する形状(頂点・三角形・KD木)
+	PolygonSnapshotGeometry*		m_geom;
+
+	/// 剛体変換の回転行列(行優先)
+	double							m_rigid_rot[9];
+
+	/// 剛体変換の並進
+	double							m_rigid_trans[3];
+
+	/// 剛体変換が単位変換でないか
+	bool							m_rigid_dirty;
+
+	/// 全三角形を外包するBoundingBox(ワールド座標系)
+	BBox							m_bbox;
+
+	/// 世代番号
+	unsigned long					m_generation;
+
+	/// 参照カウント
+	volatile int					m_refs;
+};
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:PolygonSnapshotHandle
+/// PolygonSnapshotへの参照。保持している間は複製が解放されない。
+/// コピーすると参照カウントが増え、破棄すると減る。
+///
+////////////////////////////////////////////////////////////////////////////
+class PolygonSnapshotHandle {
+public:
+	///
+	/// コンストラクタ。何も参照しない。
+	///
+	PolygonSnapshotHandle();
+
+	///
+	/// コピーコンストラクタ。
+	///
+	PolygonSnapshotHandle( const PolygonSnapshotHandle& other );
+
+	///
+	/// 代入演算子。
+	///
+	PolygonSnapshotHandle& operator=( const PolygonSnapshotHandle& other );
+
+	///
+	/// デストラクタ。参照を手放す。
+	///
+	~PolygonSnapshotHandle();
+
+	///
+	/// 参照を手放す。
+	///
+	void reset();
+
+	///
+	/// 複製を参照しているか？
+	///
+	bool valid() const {
+		return m_snapshot != NULL;
+	}
+
+	///
+	/// 参照している複製を取得。参照していない場合NULL。
+	///
+	const PolygonSnapshot* get() const {
+		return m_snapshot;
+	}
+
+	///
+	/// 参照している複製のメンバへのアクセス。
+	///
+	const PolygonSnapshot* operator->() const {
+		return m_snapshot;
+	}
+
+private:
+	friend class PolygonSnapshotSlot;
+
+	///
+	/// コンストラクタ。参照カウントは呼び出し側で増やしておくこと。
+	///
+	explicit PolygonSnapshotHandle( PolygonSnapshot* snapshot );
+
+	/// 参照している複製
+	PolygonSnapshot* m_snapshot;
+};
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:PolygonSnapshotSlot
+/// 最新のPolygonSnapshotを公開する場所。
+/// publish()は木を再構築するスレッド(1つ)だけが呼び出し、acquire()は
+/// 任意のスレッドからロックなしで呼び出せる。
+/// 読み出し側は偶奇2つのエポックのうち現在のものに入ってから複製を参照する。
+/// publish()は差し替え後にエポックを進め、差し替え前のエポックに入っている
+/// acquire()が抜けるのを待ってから古い複製への参照を手放す。
+/// 新たなacquire()は次のエポックに入るため、publish()が待たされ続けることはない。
+/// 置き換えられた古い複製は、最後のハンドルが破棄された時点で解放される。
+///
+////////////////////////////////////////////////////////////////////////////
+class PolygonSnapshotSlot {
+public:
+	///
+	/// コンストラクタ。
+	///
+	PolygonSnapshotSlot();
+
+	///
+	/// デストラクタ。公開中の複製への参照を手放す。
+	///
+	~PolygonSnapshotSlot();
+
+	///
+	/// 複製を公開し、それまでの複製を置き換える。
+	///
+	///  @param[in] snapshot	公開する複製。NULLの場合は公開を取りやめる。
+	///  @attention 再構築するスレッドだけが呼び出すこと。
+	///
+	void publish( PolygonSnapshot* snapshot );
+
+	///
+	/// 公開中の複製への参照を取得する。
+	///
+	///  @return	ハンドル。公開されていない場合は無効なハンドル。
+	///
+	PolygonSnapshotHandle acquire() const;
+
+	///
+	/// 公開中の複製の利用メモリ量を種類別に加算する。
+	///
+	///  @param[in,out]	p_usage	加算先
+	///
+	void memory_usage( PolylibMemoryUsage* p_usage ) const;
+
+private:
+	/// コピー禁止
+	PolygonSnapshotSlot( const PolygonSnapshotSlot& );
+	PolygonSnapshotSlot& operator=( const PolygonSnapshotSlot& );
+
+	/// 公開中の複製
+	mutable PolygonSnapshot* volatile	m_current;
+
+	/// 現在のエポック(偶奇で読み出し側の数を数える枠を選ぶ)
+	mutable volatile int		m_epoch;
+
+	/// エポックの偶奇ごとのacquire()中のスレッド数
+	mutable volatile int		m_readers[2];
+
+	/// 最後に公開した世代番号
+	unsigned long				m_generation;
+};
+
+} //namespace PolylibNS
+
+#endif //polylib_polygonsnapshot_h
@@ -21,7 +21,9 @@
 
 #include "common/PolylibStat.h"
 #include "common/PolylibCommon.h"
+#include "common/PolylibMemoryUsage.h"
 #include "common/Vec3.h"
+#include "util/SpaceFillingCurve.h"
 #include <vector>
 #include <map>
 #include <string>
@@ -36,9 +38,11 @@ class BBox;
 class Triangle;
 class PrivateTriangle;
 class DVertexTriangle;
+class DVertexManager;
 class VertexList;
 class VertKDT;
 class VTree;
+class PolygonSnapshot;
 
 ////////////////////////////////////////////////////////////////////////////
 ///
@@ -123,7 +127,35 @@ public:
 		const int n_vector
 		)=0;
 
-
+	///
+	/// 頂点配列と三角形の頂点番号配列からDVertexを持つ三角形ポリゴンリストを
+	/// 一括で作成する。既存の三角形ポリゴンリストは破棄される。
+	/// 頂点は重複削除済みとして扱い、DVertexのデータは頂点番号順の
+	/// スロットへ直接書き込む。OpenMP有効時は頂点・三角形の生成をスレッド並列で行う。
+	///
+	///  @param[in] coords	頂点座標(x,y,zの順にnvert*3個)
+	///  @param[in] nvert	頂点数
+	///  @param[in] index	三角形の頂点番号(ntri*3個、0で開始)
+	///  @param[in] ntri	三角形数
+	///  @param[in] idlist	三角形のid(ntri個)。NULLの場合は0からの連番。
+	///  @param[in] exidlist	三角形のユーザ定義id(ntri個)。NULLの場合は0。
+	///  @param[in] scalarlist	スカラーデータ(頂点毎にnscalar個、nvert*nscalar個)。NULL可。
+	///  @param[in] vectorlist	ベクターデータ(頂点毎にnvector*3個)。NULL可。
+	///  @param[in] weld	trueの場合、作成後に重複頂点を削除する。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention prepare_DVertex()でDVertexのデータ構成を設定しておくこと。
+	///  @attention KD木の構築は行わない。
+	///
+	virtual POLYLIB_STAT init_dvertex_indexed(const PL_REAL* coords,
+		const int nvert,
+		const int* index,
+		const int ntri,
+		const int* idlist,
+		const int* exidlist,
+		const PL_REAL* scalarlist,
+		const PL_REAL* vectorlist,
+		const bool weld
+		)=0;
 
 
 	///
@@ -291,6 +323,22 @@ public:
 		const Vec3<PL_REAL>&    pos
 		) const = 0;
 
+	///
+	/// KD木探索により、指定位置から面上の最近点を持つポリゴンを厳密に検索する。
+	///
+	///  @param[in]  pos		指定位置(木構築時の座標系)
+	///  @param[out] bary		最近点の重心座標。NULL可。
+	///  @param[out] dist2		最近点までの距離の2乗。NULL可。
+	///  @param[in]  bound2		0以上の場合、距離の2乗がbound2未満の三角形だけを検索。
+	///  @return 検索されたポリゴン
+	///
+	virtual const PrivateTriangle* search_nearest_surface(
+		const Vec3<PL_REAL>&	pos,
+		PL_REAL					bary[3],
+		PL_REAL*				dist2,
+		PL_CALC_REAL			bound2 = -1
+		) const = 0;
+
 	///
 	/// 配下の全ポリゴンのm_exid値を指定値にする。
 	///
@@ -330,6 +378,70 @@ public:
 
 	virtual void finalize_DVertex();
 
+	///
+	/// 三角形と頂点を空間充填曲線に沿って並べ替える。
+	///
+	/// @param[in] type 曲線の種類
+	/// @return	POLYLIB_STATで定義される値が返る。
+	/// @attention 既定の実装は何もしない。
+	///
+	virtual POLYLIB_STAT reorder(SpaceFillingCurve::Type type);
+
+	///
+	/// IDを指定して三角形を取得する。
+	///
+	/// @param[in] id 三角形ID
+	/// @return	三角形。見つからない場合NULL。
+	/// @attention 既定の実装は線形探索。
+	///
+	virtual PrivateTriangle* find_triangle(int id) const;
+
+	///
+	/// IDを指定して三角形を削除する。頂点は削除しない。
+	///
+	/// @param[in] id 三角形ID
+	/// @return	POLYLIB_STATで定義される値が返る。
+	/// @attention 既定の実装は線形探索。
+	///
+	virtual POLYLIB_STAT remove_triangle(int id);
+
+	///
+	/// 三角形とKD木の読み取り専用の複製を作成する。
+	///
+	/// @param[in] rigid	複製に持たせる剛体変換(回転行列9個、並進3個)。NULLの場合は単位変換。
+	/// @return	複製(参照カウント0)。作成できない場合NULL。
+	/// @attention 既定の実装は複製に対応しないのでNULLを返す。
+	///
+	virtual PolygonSnapshot* create_snapshot(const double* rigid = NULL) const;
+
+	///
+	/// 頂点・三角形とKD木をキャッシュファイルに保存する。
+	///
+	/// @param[in] fname キャッシュファイル名
+	/// @param[in] key	 キャッシュのキー(入力ファイルの識別情報と読み込み条件)
+	/// @return	POLYLIB_STATで定義される値が返る。
+	/// @attention 既定の実装はキャッシュに対応しないのでPLSTAT_NGを返す。
+	///
+	virtual POLYLIB_STAT save_cache(
+		const std::string&	fname,
+		const std::string&	key
+		) const;
+
+	///
+	/// キャッシュファイルから頂点・三角形とKD木を復元する。
+	/// 頂点の併合とKD木の構築は行わない。
+	///
+	/// @param[in] fname キャッシュファイル名
+	/// @param[in] key	 キャッシュのキー
+	/// @return	POLYLIB_STATで定義される値が返る。キャッシュが無いか
+	///			キーが一致しない場合PLSTAT_NGで、内容は変更しない。
+	/// @attention 既定の実装はキャッシュに対応しないのでPLSTAT_NGを返す。
+	///
+	virtual POLYLIB_STAT load_cache(
+		const std::string&	fname,
+		const std::string&	key
+		);
+
 
 
 
@@ -376,6 +488,13 @@ public:
 
 	virtual void print_memory_size() const =0;
 
+	///
+	/// 頂点、三角形、KD木、DVertexフィールドの利用メモリ量を加算する。
+	///
+	///  @param[in,out]	p_usage	加算先
+	///
+	virtual void memory_usage( PolylibMemoryUsage* p_usage ) const =0;
+
 
 	///
 	/// TriMeshクラスが管理しているBoundingBoxを返す。
@@ -389,6 +508,13 @@ public:
 	///
 	virtual bool hasDVertex() const =0;
 
+	///
+	/// DVertexManager
+	///
+	/// @return DVertexのデータ構成。DVertexを持たない場合はNULL。
+	///
+	virtual DVertexManager* DVM() const =0;
+
 private:
 	///
 	/// 三角形ポリゴンリストの初期化。
@@ -22,6 +22,7 @@
 #include <map>
 #include <algorithm>
 #include "polygons/Polygons.h"
+#include "polygons/TriaIdIndex.h"
 #include "common/BBox.h"
 #include <map>
 #include <vector>
@@ -125,6 +126,60 @@ public:
 		const int n_vector
 		);
 
+	///
+	/// 頂点配列と三角形の頂点番号配列から三角形ポリゴンリストを一括で作成する。
+	/// 頂点はVertex、三角形はPrivateTriangleで作成し、頂点は併合しない。
+	/// 既存の三角形ポリゴンリストは破棄される。
+	///
+	///  @param[in] coords	頂点座標(x,y,zの順にnvert*3個)
+	///  @param[in] nvert	頂点数
+	///  @param[in] index	三角形の頂点番号(ntri*3個、0で開始)
+	///  @param[in] ntri	三角形数
+	///  @param[in] idlist	三角形のid(ntri個)。NULLの場合は0からの連番。
+	///                     重複は不可。三角形リストはid順に並べ替えられる。
+	///  @param[in] exidlist	三角形のユーザ定義id(ntri個)。NULLの場合は0。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention KD木の構築は行わない。
+	///
+	POLYLIB_STAT init_indexed(const PL_REAL* coords,
+		const int nvert,
+		const int* index,
+		const int ntri,
+		const int* idlist,
+		const int* exidlist
+		);
+
+	///
+	/// 頂点配列と三角形の頂点番号配列からDVertexを持つ三角形ポリゴンリストを
+	/// 一括で作成する。既存の三角形ポリゴンリストは破棄される。
+	/// 頂点は重複削除済みとして扱い、DVertexのデータは頂点番号順の
+	/// スロットへ直接書き込む。OpenMP有効時は頂点・三角形の生成をスレッド並列で行う。
+	///
+	///  @param[in] coords	頂点座標(x,y,zの順にnvert*3個)
+	///  @param[in] nvert	頂点数
+	///  @param[in] index	三角形の頂点番号(ntri*3個、0で開始)
+	///  @param[in] ntri	三角形数
+	///  @param[in] idlist	三角形のid(ntri個)。NULLの場合は0からの連番。
+	///                     重複は不可。三角形リストはid順に並べ替えられる。
+	///  @param[in] exidlist	三角形のユーザ定義id(ntri個)。NULLの場合は0。
+	///  @param[in] scalarlist	スカラーデータ(頂点毎にnscalar個、nvert*nscalar個)。NULL可。
+	///  @param[in] vectorlist	ベクターデータ(頂点毎にnvector*3個)。NULL可。
+	///  @param[in] weld	trueの場合、作成後に重複頂点を削除する。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention prepare_DVertex()でDVertexのデータ構成を設定しておくこと。
+	///  @attention KD木の構築は行わない。
+	///
+	virtual POLYLIB_STAT init_dvertex_indexed(const PL_REAL* coords,
+		const int nvert,
+		const int* index,
+		const int ntri,
+		const int* idlist,
+		const int* exidlist,
+		const PL_REAL* scalarlist,
+		const PL_REAL* vectorlist,
+		const bool weld
+		);
+
 
 
 	///
@@ -176,6 +231,7 @@ public:
 	///  @param[in] n_tri 加える三角形の数
 	///  @param[in] n_scalar 頂点あたりのスカラーデータの数
 	///  @param[in] n_vector 頂点あたりのベクターデータの数
+	///  @attention m_idが重複する三角形は追加されない。
 
 	virtual void add_dvertex(const PL_REAL* vertlist,
 		const int* idlist,
@@ -294,6 +350,22 @@ public:
 		const Vec3<PL_REAL>&    pos
 		) const;
 
+	///
+	/// KD木探索により、指定位置から面上の最近点を持つポリゴンを厳密に検索する。
+	///
+	///  @param[in]  pos		指定位置(木構築時の座標系)
+	///  @param[out] bary		最近点の重心座標。NULL可。
+	///  @param[out] dist2		最近点までの距離の2乗。NULL可。
+	///  @param[in]  bound2		0以上の場合、距離の2乗がbound2未満の三角形だけを検索。
+	///  @return 検索されたポリゴン
+	///
+	const PrivateTriangle* search_nearest_surface(
+		const Vec3<PL_REAL>&	pos,
+		PL_REAL					bary[3],
+		PL_REAL*				dist2,
+		PL_CALC_REAL			bound2 = -1
+		) const;
+
 	///
 	/// 配下の全ポリゴンのm_exid値を指定値にする。
 	///
@@ -334,6 +406,78 @@ public:
 
 	virtual void finalize_DVertex();
 
+	///
+	/// 三角形と頂点を空間充填曲線に沿って並べ替える。
+	/// 頂点リストは頂点座標のキー順、三角形リストは重心のキー順となり、
+	/// DVertexのデータも頂点リストの順に詰め直される。
+	/// 並べ替えはポインタの入れ替えのみで、頂点・三角形のアドレスは変わらない。
+	/// 順序が変わらない場合は何もしない。ID索引は作り直される。
+	///
+	/// @param[in] type 曲線の種類
+	/// @return	POLYLIB_STATで定義される値が返る。
+	/// @attention 三角形リストの順が変わった場合はKD木が破棄される。build()を呼ぶこと。
+	///
+	virtual POLYLIB_STAT reorder(SpaceFillingCurve::Type type);
+
+	///
+	/// IDを指定して三角形を取得する。ID索引(ハッシュ表)により平均O(1)。
+	/// 索引は三角形リストを変更する操作とbuild()で更新され、検索では変更しないため
+	/// 複数スレッドから同時に呼べる。索引の外で三角形数が変わった場合は
+	/// 線形探索となる。索引の外でのIDの書き換えはbuild()後に反映される。
+	///
+	/// @param[in] id 三角形ID
+	/// @return	三角形。見つからない場合NULL。
+	///
+	virtual PrivateTriangle* find_triangle(int id) const;
+
+	///
+	/// IDを指定して三角形を削除する。三角形リストの末尾の三角形を
+	/// 削除位置へ移すため平均O(1)だが、三角形リストの順は変わる。
+	///
+	/// @param[in] id 三角形ID
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///			見つからない場合PLSTAT_TRIANGLE_NOT_EXIST。
+	/// @attention 頂点は頂点リストに残る。KD木は破棄されるのでbuild()を呼ぶこと。
+	///
+	virtual POLYLIB_STAT remove_triangle(int id);
+
+	///
+	/// 三角形とKD木の読み取り専用の複製を作成する。
+	/// 頂点座標・三角形を複製し、KD木は構築済みの木の構造を写す。
+	/// 木が無い場合や三角形リストと一致しない場合は複製に対して木を作る。
+	///
+	/// @param[in] rigid	複製に持たせる剛体変換(回転行列9個、並進3個)。NULLの場合は単位変換。
+	/// @return	複製(参照カウント0)。
+	///
+	virtual PolygonSnapshot* create_snapshot(const double* rigid = NULL) const;
+
+	///
+	/// 頂点・三角形とKD木をキャッシュファイルに保存する。頂点は頂点番号形式、
+	/// KD木はVTreeNodeImageの形で保存する。キーには頂点同一性の基準値、
+	/// KD木の最大要素数、実数型を加える。
+	///
+	/// @param[in] fname キャッシュファイル名
+	/// @param[in] key	 キャッシュのキー
+	/// @return	POLYLIB_STATで定義される値が返る。DVertexを持つ場合、
+	///			KD木が未構築の場合はPLSTAT_NG。
+	///
+	virtual POLYLIB_STAT save_cache(
+		const std::string&	fname,
+		const std::string&	key
+		) const;
+
+	///
+	/// キャッシュファイルをmmap()して頂点・三角形とKD木を復元する。
+	///
+	/// @param[in] fname キャッシュファイル名
+	/// @param[in] key	 キャッシュのキー
+	/// @return	POLYLIB_STATで定義される値が返る。DVertexを持つ場合はPLSTAT_NG。
+	///
+	virtual POLYLIB_STAT load_cache(
+		const std::string&	fname,
+		const std::string&	key
+		);
+
 	//=======================================================================
 	// Setter/Getter
 	//=======================================================================
@@ -369,6 +513,14 @@ public:
 
 	virtual void print_memory_size() const ;
 
+	///
+	/// 頂点、三角形、KD木、DVertexフィールドの利用メモリ量を加算する。
+	/// 三角形リストと頂点リストは確保済み容量で数える。
+	///
+	///  @param[in,out]	p_usage	加算先
+	///
+	virtual void memory_usage( PolylibMemoryUsage* p_usage ) const;
+
 private:
 	///
 	/// 三角形ポリゴンリストの初期化。
@@ -380,6 +532,31 @@ private:
 	///
 	void init_vertex_list();
 
+	///
+	/// VTK/VTUファイル1つから、頂点番号形式のまま初期化する(頂点の併合はしない)。
+	/// 頂点データがある場合はDVertexとして読み込む。DVertexのデータ構成が
+	/// 設定されていなければファイルの構成で設定し、設定済みであれば
+	/// ファイルの先頭から対応させる(不足分は0)。
+	///
+	///  @param[in] fname	ファイル名。
+	///  @param[in] fmt		ファイルフォーマット。
+	///  @param[in] scale	頂点座標の縮尺。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT import_indexed(
+		const std::string	&fname,
+		const std::string	&fmt,
+		PL_REAL				scale
+		);
+
+	///
+	/// キャッシュのキーに、頂点同一性の基準値、KD木の最大要素数、
+	/// 実数型と計算用の実数型を加える。
+	///
+	std::string full_cache_key(
+		const std::string	&key
+		) const;
+
 	///
 	/// 頂点リストのいれかえ
 	///
@@ -392,6 +569,23 @@ private:
 	//    virtual void vtx_compaction();
 	void vtx_compaction();
 
+	///
+	/// DVertexのデータを頂点リストの並びに詰め直す
+	///
+	void repack_dvertex();
+
+	///
+	/// 三角形リストのうちID索引へ未登録の末尾部分を登録する。
+	/// 三角形リストへの追加は末尾へのpush_backで行われるため、
+	/// 索引は登録済みの個数だけを覚えておけば追いつける。
+	///
+	void sync_id_index();
+
+	///
+	/// ID索引を三角形リストから作り直す。
+	///
+	void rebuild_id_index();
+
 
 	//=======================================================================
 	// クラス変数
@@ -413,6 +607,12 @@ private:
 	/// 2 点の同一性チェックのtolerance
 	PL_REAL m_tolerance ;
 
+	/// 三角形IDから三角形リスト位置への索引
+	TriaIdIndex m_id_index;
+
+	/// ID索引へ登録済みの三角形数(三角形リストの先頭からの個数)
+	size_t m_id_indexed;
+
 };// end of class
 
 
@@ -0,0 +1,203 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_triacodec_h
+#define polylib_triacodec_h
+
+#include <vector>
+#include <cstddef>
+
+#include "common/Vec3.h"
+#include "common/BBox.h"
+#include "common/PolylibCommon.h"
+#include "common/PolylibStat.h"
+#include "polygons/Vertex.h"
+#include "polygons/PrivateTriangle.h"
+
+using namespace Vec3class;
+
+namespace PolylibNS{
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// 構造体:TriaCodecGroup
+/// TriaCodecで復号したグループ単位の三角形情報。
+/// 頂点はグループ内で共有され、三角形は頂点番号の3つ組で表す。
+///
+////////////////////////////////////////////////////////////////////////////
+struct TriaCodecGroup {
+	/// グループID
+	int m_group_id;
+
+	/// 頂点座標リスト(x,y,zの順に頂点数*3個)
+	std::vector<PL_REAL> m_vertices;
+
+	/// 三角形の頂点番号リスト(三角形数*3個)
+	std::vector<int> m_index;
+
+	/// 三角形IDリスト
+	std::vector<int> m_ids;
+
+	/// 三角形のユーザ定義IDリスト
+	std::vector<int> m_exids;
+
+	/// 頂点あたりのDVertexスカラー数(DVertexでない場合0)
+	int m_nscalar;
+
+	/// 頂点あたりのDVertexベクター数(DVertexでない場合0)
+	int m_nvector;
+
+	/// DVertexスカラー値リスト(頂点数*m_nscalar個)
+	std::vector<PL_REAL> m_scalars;
+
+	/// DVertexベクター値リスト(頂点数*m_nvector*3個)
+	std::vector<PL_REAL> m_vectors;
+
+	TriaCodecGroup() : m_group_id(0), m_nscalar(0), m_nvector(0) {}
+
+	///
+	/// DVertexのデータを持つか。
+	///
+	bool has_dvertex() const { return m_nscalar > 0 || m_nvector > 0; }
+
+	///
+	/// 三角形数を返す。
+	///
+	size_t num_trias() const { return m_ids.size(); }
+
+	///
+	/// 従来形式の三角形頂点座標リスト(三角形数*9個)へ展開する。
+	///
+	/// @param[in,out] p_vec 展開先ベクタ(末尾に追加)
+	///
+	void expand_trias( std::vector<PL_REAL>* p_vec ) const;
+};
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:TriaCodec
+/// PE間で三角形を送受信するための圧縮形式の符号化/復号を行う。
+///  - 頂点座標は基準領域(送信先gcell bbox)の最小点からの固定小数点値に
+///    量子化し、誤差は指定した許容誤差以内に収まる。
+///  - 同一グループ内で共有される頂点は一度だけ送信し、三角形は頂点番号の
+///    3つ組で表す。
+///  - 頂点座標、頂点番号、三角形ID、ユーザ定義IDは差分を可変長整数で格納する。
+///  - 許容誤差0の場合は頂点座標を量子化せずそのまま格納する。
+///  - 頂点がDVertexの場合、スカラー/ベクター値も共有頂点ごとに無損失で格納する。
+/// MPIに依存しないため、非並列版でも利用できる。
+///
+////////////////////////////////////////////////////////////////////////////
+class TriaCodec {
+public:
+	///
+	/// コンストラクタ。
+	///
+	/// @param[in] error_bound	頂点座標の許容誤差(>=0)。0の場合は無損失。
+	///
+	TriaCodec( PL_REAL error_bound );
+
+	///
+	/// 符号化を開始する。それまでに追加したグループ情報は破棄される。
+	///
+	/// @param[in] frame	量子化の基準となる領域。通常は受信側のgcell bbox。
+	///
+	void begin( const BBox& frame );
+
+	///
+	/// グループの三角形を符号化対象に追加する。
+	/// 頂点座標とDVertexのデータはこの時点で複製されるため、
+	/// 呼び出し後にp_triasを解放してよい。
+	/// DVertexの有無とデータ構成はグループ先頭の頂点で判定する。
+	///
+	/// @param[in] group_id	グループID
+	/// @param[in] p_trias	グループ内三角形リスト(NULL可、三角形数0として扱う)
+	/// @param[in] rigid	頂点座標に適用する剛体変換(回転3x3行優先、並進3の
+	///						12要素)。NULLの場合は頂点座標をそのまま符号化する。
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT add_group(
+		int group_id,
+		const std::vector<PrivateTriangle*>* p_trias,
+		const double* rigid = NULL
+		);
+
+	///
+	/// 追加済みのグループを符号化する。
+	///
+	/// @param[out] p_buf	出力先バイト列(上書き)
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT encode( std::vector<unsigned char>* p_buf ) const;
+
+	///
+	/// 従来形式(グループID・三角形数の対、ID、ユーザ定義ID、頂点座標9個/三角形、
+	/// DVertexの場合は頂点ごとのデータ)で同じ内容を送った場合のバイト数を返す。
+	///
+	size_t raw_size() const;
+
+	///
+	/// 追加済み三角形数を返す。
+	///
+	size_t num_trias() const { return m_num_trias; }
+
+	///
+	/// 圧縮形式のバイト列を復号する。
+	///
+	/// @param[in]  p_buf		バイト列の先頭
+	/// @param[in]  size		バイト数
+	/// @param[out] p_groups	グループ単位の復号結果(上書き)
+	/// @return	POLYLIB_STATで定義される値が返る。不正なデータの場合PLSTAT_NG。
+	///
+	static POLYLIB_STAT decode(
+		const unsigned char* p_buf,
+		size_t size,
+		std::vector<TriaCodecGroup>* p_groups
+		);
+
+private:
+	/// 符号化途中のグループ情報
+	struct Group {
+		int m_group_id;
+		std::vector<long long> m_qvertices;
+		std::vector<PL_REAL> m_rvertices;
+		std::vector<int> m_index;
+		std::vector<int> m_ids;
+		std::vector<int> m_exids;
+		int m_nscalar;
+		int m_nvector;
+		std::vector<PL_REAL> m_fields;
+	};
+
+	/// 量子化幅(許容誤差の2倍)。0の場合は無損失
+	double m_step;
+
+	/// 量子化の基準点
+	double m_origin[3];
+
+	/// 量子化範囲を超えた頂点があった場合true
+	bool m_overflow;
+
+	/// 追加済み三角形数
+	size_t m_num_trias;
+
+	/// 追加済みグループ情報
+	std::vector<Group> m_groups;
+};
+
+} //namespace PolylibNS
+
+#endif // polylib_triacodec_h
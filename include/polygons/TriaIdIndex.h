@@ -0,0 +1,124 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_triaidindex_h
+#define polylib_triaidindex_h
+
+#include <vector>
+#include <cstddef>
+
+namespace PolylibNS{
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:TriaIdIndex
+/// 三角形IDから三角形リスト上の位置(0以上の整数)への索引。
+/// オープンアドレス法(線形探査)のハッシュ表で、追加・検索・削除は平均O(1)。
+/// 削除済みの枠は墓標として残し、再ハッシュ時に取り除く。
+///
+////////////////////////////////////////////////////////////////////////////
+class TriaIdIndex {
+public:
+	///
+	/// コンストラクタ。
+	///
+	TriaIdIndex();
+
+	///
+	/// 全要素を削除する。確保済み領域は保持する。
+	///
+	void clear();
+
+	///
+	/// n要素を再ハッシュなしで格納できるよう領域を確保する。
+	///
+	/// @param[in] n	要素数
+	///
+	void reserve( size_t n );
+
+	///
+	/// IDと位置の組を追加する。
+	///
+	/// @param[in] id	三角形ID
+	/// @param[in] pos	位置(0以上)
+	/// @return	追加した場合true。IDが登録済みの場合は何もせずfalse。
+	///
+	bool insert( int id, int pos );
+
+	///
+	/// 登録済みIDの位置を更新する。
+	///
+	/// @param[in] id	三角形ID
+	/// @param[in] pos	新しい位置
+	/// @return	IDが登録済みの場合true。
+	///
+	bool update( int id, int pos );
+
+	///
+	/// IDの位置を返す。
+	///
+	/// @param[in] id	三角形ID
+	/// @return	位置。未登録の場合-1。
+	///
+	int find( int id ) const;
+
+	///
+	/// IDを削除する。
+	///
+	/// @param[in] id	三角形ID
+	/// @return	削除した場合true。
+	///
+	bool erase( int id );
+
+	///
+	/// 登録数を返す。
+	///
+	size_t size() const { return m_size; }
+
+	///
+	/// 利用メモリ量(byte)を返す。
+	///
+	size_t memory_size() const;
+
+private:
+	/// 表の1枠
+	struct Slot {
+		int m_id;	///< 三角形ID
+		int m_pos;	///< 位置。EMPTY:未使用、DELETED:削除済み
+	};
+
+	enum { EMPTY = -1, DELETED = -2 };
+
+	/// IDのハッシュ値から最初の枠番号を求める
+	size_t first_slot( int id ) const;
+
+	/// 表の大きさを変更し、全要素を入れ直す
+	void rehash( size_t nslot );
+
+	/// ハッシュ表(大きさは2のべき乗)
+	std::vector<Slot> m_slots;
+
+	/// 登録数
+	size_t m_size;
+
+	/// 登録数+削除済み枠数
+	size_t m_used;
+};
+
+} //namespace PolylibNS
+
+#endif //polylib_triaidindex_h
@@ -88,6 +88,11 @@ public:
 		PL_REAL	area
 		) ;
 
+	///
+	/// デストラクタ。派生クラス(DVertexTriangle等)を基底ポインタでdeleteするため仮想とする。
+	///
+	virtual ~Triangle() {}
+
 	//=======================================================================
 	// Setter/Getter
 	//=======================================================================
@@ -157,6 +162,40 @@ public:
 	///
 	virtual int get_shell() const;
 
+	///
+	/// 指定位置に最も近い三角形上の点を求める。
+	///
+	/// 判定・距離はPL_CALC_REALで評価する。
+	///
+	/// @param[in]  pos		指定位置
+	/// @param[out] bary	最近点の重心座標(頂点0,1,2の重み、和は1)。NULL可。
+	/// @param[out] dist2	最近点までの距離の2乗(PL_REALへ丸める前の値)。NULL可。
+	/// @return 三角形上の最近点
+	///
+	Vec3<PL_REAL> closest_point(
+		const Vec3<PL_REAL>&	pos,
+		PL_REAL					bary[3],
+		PL_CALC_REAL*			dist2 = NULL
+		) const;
+
+	///
+	/// 演算型Cで指定位置に最も近い三角形上の点を求める。
+	///
+	/// closest_point()はC=PL_CALC_REALとして呼ぶ。
+	/// Cはfloatとdoubleを実体化しており、一つのライブラリで併用できる。
+	///
+	/// @param[in]  pos		指定位置
+	/// @param[out] bary	最近点の重心座標。NULL可。
+	/// @param[out] dist2	最近点までの距離の2乗(型Cの値)。NULL可。
+	/// @return 三角形上の最近点
+	///
+	template <typename C>
+	Vec3<PL_REAL> closest_point_as(
+		const Vec3<PL_REAL>&	pos,
+		PL_REAL					bary[3],
+		C*						dist2
+		) const;
+
 protected:
 	///
 	/// 法線ベクトル算出。
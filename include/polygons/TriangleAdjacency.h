@@ -0,0 +1,260 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_triangleadjacency_h
+#define polylib_triangleadjacency_h
+
+#include <vector>
+#include <cstddef>
+
+#include "common/PolylibStat.h"
+#include "common/PolylibCommon.h"
+#include "common/BBox.h"
+
+namespace PolylibNS {
+
+class VertexList;
+class PrivateTriangle;
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:TriangleAdjacency
+/// 頂点を共有する三角形の稜線による隣接関係(稜線表)と連結成分(シェル)。
+/// 三角形番号はbuild()に渡した三角形リストの添字、頂点番号は頂点リストの
+/// 添字である。三角形tの辺k(k=0,1,2)は頂点k→頂点(k+1)%3の稜線。
+/// 稜線は頂点番号の組(小,大)の昇順に番号付けし、稜線を使う三角形の辺を
+/// CSR形式で保持する。
+///
+////////////////////////////////////////////////////////////////////////////
+class TriangleAdjacency {
+public:
+	///
+	/// コンストラクタ。
+	///
+	TriangleAdjacency();
+
+	///
+	/// 稜線表を作成する。頂点は頂点リスト上で併合済みであること
+	/// (同じ位置の別頂点は別の頂点として扱う)。2頂点が同じ退化した辺は
+	/// 稜線に含めない。
+	///
+	///  @param[in] vertex_list	頂点リスト。
+	///  @param[in] tri_list	三角形リスト。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT build(
+		VertexList*								vertex_list,
+		const std::vector<PrivateTriangle*>		*tri_list
+		);
+
+	///
+	/// 稜線で連結した三角形をシェルとして番号付けする(並列のunion-find)。
+	/// 非多様体稜線も連結として扱う。シェル番号は0からで、シェルに含まれる
+	/// 最小の三角形番号の順。シェル毎の外接矩形・三角形数・閉じているかも
+	/// 求める。
+	///
+	///  @param[in] set_triangles	true:三角形のm_shellにシェル番号を設定する。
+	///  @return	シェル数。build()前は0。
+	///
+	int label_shells(
+		bool	set_triangles = true
+		);
+
+	///
+	/// 稜線表とシェルを破棄する。
+	///
+	void clear();
+
+	///
+	/// 三角形数を取得。
+	///
+	int num_triangles() const {
+		return (int)m_tri_edge.size() / 3;
+	}
+
+	///
+	/// 頂点数を取得。
+	///
+	int num_vertices() const {
+		return m_nvert;
+	}
+
+	///
+	/// 稜線数を取得。
+	///
+	int num_edges() const {
+		return (int)m_edge_vtx.size() / 2;
+	}
+
+	///
+	/// 稜線の両端の頂点番号(小,大)を取得。
+	///
+	void edge_vertices( int e, int* v0, int* v1 ) const {
+		*v0 = m_edge_vtx[ (size_t)e*2 ];
+		*v1 = m_edge_vtx[ (size_t)e*2+1 ];
+	}
+
+	///
+	/// 稜線を使う三角形の辺の数を取得。1は境界稜線、2は多様体稜線、
+	/// 3以上は非多様体稜線。
+	///
+	int edge_valence( int e ) const {
+		return m_edge_offsets[e+1] - m_edge_offsets[e];
+	}
+
+	///
+	/// 稜線を使うi番目の三角形の辺を取得。値は三角形番号*3+辺番号。
+	///
+	int edge_use( int e, int i ) const {
+		return m_edge_uses[ m_edge_offsets[e] + i ];
+	}
+
+	///
+	/// 三角形の辺の稜線番号を取得。退化した辺は-1。
+	///
+	int triangle_edge( int t, int k ) const {
+		return m_tri_edge[ (size_t)t*3+k ];
+	}
+
+	///
+	/// 三角形の辺の向こう側の三角形番号を取得。境界稜線・非多様体稜線・
+	/// 退化した辺では-1。
+	///
+	int neighbor( int t, int k ) const;
+
+	///
+	/// 三角形の頂点番号を取得。
+	///
+	int triangle_vertex( int t, int k ) const {
+		return m_tri_vidx[ (size_t)t*3+k ];
+	}
+
+	///
+	/// 境界稜線(使う辺が1つ)の一覧を取得。
+	///
+	///  @param[out] edges	稜線番号のリスト。
+	///
+	void boundary_edges(
+		std::vector<int>	*edges
+		) const;
+
+	///
+	/// 非多様体稜線(使う辺が3つ以上)の一覧を取得。
+	///
+	///  @param[out] edges	稜線番号のリスト。
+	///
+	void nonmanifold_edges(
+		std::vector<int>	*edges
+		) const;
+
+	///
+	/// 向きが揃っていない多様体稜線(2つの三角形が同じ向きに辿る稜線)の
+	/// 一覧を取得。法線の向きが反転している三角形の検出に用いる。
+	///
+	///  @param[out] edges	稜線番号のリスト。
+	///
+	void misoriented_edges(
+		std::vector<int>	*edges
+		) const;
+
+	///
+	/// 全ての稜線が向きの揃った多様体稜線か(閉じた向き付け可能な曲面か)？
+	///
+	bool is_closed() const;
+
+	///
+	/// シェル数を取得。label_shells()前は0。
+	///
+	int num_shells() const {
+		return (int)m_shell_ntri.size();
+	}
+
+	///
+	/// 三角形のシェル番号を取得。label_shells()後に有効。
+	///
+	int get_shell( int t ) const {
+		return m_tri_shell[t];
+	}
+
+	///
+	/// シェルの三角形数を取得。
+	///
+	int shell_num_triangles( int s ) const {
+		return m_shell_ntri[s];
+	}
+
+	///
+	/// シェルの外接矩形を取得。
+	///
+	const BBox& shell_bbox( int s ) const {
+		return m_shell_bbox[s];
+	}
+
+	///
+	/// シェルが閉じているか(境界・非多様体・向きの揃っていない稜線を
+	/// 含まないか)？
+	///
+	bool is_shell_closed( int s ) const {
+		return m_shell_closed[s] != 0;
+	}
+
+	///
+	/// 利用メモリ量(byte)を返す。
+	///
+	size_t memory_size() const;
+
+private:
+	/// 多様体稜線の2辺が逆向きに辿っていればtrue
+	bool is_oriented_edge( int e ) const;
+
+	/// 頂点数
+	int								m_nvert;
+
+	/// 三角形の頂点番号(三角形数*3)
+	std::vector<int>				m_tri_vidx;
+
+	/// 三角形の辺の稜線番号(三角形数*3)
+	std::vector<int>				m_tri_edge;
+
+	/// 稜線の両端の頂点番号(稜線数*2)
+	std::vector<int>				m_edge_vtx;
+
+	/// 稜線毎の辺の開始位置(稜線数+1個)
+	std::vector<int>				m_edge_offsets;
+
+	/// 稜線を使う辺(三角形番号*3+辺番号)
+	std::vector<int>				m_edge_uses;
+
+	/// 三角形リスト
+	std::vector<PrivateTriangle*>	m_triangles;
+
+	/// 三角形のシェル番号
+	std::vector<int>				m_tri_shell;
+
+	/// シェルの三角形数
+	std::vector<int>				m_shell_ntri;
+
+	/// シェルの外接矩形
+	std::vector<BBox>				m_shell_bbox;
+
+	/// シェルが閉じていれば1
+	std::vector<char>				m_shell_closed;
+};
+
+} //namespace PolylibNS
+
+#endif //polylib_triangleadjacency_h
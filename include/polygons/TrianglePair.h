@@ -0,0 +1,115 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_trianglepair_h
+#define polylib_trianglepair_h
+
+#include "common/PolylibCommon.h"
+
+//
+// 2つの三角形の交差判定と距離。
+// 三角形は3頂点の座標(x0,y0,z0,x1,y1,z1,x2,y2,z2)の9要素で渡す。
+//
+
+namespace PolylibNS {
+
+class Triangle;
+class PrivateTriangle;
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// 構造体:TrianglePair
+/// 2つのグループ(KD木)の間の三角形の組。
+///
+////////////////////////////////////////////////////////////////////////////
+struct TrianglePair {
+	/// 1つ目のグループの三角形
+	const PrivateTriangle*	tri_a;
+
+	/// 2つ目のグループの三角形
+	const PrivateTriangle*	tri_b;
+
+	/// 三角形間の距離の2乗。交差する組では0
+	PL_CALC_REAL			dist2;
+
+	TrianglePair() : tri_a(0), tri_b(0), dist2(0) {}
+
+	TrianglePair(
+		const PrivateTriangle*	a,
+		const PrivateTriangle*	b,
+		PL_CALC_REAL			d2
+		) : tri_a(a), tri_b(b), dist2(d2) {}
+};
+
+///
+/// 三角形の3頂点の座標をPL_CALC_REALで取り出す。
+///
+///  @param[in]  tri	三角形。
+///  @param[out] c		頂点座標(9要素)。
+///
+void tri_pair_coords(
+	const Triangle*		tri,
+	PL_CALC_REAL		c[9]
+	);
+
+///
+/// 2つの三角形が交差(共有点を持つ)するか判定する。
+/// 面法線2本、辺の組の外積9本、面内の辺の法線6本の分離軸で判定するので、
+/// 同一平面上の三角形も扱える。接するだけの組も交差とする。
+///
+///  @param[in] a	三角形の頂点座標。
+///  @param[in] b	三角形の頂点座標。
+///  @return	true:交差する。
+///
+bool tri_tri_intersect(
+	const PL_CALC_REAL	a[9],
+	const PL_CALC_REAL	b[9]
+	);
+
+///
+/// 1つの三角形とn個の三角形の交差をまとめて判定する。
+/// 三角形毎の分岐を持たないので、コンパイラのSIMD化の対象になる。
+///
+///  @param[in]  a		三角形の頂点座標。
+///  @param[in]  b		三角形の頂点座標(9*n要素、三角形毎に連続)。
+///  @param[in]  n		bの三角形数。
+///  @param[out] hit	交差する場合1、しない場合0(n要素)。
+///
+void tri_tri_intersect_batch(
+	const PL_CALC_REAL	a[9],
+	const PL_CALC_REAL	*b,
+	int					n,
+	char				*hit
+	);
+
+///
+/// 2つの三角形の間の距離の2乗を求める。交差する場合は0。
+/// 交差しない場合の最短距離は、頂点と三角形の距離(6通り)と辺と辺の距離
+/// (9通り)のうち最小のもの。
+///
+///  @param[in] a	三角形の頂点座標。
+///  @param[in] b	三角形の頂点座標。
+///  @return	距離の2乗。
+///
+PL_CALC_REAL tri_tri_dist2(
+	const PL_CALC_REAL	a[9],
+	const PL_CALC_REAL	b[9]
+	);
+
+} //namespace PolylibNS
+
+#endif //polylib_trianglepair_h
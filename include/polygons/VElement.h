@@ -71,6 +71,11 @@ public:
 	///
 	Vec3<PL_REAL> get_pos() const;
 
+	///
+	/// Centroid of triangle (木構築時の座標系)。
+	///
+	Vec3<PL_REAL> get_centroid() const;
+
 	///
 	/// Bounding box of this triangle
 	///
@@ -86,6 +91,9 @@ private:
 	/// Center position of bbox on triangle.
 	Vec3<PL_REAL>			m_pos;
 
+	/// Centroid of triangle (木構築時の座標系)。
+	Vec3<PL_REAL>			m_centroid;
+
 	/// Bounding box of this triangle
 	BBox			m_bbox;
 };
@@ -101,6 +101,21 @@ public:
 	/// @param[in] p 要素。
 	///
 	void set_bbox_search(const VElement *p) ;
+
+	///
+	/// 検索用BBoxを設定。
+	///
+	/// @param[in] bbox 検索用bbox。
+	///
+	void set_bbox_search(const BBox& bbox) ;
+
+	///
+	/// 子供ノードを設定。保存した木の復元に用いる。
+	///
+	/// @param[in] left  左のNode。
+	/// @param[in] right 右のNode。
+	///
+	void set_children(VNode* left, VNode* right) ;
 	///
 	/// 左のNodeを取得。
 	///
@@ -21,6 +21,7 @@
 #include "common/BBox.h"
 #include "common/PolylibStat.h"
 #include "common/PolylibCommon.h"
+#include "common/PolylibMemoryUsage.h"
 #include "polygons/Vertex.h"
 
 #include <vector>
@@ -32,6 +33,36 @@ class BBox;
 class PrivateTriangle;
 class VNode;
 class VElement;
+struct TrianglePair;
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// 構造体:VTreeNodeImage
+/// VTreeのノードをポインタを使わずに表したもの。ファイルへの保存と
+/// 復元に用いる。ノードは行きがけ順に並べ、子供は配列の番号で表す。
+///
+////////////////////////////////////////////////////////////////////////////
+struct VTreeNodeImage {
+	/// KD木生成用のBouding Box(min x,y,z、max x,y,z)
+	PL_REAL		bbox[6];
+
+	/// KD木検索用のBouding Box(min x,y,z、max x,y,z)
+	PL_REAL		bbox_search[6];
+
+	/// 左右の子供ノードの番号。リーフでは-1
+	int			left;
+	int			right;
+
+	/// 分割軸(AxisEnum)
+	int			axis;
+
+	/// 要素の三角形番号の配列中の、このノードの要素の先頭位置と数
+	int			elem_begin;
+	int			elem_count;
+
+	/// 8バイト境界に揃えるための詰め物
+	int			pad;
+};
 
 ////////////////////////////////////////////////////////////////////////////
 ///
@@ -55,6 +86,27 @@ public:
 		std::vector<PrivateTriangle*>	*tri_list
 		);
 
+	///
+	/// コンストラクタ。export_image()で作成したノードから木を復元する。
+	/// 三角形の振り分けは行わない。
+	///
+	/// @param[in] max_elem	最大要素数。
+	/// @param[in] nodes	ノードの配列(行きがけ順)。
+	/// @param[in] nnode	ノード数。
+	/// @param[in] elems	要素の三角形番号(tri_list上の番号)。
+	/// @param[in] nelem	要素数。
+	/// @param[in] tri_list	木構造の元になるポリゴンのリスト。
+	/// @attention 配列の正当性はMeshCacheFile::open()で検査済みであること。
+	///
+	VTree(
+		int							max_elem,
+		const VTreeNodeImage		*nodes,
+		int							nnode,
+		const int					*elems,
+		int							nelem,
+		std::vector<PrivateTriangle*>	*tri_list
+		);
+
 	///
 	/// デストラクタ。
 	///
@@ -119,11 +171,89 @@ public:
 		) const;
 
 	///
+	/// KD木探索により、指定位置から面上の最近点を持つポリゴンを検索する。
+	/// search_nearest()は重心で比較するが、こちらは三角形までの距離で比較する
+	/// 厳密な検索である。ノードの検索用bboxまでの距離で枝刈りする。
+	///
+	///  @param[in]  pos		指定位置(木構築時の座標系)
+	///  @param[out] bary		最近点の重心座標(頂点0,1,2の重み)。NULL可。
+	///  @param[out] dist2		最近点までの距離の2乗。NULL可。
+	///  @param[in]  bound2		0以上の場合、距離の2乗がbound2未満の三角形だけを
+	///							検索する。既知の三角形までの距離を与えると、
+	///							始めから枝刈りできる。負の場合は制限しない。
+	///  @return    検索されたポリゴン。ポリゴンが無い場合は0。
+	///
+	const PrivateTriangle* search_nearest_surface(
+		const Vec3<PL_REAL>&	pos,
+		PL_REAL					bary[3],
+		PL_REAL*				dist2,
+		PL_CALC_REAL			bound2 = -1
+		) const;
+
+	///
+	/// 2つのKD木を同時に辿り(二重木探索)、距離がdist以下の三角形の組を
+	/// 求める。ノードの検索用bboxどうしの距離で枝刈りし、ノードの組に
+	/// 分けて並列に判定する。
+	///
+	///  @param[in]  other	相手のKD木。
+	///  @param[in]  rel	相手の木の座標系からこの木の座標系への剛体変換
+	///						(回転3x3行優先、並進3の12要素)。NULLは恒等変換。
+	///  @param[in]  dist	距離。負の場合は交差する組を求める。
+	///  @param[out] pairs	三角形の組(末尾に追加)。tri_aがこの木の三角形。
+	///						追加分は三角形IDの順に並べる。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///  @attention	相手の木の三角形の頂点座標もrelで変換して判定する。
+	///
+	POLYLIB_STAT search_pairs(
+		const VTree					*other,
+		const PL_CALC_REAL			*rel,
+		PL_REAL						dist,
+		std::vector<TrianglePair>	*pairs
+		) const;
+	///
+	/// 2つのKD木を同時に辿り、最も近い三角形の組を求める。近いノードの組
+	/// から検索し、全スレッドで共有する最短距離で枝刈りする。
+	///
+	///  @param[in]  other	相手のKD木。
+	///  @param[in]  rel	相手の木の座標系からこの木の座標系への剛体変換。
+	///						NULLは恒等変換。
+	///  @param[out] pair	最も近い組。どちらかの木が空の場合tri_aが0。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT search_nearest_pair(
+		const VTree					*other,
+		const PL_CALC_REAL			*rel,
+		TrianglePair				*pair
+		) const;
+	///
 	/// KD木クラスが利用しているメモリ量を返す。
 	///
 	///  @return	利用中のメモリ量(byte)
 	///
-	unsigned int memory_size();
+	unsigned long long memory_size();
+
+	///
+	/// KD木クラスが利用しているメモリ量をノードと要素に分けて加算する。
+	/// ノード内要素リストは確保済み容量で数える。
+	///
+	///  @param[in,out]	p_usage	加算先
+	///
+	void memory_usage( PolylibMemoryUsage* p_usage ) const;
+
+	///
+	/// 木をポインタを使わない形(VTreeNodeImage)に変換する。
+	///
+	///  @param[in]  tri_list	木構造の元になったポリゴンのリスト。
+	///  @param[out] nodes		ノードの配列(行きがけ順)。
+	///  @param[out] elems		要素の三角形番号(tri_list上の番号)。
+	///  @return	POLYLIB_STATで定義される値が返る。tri_listに無い三角形を
+	///				持つ場合PLSTAT_NG。
+	///
+	POLYLIB_STAT export_image(
+		const std::vector<PrivateTriangle*>	*tri_list,
+		std::vector<VTreeNodeImage>			*nodes,
+		std::vector<int>					*elems
+		) const;
 
 private:
 	///
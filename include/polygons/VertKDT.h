@@ -22,6 +22,7 @@
 #include "common/BBox.h"
 #include "common/PolylibCommon.h"
 #include "common/PolylibStat.h"
+#include "common/PolylibMemoryUsage.h"
 #include "polygons/Vertex.h"
 #include "polygons/VertexList.h"
 
@@ -101,7 +102,15 @@ public:
 	///
 	///  @return	利用中のメモリ量(byte)
 	///
-	unsigned int memory_size();
+	unsigned long long memory_size();
+
+	///
+	/// KD木クラスが利用しているメモリ量をノードと要素に分けて加算する。
+	/// ノード内要素リストは確保済み容量で数える。
+	///
+	///  @param[in,out]	p_usage	加算先
+	///
+	void memory_usage( PolylibMemoryUsage* p_usage ) const;
 
 
 	///root node のBBoxを返す
@@ -57,6 +57,10 @@ public:
 
 	Vertex(PL_REAL x,PL_REAL y,PL_REAL z);
 
+	/// デストラクタ
+	///  DVertexをVertex*のままdeleteできるよう仮想とする。
+	virtual ~Vertex(){}
+
 	///  index アクセス
 	///
 
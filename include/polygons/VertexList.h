@@ -27,6 +27,7 @@
 #include "common/BBox.h"
 #include "common/PolylibCommon.h"
 #include "common/PolylibStat.h"
+#include "common/PolylibMemoryUsage.h"
 #include "polygons/Vertex.h"
 
 
@@ -56,8 +57,8 @@ private:
 	std::vector<Vertex*>* m_vertex_list;
 	/// 同一性チェックの基準値
 	PL_REAL m_tolerance;
-	/// 同一性チェックの基準値の2乗
-	PL_REAL m_tolerance_2;
+	/// 同一性チェックの基準値の2乗(演算型)
+	PL_CALC_REAL m_tolerance_2;
 	/// Vertex  用KD木
 	VertKDT* m_vkdt;
 
@@ -159,6 +160,13 @@ public:
 	/// 重複頂点の削除
 	POLYLIB_STAT vertex_compaction(std::map<Vertex*,Vertex*>* vertex_map);
 
+	/// 頂点と頂点リストの利用メモリ量をm_verticesへ加算する。
+	/// 頂点用KD木は含まない。
+	///
+	/// @param[in,out] p_usage		加算先
+	/// @param[in]     vertex_size	頂点1つの大きさ(DVertexの場合sizeof(DVertex))
+	void memory_usage(PolylibMemoryUsage* p_usage, size_t vertex_size = sizeof(Vertex)) const;
+
 
 	//  private:
 	/// Vertex の解放
@@ -0,0 +1,382 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_profiler_h
+#define polylib_profiler_h
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "common/PolylibStat.h"
+
+namespace PolylibNS {
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:PolylibProfiler
+/// 実行時に有効/無効を切り替えられる計測機能。
+///  - 処理段階(フェーズ)ごとの経過時間と呼び出し回数
+///  - KD木の訪問ノード数、判定三角形数、隣接PEごとの送受信バイト数などのカウンタ
+///  - 有効時にはフェーズ区間をイベントとして記録し、Chrome trace形式で出力できる
+/// 状態はプロセス内で一つだけ持つ(全メソッドstatic)。
+/// 無効時の計測箇所のコストは静的フラグの判定のみ。
+/// 環境変数POLYLIB_PROFILEに1を設定すると起動時から有効、
+/// traceを設定するとイベント記録も有効になる。
+/// フェーズの計測は計測スレッド(enable()またはreset()を呼んだスレッド、
+/// 環境変数で有効にした場合は最初に計測したスレッド)のOpenMP並列領域の外でのみ行う。
+/// 他のスレッドからのbegin()はfalseを返す。カウンタはどのスレッドからも加算できる。
+/// MPI版の集計はMPIPolylib::write_profile()で行う。
+///
+////////////////////////////////////////////////////////////////////////////
+class PolylibProfiler {
+public:
+	///
+	/// フェーズ
+	///
+	enum Phase {
+		PH_LOAD = 0,		///< ファイル読み込み
+		PH_WELD,			///< 頂点の縮約
+		PH_BUILD,			///< KD木構築
+		PH_SEARCH,			///< 検索
+		PH_MOVE,			///< 移動
+		PH_DISTRIBUTE,		///< rank0からのポリゴン配信
+		PH_MIGRATE,			///< PE間移動(全体)
+		PH_MIG_PACK,		///< PE間移動:送信データ作成
+		PH_MIG_SEND,		///< PE間移動:送信
+		PH_MIG_RECV,		///< PE間移動:受信
+		PH_MIG_UNPACK,		///< PE間移動:受信データの追加
+		PH_NUM
+	};
+
+	///
+	/// カウンタ
+	///
+	enum Counter {
+		CT_NODES_VISITED = 0,	///< 検索で訪問したKD木ノード数
+		CT_TRIAS_TESTED,		///< 検索で判定した三角形数
+		CT_SEARCH_QUERIES,		///< 検索回数
+		CT_BYTES_SENT,			///< PE間移動の送信バイト数
+		CT_BYTES_RECV,			///< PE間移動の受信バイト数
+		CT_TRIAS_SENT,			///< PE間移動の送信三角形数
+		CT_TRIAS_RECV,			///< PE間移動の受信三角形数
+		CT_NUM
+	};
+
+	///
+	/// 記録したフェーズ区間
+	///
+	struct Event {
+		int		m_phase;	///< フェーズ
+		double	m_begin;	///< 開始時刻[秒]
+		double	m_end;		///< 終了時刻[秒]
+	};
+
+	///
+	/// 1プロセス分の計測結果
+	///
+	struct Record {
+		/// ランク番号
+		int m_rank;
+
+		/// フェーズごとの経過時間[秒]
+		double m_time[PH_NUM];
+
+		/// フェーズごとの呼び出し回数
+		long long m_calls[PH_NUM];
+
+		/// カウンタ値
+		long long m_count[CT_NUM];
+
+		/// 隣接PEごとの送受信バイト数(ランク番号→(送信,受信))
+		std::map<int, std::pair<long long, long long> > m_neighbour;
+
+		/// フェーズ区間イベント
+		std::vector<Event> m_events;
+
+		Record();
+	};
+
+	///
+	/// 全プロセスの集計値
+	///
+	struct Summary {
+		/// プロセス数
+		int m_nrank;
+
+		/// フェーズ経過時間の最小/最大/合計[秒]
+		double m_time_min[PH_NUM];
+		double m_time_max[PH_NUM];
+		double m_time_sum[PH_NUM];
+
+		/// フェーズ呼び出し回数の合計
+		long long m_calls_sum[PH_NUM];
+
+		/// カウンタ値の最小/最大/合計
+		long long m_count_min[CT_NUM];
+		long long m_count_max[CT_NUM];
+		long long m_count_sum[CT_NUM];
+
+		Summary();
+	};
+
+	///
+	/// 計測の有効/無効を設定する。計測値は保持される。
+	/// 無効から有効にすると基準時刻を現在時刻にし、記録済みイベントを破棄する。
+	/// 有効にした呼び出しスレッドが計測スレッドになる。
+	///
+	/// @param[in] flag		trueで有効
+	/// @param[in] trace	trueでフェーズ区間イベントも記録
+	///
+	static void enable( bool flag, bool trace = false );
+
+	///
+	/// 計測が有効か。
+	///
+	static bool enabled() { return s_enabled; }
+
+	///
+	/// イベント記録が有効か。
+	///
+	static bool tracing() { return s_enabled && s_trace; }
+
+	///
+	/// 計測値とイベントを消去する。
+	///
+	static void reset();
+
+	///
+	/// 経過時間計測用の現在時刻[秒]。
+	///
+	static double now();
+
+	///
+	/// フェーズの計測を開始する。同じフェーズの入れ子は外側だけを計測する。
+	///
+	/// @param[in] phase	フェーズ
+	/// @return	計測を開始した場合true。無効時、並列領域内、計測スレッド以外ではfalse。
+	///
+	static bool begin( Phase phase ) {
+		if( !s_enabled ) return false;
+		return begin_phase( phase );
+	}
+
+	///
+	/// フェーズの計測を終了する。begin()がtrueを返した場合のみ呼ぶこと。
+	///
+	/// @param[in] phase	フェーズ
+	///
+	static void end( Phase phase );
+
+	///
+	/// カウンタに加算する。
+	///
+	/// @param[in] counter	カウンタ
+	/// @param[in] n		加算値
+	///
+	static void count( Counter counter, long long n ) {
+		if( !s_enabled ) return;
+		add_count( counter, n );
+	}
+
+	///
+	/// 隣接PEとの送受信バイト数を加算する。CT_BYTES_SENT/RECVにも加算される。
+	///
+	/// @param[in] rank		隣接PEのランク番号
+	/// @param[in] sent		送信バイト数
+	/// @param[in] recv		受信バイト数
+	///
+	static void count_neighbour( int rank, long long sent, long long recv );
+
+	///
+	/// フェーズの経過時間[秒]を返す。
+	///
+	static double phase_time( Phase phase );
+
+	///
+	/// フェーズの呼び出し回数を返す。
+	///
+	static long long phase_calls( Phase phase );
+
+	///
+	/// カウンタ値を返す。
+	///
+	static long long counter( Counter counter );
+
+	///
+	/// フェーズ名を返す。
+	///
+	static const char* phase_name( int phase );
+
+	///
+	/// カウンタ名を返す。
+	///
+	static const char* counter_name( int counter );
+
+	///
+	/// 現在の計測値を取得する。
+	///
+	/// @param[out] p_rec	計測値
+	/// @param[in]  rank	記録するランク番号
+	///
+	static void get_record( Record* p_rec, int rank = 0 );
+
+	///
+	/// 計測値をバイト列に変換する(プロセス間の転送用)。
+	///
+	/// @param[in]  rec		計測値
+	/// @param[out] p_buf	出力先(上書き)
+	///
+	static void pack_record( const Record& rec, std::vector<char>* p_buf );
+
+	///
+	/// pack_record()で変換したバイト列を計測値に戻す。
+	///
+	/// @param[in]  p_buf	バイト列の先頭
+	/// @param[in]  size	バイト数
+	/// @param[out] p_rec	計測値
+	/// @return	読み込んだバイト数。不正なデータの場合0。
+	///
+	static size_t unpack_record( const char* p_buf, size_t size, Record* p_rec );
+
+	///
+	/// 計測値から集計値を求める。
+	///
+	/// @param[in]  recs	全プロセスの計測値
+	/// @param[out] p_sum	集計値
+	///
+	static void summarize( const std::vector<Record>& recs, Summary* p_sum );
+
+	///
+	/// 集計値とプロセスごとの計測値をJSON形式で出力する。
+	///
+	/// @param[in] fname	出力ファイル名
+	/// @param[in] sum		集計値
+	/// @param[in] recs		プロセスごとの計測値
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	static POLYLIB_STAT write_json(
+		const std::string& fname,
+		const Summary& sum,
+		const std::vector<Record>& recs
+		);
+
+	///
+	/// フェーズ区間イベントをChrome trace形式(chrome://tracing, Perfetto)で出力する。
+	/// プロセスはランク番号で区別され、時刻はorigin[秒]からの経過時間となる。
+	///
+	/// @param[in] fname	出力ファイル名
+	/// @param[in] recs		プロセスごとの計測値
+	/// @param[in] origin	時刻の基準
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	static POLYLIB_STAT write_chrome_trace(
+		const std::string& fname,
+		const std::vector<Record>& recs,
+		double origin
+		);
+
+	///
+	/// 自プロセスの計測値を出力する(非並列版用)。
+	///
+	/// @param[in] json_file	JSON出力ファイル名
+	/// @param[in] trace_file	Chrome trace出力ファイル名。空文字列の場合は出力しない。
+	/// @return	POLYLIB_STATで定義される値が返る。
+	///
+	static POLYLIB_STAT write_profile(
+		const std::string& json_file,
+		const std::string& trace_file = ""
+		);
+
+	///
+	/// 計測の基準時刻(有効化またはreset()の時刻)を返す。
+	///
+	static double origin() { return s_origin; }
+
+	///
+	/// 記録するイベント数の上限。超えた分は記録されない。
+	///
+	static const size_t MAX_EVENTS = 1000000;
+
+private:
+	static bool begin_phase( Phase phase );
+	static void add_count( Counter counter, long long n );
+
+	/// 計測有効フラグ
+	static bool s_enabled;
+
+	/// イベント記録フラグ
+	static bool s_trace;
+
+	/// 基準時刻
+	static double s_origin;
+};
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:PolylibProfileScope
+/// スコープの間、指定フェーズを計測する。
+/// 途中でreturnしても計測が閉じられる。
+///
+////////////////////////////////////////////////////////////////////////////
+class PolylibProfileScope {
+public:
+	///
+	/// コンストラクタ。
+	///
+	/// @param[in] phase	フェーズ
+	/// @param[in] start	trueの場合すぐに計測を開始する
+	///
+	explicit PolylibProfileScope( PolylibProfiler::Phase phase, bool start = true )
+		: m_phase(phase), m_active(false) {
+		if( start ) m_active = PolylibProfiler::begin( m_phase );
+	}
+
+	///
+	/// デストラクタ。計測中なら終了する。
+	///
+	~PolylibProfileScope() { stop(); }
+
+	///
+	/// 計測を開始する。
+	///
+	void start() {
+		if( !m_active ) m_active = PolylibProfiler::begin( m_phase );
+	}
+
+	///
+	/// 計測を終了する。
+	///
+	void stop() {
+		if( m_active ) {
+			PolylibProfiler::end( m_phase );
+			m_active = false;
+		}
+	}
+
+private:
+	PolylibProfiler::Phase m_phase;
+	bool m_active;
+
+	PolylibProfileScope( const PolylibProfileScope& );
+	PolylibProfileScope& operator=( const PolylibProfileScope& );
+};
+
+} //namespace PolylibNS
+
+#endif //polylib_profiler_h
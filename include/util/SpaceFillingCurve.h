@@ -0,0 +1,106 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_spacefillingcurve_h
+#define polylib_spacefillingcurve_h
+
+#include <string>
+
+#include "common/Vec3.h"
+#include "common/BBox.h"
+#include "common/PolylibCommon.h"
+
+using namespace Vec3class;
+
+namespace PolylibNS {
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:SpaceFillingCurve
+/// 空間充填曲線(Morton/Hilbert)による3次元座標の1次元キーを求める。
+/// 座標は指定範囲で各軸BITS bitの整数に量子化され、キーは3*BITS bitとなる。
+/// 三角形・頂点の並べ替え(TriMesh::reorder())に用いる。
+///
+////////////////////////////////////////////////////////////////////////////
+class SpaceFillingCurve {
+public:
+	///
+	/// 曲線の種類
+	///
+	enum Type {
+		SFC_NONE = 0,	///< 並べ替えない
+		SFC_MORTON,		///< Morton(Z-order)曲線
+		SFC_HILBERT		///< Hilbert曲線
+	};
+
+	/// 1軸あたりのbit数
+	static const int BITS = 21;
+
+	///
+	/// 座標のキーを返す。
+	///
+	/// @param[in] type	曲線の種類
+	/// @param[in] pos	座標
+	/// @param[in] bbox	量子化の範囲。範囲外の座標は境界に丸められる。
+	/// @return	キー。SFC_NONEの場合0。
+	///
+	static unsigned long long key(
+		Type					type,
+		const Vec3<PL_REAL>&	pos,
+		const BBox&				bbox
+		);
+
+	///
+	/// 量子化済み座標のMortonキーを返す。
+	///
+	/// @param[in] x,y,z	BITS bitの整数座標
+	///
+	static unsigned long long morton_key(
+		unsigned int x,
+		unsigned int y,
+		unsigned int z
+		);
+
+	///
+	/// 量子化済み座標のHilbertキーを返す。
+	///
+	/// @param[in] x,y,z	BITS bitの整数座標
+	///
+	static unsigned long long hilbert_key(
+		unsigned int x,
+		unsigned int y,
+		unsigned int z
+		);
+
+	///
+	/// 文字列("none","morton","hilbert")から曲線の種類を求める。
+	///
+	/// @param[in]  str		文字列(大文字小文字は区別しない)
+	/// @param[out] p_type	曲線の種類
+	/// @return	認識できた場合true
+	///
+	static bool parse( const std::string& str, Type* p_type );
+
+	///
+	/// 曲線の種類の名前を返す。
+	///
+	static const char* name( Type type );
+};
+
+} //namespace PolylibNS
+
+#endif //polylib_spacefillingcurve_h
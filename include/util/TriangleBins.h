@@ -0,0 +1,183 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifndef polylib_trianglebins_h
+#define polylib_trianglebins_h
+
+#include <vector>
+#include <cstddef>
+
+#include "common/Vec3.h"
+#include "common/PolylibStat.h"
+#include "common/PolylibCommon.h"
+
+using namespace Vec3class;
+
+namespace PolylibNS {
+
+class Triangle;
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// 構造体:CellGrid
+/// 等間隔直交格子。セル(i,j,k)は
+/// [m_origin + (i,j,k)*m_cell_size, m_origin + (i+1,j+1,k+1)*m_cell_size]
+/// の範囲を占める。
+///
+////////////////////////////////////////////////////////////////////////////
+struct CellGrid {
+	/// 格子の原点(セル(0,0,0)の最小位置)
+	Vec3<PL_REAL>	m_origin;
+
+	/// セル1辺の長さ
+	Vec3<PL_REAL>	m_cell_size;
+
+	/// 各軸のセル数
+	int				m_dims[3];
+
+	CellGrid() {
+		m_dims[0] = m_dims[1] = m_dims[2] = 0;
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:TriangleBins
+/// 直交格子の各セルと重なる三角形の一覧(CSR形式)。
+/// セルcの三角形番号はget_indices()の[begin(c),end(c))に昇順で格納され、
+/// 番号はget_triangles()の添字である。
+/// セルを1つずつsearch_polygons()で検索する代わりに、全セル分を一括で作る。
+///
+////////////////////////////////////////////////////////////////////////////
+class TriangleBins {
+public:
+	///
+	/// コンストラクタ。
+	///
+	TriangleBins();
+
+	///
+	/// 一覧を作成する。三角形を外包する矩形(またはexact指定時は三角形そのもの)
+	/// と重なる全セルに登録する。セル境界に接するだけの三角形も両側のセルに
+	/// 登録する(BBox::crossed()と同じ扱い)。格子外の部分は無視する。
+	///
+	///  @param[in] grid		格子。
+	///  @param[in] trias		三角形のリスト。
+	///  @param[in] exact		true:三角形とセルの交差を分離軸判定で厳密に調べる。
+	///							false:三角形を外包する矩形で判定する。
+	///  @param[in] rigid		三角形毎の頂点座標の剛体変換(回転3x3行優先、
+	///							並進3の12要素。NULLの要素は恒等変換)。
+	///							NULLの場合は頂点座標をそのまま用いる。
+	///  @return	POLYLIB_STATで定義される値が返る。
+	///
+	POLYLIB_STAT build(
+		const CellGrid&					grid,
+		const std::vector<Triangle*>&	trias,
+		bool							exact = false,
+		const std::vector<const double*>* rigid = NULL
+		);
+
+	///
+	/// 一覧を破棄する。
+	///
+	void clear();
+
+	///
+	/// 格子を取得。
+	///
+	const CellGrid& get_grid() const {
+		return m_grid;
+	}
+
+	///
+	/// セル数を取得。
+	///
+	size_t num_cells() const {
+		return m_offsets.empty() ? 0 : m_offsets.size() - 1;
+	}
+
+	///
+	/// セル番号を取得。iが最も速く変わる。
+	///
+	size_t cell_index( int i, int j, int k ) const {
+		return ( (size_t)k * m_grid.m_dims[1] + j ) * m_grid.m_dims[0] + i;
+	}
+
+	///
+	/// セルに登録された三角形数を取得。
+	///
+	size_t count( size_t cell ) const {
+		return m_offsets[cell+1] - m_offsets[cell];
+	}
+
+	///
+	/// セルの三角形番号の開始位置を取得。
+	///
+	size_t begin( size_t cell ) const {
+		return m_offsets[cell];
+	}
+
+	///
+	/// セルの三角形番号の終了位置(最後の次)を取得。
+	///
+	size_t end( size_t cell ) const {
+		return m_offsets[cell+1];
+	}
+
+	///
+	/// 開始位置の配列(セル数+1個)を取得。
+	///
+	const std::vector<size_t>& get_offsets() const {
+		return m_offsets;
+	}
+
+	///
+	/// 三角形番号の配列を取得。
+	///
+	const std::vector<int>& get_indices() const {
+		return m_indices;
+	}
+
+	///
+	/// 三角形番号に対応する三角形のリストを取得。
+	///
+	const std::vector<Triangle*>& get_triangles() const {
+		return m_triangles;
+	}
+
+	///
+	/// 利用メモリ量(byte)を返す。
+	///
+	size_t memory_size() const;
+
+private:
+	/// 格子
+	CellGrid				m_grid;
+
+	/// セル毎の開始位置(セル数+1個)
+	std::vector<size_t>		m_offsets;
+
+	/// 三角形番号
+	std::vector<int>		m_indices;
+
+	/// 三角形のリスト
+	std::vector<Triangle*>	m_triangles;
+};
+
+} //namespace PolylibNS
+
+#endif //polylib_trianglebins_h
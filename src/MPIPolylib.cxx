@@ -15,7 +15,10 @@
 ###################################################################################
 */
 
+#include <ctime>
+#include <cstdio>
 #include "MPIPolylib.h"
+#include "util/PolylibProfiler.h"
 
 
 namespace PolylibNS {
@@ -250,16 +253,6 @@ POLYLIB_STAT
 	PL_REAL scale
 	)
 {
-	//#define TIME_MEASURE
-#ifdef TIME_MEASURE
-	double time1=0;
-	double time2=0;
-	double time3=0;
-	double time4=0;
-	time1=MPI_Wtime();
-
-#endif // TIME_MEASURE
-
 	//#define DEBUG
 #ifdef DEBUG
 	PL_DBGOSH << m_myrank << ": " << "MPIPolylib::load_rank0() in. " << std::endl;
@@ -291,6 +284,9 @@ POLYLIB_STAT
 		return e;
 	}
 
+	// 読み込み後の配信を計測
+	PolylibProfileScope prof( PolylibProfiler::PH_DISTRIBUTE, false );
+
 	if( m_myrank == 0 ) {
 
 		// ポリゴン情報を構築 (三角形IDファイルは不要なので、第二引数はダミー)
@@ -305,15 +301,11 @@ POLYLIB_STAT
 			return ret;
 		}
 
-
-#ifdef TIME_MEASURE
-		time2=MPI_Wtime();
-#endif // TIME_MEASURE
-
 #ifdef DEBUG
 		PL_DBGOSH << m_myrank << ": " << "MPIPolylib::load_rank0() load_polygons end. " << std::endl;
 #endif
 
+		prof.start();
 
 		// ポリゴン情報を他PEへ配信する。
 		if( (ret = send_polygons_to_all()) != PLSTAT_OK ) {
@@ -322,10 +314,6 @@ POLYLIB_STAT
 			return ret;
 		}
 
-#ifdef TIME_MEASURE
-		time3=MPI_Wtime();
-#endif // TIME_MEASURE
-
 #ifdef DEBUG
 		PL_DBGOSH << m_myrank << ": " << "MPIPolylib::load_rank0() send_polyons_to_all. " << std::endl;
 #endif
@@ -347,6 +335,8 @@ POLYLIB_STAT
 
 	} else { //for other rank
 
+		prof.start();
+
 		// ポリゴン情報をrank0から受信する。
 		if( (ret = receive_polygons_from_rank0()) != PLSTAT_OK ) {
 			PL_ERROSH << "[ERROR]MPIPolylib::load_rank0():receive_polygons_from_rank0()"
@@ -355,19 +345,8 @@ POLYLIB_STAT
 		}
 	}
 
-#ifdef TIME_MEASURE
-	time4=MPI_Wtime();
-	PL_DBGOSH << m_myrank << ": " << "MPIPolylib::load_rank0() time measure" << std::endl;
-	PL_DBGOSH << m_myrank << ":time1 " << time1 << std::endl;
-	PL_DBGOSH << m_myrank << ":time2 " << time2-time1 << std::endl;
-	PL_DBGOSH << m_myrank << ":time3 " << time3-time1 << std::endl;
-	PL_DBGOSH << m_myrank << ":time4 " << time4-time1 << std::endl;
-
-#endif // TIME_MEASURE
-
-	//#undef TIME_MEASURE
-
-	return PLSTAT_OK;
+	// migrate()の送信形式を決めておく
+	return update_migration_format();
 
 	//#undef DEBUG
 }
@@ -379,14 +358,6 @@ POLYLIB_STAT
     PL_REAL scale
     )
 {
-    //#define TIME_MEASURE
-#ifdef TIME_MEASURE
-    double time1=0;
-    double time2=0;
-    time1=MPI_Wtime();
-
-#endif // TIME_MEASURE
-
     //#define DEBUG
 #ifdef DEBUG
     PL_DBGOSH << m_myrank << ": " << "MPIPolylib::load_only_in_rank0() in. " << std::endl;
@@ -432,21 +403,11 @@ POLYLIB_STAT
             return ret;
         }
 
-
-#ifdef TIME_MEASURE
-        time2=MPI_Wtime();
-#endif // TIME_MEASURE
-
 #ifdef DEBUG
         PL_DBGOSH << m_myrank << ": " << "MPIPolylib::load_only_in_rank0() load_polygons end. " << std::endl;
 #endif
     }
 
-#ifdef TIME_MEASURE
-    PL_DBGOSH << m_myrank << ": " << "MPIPolylib::load_only_in_rank0() time measure" << std::endl;
-    PL_DBGOSH << m_myrank << ":time1 " << time1 << std::endl;
-    PL_DBGOSH << m_myrank << ":time2 " << time2-time1 << std::endl;
-#endif // TIME_MEASURE
     return PLSTAT_OK;
 }
 
@@ -454,11 +415,7 @@ POLYLIB_STAT
     MPIPolylib::distribute_only_from_rank0(
     )
 {
-    //#define TIME_MEASURE
-#ifdef TIME_MEASURE
-    double time3=0;
-    double time4=0;
-#endif // TIME_MEASURE
+    PolylibProfileScope prof( PolylibProfiler::PH_DISTRIBUTE );
 
     POLYLIB_STAT ret;
 
@@ -471,10 +428,6 @@ POLYLIB_STAT
             return ret;
         }
 
-#ifdef TIME_MEASURE
-        time3=MPI_Wtime();
-#endif // TIME_MEASURE
-
 #ifdef DEBUG
         PL_DBGOSH << m_myrank << ": " << "MPIPolylib::distribute_only_from_rank0() send_polyons_to_all. " << std::endl;
 #endif
@@ -504,13 +457,6 @@ POLYLIB_STAT
         }
     }
 
-#ifdef TIME_MEASURE
-    time4=MPI_Wtime();
-    PL_DBGOSH << m_myrank << ": " << "MPIPolylib::distribute_only_from_rank0() time measure" << std::endl;
-    PL_DBGOSH << m_myrank << ":time3 " << time3 << std::endl;
-    PL_DBGOSH << m_myrank << ":time4 " << time4-time3 << std::endl;
-#endif // TIME_MEASURE
-
     return PLSTAT_OK;
 }
 
@@ -535,7 +481,8 @@ POLYLIB_STAT
 		return ret;
 	}
 
-	return PLSTAT_OK;
+	// migrate()の送信形式を決めておく
+	return update_migration_format();
 }
 
 // new version
@@ -557,7 +504,8 @@ POLYLIB_STAT
 	if( m_myrank == 0 ) {
 		// 他rankからポリゴン情報を受信
 		if(stl_format==TriMeshIO::FMT_VTK_A ||
-			stl_format==TriMeshIO::FMT_VTK_B){ // VTK output
+			stl_format==TriMeshIO::FMT_VTK_B ||
+			stl_format==TriMeshIO::FMT_VTU){ // VTK output
 
 #ifdef DEBUG
 				PL_DBGOSH << "MPIPolylib::save_rank0() VTK. |" << stl_format <<"| |"<<TriMeshIO::FMT_VTK_A<<"|" << std::endl;
@@ -601,7 +549,8 @@ POLYLIB_STAT
 
 		// rank0へポリゴン情報を送信
 		if(stl_format==TriMeshIO::FMT_VTK_A ||
-			stl_format==TriMeshIO::FMT_VTK_B){ // VTK output
+			stl_format==TriMeshIO::FMT_VTK_B ||
+			stl_format==TriMeshIO::FMT_VTU){ // VTK output
 
 				if( (ret = send_polygons_to_rank0_vtk()) != PLSTAT_OK ) {
 					PL_ERROSH << "[ERROR]MPIPolylib::save_rank0():send_polygons_to_rank0() faild."
@@ -639,6 +588,48 @@ POLYLIB_STAT
 	std::string stl_format,
 	std::string extend,
 	ID_FORMAT	id_format
+	){
+		return save_parallel_files( p_config_filename, stl_format, extend, id_format, NULL );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT
+	MPIPolylib::save_parallel_async(
+	std::string *p_config_filename,
+	std::string stl_format,
+	std::string extend,
+	ID_FORMAT	id_format,
+	bool		block
+	){
+		// 待たない場合は、保存するかどうかを全rankで揃える
+		if( !block ) {
+			int busy = save_async_busy() ? 1 : 0;
+			int any_busy = 0;
+			if( MPI_Allreduce( &busy, &any_busy, 1, MPI_INT, MPI_MAX, m_mycomm ) != MPI_SUCCESS ) {
+				PL_ERROSH << "[ERROR]MPIPolylib::save_parallel_async():MPI_Allreduce faild." << std::endl;
+				return PLSTAT_MPI_ERROR;
+			}
+			if( any_busy ) return PLSTAT_SAVE_BUSY;
+		}
+
+		POLYLIB_STAT ret = prepare_checkpoint( true );
+		if( ret != PLSTAT_OK ) return ret;
+
+		std::vector<CheckpointPiece*> snapshot;
+		ret = save_parallel_files( p_config_filename, stl_format, extend, id_format, &snapshot );
+		return start_checkpoint( ret, &snapshot );
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT
+	MPIPolylib::save_parallel_files(
+	std::string *p_config_filename,
+	std::string stl_format,
+	std::string extend,
+	ID_FORMAT	id_format,
+	std::vector<CheckpointPiece*>	*snapshot
 	){
 
 		//#define DEBUG
@@ -646,16 +637,72 @@ POLYLIB_STAT
 		PL_DBGOSH << "MPIPolylib::save_parallel() in. " << std::endl;
 #endif
 		POLYLIB_STAT ret;
+		bool vtu = ( stl_format == TriMeshIO::FMT_VTU );
+
+		// VTUはrank0がピースをまとめるので、付加文字列を全rankで揃える
+		if( vtu && extend == "" ) {
+			char	my_extend[128];
+			if( m_myrank == 0 ) {
+				time_t		timer = time(NULL);
+				struct tm	*date = localtime(&timer);
+				sprintf(my_extend, "%04d%02d%02d%02d%02d%02d",
+					date->tm_year+1900, date->tm_mon+1, date->tm_mday,
+					date->tm_hour,      date->tm_min,   date->tm_sec);
+			}
+			if( MPI_Bcast( my_extend, sizeof(my_extend), MPI_CHAR, 0, m_mycomm ) != MPI_SUCCESS ) {
+				PL_ERROSH << "[ERROR]MPIPolylib::save_parallel():MPI_Bcast,MPI_CHAR faild." << std::endl;
+				return PLSTAT_MPI_ERROR;
+			}
+			extend = my_extend;
+		}
 
 		// 各ランク毎に保存
-		if( (ret = Polylib::save_with_rankno( p_config_filename, m_myrank, m_numproc-1, extend, stl_format, id_format)) != PLSTAT_OK ) {
+		if( (ret = Polylib::save_with_rankno( p_config_filename, m_myrank, m_numproc-1, extend, stl_format, id_format, snapshot)) != PLSTAT_OK ) {
 			PL_ERROSH << "[ERROR]MPIPolylib::save_parallel():Polylib::save_with_rankno():failed. returns:" << PolylibStat2::String(ret) << std::endl;
-			return ret;
+			if( !vtu ) return ret;
 		} else { //good
 #ifdef DEBUG
 			PL_DBGOSH << "MPIPolylib::save_parallel() ready to out. " << std::endl;
 #endif
 		}
+		if( !vtu ) return PLSTAT_OK;
+
+		// VTUの場合、rank0がグループ毎にピースの一覧(.pvtu)を保存する。
+		// save_with_rankno()はリーフでないグループと三角形が0個のグループを
+		// 出力しないので、ピースを出力したランクをrank0へ集める
+		// (集約は全rankで行うため、保存の失敗はその後で返す)
+		int ngroup = (int)m_pg_list.size();
+		std::vector<int> has_piece( ngroup > 0 ? ngroup : 1, 0 );
+		for( int g = 0; g < ngroup; g++ ) {
+			if( m_pg_list[g]->get_children().empty() == false ) continue;
+			if( m_pg_list[g]->get_triangles()->size() == 0 ) continue;
+			has_piece[g] = 1;
+		}
+		std::vector<int> all_pieces;
+		if( m_myrank == 0 ) all_pieces.resize( has_piece.size() * m_numproc );
+		if( MPI_Gather( &has_piece[0], (int)has_piece.size(), MPI_INT,
+				m_myrank == 0 ? &all_pieces[0] : NULL, (int)has_piece.size(), MPI_INT,
+				0, m_mycomm ) != MPI_SUCCESS ) {
+			PL_ERROSH << "[ERROR]MPIPolylib::save_parallel():MPI_Gather faild." << std::endl;
+			return PLSTAT_MPI_ERROR;
+		}
+		if( ret != PLSTAT_OK ) return ret;
+
+		if( m_myrank == 0 ) {
+			for( int g = 0; g < ngroup; g++ ) {
+				if( m_pg_list[g]->get_children().empty() == false ) continue;
+				std::vector<int> ranks;
+				for( int rank = 0; rank < m_numproc; rank++ ) {
+					if( all_pieces[ rank*has_piece.size() + g ] ) ranks.push_back( rank );
+				}
+				// どのランクにも三角形が無いグループは一覧を出力しない
+				if( ranks.empty() ) continue;
+				if( (ret = m_pg_list[g]->save_pvtu_file( m_numproc-1, ranks, extend )) != PLSTAT_OK ) {
+					PL_ERROSH << "[ERROR]MPIPolylib::save_parallel():save_pvtu_file():failed. returns:" << PolylibStat2::String(ret) << std::endl;
+					return ret;
+				}
+			}
+		}
 
 		return PLSTAT_OK;
 		//#undef DEBUG
@@ -672,6 +719,7 @@ POLYLIB_STAT
 #ifdef DEBUG
 	PL_DBGOSH << "MPIPolylib::move() in. " << std::endl;
 #endif
+	PolylibProfileScope prof( PolylibProfiler::PH_MOVE );
 	POLYLIB_STAT ret;
 	std::vector<PolygonGroup*>::iterator group_itr;
 	PolygonGroup *p_pg;
@@ -740,19 +788,45 @@ POLYLIB_STAT
 	std::vector<int*>  send_tria_exids_bufs;
 	std::vector<PL_REAL*> send_trias_bufs;
 
+	// 圧縮形式時の送信バッファと、グループ毎の送信三角形リスト
+	std::vector< std::vector<unsigned char>* > send_packed_bufs;
+	std::vector<const std::vector<PrivateTriangle*>*> packed_trias_list;
+
 	// 送信用MPI_Reqeust配列を確保
-	MPI_Request *mpi_reqs = new MPI_Request[ m_neibour_procs.size() * 4 ]; // 隣接PEごとに4回Isendする
-	MPI_Status  *mpi_stats = new MPI_Status[ m_neibour_procs.size() * 4 ];
+	MPI_Request *mpi_reqs = new MPI_Request[ m_neibour_procs.size() * 5 ]; // 隣接PEごとに最大5回Isendする
+	MPI_Status  *mpi_stats = new MPI_Status[ m_neibour_procs.size() * 5 ];
 	int reqs_pos = 0;
 
+	// 送信形式が未定(読み込み後にグループを追加した等)なら決める。
+	// グループ構成は全rankで共通なので、全rankで同時に呼ばれる
+	if( m_dvertex_migration.size() != this->m_pg_list.size() ) {
+		if( (ret = update_migration_format()) != PLSTAT_OK ) return ret;
+	}
+
+	// DVertexを持つグループはデータごと圧縮形式で、残りは従来形式で送る
+	bool any_packed = false, any_legacy = false;
+	for( i=0; i<this->m_pg_list.size(); i++ ) {
+		if( use_packed_migration( i ) ) any_packed = true;
+		else any_legacy = true;
+	}
+
+	// 段階ごとの計測(隣接PEごとに開始/終了を繰り返す)
+	PolylibProfileScope prof( PolylibProfiler::PH_MIGRATE );
+	PolylibProfileScope prof_pack( PolylibProfiler::PH_MIG_PACK, false );
+	PolylibProfileScope prof_send( PolylibProfiler::PH_MIG_SEND, false );
+	PolylibProfileScope prof_recv( PolylibProfiler::PH_MIG_RECV, false );
+	PolylibProfileScope prof_unpack( PolylibProfiler::PH_MIG_UNPACK, false );
+
 	//隣接PEごとに移動三角形情報を送信
 	for (procs_itr = m_neibour_procs.begin(); procs_itr != m_neibour_procs.end(); procs_itr++) {
+		prof_pack.start();
 
 		// 送信用一時データ初期化
 		send_num_trias.clear();
 		send_trias.clear();
 		send_tria_ids.clear();
 		send_tria_exids.clear();
+		packed_trias_list.clear();
 
 		// 全ポリゴングループに対して
 		for( group_itr=this->m_pg_list.begin(); group_itr!=this->m_pg_list.end(); group_itr++ ) {
@@ -779,11 +853,20 @@ POLYLIB_STAT
 					&((*itr).second) );
 			}
 
+			// 圧縮形式のグループは三角形リストをまとめて後で符号化し、
+			// 従来形式には三角形数0として載せる
+			bool packed = use_packed_migration( group_itr - this->m_pg_list.begin() );
+			packed_trias_list.push_back( packed ? p_trias : NULL );
+			if( packed ) {
+				pack_num_trias( &send_num_trias, p_pg->get_internal_id(), NULL );
+				continue;
+			}
+
 			// グループIDと当該グループの三角形数の対を送信データに追加
 			pack_num_trias( &send_num_trias, p_pg->get_internal_id(), p_trias );
 
 			// 三角形情報を送信データに追加
-			pack_trias( &send_trias, p_trias );
+			pack_trias( &send_trias, p_trias, p_pg );
 
 			// 三角形ID情報を送信データに追加
 			pack_tria_ids( &send_tria_ids, p_trias );
@@ -795,6 +878,32 @@ POLYLIB_STAT
 			if( p_trias ) delete p_trias;
 		}
 
+		// 圧縮形式で当該PEへ非同期送信
+		if( any_packed ) {
+			std::vector<unsigned char>* p_buf = new std::vector<unsigned char>;
+			send_packed_bufs.push_back( p_buf );
+			ret = send_packed_trias( *procs_itr, packed_trias_list, p_buf,
+				&mpi_reqs[reqs_pos++] );
+			long long ntrias = 0;
+			for( i=0; i<packed_trias_list.size(); i++ ) {
+				if( packed_trias_list[i] ) {
+					ntrias += packed_trias_list[i]->size();
+					delete packed_trias_list[i];
+				}
+			}
+			if( ret != PLSTAT_OK ) {
+				PL_ERROSH << "[ERROR]MPIPolylib::migrate():send_packed_trias() failed."
+					<< std::endl;
+				return ret;
+			}
+			PolylibProfiler::count_neighbour( (*procs_itr)->m_rank, p_buf->size(), 0 );
+			PolylibProfiler::count( PolylibProfiler::CT_TRIAS_SENT, ntrias );
+		}
+		if( !any_legacy ) {
+			prof_pack.stop();
+			continue;
+		}
+
 		//-----  送信データをシリアライズ
 		// 送信データ初期化
 		p_send_num_trias_array = NULL;
@@ -837,6 +946,13 @@ POLYLIB_STAT
 		send_tria_exids_bufs.push_back( p_send_tria_exids_array );
 		send_trias_bufs.push_back( p_send_trias_array );
 
+		prof_pack.stop();
+		PolylibProfiler::count_neighbour( (*procs_itr)->m_rank,
+			( send_num_trias.size() + send_tria_ids.size() + send_tria_exids.size() ) * sizeof(int)
+			+ send_trias.size() * sizeof(PL_REAL), 0 );
+		PolylibProfiler::count( PolylibProfiler::CT_TRIAS_SENT, send_tria_ids.size() );
+		prof_send.start();
+
 		// 当該PEへ非同期送信 (MPI_Wait()は後でまとめて行う)
 #ifdef DEBUG
 		PL_DBGOSH << "sending polygons rank:" << m_myrank <<  "->rank:"
@@ -915,6 +1031,7 @@ POLYLIB_STAT
 			PL_ERROSH << __func__ <<"sizeof(PL_REAL)" <<sizeof(PL_REAL) << std::endl;
 			return PLSTAT_MPI_ERROR;
 		}
+		prof_send.stop();
 	}
 
 
@@ -925,10 +1042,39 @@ POLYLIB_STAT
 
 	//隣接PEごとに移動三角形情報を受信
 	for (procs_itr = m_neibour_procs.begin(); procs_itr != m_neibour_procs.end(); procs_itr++) {
+		prof_recv.start();
 		int pos_id, pos_exid, pos_tria;
 		MPI_Request mpi_req;
 		MPI_Status  mpi_stat;
 
+		// 圧縮形式で受信し、共有頂点のまま各グループへ追加
+		if( any_packed ) {
+			std::vector<TriaCodecGroup> packed_groups;
+			size_t recv_size = 0;
+			if( (ret = recv_packed_trias( (*procs_itr)->m_rank, &packed_groups, &recv_size )) != PLSTAT_OK ) {
+				PL_ERROSH << "[ERROR]MPIPolylib::migrate():recv_packed_trias() failed."
+					<< std::endl;
+				return ret;
+			}
+			prof_recv.stop();
+			if( PolylibProfiler::enabled() ) {
+				long long ntrias = 0;
+				for( i=0; i<packed_groups.size(); i++ ) ntrias += packed_groups[i].num_trias();
+				PolylibProfiler::count_neighbour( (*procs_itr)->m_rank, 0, recv_size );
+				PolylibProfiler::count( PolylibProfiler::CT_TRIAS_RECV, ntrias );
+			}
+
+			prof_unpack.start();
+			if( (ret = add_packed_trias( packed_groups )) != PLSTAT_OK ) {
+				PL_ERROSH << "[ERROR]MPIPolylib::migrate():add_packed_trias() failed."
+					<< std::endl;
+				return ret;
+			}
+			prof_unpack.stop();
+			if( !any_legacy ) continue;
+			prof_recv.start();
+		}
+
 		// グループIDとグループ毎三角形数の対を非同期受信
 		// グループ情報は各rank共有しているのでグループ数は予め分かっている
 		int *p_intarray = new int[ this->m_pg_list.size()*2 ];
@@ -1071,7 +1217,14 @@ POLYLIB_STAT
 #endif
 
 
+		prof_recv.stop();
+		PolylibProfiler::count_neighbour( (*procs_itr)->m_rank, 0,
+			( this->m_pg_list.size()*2 + total_tria_num*2 ) * sizeof(int)
+			+ total_tria_num*3*3 * sizeof(PL_REAL) );
+		PolylibProfiler::count( PolylibProfiler::CT_TRIAS_RECV, total_tria_num );
+
 		// 各ポリゴングループに対して三角形情報を追加
+		prof_unpack.start();
 		pos_id = 0;
 		pos_exid = 0;
 		pos_tria = 0;
@@ -1104,6 +1257,10 @@ POLYLIB_STAT
 			PL_DBGOSH << "adding trinagles to PolygonGroup"
 				<< i <<"  pg_id  "<< pg_id << std::endl;
 #endif
+			// 受信した三角形はワールド座標系なので、剛体インスタンシングのグループは
+			// 頂点を追加する前に変換を頂点へ反映する(KD木は最後に再構築する)
+			if( num_trias > 0 ) p_pg->materialize_vertices( false );
+
 			// PrivateTriangleのベクタ - 受信データ配列からベクタへの変換用
 			std::vector<PrivateTriangle*> tria_vec;
 
@@ -1188,13 +1345,16 @@ POLYLIB_STAT
 		delete[] p_idarray;
 		delete[] p_exidarray;
 		delete[] p_triaarray;
+		prof_unpack.stop();
 	}
 
 	// MPI_Isend()を纏めてアンロック
-	if (MPI_Waitall( m_neibour_procs.size()*4, mpi_reqs, mpi_stats ) != MPI_SUCCESS) {
+	prof_send.start();
+	if (MPI_Waitall( reqs_pos, mpi_reqs, mpi_stats ) != MPI_SUCCESS) {
 		PL_ERROSH << "[ERROR]MPIPolylib::migrate():MPI_Waitall failed." << std::endl;
 		return PLSTAT_MPI_ERROR;
 	}
+	prof_send.stop();
 
 	// 送信データ領域をdelete
 	for( i=0; i<send_num_trias_bufs.size(); i++ ) {
@@ -1209,6 +1369,9 @@ POLYLIB_STAT
 	for( i=0; i<send_trias_bufs.size(); i++ ) {
 		delete[] send_trias_bufs.at(i);
 	}
+	for( i=0; i<send_packed_bufs.size(); i++ ) {
+		delete send_packed_bufs.at(i);
+	}
 
 	// 移動してきた三角形を含めたKD木を再構築
 	for (group_itr = this->m_pg_list.begin(); group_itr != this->m_pg_list.end(); group_itr++) {
@@ -1243,6 +1406,165 @@ POLYLIB_STAT
 }
 
 
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT
+	MPIPolylib::set_packed_transfer(
+	bool flag,
+	PL_REAL error_bound
+	)
+{
+	if( flag && !(error_bound >= 0.0) ) {
+		PL_ERROSH << "[ERROR]MPIPolylib::set_packed_transfer():invalid error_bound:"
+			<< error_bound << std::endl;
+		return PLSTAT_NG;
+	}
+	m_packed_transfer = flag;
+	if( flag ) m_packed_error_bound = error_bound;
+	return PLSTAT_OK;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+void
+	MPIPolylib::get_packed_transfer_stats(
+	size_t* raw_bytes,
+	size_t* packed_bytes,
+	double* codec_time
+	) const
+{
+	if( raw_bytes )    *raw_bytes    = m_packed_raw_bytes;
+	if( packed_bytes ) *packed_bytes = m_packed_bytes;
+	if( codec_time )   *codec_time   = m_packed_time;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+void
+	MPIPolylib::reset_packed_transfer_stats()
+{
+	m_packed_raw_bytes = 0;
+	m_packed_bytes = 0;
+	m_packed_time = 0.0;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT
+	MPIPolylib::update_migration_format()
+{
+	size_t ngroup = this->m_pg_list.size();
+	std::vector<int> has_dvertex( ngroup + 1, 0 );
+	for( size_t i=0; i<ngroup; i++ ) {
+		if( this->m_pg_list[i]->get_movable() && this->m_pg_list[i]->get_DVM() != NULL ) {
+			has_dvertex[i] = 1;
+		}
+	}
+
+	// グループのDVertex化はrank毎に行われるため、全rankで論理和をとる
+	std::vector<int> any_dvertex( ngroup + 1, 0 );
+	if (MPI_Allreduce( &has_dvertex[0], &any_dvertex[0], ngroup + 1, MPI_INT, MPI_LOR,
+		m_mycomm ) != MPI_SUCCESS) {
+			PL_ERROSH << "[ERROR]MPIPolylib::update_migration_format():MPI_Allreduce faild."
+				<< std::endl;
+			return PLSTAT_MPI_ERROR;
+	}
+	m_dvertex_migration.assign( any_dvertex.begin(), any_dvertex.begin() + ngroup );
+	return PLSTAT_OK;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT
+	MPIPolylib::write_profile(
+	const std::string& json_file,
+	const std::string& trace_file
+	)
+{
+#ifdef DEBUG
+	PL_DBGOSH << "MPIPolylib::write_profile() in. " << std::endl;
+#endif
+	const int nph = PolylibProfiler::PH_NUM;
+	const int nct = PolylibProfiler::CT_NUM;
+
+	PolylibProfiler::Record rec;
+	PolylibProfiler::get_record( &rec, m_myrank );
+	if( trace_file.empty() ) rec.m_events.clear();
+
+	// フェーズ時間とカウンタはリダクションで集計
+	PolylibProfiler::Summary sum;
+	sum.m_nrank = m_numproc;
+	if (MPI_Reduce( rec.m_time,  sum.m_time_min,  nph, MPI_DOUBLE,    MPI_MIN, 0, m_mycomm ) != MPI_SUCCESS ||
+		MPI_Reduce( rec.m_time,  sum.m_time_max,  nph, MPI_DOUBLE,    MPI_MAX, 0, m_mycomm ) != MPI_SUCCESS ||
+		MPI_Reduce( rec.m_time,  sum.m_time_sum,  nph, MPI_DOUBLE,    MPI_SUM, 0, m_mycomm ) != MPI_SUCCESS ||
+		MPI_Reduce( rec.m_calls, sum.m_calls_sum, nph, MPI_LONG_LONG, MPI_SUM, 0, m_mycomm ) != MPI_SUCCESS ||
+		MPI_Reduce( rec.m_count, sum.m_count_min, nct, MPI_LONG_LONG, MPI_MIN, 0, m_mycomm ) != MPI_SUCCESS ||
+		MPI_Reduce( rec.m_count, sum.m_count_max, nct, MPI_LONG_LONG, MPI_MAX, 0, m_mycomm ) != MPI_SUCCESS ||
+		MPI_Reduce( rec.m_count, sum.m_count_sum, nct, MPI_LONG_LONG, MPI_SUM, 0, m_mycomm ) != MPI_SUCCESS) {
+			PL_ERROSH << "[ERROR]MPIPolylib::write_profile():MPI_Reduce faild." << std::endl;
+			return PLSTAT_MPI_ERROR;
+	}
+
+	// トレースの時刻基準は全rankで最も早い計測開始時刻
+	double origin = PolylibProfiler::origin();
+	double origin_min = origin;
+	if (MPI_Reduce( &origin, &origin_min, 1, MPI_DOUBLE, MPI_MIN, 0, m_mycomm ) != MPI_SUCCESS) {
+		PL_ERROSH << "[ERROR]MPIPolylib::write_profile():MPI_Reduce faild." << std::endl;
+		return PLSTAT_MPI_ERROR;
+	}
+
+	// 隣接PE別バイト数とイベントはrank0へ集める
+	std::vector<char> buf;
+	PolylibProfiler::pack_record( rec, &buf );
+	int size = buf.size();
+	std::vector<int> sizes( m_numproc, 0 );
+	std::vector<int> displs( m_numproc, 0 );
+	if (MPI_Gather( &size, 1, MPI_INT, &sizes[0], 1, MPI_INT, 0, m_mycomm ) != MPI_SUCCESS) {
+		PL_ERROSH << "[ERROR]MPIPolylib::write_profile():MPI_Gather faild." << std::endl;
+		return PLSTAT_MPI_ERROR;
+	}
+	int total = 0;
+	for( int i=0; i<m_numproc; i++ ) {
+		displs[i] = total;
+		total += sizes[i];
+	}
+	std::vector<char> all( m_myrank == 0 ? total : 1 );
+	if (MPI_Gatherv( &buf[0], size, MPI_BYTE, &all[0], &sizes[0], &displs[0],
+		MPI_BYTE, 0, m_mycomm ) != MPI_SUCCESS) {
+			PL_ERROSH << "[ERROR]MPIPolylib::write_profile():MPI_Gatherv faild." << std::endl;
+			return PLSTAT_MPI_ERROR;
+	}
+
+	int ret = PLSTAT_OK;
+	if( m_myrank == 0 ) {
+		std::vector<PolylibProfiler::Record> recs( m_numproc );
+		for( int i=0; i<m_numproc; i++ ) {
+			if( PolylibProfiler::unpack_record( &all[displs[i]], sizes[i], &recs[i] ) == 0 ) {
+				ret = PLSTAT_NG;
+				break;
+			}
+		}
+		if( ret == PLSTAT_OK ) {
+			ret = PolylibProfiler::write_json( json_file, sum, recs );
+		}
+		if( ret == PLSTAT_OK && !trace_file.empty() ) {
+			ret = PolylibProfiler::write_chrome_trace( trace_file, recs, origin_min );
+		}
+	}
+
+	// 出力結果を全rankで共有
+	if (MPI_Bcast( &ret, 1, MPI_INT, 0, m_mycomm ) != MPI_SUCCESS) {
+		PL_ERROSH << "[ERROR]MPIPolylib::write_profile():MPI_Bcast faild." << std::endl;
+		return PLSTAT_MPI_ERROR;
+	}
+	return (POLYLIB_STAT)ret;
+}
+
+
 // public /////////////////////////////////////////////////////////////////////
 
 ParallelInfo* MPIPolylib::get_proc(int rank)
@@ -1260,45 +1582,104 @@ ParallelInfo* MPIPolylib::get_proc(int rank)
 
 // public /////////////////////////////////////////////////////////////////////
 
-unsigned int MPIPolylib::used_memory_size()
+unsigned long long MPIPolylib::used_memory_size()
 {
-	unsigned int								size;
-	std::map< int, std::vector<int> >::iterator	ex;
-	std::vector<ParallelInfo *>::iterator			pi;
+	return memory_usage().total();
+}
+
+// public /////////////////////////////////////////////////////////////////////
 
-	// Polylibクラスが管理している領域を取得
-	size = Polylib::used_memory_size();
+PolylibMemoryUsage MPIPolylib::memory_usage(
+	std::vector<std::pair<std::string, PolylibMemoryUsage> >* p_groups
+	)
+{
+	// Polylibクラスが管理している領域
+	PolylibMemoryUsage usage = Polylib::memory_usage( p_groups );
 
-	// 自PE担当領域情報
-	size += sizeof(ParallelInfo);
-	size += m_myproc.m_exclusion_map.size() * (sizeof(int)+sizeof(std::vector<int>));
-	for (ex = m_myproc.m_exclusion_map.begin();
-		ex != m_myproc.m_exclusion_map.end(); ex++) {
-			size += ex->second.size() * sizeof(int);
-	}
+	// 自クラス分(Polylib分を除く)
+	usage.m_other += sizeof(MPIPolylib) - sizeof(Polylib);
 
-	// 自PEを除く全PE担当領域情報リスト
-	size += sizeof(std::vector<ParallelInfo *>);
+	// 自PE担当領域情報と全PE担当領域情報リスト
+	unsigned long long comm = 0;
+	std::vector<const ParallelInfo*> procs;
+	procs.push_back( &m_myproc );
+	std::vector<ParallelInfo *>::iterator pi;
 	for (pi = m_other_procs.begin(); pi != m_other_procs.end(); pi++) {
-		size += sizeof(ParallelInfo);
-		size += (*pi)->m_exclusion_map.size() * (sizeof(int)+sizeof(std::vector<int>));
-		for (ex = (*pi)->m_exclusion_map.begin();
-			ex != (*pi)->m_exclusion_map.end(); ex++) {
-				size += ex->second.size() * sizeof(int);
+		comm += sizeof(ParallelInfo);
+		procs.push_back( *pi );
+	}
+	for (size_t i = 0; i < procs.size(); i++) {
+		// 移動除外リスト(mapのノードはキー/値と木構造のポインタ3つ+色で概算)
+		std::map< int, std::vector<int> >::const_iterator ex;
+		for (ex = procs[i]->m_exclusion_map.begin();
+			ex != procs[i]->m_exclusion_map.end(); ex++) {
+			comm += sizeof(std::pair<const int, std::vector<int> >) + 4 * sizeof(void*);
+			comm += ex->second.capacity() * sizeof(int);
 		}
 	}
 
-	// 隣接PE担当領域情報リスト
-	size += sizeof(std::vector<ParallelInfo *>);
-	size += m_neibour_procs.size() * sizeof(std::vector<ParallelInfo *>);
+	// PE担当領域情報リスト
+	comm += m_other_procs.capacity() * sizeof(ParallelInfo *);
+	comm += m_neibour_procs.capacity() * sizeof(ParallelInfo *);
+
+	usage.m_comm_buffers += comm;
+	return usage;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT
+MPIPolylib::reduce_memory_usage(
+	PolylibMemoryUsage* p_min,
+	PolylibMemoryUsage* p_max,
+	PolylibMemoryUsage* p_sum,
+	std::vector<std::pair<std::string, PolylibMemoryUsage> >* p_groups
+	)
+{
+	const int n = PolylibMemoryUsage::NUM_ITEMS;
+	std::vector<std::pair<std::string, PolylibMemoryUsage> > groups;
+	PolylibMemoryUsage usage = memory_usage( &groups );
+
+	// 自PEの値 + グループごとの値(グループリストの並びは全rankで共通)
+	std::vector<unsigned long long> local( n * (1 + groups.size()) );
+	usage.to_array( &local[0] );
+	for (size_t i = 0; i < groups.size(); i++) {
+		groups[i].second.to_array( &local[n * (1 + i)] );
+	}
 
-	// 自プロセスのランク数、全プロセス数
-	size += sizeof(int) * 2;
+	unsigned long long lmin[n], lmax[n];
+	unsigned long long gmin[n], gmax[n];
+	std::vector<unsigned long long> gsum( local.size() );
+	for (int i = 0; i < n; i++) { lmin[i] = lmax[i] = local[i]; }
 
-	// 自プロセスが利用するコミュニケーター
-	size += sizeof(MPI_Comm);
+	if (MPI_Allreduce(lmin, gmin, n, MPI_UNSIGNED_LONG_LONG, MPI_MIN, m_mycomm)
+		!= MPI_SUCCESS) {
+		PL_ERROSH << "[ERROR]MPIPolylib::reduce_memory_usage():MPI_Allreduce(min) faild." << std::endl;
+		return PLSTAT_MPI_ERROR;
+	}
+	if (MPI_Allreduce(lmax, gmax, n, MPI_UNSIGNED_LONG_LONG, MPI_MAX, m_mycomm)
+		!= MPI_SUCCESS) {
+		PL_ERROSH << "[ERROR]MPIPolylib::reduce_memory_usage():MPI_Allreduce(max) faild." << std::endl;
+		return PLSTAT_MPI_ERROR;
+	}
+	if (MPI_Allreduce(&local[0], &gsum[0], (int)local.size(), MPI_UNSIGNED_LONG_LONG,
+		MPI_SUM, m_mycomm) != MPI_SUCCESS) {
+		PL_ERROSH << "[ERROR]MPIPolylib::reduce_memory_usage():MPI_Allreduce(sum) faild." << std::endl;
+		return PLSTAT_MPI_ERROR;
+	}
 
-	return size;
+	if( p_min ) p_min->from_array( gmin );
+	if( p_max ) p_max->from_array( gmax );
+	if( p_sum ) p_sum->from_array( &gsum[0] );
+	if( p_groups ) {
+		p_groups->clear();
+		for (size_t i = 0; i < groups.size(); i++) {
+			PolylibMemoryUsage u;
+			u.from_array( &gsum[n * (1 + i)] );
+			p_groups->push_back( std::make_pair( groups[i].first, u ) );
+		}
+	}
+	return PLSTAT_OK;
 }
 
 
@@ -1306,6 +1687,11 @@ unsigned int MPIPolylib::used_memory_size()
 
 MPIPolylib::MPIPolylib() : Polylib()
 {
+	m_packed_transfer = false;
+	m_packed_error_bound = 1.0e-6;
+	m_packed_raw_bytes = 0;
+	m_packed_bytes = 0;
+	m_packed_time = 0.0;
 }
 
 
@@ -1378,6 +1764,7 @@ POLYLIB_STAT
 	int          *p_send_tria_exids_array;
 	std::vector<PL_REAL> send_trias;
 	PL_REAL        *p_send_trias_array;
+	std::vector<const std::vector<PrivateTriangle*>*> packed_trias_list;
 
 	// 全PEに対して
 	for (proc_itr = m_other_procs.begin(); proc_itr != m_other_procs.end(); proc_itr++) {
@@ -1388,6 +1775,7 @@ POLYLIB_STAT
 		send_trias.clear();
 		send_tria_ids.clear();
 		send_tria_exids.clear();
+		packed_trias_list.clear();
 
 		// 全グループに対して
 		for (group_itr = this->m_pg_list.begin(); group_itr != this->m_pg_list.end(); group_itr++) {
@@ -1401,11 +1789,17 @@ POLYLIB_STAT
 				p_trias = p_pg->search( &((*proc_itr)->m_area.m_gcell_bbox), false );
 			}
 
+			// 圧縮形式ではグループ毎の三角形リストをまとめて後で符号化
+			if( m_packed_transfer ) {
+				packed_trias_list.push_back( p_trias );
+				continue;
+			}
+
 			// グループIDと当該グループの三角形数の対を送信データに追加
 			pack_num_trias( &send_num_trias, p_pg->get_internal_id(), p_trias );
 
 			// 三角形情報を送信データに追加
-			pack_trias( &send_trias, p_trias );
+			pack_trias( &send_trias, p_trias, p_pg );
 
 			// 三角形ID情報を送信データに追加
 			pack_tria_ids( &send_tria_ids, p_trias );
@@ -1417,6 +1811,21 @@ POLYLIB_STAT
 			if( p_trias ) delete p_trias;
 		}
 
+		// 圧縮形式で当該PEへ送信
+		if( m_packed_transfer ) {
+			std::vector<unsigned char> buf;
+			POLYLIB_STAT ret = send_packed_trias( *proc_itr, packed_trias_list, &buf, NULL );
+			for( i=0; i<packed_trias_list.size(); i++ ) {
+				if( packed_trias_list[i] ) delete packed_trias_list[i];
+			}
+			if( ret != PLSTAT_OK ) {
+				PL_ERROSH << "[ERROR]MPIPolylib::send_polygons_to_all():send_packed_trias() failed."
+					<< std::endl;
+				return ret;
+			}
+			continue;
+		}
+
 		//----  送信データをシリアライズ
 		// 送信データ配列初期化
 		p_send_num_trias_array = NULL;
@@ -1546,7 +1955,8 @@ POLYLIB_STAT
 POLYLIB_STAT
 	MPIPolylib::pack_trias(
 	std::vector<PL_REAL>* p_vec,
-	const std::vector<PrivateTriangle*>* p_trias
+	const std::vector<PrivateTriangle*>* p_trias,
+	const PolygonGroup* p_pg
 	)
 {
 #ifdef DEBUG
@@ -1554,13 +1964,14 @@ POLYLIB_STAT
 #endif
 	if( p_trias == NULL ) return PLSTAT_OK;
 
-	// 出力配列に、三角形頂点座標を順に追加
+	// 出力配列に、三角形頂点座標(ワールド座標系)を順に追加
 	for( unsigned int i=0; i<p_trias->size(); i++ ) {
 		Vertex** tmp_vlist=p_trias->at(i)->get_vertex();
 		for( unsigned int j=0; j<3; j++ ) {
-			Vertex* vtmp= tmp_vlist[j];
+			Vec3<PL_REAL> vtmp = *tmp_vlist[j];
+			if( p_pg != NULL ) vtmp = p_pg->to_world_pos( vtmp );
 			for( unsigned int k=0; k<3; k++ ) {
-				p_vec->push_back(  (*vtmp)[k] );
+				p_vec->push_back(  vtmp[k] );
 				//p_vec->push_back( p_trias->at(i)->get_vertex()[j][k] );
 			}
 		}
@@ -1568,6 +1979,224 @@ POLYLIB_STAT
 	return PLSTAT_OK;
 }
 
+
+// protected //////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT
+	MPIPolylib::send_packed_trias(
+	ParallelInfo* p_proc,
+	const std::vector<const std::vector<PrivateTriangle*>*>& p_trias_list,
+	std::vector<unsigned char>* p_buf,
+	MPI_Request* p_req
+	)
+{
+#ifdef DEBUG
+	PL_DBGOSH << "MPIPolylib::send_packed_trias() in. " << std::endl;
+#endif
+	POLYLIB_STAT ret;
+	double t0 = MPI_Wtime();
+
+	// 送信先gcell bboxを基準に量子化。DVertexのために圧縮形式を用いる場合は無損失
+	TriaCodec codec( m_packed_transfer ? m_packed_error_bound : 0.0 );
+	codec.begin( p_proc->m_area.m_gcell_bbox );
+	for( unsigned int i=0; i<this->m_pg_list.size(); i++ ) {
+		// 剛体インスタンシングのグループはワールド座標系で送る
+		double rt[12];
+		bool rigid = this->m_pg_list[i]->get_rigid_transform( rt );
+		if( (ret = codec.add_group( this->m_pg_list[i]->get_internal_id(),
+				p_trias_list.at(i), rigid ? rt : NULL )) != PLSTAT_OK ) {
+			return ret;
+		}
+	}
+	if( (ret = codec.encode( p_buf )) != PLSTAT_OK ) return ret;
+
+	m_packed_time += MPI_Wtime() - t0;
+	m_packed_raw_bytes += codec.raw_size();
+	m_packed_bytes += p_buf->size();
+
+#ifdef DEBUG
+	PL_DBGOSH << "sending packed polygons rank:" << m_myrank << "->rank:"
+		<< p_proc->m_rank << " trias:" << codec.num_trias()
+		<< " raw:" << codec.raw_size() << " packed:" << p_buf->size() << std::endl;
+#endif
+
+	int rc;
+	if( p_req ) {
+		rc = MPI_Isend( &(*p_buf)[0], p_buf->size(), MPI_BYTE, p_proc->m_rank,
+			MPITAG_PACKED_TRIAS, m_mycomm, p_req );
+	} else {
+		rc = MPI_Send( &(*p_buf)[0], p_buf->size(), MPI_BYTE, p_proc->m_rank,
+			MPITAG_PACKED_TRIAS, m_mycomm );
+	}
+	if( rc != MPI_SUCCESS ) {
+		PL_ERROSH << "[ERROR]MPIPolylib::send_packed_trias():MPI_Send,"
+			<< "MPITAG_PACKED_TRIAS faild." << std::endl;
+		return PLSTAT_MPI_ERROR;
+	}
+	return PLSTAT_OK;
+}
+
+
+// protected //////////////////////////////////////////////////////////////////
+
+bool
+	MPIPolylib::use_packed_migration(
+	size_t index
+	) const
+{
+	if( m_packed_transfer ) return true;
+	return index < m_dvertex_migration.size() && m_dvertex_migration[index] != 0;
+}
+
+
+// protected //////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT
+	MPIPolylib::recv_packed_trias(
+	int rank,
+	std::vector<TriaCodecGroup>* p_groups,
+	size_t* p_size
+	)
+{
+#ifdef DEBUG
+	PL_DBGOSH << "MPIPolylib::recv_packed_trias() in. " << std::endl;
+#endif
+	MPI_Status mpi_stat;
+	int size;
+
+	// サイズは可変なのでprobeしてから受信
+	if (MPI_Probe( rank, MPITAG_PACKED_TRIAS, m_mycomm, &mpi_stat ) != MPI_SUCCESS ||
+		MPI_Get_count( &mpi_stat, MPI_BYTE, &size ) != MPI_SUCCESS) {
+			PL_ERROSH << "[ERROR]MPIPolylib::recv_packed_trias():MPI_Probe,"
+				<< "MPITAG_PACKED_TRIAS faild." << std::endl;
+			return PLSTAT_MPI_ERROR;
+	}
+	if( p_size ) *p_size = size;
+	std::vector<unsigned char> buf( size );
+	if (MPI_Recv( &buf[0], size, MPI_BYTE, rank,
+		MPITAG_PACKED_TRIAS, m_mycomm, &mpi_stat ) != MPI_SUCCESS) {
+			PL_ERROSH << "[ERROR]MPIPolylib::recv_packed_trias():MPI_Recv,"
+				<< "MPITAG_PACKED_TRIAS faild." << std::endl;
+			return PLSTAT_MPI_ERROR;
+	}
+
+	double t0 = MPI_Wtime();
+	POLYLIB_STAT ret = TriaCodec::decode( &buf[0], buf.size(), p_groups );
+	m_packed_time += MPI_Wtime() - t0;
+
+	if( ret == PLSTAT_OK && p_groups->size() != this->m_pg_list.size() ) {
+		PL_ERROSH << "[ERROR]MPIPolylib::recv_packed_trias():group count mismatch:"
+			<< p_groups->size() << std::endl;
+		return PLSTAT_NG;
+	}
+	return ret;
+}
+
+
+// protected //////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT
+	MPIPolylib::add_packed_trias(
+	const std::vector<TriaCodecGroup>& groups
+	)
+{
+	POLYLIB_STAT ret;
+
+	for( unsigned int g=0; g<groups.size(); g++ ) {
+		const TriaCodecGroup& grp = groups[g];
+		if( grp.num_trias() == 0 ) continue;
+
+		PolygonGroup* p_pg = this->get_group( grp.m_group_id );
+		if( p_pg == NULL ) {
+			PL_ERROSH << "[ERROR]MPIPolylib::add_packed_trias():invalid pg_id:"
+				<< grp.m_group_id << std::endl;
+			return PLSTAT_NG;
+		}
+
+		// DVertexのデータ構成を受信側グループと合わせる
+		DVertexManager* p_dvm = NULL;
+		if( grp.has_dvertex() ) {
+			p_dvm = p_pg->get_DVM();
+			if( p_dvm == NULL && ( p_pg->get_triangles() == NULL ||
+				p_pg->get_triangles()->size() == 0 ) ) {
+				// 空のグループはここでDVertex化する
+				p_pg->prepare_DVertex( grp.m_nscalar, grp.m_nvector );
+				p_dvm = p_pg->get_DVM();
+			}
+			if( p_dvm == NULL || p_dvm->nscalar() != grp.m_nscalar ||
+				p_dvm->nvector() != grp.m_nvector ) {
+				PL_ERROSH << "[ERROR]MPIPolylib::add_packed_trias():DVertex layout mismatch. pg_id:"
+					<< grp.m_group_id << " nscalar:" << grp.m_nscalar
+					<< " nvector:" << grp.m_nvector << std::endl;
+				return PLSTAT_NG;
+			}
+		}
+
+		// 受信した三角形はワールド座標系なので、剛体インスタンシングのグループは
+		// 頂点を追加する前に変換を頂点へ反映する(KD木はmigrate()の最後に再構築する)
+		p_pg->materialize_vertices( false );
+
+		// 共有頂点ごとにVertex(DVertex)を生成
+		// 頂点は送信側で共有済みのため、ここでは再結合しない
+		VertexList* p_vlist = p_pg->get_vertexlist();
+		size_t nvert = grp.m_vertices.size() / 3;
+		std::vector<Vertex*> vertices( nvert );
+		for( size_t i=0; i<nvert; i++ ) {
+			Vec3<PL_REAL> pos( grp.m_vertices[i*3],
+				grp.m_vertices[i*3+1],
+				grp.m_vertices[i*3+2] );
+			if( p_dvm != NULL ) {
+				DVertex* dv = new DVertex( p_dvm );
+				Vertex* v = dv;
+				*v = pos;
+				for( int k=0; k<grp.m_nscalar; k++ ) {
+					dv->set_scalar( k, grp.m_scalars[i*grp.m_nscalar+k] );
+				}
+				for( int k=0; k<grp.m_nvector; k++ ) {
+					const PL_REAL* p = &grp.m_vectors[(i*grp.m_nvector+k)*3];
+					dv->set_vector( k, Vec3<PL_REAL>( p[0], p[1], p[2] ) );
+				}
+				vertices[i] = dv;
+			} else {
+				vertices[i] = new Vertex( pos );
+			}
+			p_vlist->vtx_add_nocheck( vertices[i] );
+		}
+
+		std::vector<PrivateTriangle*> tria_vec;
+		tria_vec.reserve( grp.num_trias() );
+		for( size_t i=0; i<grp.num_trias(); i++ ) {
+			Vertex* vertex_ptr[3];
+			vertex_ptr[0] = vertices[ grp.m_index[i*3]   ];
+			vertex_ptr[1] = vertices[ grp.m_index[i*3+1] ];
+			vertex_ptr[2] = vertices[ grp.m_index[i*3+2] ];
+			if( p_dvm != NULL ) {
+				DVertex* dvertex_ptr[3];
+				for( int k=0; k<3; k++ ) {
+					dvertex_ptr[k] = static_cast<DVertex*>( vertex_ptr[k] );
+				}
+				tria_vec.push_back( new DVertexTriangle( dvertex_ptr,
+					grp.m_ids[i], grp.m_exids[i] ) );
+			} else {
+				tria_vec.push_back( new PrivateTriangle( vertex_ptr,
+					grp.m_ids[i], grp.m_exids[i] ) );
+			}
+		}
+
+		ret = p_pg->add_triangles( &tria_vec );
+
+		for( size_t i=0; i<tria_vec.size(); i++ ) {
+			delete tria_vec[i];
+		}
+		if( ret != PLSTAT_OK ) {
+			PL_ERROSH << "[ERROR]MPIPolylib::add_packed_trias():p_pg->add_triangles() failed. returns:"
+				<< PolylibStat2::String(ret) << std::endl;
+			return ret;
+		}
+	}
+	return PLSTAT_OK;
+}
+
 // protected ////////////////////////////////////////////////////////////////// //for DVertex
 
 POLYLIB_STAT
@@ -1780,6 +2409,22 @@ POLYLIB_STAT
 			//p_pg->build_polygon_tree();
 			p_trias = p_pg->search( &(m_myproc.m_area.m_gcell_bbox), false );
 
+			// 全て自領域内なら再構築しない(剛体インスタンシングのグループは
+			// ローカル座標系のまま残る)
+			if( p_trias && p_trias->size() == p_pg->get_triangles()->size() ) {
+				delete p_trias;
+				continue;
+			}
+
+			// 剛体インスタンシングのグループの検索結果はローカル座標系なので、
+			// 変換を頂点へ反映してからワールド座標系で抽出し直す
+			double rt[12];
+			if( p_trias && p_pg->get_rigid_transform( rt ) ) {
+				delete p_trias;
+				p_pg->materialize_vertices( false );
+				p_trias = p_pg->linear_search( &(m_myproc.m_area.m_gcell_bbox), false );
+			}
+
 			// 検索結果のディープコピーを作成
 			copy_trias.clear();
 			if( p_trias ) {
@@ -1881,6 +2526,36 @@ POLYLIB_STAT
 	unsigned int pos_id, pos_exid, pos_tria;
 	MPI_Status mpi_stat;
 
+	// 圧縮形式で受信し、グループ毎に展開してポリゴン情報を設定
+	if( m_packed_transfer ) {
+		std::vector<TriaCodecGroup> packed_groups;
+		if( recv_packed_trias( 0, &packed_groups ) != PLSTAT_OK ) {
+			PL_ERROSH << "[ERROR]MPIPolylib::receive_polygons_from_rank0()"
+				<< ":recv_packed_trias() failed." << std::endl;
+			return PLSTAT_MPI_ERROR;
+		}
+		for( i=0; i<packed_groups.size(); i++ ) {
+			const TriaCodecGroup& grp = packed_groups[i];
+			PolygonGroup* p_pg = this->get_group( grp.m_group_id );
+			if( p_pg == NULL ) {
+				PL_ERROSH << "[ERROR]MPIPolylib::receive_polygons_from_rank0():invalid pg_id:"
+					<< grp.m_group_id << std::endl;
+				return PLSTAT_NG;
+			}
+			std::vector<PL_REAL> trias;
+			grp.expand_trias( &trias );
+			unsigned int num_trias = grp.num_trias();
+			if( p_pg->init( num_trias ? &trias[0] : NULL,
+					num_trias ? &grp.m_ids[0] : NULL,
+					num_trias ? &grp.m_exids[0] : NULL,
+					0, 0, 0, num_trias ) != PLSTAT_OK ) {
+				PL_ERROSH << "[ERROR]MPIPolylib::receive_polygons_from_rank0():p_pg->init() failed:" << std::endl;
+				return PLSTAT_NG;
+			}
+		}
+		return PLSTAT_OK;
+	}
+
 	// グループIDとグループ毎三角形数の対をrank0から受信
 	// グループ情報は配信済みなので、グループ数は予め分かっている
 	int *p_intarray = new int[ this->m_pg_list.size() * 2 ];
@@ -2649,7 +3324,7 @@ POLYLIB_STAT
 			pack_num_trias( &send_num_trias, p_pg->get_internal_id(), p_trias );
 
 			// 三角形情報を送信データに追加
-			pack_trias( &send_trias, p_trias );
+			pack_trias( &send_trias, p_trias, p_pg );
 
 			// 三角形ID情報を送信データに追加
 			pack_tria_ids( &send_tria_ids, p_trias );
@@ -2800,7 +3475,7 @@ POLYLIB_STAT
 				pack_num_trias( &send_num_trias, p_pg->get_internal_id(), p_trias );
 
 				// 三角形情報を送信データに追加
-				pack_trias( &send_trias, p_trias );
+				pack_trias( &send_trias, p_trias, p_pg );
 
 				// 三角形ID情報を送信データに追加
 				pack_tria_ids(&send_tria_ids, p_trias );
@@ -3006,6 +3681,7 @@ POLYLIB_STAT
 
 			// 隣接PE領域(ガイドセル含)に懸かる三角形IDリストを作成
 			p_trias = p_pg->search( &(m_neibour_procs.at(i)->m_area.m_gcell_bbox), false );
+			if( p_trias == NULL ) return p_pg->load_deferred();
 			for( j=0; j<p_trias->size(); j++ ) {
 				ids.push_back( p_trias->at(j)->get_id() );
 			}
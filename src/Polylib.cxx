@@ -18,8 +18,14 @@
 
 #include "Polylib.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include <fstream>
+#include <algorithm>
 #include <map>
+#include <set>
 #include <string.h>
 #include <vector>
 #include <iostream>
@@ -36,6 +42,8 @@
 #include "polygons/VertexList.h"
 #include "polygons/VertKDT.h"
 #include "polygons/VTree.h"
+#include "file_io/CheckpointWriter.h"
+#include "util/PolylibProfiler.h"
 
 
 
@@ -154,6 +162,48 @@ POLYLIB_STAT Polylib::save(
 	std::string	*p_config_name,
 	std::string	stl_format,
 	std::string	extend
+	) {
+		return save_files(p_config_name, stl_format, extend, NULL);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::save_async(
+	std::string	*p_config_name,
+	std::string	stl_format,
+	std::string	extend,
+	bool		block
+	) {
+		POLYLIB_STAT stat = prepare_checkpoint(block);
+		if (stat != PLSTAT_OK) return stat;
+
+		std::vector<CheckpointPiece*> snapshot;
+		stat = save_files(p_config_name, stl_format, extend, &snapshot);
+		return start_checkpoint(stat, &snapshot);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool Polylib::save_async_busy() const
+{
+	return m_checkpoint != NULL && m_checkpoint->busy();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::save_async_wait()
+{
+	if (m_checkpoint == NULL) return PLSTAT_OK;
+	return m_checkpoint->wait();
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::save_files(
+	std::string	*p_config_name,
+	std::string	stl_format,
+	std::string	extend,
+	std::vector<CheckpointPiece*>	*snapshot
 	) {
 		//#define DEBUG
 #ifdef DEBUG
@@ -190,8 +240,17 @@ POLYLIB_STAT Polylib::save(
 			}
 
 			// STLファイル保存 (第一引数のランク番号は不要)
-			stat = (*it)->save_stl_file("", my_extend, stl_format,
-				stl_fname_map);
+			if (snapshot == NULL) {
+				stat = (*it)->save_stl_file("", my_extend, stl_format,
+					stl_fname_map);
+			}
+			else {
+				CheckpointPiece* piece = new CheckpointPiece;
+				snapshot->push_back(piece);
+				stat = (*it)->snapshot_files("", my_extend, stl_format,
+					stl_fname_map, piece);
+				piece->id_fname = "";
+			}
 
 #ifdef DEBUG
 			PL_DBGOSH << __FUNCTION__ << " save_stl_file called "<< my_extend << std::endl;
@@ -261,6 +320,7 @@ POLYLIB_STAT Polylib::move(
 #ifdef DEBUG
 		PL_DBGOSH << "Polylib::move() in." << std::endl;
 #endif
+		PolylibProfileScope prof( PolylibProfiler::PH_MOVE );
 		POLYLIB_STAT ret;
 		std::vector<PolygonGroup*>::iterator it;
 
@@ -268,6 +328,10 @@ POLYLIB_STAT Polylib::move(
 
 			// リーフグループで、movableフラグONのポリゴンを移動
 			if ((*it)->get_children().empty() == true && (*it)->get_movable() ) {
+				// 遅延読み込み中であれば移動前に読み込む
+				ret = (*it)->load_deferred();
+				if (ret != PLSTAT_OK)	return ret;
+
 				ret = (*it)->move(params);
 				if (ret != PLSTAT_OK)	return ret;
 
@@ -484,53 +548,40 @@ POLYLIB_STAT Polylib::show_group_info(std::string group_name)
 
 // public /////////////////////////////////////////////////////////////////////
 
-unsigned int Polylib::used_memory_size()
+unsigned long long Polylib::used_memory_size()
 {
-	unsigned int size;
-	std::vector<PolygonGroup*>::iterator pg;
-	std::vector<PrivateTriangle*>::iterator pt;
-
-	// 自クラスとFactoryクラス
-	size = sizeof(Polylib) + sizeof(PolygonGroupFactory);
-
-	// ポリゴングループ
-#ifdef DEBUG
-	PL_DBGOSH << "Polylib::used_memory_size:PolygonGroup num=" << m_pg_list.size() << std::endl;
-#endif
-	for (pg = m_pg_list.begin(); pg != m_pg_list.end(); pg++) {
+	return memory_usage().total();
+}
 
-		// PolygonGroupクラス
-		size += sizeof(PolygonGroup);
+// public /////////////////////////////////////////////////////////////////////
 
-		// TriMeshクラス
-		size += sizeof(TriMesh);
+PolylibMemoryUsage Polylib::memory_usage(
+	std::vector<std::pair<std::string, PolylibMemoryUsage> >* p_groups
+	)
+{
+	PolylibMemoryUsage total;
 
-		// 三角形移動前一時リスト
-		size += (*pg)->get_num_of_trias_before_move() * sizeof(std::vector<void> *);
+	// 自クラスとFactoryクラス
+	total.m_other += sizeof(Polylib) + sizeof(PolygonGroupFactory)
+		+ m_pg_list.capacity() * sizeof(PolygonGroup*);
 
-		// リーフにはポリゴンがある
-		if ((*pg)->get_children().empty()) {
+	if( p_groups ) p_groups->clear();
 
-			// 三角形ポリゴン
-			std::vector<PrivateTriangle*>	*tri_list = (*pg)->get_triangles();
+	// ポリゴングループ
 #ifdef DEBUG
-			PL_DBGOSH << "Polylib::used_memory_size:PrivateTriangle num=" << tri_list->size() << std::endl;
+	PL_DBGOSH << "Polylib::memory_usage:PolygonGroup num=" << m_pg_list.size() << std::endl;
 #endif
-			size += tri_list->size() *
-				(sizeof(PrivateTriangle)+sizeof(PrivateTriangle*));
-			VertexList* vertexlist=(*pg)->get_vertexlist();
-			size += vertexlist->size() * (sizeof(Vertex)+sizeof(Vertex*));
-			VertKDT* vertkdt=(*pg)->get_vertkdt();
-			size+= vertkdt->memory_size();
-
-			// KD木
-			VTree *vtree = (*pg)->get_vtree();
-			size += vtree->memory_size();
+	std::vector<PolygonGroup*>::iterator pg;
+	for (pg = m_pg_list.begin(); pg != m_pg_list.end(); pg++) {
+		PolylibMemoryUsage usage;
+		(*pg)->memory_usage( &usage );
+		total += usage;
+		if( p_groups ) {
+			p_groups->push_back( std::make_pair( (*pg)->acq_fullpath(), usage ) );
 		}
-
 	}
 
-	return size;
+	return total;
 }
 
 // public /////////////////////////////////////////////////////////////////////
@@ -564,6 +615,108 @@ PolygonGroup* Polylib::get_group(std::string name) const
 
 // public /////////////////////////////////////////////////////////////////////
 
+POLYLIB_STAT Polylib::acquire_snapshots(
+	std::string							group_name,
+	std::vector<PolygonSnapshotHandle>	*handles
+	) const {
+
+		if (handles == NULL) return PLSTAT_ARGUMENT_NULL;
+
+		PolygonGroup* pg = get_group(group_name);
+		if (pg == 0) {
+			PL_ERROSH << "[ERROR]Polylib::acquire_snapshots():Group not found: "
+				<< group_name << std::endl;
+			return PLSTAT_GROUP_NOT_FOUND;
+		}
+
+		std::vector<PolygonGroup*> pg_list;
+
+		//子孫を検索
+		search_group(pg, &pg_list);
+
+		//自身を追加
+		pg_list.push_back(pg);
+
+		std::vector<PolygonGroup*>::iterator it;
+		for (it = pg_list.begin(); it != pg_list.end(); it++) {
+			PolygonSnapshotHandle h = (*it)->acquire_snapshot();
+			if (h.valid()) handles->push_back(h);
+		}
+		return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::bin_polygons(
+	const CellGrid&					grid,
+	TriangleBins					*bins,
+	const std::vector<std::string>	*group_names,
+	bool							exact
+	) const {
+
+		if (bins == NULL) return PLSTAT_ARGUMENT_NULL;
+
+		// 対象グループ(子孫を含む)
+		std::set<PolygonGroup*> selected;
+		if (group_names != NULL) {
+			for (size_t i = 0; i < group_names->size(); i++) {
+				PolygonGroup* pg = get_group((*group_names)[i]);
+				if (pg == 0) {
+					PL_ERROSH << "[ERROR]Polylib::bin_polygons():Group not found: "
+						<< (*group_names)[i] << std::endl;
+					return PLSTAT_GROUP_NOT_FOUND;
+				}
+				std::vector<PolygonGroup*> pg_list;
+				search_group(pg, &pg_list);
+				pg_list.push_back(pg);
+				selected.insert(pg_list.begin(), pg_list.end());
+			}
+		}
+
+		// リーフグループの三角形を登録順に集める。剛体インスタンシングの
+		// グループは三角形毎に変換を添えてワールド座標系で登録する
+		std::vector<Triangle*> trias;
+		std::vector<double> frames(m_pg_list.size() * 12);
+		std::vector<const double*> rigid;
+		bool any_rigid = false;
+		for (size_t g = 0; g < m_pg_list.size(); g++) {
+			PolygonGroup* pg = m_pg_list[g];
+			if (pg->get_children().size() != 0) continue;
+			if (group_names != NULL && selected.count(pg) == 0) continue;
+			std::vector<PrivateTriangle*>* tri_list = pg->get_triangles();
+			if (tri_list == NULL) continue;
+			const double* rt = NULL;
+			if (pg->get_rigid_transform(&frames[g*12])) {
+				rt = &frames[g*12];
+				any_rigid = true;
+			}
+			trias.insert(trias.end(), tri_list->begin(), tri_list->end());
+			rigid.insert(rigid.end(), tri_list->size(), rt);
+		}
+
+		return bins->build(grid, trias, exact, any_rigid ? &rigid : NULL);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::bin_polygons(
+	const CalcAreaInfo&				area,
+	TriangleBins					*bins,
+	const std::vector<std::string>	*group_names,
+	bool							exact
+	) const {
+
+		CellGrid grid;
+		grid.m_origin = area.m_gcell_min;
+		grid.m_cell_size = area.m_dx;
+		for (int a = 0; a < 3; a++) {
+			grid.m_dims[a] = (int)(area.m_bbsize[a] + 2 * area.m_gcsize[a] + 0.5);
+		}
+		return bin_polygons(grid, bins, group_names, exact);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
 const Triangle* Polylib::search_nearest_polygon(
 	std::string	 group_name,
 	const Vec3<PL_REAL>&	pos
@@ -585,7 +738,7 @@ const Triangle* Polylib::search_nearest_polygon(
 		pg_list2->push_back(pg);
 
 		const PrivateTriangle* tri_min = 0;
-		PL_REAL dist2_min = 0.0;
+		PL_CALC_REAL dist2_min = 0.0;
 
 		//対象ポリゴングループ毎に検索
 		std::vector<PolygonGroup*>::iterator it;
@@ -597,10 +750,14 @@ const Triangle* Polylib::search_nearest_polygon(
 
 					Vertex** v = tri->get_vertex();
 
-					Vec3<PL_REAL> c(((*v[0])[0]+(*v[1])[0]+(*v[2])[0])/3.0,
-						((*v[0])[1]+(*v[1])[1]+(*v[2])[1])/3.0,
-						((*v[0])[2]+(*v[1])[2]+(*v[2])[2])/3.0);
-					PL_REAL dist2 = (c - pos).lengthSquared();
+					// 重心はワールド座標系で比較する
+					Vec3<PL_REAL> lc(((PL_CALC_REAL)(*v[0])[0]+(*v[1])[0]+(*v[2])[0])/3.0,
+						((PL_CALC_REAL)(*v[0])[1]+(*v[1])[1]+(*v[2])[1])/3.0,
+						((PL_CALC_REAL)(*v[0])[2]+(*v[1])[2]+(*v[2])[2])/3.0);
+					Vec3<PL_REAL> wc = (*it)->to_world_pos(lc);
+					Vec3<PL_CALC_REAL> c(wc[0], wc[1], wc[2]);
+					Vec3<PL_CALC_REAL> p(pos[0], pos[1], pos[2]);
+					PL_CALC_REAL dist2 = (c - p).lengthSquared();
 					if (tri_min == 0 || dist2 < dist2_min) {
 						tri_min = tri;
 						dist2_min = dist2;
@@ -614,6 +771,82 @@ const Triangle* Polylib::search_nearest_polygon(
 		return (const Triangle*)tri_min;
 }
 
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::search_intersecting_pairs(
+	std::string					group_a,
+	std::string					group_b,
+	std::vector<TrianglePair>	*pairs
+	) const {
+
+		if (pairs == NULL) return PLSTAT_ARGUMENT_NULL;
+		std::vector<PolygonGroup*> leaves_a, leaves_b;
+		POLYLIB_STAT ret = leaf_groups(group_a, &leaves_a);
+		if (ret != PLSTAT_OK) return ret;
+		ret = leaf_groups(group_b, &leaves_b);
+		if (ret != PLSTAT_OK) return ret;
+
+		for (size_t i = 0; i < leaves_a.size(); i++) {
+			for (size_t j = 0; j < leaves_b.size(); j++) {
+				ret = leaves_a[i]->search_intersecting_pairs(leaves_b[j], pairs);
+				if (ret != PLSTAT_OK) return ret;
+			}
+		}
+		return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::search_pairs_within(
+	std::string					group_a,
+	std::string					group_b,
+	PL_REAL						dist,
+	std::vector<TrianglePair>	*pairs
+	) const {
+
+		if (pairs == NULL) return PLSTAT_ARGUMENT_NULL;
+		std::vector<PolygonGroup*> leaves_a, leaves_b;
+		POLYLIB_STAT ret = leaf_groups(group_a, &leaves_a);
+		if (ret != PLSTAT_OK) return ret;
+		ret = leaf_groups(group_b, &leaves_b);
+		if (ret != PLSTAT_OK) return ret;
+
+		for (size_t i = 0; i < leaves_a.size(); i++) {
+			for (size_t j = 0; j < leaves_b.size(); j++) {
+				ret = leaves_a[i]->search_pairs_within(leaves_b[j], dist, pairs);
+				if (ret != PLSTAT_OK) return ret;
+			}
+		}
+		return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::search_nearest_pair(
+	std::string					group_a,
+	std::string					group_b,
+	TrianglePair				*pair
+	) const {
+
+		if (pair == NULL) return PLSTAT_ARGUMENT_NULL;
+		*pair = TrianglePair();
+		std::vector<PolygonGroup*> leaves_a, leaves_b;
+		POLYLIB_STAT ret = leaf_groups(group_a, &leaves_a);
+		if (ret != PLSTAT_OK) return ret;
+		ret = leaf_groups(group_b, &leaves_b);
+		if (ret != PLSTAT_OK) return ret;
+
+		for (size_t i = 0; i < leaves_a.size(); i++) {
+			for (size_t j = 0; j < leaves_b.size(); j++) {
+				TrianglePair p;
+				ret = leaves_a[i]->search_nearest_pair(leaves_b[j], &p);
+				if (ret != PLSTAT_OK) return ret;
+				if (p.tri_a != 0 && (pair->tri_a == 0 || p.dist2 < pair->dist2)) *pair = p;
+			}
+		}
+		return PLSTAT_OK;
+}
+
 // protected //////////////////////////////////////////////////////////////////
 
 Polylib::Polylib()
@@ -629,6 +862,10 @@ Polylib::Polylib()
 	//同一頂点かどうかの判定基準
 	m_distance_tolerance=1.0e-10;
 
+	m_checkpoint = NULL;
+	m_load_threads = 1;
+	m_lazy_load = false;
+
 	//PL_DBGOS<< __FUNCTION__ <<" m_factory "<< m_factory << " tp " << tp<<std::std::endl;
 
 }
@@ -637,6 +874,8 @@ Polylib::Polylib()
 
 Polylib::~Polylib()
 {
+	// 実行中の非同期保存を待つ
+	delete m_checkpoint;
 
 	//#define DEBUG
 	std::vector<PolygonGroup*>::iterator it;
@@ -832,54 +1071,206 @@ POLYLIB_STAT Polylib::load_polygons(
 	)
 {
 
-#ifdef TIME_MEASURE
-	time_t start;
-	time(&start);
-#endif
+	PolylibProfileScope prof( PolylibProfiler::PH_LOAD );
 
 	//#define DEBUG
 #ifdef DEBUG
 	PL_DBGOSH << "Polylib::load_polygons() in." << std::endl;
 #endif
+	// リーフのみがポリゴン情報を持っている
+	std::vector<PolygonGroup*> leaves;
 	std::vector<PolygonGroup*>::iterator it;
 	for (it = m_pg_list.begin(); it != m_pg_list.end(); it++) {
-		// リーフの場合
-		if ((*it)->get_children().empty() == true) {
+		if ((*it)->get_children().empty() == true) leaves.push_back(*it);
+	}
+	int nleaf = leaves.size();
+	for (int i = 0; i < nleaf; i++) leaves[i]->set_cache_dir(m_cache_dir);
 
-			//STLファイルを読み込む
+	// 遅延読み込みでは読み込み条件だけを登録する
+	if (m_lazy_load) {
+		for (int i = 0; i < nleaf; i++) {
+			POLYLIB_STAT ret = leaves[i]->defer_load(with_id_file, id_format, scale);
+			if (ret != PLSTAT_OK)		return ret;
+		}
+		return PLSTAT_OK;
+	}
 
-#ifdef DEBUG
-			PL_DBGOSH << "Polylib::load_polygons() load_stl_file in." << std::endl;
+	int nthreads = 1;
+#ifdef _OPENMP
+	nthreads = (m_load_threads > 0) ? m_load_threads : omp_get_max_threads();
 #endif
+	if (nthreads <= 1 || nleaf <= 1) {
+		for (int i = 0; i < nleaf; i++) {
+			POLYLIB_STAT ret = load_leaf_group(leaves[i], with_id_file, id_format, scale);
+			if (ret != PLSTAT_OK)		return ret;
+		}
+		return PLSTAT_OK;
+	}
 
-			POLYLIB_STAT ret = (*it)->load_stl_file(scale);
+	// ファイルサイズの大きい順に並べる
+	std::vector< std::pair<long long,int> > order(nleaf);
+	long long total = 0;
+	for (int i = 0; i < nleaf; i++) {
+		long long size = 0;
+		std::map<std::string, std::string> files = leaves[i]->get_file_name();
+		std::map<std::string, std::string>::iterator fit;
+		for (fit = files.begin(); fit != files.end(); fit++) {
+			std::ifstream ifs(fit->first.c_str(), std::ios::in | std::ios::binary);
+			if (ifs.is_open()) {
+				ifs.seekg(0, std::ios::end);
+				size += (long long)ifs.tellg();
+			}
+		}
+		order[i] = std::make_pair(-size, i);
+		total += size;
+	}
+	std::sort(order.begin(), order.end());
+
+	// 全体のnthreads分の1を超えるグループは、グループ内の並列処理を
+	// 使えるように1つずつ読み込み、残りをグループ単位で並列に読み込む
+	std::vector<POLYLIB_STAT> stats(nleaf, PLSTAT_OK);
+	std::vector<int> rest;
+	for (int k = 0; k < nleaf; k++) {
+		int i = order[k].second;
+		if (-order[k].first * nthreads > total) {
+			stats[i] = load_leaf_group(leaves[i], with_id_file, id_format, scale);
+		}
+		else {
+			rest.push_back(i);
+		}
+	}
+	int nrest = rest.size();
 
 #ifdef DEBUG
-			PL_DBGOSH << "Polylib::load_polygons() load_stl_file out." << std::endl;
+	PL_DBGOSH << "Polylib::load_polygons() threads=" << nthreads << " leaves=" << nleaf
+		<< " parallel=" << nrest << std::endl;
 #endif
 
-			if (ret != PLSTAT_OK)		return ret;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1) num_threads(nthreads)
+#endif
+	for (int k = 0; k < nrest; k++) {
+		stats[rest[k]] = load_leaf_group(leaves[rest[k]], with_id_file, id_format, scale);
+	}
 
-			// 必要であればIDファイルを読み込んでm_idを設定
-			if (with_id_file == true) {
-				POLYLIB_STAT ret = (*it)->load_id_file(id_format);
-				if (ret != PLSTAT_OK)		return ret;
-			}
+	// 逐次の読み込みと同じく、グループ順で最初のエラーを返す
+	for (int i = 0; i < nleaf; i++) {
+		if (stats[i] != PLSTAT_OK)		return stats[i];
+	}
+	return PLSTAT_OK;
+
+	//#undef DEBUG
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void Polylib::set_load_threads(
+	int		nthreads
+	)
+{
+	m_load_threads = (nthreads < 0) ? 1 : nthreads;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::prefetch(
+	std::string		group_name
+	)
+{
+	PolylibProfileScope prof( PolylibProfiler::PH_LOAD );
+
+	PolygonGroup* pg = get_group(group_name);
+	if (pg == 0) {
+		PL_ERROSH << "[ERROR]Polylib::prefetch():Group not found: "
+			<< group_name << std::endl;
+		return PLSTAT_GROUP_NOT_FOUND;
+	}
+
+	std::vector<PolygonGroup*> pg_list;
+
+	//子孫を検索
+	search_group(pg, &pg_list);
+
+	//自身を追加
+	pg_list.push_back(pg);
+
+	// 未読み込みのリーフのみ対象
+	std::vector<PolygonGroup*> leaves;
+	std::vector<PolygonGroup*>::iterator it;
+	for (it = pg_list.begin(); it != pg_list.end(); it++) {
+		if ((*it)->get_children().empty() == true && (*it)->is_load_deferred()) {
+			leaves.push_back(*it);
 		}
 	}
+	int nleaf = leaves.size();
+	if (nleaf == 0)		return PLSTAT_OK;
 
-#ifdef TIME_MEASURE
-	time_t end;
-	time(&end);
-	printf("start time %s\n",ctime(&start));
-	printf("end time %s\n",ctime(&end));
-	int a;
-	std::cin >> a;
+	int nthreads = 1;
+#ifdef _OPENMP
+	nthreads = (m_load_threads > 0) ? m_load_threads : omp_get_max_threads();
+	if (nthreads > nleaf) nthreads = nleaf;
 #endif
 
+#ifdef DEBUG
+	PL_DBGOSH << "Polylib::prefetch() " << group_name << " leaves=" << nleaf
+		<< " threads=" << nthreads << std::endl;
+#endif
+
+	std::vector<POLYLIB_STAT> stats(nleaf, PLSTAT_OK);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1) num_threads(nthreads) if(nthreads > 1)
+#endif
+	for (int i = 0; i < nleaf; i++) {
+		stats[i] = leaves[i]->load_deferred();
+	}
+
+	for (int i = 0; i < nleaf; i++) {
+		if (stats[i] != PLSTAT_OK)		return stats[i];
+	}
 	return PLSTAT_OK;
+}
 
-	//#undef DEBUG
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::save_bbox_index()
+{
+	std::vector<PolygonGroup*>::iterator it;
+	for (it = m_pg_list.begin(); it != m_pg_list.end(); it++) {
+		if ((*it)->get_children().empty() == false) continue;
+		POLYLIB_STAT ret = (*it)->save_bbox_index();
+		if (ret != PLSTAT_OK)		return ret;
+	}
+	return PLSTAT_OK;
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::load_leaf_group(
+	PolygonGroup	*pg,
+	bool			with_id_file,
+	ID_FORMAT		id_format,
+	PL_REAL			scale
+	)
+{
+	//STLファイルを読み込む
+
+#ifdef DEBUG
+	PL_DBGOSH << "Polylib::load_leaf_group() load_stl_file in." << std::endl;
+#endif
+
+	POLYLIB_STAT ret = pg->load_stl_file(scale);
+
+#ifdef DEBUG
+	PL_DBGOSH << "Polylib::load_leaf_group() load_stl_file out." << std::endl;
+#endif
+
+	if (ret != PLSTAT_OK)		return ret;
+
+	// 必要であればIDファイルを読み込んでm_idを設定
+	if (with_id_file == true) {
+		ret = pg->load_id_file(id_format);
+	}
+	return ret;
 }
 
 
@@ -967,7 +1358,8 @@ POLYLIB_STAT Polylib::save_with_rankno(
 	int 		maxrank,
 	std::string		extend,
 	std::string		stl_format,
-	ID_FORMAT	id_format
+	ID_FORMAT	id_format,
+	std::vector<CheckpointPiece*>	*snapshot
 	){
 		//#define DEBUG
 #ifdef DEBUG
@@ -1013,11 +1405,21 @@ POLYLIB_STAT Polylib::save_with_rankno(
 			// ポリゴン数が0ならばファイル出力不要 2010.10.19
 			if ((*it)->get_triangles()->size() == 0) continue;
 
-			//stat = (*it)->save_stl_file(rank_no, my_extend, stl_format);
-			stat = (*it)->save_stl_file(rank_no, my_extend, stl_format,stl_fname_map);
-			if (stat != PLSTAT_OK)	return stat;
-			stat = (*it)->save_id_file(rank_no, my_extend, id_format);
-			if (stat != PLSTAT_OK)	return stat;
+			if (snapshot != NULL) {
+				CheckpointPiece* piece = new CheckpointPiece;
+				snapshot->push_back(piece);
+				piece->id_format = id_format;
+				stat = (*it)->snapshot_files(rank_no, my_extend, stl_format,
+					stl_fname_map, piece);
+				if (stat != PLSTAT_OK)	return stat;
+			}
+			else {
+				//stat = (*it)->save_stl_file(rank_no, my_extend, stl_format);
+				stat = (*it)->save_stl_file(rank_no, my_extend, stl_format,stl_fname_map);
+				if (stat != PLSTAT_OK)	return stat;
+				stat = (*it)->save_id_file(rank_no, my_extend, id_format);
+				if (stat != PLSTAT_OK)	return stat;
+			}
 			std::string rank_string,my_extend_string;
 			rank_string=rank_no;
 			my_extend_string = my_extend;
@@ -1050,6 +1452,33 @@ POLYLIB_STAT Polylib::save_with_rankno(
 
 }
 
+// protected //////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::prepare_checkpoint(
+	bool	block
+	){
+		if (m_checkpoint == NULL) m_checkpoint = new CheckpointWriter();
+		if (m_checkpoint->busy() && !block) return PLSTAT_SAVE_BUSY;
+
+		// 前回の複製を解放してから次の複製を作る
+		m_checkpoint->wait();
+		return PLSTAT_OK;
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::start_checkpoint(
+	POLYLIB_STAT					stat,
+	std::vector<CheckpointPiece*>	*snapshot
+	){
+		if (stat != PLSTAT_OK) {
+			for (size_t i = 0; i < snapshot->size(); i++) delete (*snapshot)[i];
+			snapshot->clear();
+			return stat;
+		}
+		return m_checkpoint->start(*snapshot);
+}
+
 /////////////////////////////////////////　　
 // 追加　２０１２ー０８
 //////////////////////////////////
@@ -1262,11 +1691,7 @@ std::vector<PrivateTriangle*>* Polylib::search_polygons(
 		}
 		std::vector<PolygonGroup*>* pg_list2 = new std::vector<PolygonGroup*>;
 
-#ifdef BENCHMARK
-		double st1, st2, ut1, ut2, tt1, tt2;
-		bool ret1, ret2;
-		ret1 = getrusage_sec(&ut1, &st1, &tt1);
-#endif
+		PolylibProfileScope prof( PolylibProfiler::PH_SEARCH );
 
 		//子孫を検索
 		search_group(pg, pg_list2);
@@ -1307,27 +1732,34 @@ std::vector<PrivateTriangle*>* Polylib::search_polygons(
 #endif
 			}
 		}
-#ifdef BENCHMARK
-		ret2 = getrusage_sec(&ut2,&st2,&tt2);
-		if (ret1 == false || ret2 == false) {
-			PL_DBGOSH << "Search SYS   Time Error" << std::endl;
-			PL_DBGOSH << "Search CPU   Time Error" << std::endl;
-			PL_DBGOSH << "Search Total Time Error" << std::endl;
-		}
-		else{
-			cout.setf(ios::scientific, ios::floatfield);
-			PL_DBGOSH << "Search SYS   Time:" << st2 - st1 << std::endl;
-			PL_DBGOSH << "Search CPU   Time:" << ut2 - ut1 << std::endl;
-			PL_DBGOSH << "Search Total Time:" << tt2 - tt1 << std::endl;
-			std::cout.unsetf(ios::scientific);
-		}
-#endif
 
 		delete pg_list2;
 		*ret = PLSTAT_OK;
 		return tri_list;
 }
 
+// protected //////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::leaf_groups(
+	const std::string&			group_name,
+	std::vector<PolygonGroup*>	*leaves
+	) const {
+
+		PolygonGroup* pg = get_group(group_name);
+		if (pg == 0) {
+			PL_ERROSH << "[ERROR]Polylib::leaf_groups():Group not found: "
+				<< group_name << std::endl;
+			return PLSTAT_GROUP_NOT_FOUND;
+		}
+		std::vector<PolygonGroup*> pg_list;
+		search_group(pg, &pg_list);
+		pg_list.push_back(pg);
+		for (size_t i = 0; i < pg_list.size(); i++) {
+			if (pg_list[i]->get_children().empty()) leaves->push_back(pg_list[i]);
+		}
+		return PLSTAT_OK;
+}
+
 // private ////////////////////////////////////////////////////////////////////
 
 void Polylib::search_group(
@@ -1513,4 +1945,27 @@ void Polylib::finalize_DVertex(std::string name){
 
 }
 
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT Polylib::init_DVertex_PolygonGroup(std::string name,
+	const PL_REAL* coords,
+	const int nvert,
+	const int* index,
+	const int ntri,
+	const int* idlist,
+	const int* exidlist,
+	const PL_REAL* scalarlist,
+	const PL_REAL* vectorlist,
+	const bool weld){
+
+		PolygonGroup* pg_instance = get_group(name);
+		if (pg_instance == NULL) {
+			PL_ERROSH << "[ERROR]Polylib::init_DVertex_PolygonGroup():Group not found: "
+				<< name << std::endl;
+			return PLSTAT_GROUP_NOT_FOUND;
+		}
+		return pg_instance->init_dvertex_indexed(coords,nvert,index,ntri,
+			idlist,exidlist,scalarlist,vectorlist,weld);
+}
+
 } //namespace PolylibNS
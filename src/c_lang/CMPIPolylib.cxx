@@ -216,7 +216,7 @@ POLYLIB_STAT mpipolylib_show_group_info(char* group_name)
 
 
 // used_memory_size
-unsigned int mpipolylib_used_memory_size()
+unsigned long long mpipolylib_used_memory_size()
 {
 	return (MPIPolylib::get_instance())->used_memory_size();
 }
@@ -143,7 +143,7 @@ polylib_show_group_info(char* group_name)
 }
 
 // used_memory_size
-unsigned int
+unsigned long long
 polylib_used_memory_size()
 {
 	return (Polylib::get_instance())->used_memory_size();
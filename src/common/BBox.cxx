@@ -118,14 +118,7 @@ AxisEnum BBox::getMaxAxis(PL_REAL& length) const {
 /// @return 含まれる場合はtrue。他はfalse。
 ///
 bool BBox::contain(const Vec3<PL_REAL>& pos) const {
-	if (min.x <= pos.x && pos.x <= max.x &&
-		min.y <= pos.y && pos.y <= max.y &&
-		min.z <= pos.z && pos.z <= max.z) {
-			return true;
-	}
-	else {
-		return false;
-	}
+	return containAs<PL_CALC_REAL>(pos);
 }
 
 ///
@@ -135,10 +128,7 @@ bool BBox::contain(const Vec3<PL_REAL>& pos) const {
 /// @return 交差する場合はtrue。他はfalse。
 ///
 bool BBox::crossed(const BBox& bbox) const {
-	if (max.x < bbox.min.x || bbox.max.x < min.x) return false;
-	if (max.y < bbox.min.y || bbox.max.y < min.y) return false;
-	if (max.z < bbox.min.z || bbox.max.z < min.z) return false;
-	return true;
+	return crossedAs<PL_CALC_REAL>(bbox);
 }
 
 ///
@@ -0,0 +1,176 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "file_io/CheckpointWriter.h"
+#include "file_io/TriMeshIO.h"
+#include "file_io/triangle_id.h"
+#include "polygons/TriMesh.h"
+
+namespace PolylibNS {
+
+//  複製から一時的なTriMeshを作り、ポリゴンファイルとIDファイルを保存する
+static POLYLIB_STAT write_piece( const CheckpointPiece* piece )
+{
+	const VtkMesh& m = piece->mesh;
+	int nvert = m.nvert();
+	int ntri = m.ntri();
+	const PL_REAL* coords = ( nvert > 0 ) ? &m.coords[0] : NULL;
+	const int* index = ( ntri > 0 ) ? &m.index[0] : NULL;
+	const int* ids = m.ids.empty() ? NULL : &m.ids[0];
+	const int* exids = m.exids.empty() ? NULL : &m.exids[0];
+
+	TriMesh tm;
+	POLYLIB_STAT ret;
+	if( m.nscalar > 0 || m.nvector > 0 ) {
+		tm.prepare_DVertex( m.nscalar, m.nvector );
+		ret = tm.init_dvertex_indexed( coords, nvert, index, ntri, ids, exids,
+			m.scalars.empty() ? NULL : &m.scalars[0],
+			m.vectors.empty() ? NULL : &m.vectors[0], false );
+	}
+	else {
+		ret = tm.init_indexed( coords, nvert, index, ntri, ids, exids );
+	}
+	if( ret != PLSTAT_OK ) return ret;
+
+	if( piece->format == TriMeshIO::FMT_VTU ) {
+		ret = vtu_save( tm.get_vtx_list(), tm.get_tri_list(), piece->fname,
+			m.nscalar, m.nvector );
+	}
+	else {
+		ret = TriMeshIO::save( tm.get_vtx_list(), tm.get_tri_list(),
+			piece->fname, piece->format );
+	}
+	if( ret != PLSTAT_OK ) return ret;
+
+	if( piece->id_fname != "" ) {
+		ret = save_id( tm.get_tri_list(), piece->id_fname, piece->id_format );
+	}
+	return ret;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+CheckpointWriter::CheckpointWriter()
+{
+	m_joinable = false;
+	m_done = 1;
+	m_stat = PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+CheckpointWriter::~CheckpointWriter()
+{
+	wait();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT CheckpointWriter::start(
+	std::vector<CheckpointPiece*>	&pieces
+	)
+{
+	// 前の保存の失敗はwrite_all()が出力済み
+	wait();
+
+	m_pieces.swap( pieces );
+	std::vector<CheckpointPiece*>().swap( pieces );
+	m_stat = PLSTAT_OK;
+	m_done = 0;
+	__sync_synchronize();
+
+	if( pthread_create( &m_thread, NULL, run, this ) != 0 ) {
+		// スレッドを作れない場合はその場で保存する
+		PL_ERROSH << "[ERROR]CheckpointWriter::start():pthread_create failed."
+			<< " saving synchronously." << std::endl;
+		m_stat = write_all();
+		clear_pieces();
+		m_done = 1;
+		return m_stat;
+	}
+	m_joinable = true;
+
+#ifdef DEBUG
+	PL_DBGOSH << "CheckpointWriter::start():" << m_pieces.size() << " pieces." << std::endl;
+#endif
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool CheckpointWriter::busy() const
+{
+	return __sync_fetch_and_add( const_cast<volatile int*>( &m_done ), 0 ) == 0;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT CheckpointWriter::wait()
+{
+	if( m_joinable ) {
+		pthread_join( m_thread, NULL );
+		m_joinable = false;
+		clear_pieces();
+	}
+	return m_stat;
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+void* CheckpointWriter::run( void* arg )
+{
+	CheckpointWriter* self = static_cast<CheckpointWriter*>( arg );
+#ifdef _OPENMP
+	// 計算側のスレッドと競合しないよう、保存は1スレッドで行う
+	omp_set_num_threads( 1 );
+#endif
+	self->m_stat = self->write_all();
+	// m_statの書き込みを先に見せてから終了を知らせる
+	__sync_synchronize();
+	__sync_lock_test_and_set( &self->m_done, 1 );
+	return NULL;
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT CheckpointWriter::write_all()
+{
+	POLYLIB_STAT ret = PLSTAT_OK;
+	for( size_t i=0; i<m_pieces.size(); i++ ) {
+		POLYLIB_STAT stat = write_piece( m_pieces[i] );
+		if( stat != PLSTAT_OK ) {
+			PL_ERROSH << "[ERROR]CheckpointWriter:" << m_pieces[i]->fname
+				<< " failed. returns:" << PolylibStat2::String(stat) << std::endl;
+			if( ret == PLSTAT_OK ) ret = stat;
+		}
+	}
+	return ret;
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+void CheckpointWriter::clear_pieces()
+{
+	for( size_t i=0; i<m_pieces.size(); i++ ) delete m_pieces[i];
+	std::vector<CheckpointPiece*>().swap( m_pieces );
+}
+
+} //namespace PolylibNS
@@ -35,6 +35,7 @@ const string TriMeshIO::FMT_OBJ_B  = "obj_b";
 const string TriMeshIO::FMT_OBJ_BB = "obj_bb";
 const string TriMeshIO::FMT_VTK_A  = "vtk_a";
 const string TriMeshIO::FMT_VTK_B  = "vtk_b";
+const string TriMeshIO::FMT_VTU    = "vtu";
 const string TriMeshIO::DEFAULT_FMT = TriMeshIO::FMT_STL_B;
 
 
@@ -47,7 +48,8 @@ string TriMeshIO::input_file_format(
 
 
 	//書式の決定
-	char	*ext = stl_get_ext(filename);
+	std::string	ext_str = stl_get_ext(filename);
+	const char	*ext = ext_str.c_str();
 	//#define DEBUG
 #ifdef DEBUG
 	PL_DBGOS << __func__ << " file " << filename <<" ext " << ext <<std::endl;
@@ -79,6 +81,14 @@ string TriMeshIO::input_file_format(
 		else	return FMT_OBJ_B;
 
 	}
+	else if (!strcmp(ext, "vtk") || !strcmp(ext, "VTK")) {
+		if(is_vtk_a(filename) == true)	  return FMT_VTK_A;
+		else	return FMT_VTK_B;
+	}
+	else if (!strcmp(ext, "vtu") || !strcmp(ext, "VTU") ||
+		!strcmp(ext, "vtp") || !strcmp(ext, "VTP")) {
+		return FMT_VTU;
+	}
 
 
 
@@ -139,6 +149,12 @@ POLYLIB_STAT TriMeshIO::load(
 			else if (fmt == FMT_OBJ_B || fmt == FMT_OBJ_BB) {
 				//PL_DBGOSH<< __func__<<" obj_b_load "<< fmt << std::endl;
 				ret = obj_b_load(vertex_list,tri_list, fname, &total, scale);
+			}
+			else if (fmt == FMT_VTK_A || fmt == FMT_VTK_B) {
+				ret = vtk_load(vertex_list,tri_list, fname, &total, scale);
+			}
+			else if (fmt == FMT_VTU) {
+				ret = vtu_load(vertex_list,tri_list, fname, &total, scale);
 			} else {
 				//PL_DBGOSH<< __func__<<" failed!!! "<< fmt << std::endl;
 				return PLSTAT_UNKNOWN_STL_FORMAT;
@@ -156,6 +172,31 @@ POLYLIB_STAT TriMeshIO::load(
 
 // public /////////////////////////////////////////////////////////////////////
 
+POLYLIB_STAT TriMeshIO::load_indexed(
+	const std::string	&fname,
+	const std::string	&fmt,
+	VtkMesh				*mesh,
+	PL_REAL				scale
+	) {
+		if (fmt == FMT_VTK_A || fmt == FMT_VTK_B) {
+			return vtk_read(fname, mesh, scale);
+		}
+		else if (fmt == FMT_VTU) {
+			return vtu_read(fname, mesh, scale);
+		}
+		return PLSTAT_UNKNOWN_STL_FORMAT;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool TriMeshIO::is_indexed_format(
+	const std::string &fmt
+	) {
+		return fmt == FMT_VTK_A || fmt == FMT_VTK_B || fmt == FMT_VTU;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
 POLYLIB_STAT TriMeshIO::save(
 	VertexList* vertex_list,
 	std::vector<PrivateTriangle*>	*tri_list,
@@ -197,6 +238,9 @@ POLYLIB_STAT TriMeshIO::save(
 		else if (fmt == FMT_VTK_B) {
 			return vtk_b_save(vertex_list,tri_list, fname);
 		}
+		else if (fmt == FMT_VTU) {
+			return vtu_save(vertex_list,tri_list, fname);
+		}
 		else{
 			return PLSTAT_UNKNOWN_STL_FORMAT;
 		}
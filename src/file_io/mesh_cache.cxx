@@ -0,0 +1,341 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "file_io/mesh_cache.h"
+
+namespace PolylibNS {
+
+/// キャッシュファイルの識別子
+static const char MESH_CACHE_MAGIC[8] = { 'P','L','M','C','A','C','H','E' };
+
+/// キャッシュファイルの版
+#define MESH_CACHE_VERSION	1
+
+/// 節の数と番号
+enum {
+	SEC_COORDS = 0,
+	SEC_INDEX,
+	SEC_IDS,
+	SEC_EXIDS,
+	SEC_NORMALS,
+	SEC_AREAS,
+	SEC_NODES,
+	SEC_ELEMS,
+	SEC_NUM
+};
+
+// キャッシュファイルの先頭。キーと各節が続く
+struct MeshCacheHeader {
+	char		magic[8];
+	int			version;
+	int			real_size;		// sizeof(PL_REAL)
+	int			node_size;		// sizeof(VTreeNodeImage)
+	int			key_size;
+	int			nvert;
+	int			ntri;
+	int			nnode;
+	int			nelem;
+	int			max_elements;
+	int			pad;
+	long long	file_size;
+	long long	off[SEC_NUM];
+	double		bbox[6];
+};
+
+// 8バイト境界に切り上げる
+static long long align8( long long n )
+{
+	return ( n + 7 ) & ~7LL;
+}
+
+// 各節のバイト数
+static void section_sizes( const MeshCacheView& v, long long size[SEC_NUM] )
+{
+	size[SEC_COORDS]	= (long long)v.nvert * 3 * sizeof(PL_REAL);
+	size[SEC_INDEX]		= (long long)v.ntri * 3 * sizeof(int);
+	size[SEC_IDS]		= (long long)v.ntri * sizeof(int);
+	size[SEC_EXIDS]		= (long long)v.ntri * sizeof(int);
+	size[SEC_NORMALS]	= (long long)v.ntri * 3 * sizeof(PL_REAL);
+	size[SEC_AREAS]		= (long long)v.ntri * sizeof(PL_REAL);
+	size[SEC_NODES]		= (long long)v.nnode * sizeof(VTreeNodeImage);
+	size[SEC_ELEMS]		= (long long)v.nelem * sizeof(int);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+MeshCacheView::MeshCacheView() :
+	nvert(0), ntri(0), nnode(0), nelem(0), max_elements(0),
+	coords(NULL), index(NULL), ids(NULL), exids(NULL),
+	normals(NULL), areas(NULL), nodes(NULL), elems(NULL)
+{
+	for( int i=0; i<6; i++ ) bbox[i] = 0.0;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT mesh_cache_write(
+	const std::string&		fname,
+	const std::string&		key,
+	const MeshCacheView&	view
+	)
+{
+	MeshCacheHeader h;
+	memset( &h, 0, sizeof(h) );
+	memcpy( h.magic, MESH_CACHE_MAGIC, sizeof(h.magic) );
+	h.version = MESH_CACHE_VERSION;
+	h.real_size = sizeof(PL_REAL);
+	h.node_size = sizeof(VTreeNodeImage);
+	h.key_size = key.size();
+	h.nvert = view.nvert;
+	h.ntri = view.ntri;
+	h.nnode = view.nnode;
+	h.nelem = view.nelem;
+	h.max_elements = view.max_elements;
+	for( int i=0; i<6; i++ ) h.bbox[i] = view.bbox[i];
+
+	long long size[SEC_NUM];
+	section_sizes( view, size );
+	long long pos = align8( sizeof(h) + key.size() );
+	for( int i=0; i<SEC_NUM; i++ ) {
+		h.off[i] = pos;
+		pos = align8( pos + size[i] );
+	}
+	h.file_size = pos;
+
+	const void* data[SEC_NUM] = { view.coords, view.index, view.ids, view.exids,
+		view.normals, view.areas, view.nodes, view.elems };
+
+	// 同じキャッシュを作る他のプロセスと衝突しないよう、別名で書いてから置き換える
+	char host[64] = "";
+	gethostname( host, sizeof(host) - 1 );
+	std::ostringstream tmp;
+	tmp << fname << ".tmp." << host << "." << getpid();
+	std::string tmpname = tmp.str();
+
+	std::ofstream ofs( tmpname.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+	if( !ofs ) {
+		PL_ERROSH << "[ERROR]mesh_cache_write():Can't open " << tmpname << std::endl;
+		return PLSTAT_NG;
+	}
+	static const char zeros[8] = { 0,0,0,0,0,0,0,0 };
+	ofs.write( (const char*)&h, sizeof(h) );
+	ofs.write( key.data(), key.size() );
+	long long cur = sizeof(h) + key.size();
+	for( int i=0; i<SEC_NUM; i++ ) {
+		ofs.write( zeros, h.off[i] - cur );
+		if( size[i] > 0 ) ofs.write( (const char*)data[i], size[i] );
+		cur = h.off[i] + size[i];
+	}
+	ofs.write( zeros, h.file_size - cur );
+	ofs.close();
+	if( ofs.fail() ) {
+		PL_ERROSH << "[ERROR]mesh_cache_write():Write failed " << tmpname << std::endl;
+		unlink( tmpname.c_str() );
+		return PLSTAT_NG;
+	}
+
+	if( rename( tmpname.c_str(), fname.c_str() ) != 0 ) {
+		PL_ERROSH << "[ERROR]mesh_cache_write():Can't rename to " << fname << std::endl;
+		unlink( tmpname.c_str() );
+		return PLSTAT_NG;
+	}
+#ifdef DEBUG
+	PL_DBGOSH << "mesh_cache_write():" << fname << " size=" << h.file_size << std::endl;
+#endif
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+std::string mesh_cache_name(
+	const std::string&		dir,
+	const std::string&		key
+	)
+{
+	// FNV-1a 64bit
+	unsigned long long hash = 14695981039346656037ULL;
+	for( size_t i=0; i<key.size(); i++ ) {
+		hash ^= (unsigned char)key[i];
+		hash *= 1099511628211ULL;
+	}
+	char buf[32];
+	sprintf( buf, "%016llx", hash );
+
+	std::string fname = dir;
+	if( !fname.empty() && fname[fname.size()-1] != '/' ) fname += "/";
+	return fname + "plcache_" + buf + ".plc";
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool mesh_cache_file_identity(
+	const std::string&		path,
+	std::string*			identity
+	)
+{
+	struct stat st;
+	if( stat( path.c_str(), &st ) != 0 ) return false;
+
+	std::ostringstream oss;
+	oss << path << " " << (long long)st.st_size << " " << (long long)st.st_mtime;
+	*identity = oss.str();
+	return true;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+MeshCacheFile::MeshCacheFile()
+{
+	m_addr = NULL;
+	m_size = 0;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+MeshCacheFile::~MeshCacheFile()
+{
+	close();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT MeshCacheFile::open(
+	const std::string&	fname,
+	const std::string&	key
+	)
+{
+	close();
+
+	int fd = ::open( fname.c_str(), O_RDONLY );
+	if( fd < 0 ) return PLSTAT_NG;
+
+	struct stat st;
+	if( fstat( fd, &st ) != 0 || (size_t)st.st_size < sizeof(MeshCacheHeader) ) {
+		::close( fd );
+		return PLSTAT_NG;
+	}
+	void* addr = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	::close( fd );
+	if( addr == MAP_FAILED ) return PLSTAT_NG;
+	m_addr = addr;
+	m_size = st.st_size;
+
+	// 先頭とキーの確認
+	const MeshCacheHeader* h = (const MeshCacheHeader*)m_addr;
+	const char* base = (const char*)m_addr;
+	if( memcmp( h->magic, MESH_CACHE_MAGIC, sizeof(h->magic) ) != 0 ||
+		h->version != MESH_CACHE_VERSION ||
+		h->real_size != (int)sizeof(PL_REAL) ||
+		h->node_size != (int)sizeof(VTreeNodeImage) ||
+		h->file_size != (long long)m_size ||
+		h->key_size != (int)key.size() ||
+		sizeof(MeshCacheHeader) + key.size() > m_size ||
+		key.compare( 0, key.size(), base + sizeof(MeshCacheHeader), h->key_size ) != 0 ) {
+			close();
+			return PLSTAT_NG;
+	}
+
+	m_view.nvert = h->nvert;
+	m_view.ntri = h->ntri;
+	m_view.nnode = h->nnode;
+	m_view.nelem = h->nelem;
+	m_view.max_elements = h->max_elements;
+	for( int i=0; i<6; i++ ) m_view.bbox[i] = h->bbox[i];
+
+	// 各節が領域内にあることを確認してから参照を作る
+	long long size[SEC_NUM];
+	if( h->nvert < 0 || h->ntri < 0 || h->nnode < 1 || h->nelem < 0 ) {
+		close();
+		return PLSTAT_NG;
+	}
+	section_sizes( m_view, size );
+	for( int i=0; i<SEC_NUM; i++ ) {
+		if( h->off[i] < 0 || h->off[i] % 8 != 0 || h->off[i] + size[i] > h->file_size ) {
+			close();
+			return PLSTAT_NG;
+		}
+	}
+	m_view.coords	= (const PL_REAL*)( base + h->off[SEC_COORDS] );
+	m_view.index	= (const int*)( base + h->off[SEC_INDEX] );
+	m_view.ids		= (const int*)( base + h->off[SEC_IDS] );
+	m_view.exids	= (const int*)( base + h->off[SEC_EXIDS] );
+	m_view.normals	= (const PL_REAL*)( base + h->off[SEC_NORMALS] );
+	m_view.areas	= (const PL_REAL*)( base + h->off[SEC_AREAS] );
+	m_view.nodes	= (const VTreeNodeImage*)( base + h->off[SEC_NODES] );
+	m_view.elems	= (const int*)( base + h->off[SEC_ELEMS] );
+
+	if( !validate() ) {
+		PL_ERROSH << "[ERROR]MeshCacheFile::open():broken cache file " << fname << std::endl;
+		close();
+		return PLSTAT_NG;
+	}
+#ifdef DEBUG
+	PL_DBGOSH << "MeshCacheFile::open():" << fname << " nvert=" << m_view.nvert
+		<< " ntri=" << m_view.ntri << " nnode=" << m_view.nnode << std::endl;
+#endif
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void MeshCacheFile::close()
+{
+	if( m_addr != NULL ) munmap( m_addr, m_size );
+	m_addr = NULL;
+	m_size = 0;
+	m_view = MeshCacheView();
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+bool MeshCacheFile::validate() const
+{
+	const MeshCacheView& v = m_view;
+	for( long long i=0; i<(long long)v.ntri*3; i++ ) {
+		if( v.index[i] < 0 || v.index[i] >= v.nvert ) return false;
+	}
+	for( int i=0; i<v.nelem; i++ ) {
+		if( v.elems[i] < 0 || v.elems[i] >= v.ntri ) return false;
+	}
+
+	// 根以外の各ノードがちょうど1度だけ、自分より後ろから参照されること
+	std::vector<char> used( v.nnode, 0 );
+	for( int i=0; i<v.nnode; i++ ) {
+		const VTreeNodeImage& n = v.nodes[i];
+		if( n.axis < 0 || n.axis > 2 ) return false;
+		if( n.elem_begin < 0 || n.elem_count < 0 ||
+			(long long)n.elem_begin + n.elem_count > v.nelem ) return false;
+		if( n.left < 0 && n.right < 0 ) continue;
+		if( n.left <= i || n.right <= i || n.left >= v.nnode || n.right >= v.nnode ||
+			n.left == n.right ) return false;
+		if( used[n.left]++ || used[n.right]++ ) return false;
+	}
+	return true;
+}
+
+} //namespace PolylibNS
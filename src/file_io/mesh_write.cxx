@@ -0,0 +1,409 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "file_io/mesh_write.h"
+#include "file_io/stl.h"
+
+namespace PolylibNS {
+
+/// write_records()の1ブロックのレコード数
+#define MESH_WRITE_BLOCK	8192
+
+/// 10の累乗(double で正確に表せる範囲)
+static const double s_pow10[23] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//  a*10^kを整数に丸める(偶数丸め)。|k|が22を超える場合false。
+static bool scaled_round( double a, int k, long long* m )
+{
+	if( k > 22 || k < -22 ) return false;
+	double x = ( k >= 0 ) ? a * s_pow10[k] : a / s_pow10[-k];
+	double r = std::floor( x );
+	double f = x - r;
+	if( f > 0.5 || ( f == 0.5 && std::fmod( r, 2.0 ) != 0.0 ) ) r += 1.0;
+	*m = (long long)r;
+	return true;
+}
+
+//  指数部("e+05"等、2桁以上)を書き込む
+static char* put_exponent( char* p, int e )
+{
+	*p++ = 'e';
+	if( e < 0 ) {
+		*p++ = '-';
+		e = -e;
+	}
+	else {
+		*p++ = '+';
+	}
+	if( e >= 100 ) *p++ = '0' + e / 100;
+	*p++ = '0' + ( e / 10 ) % 10;
+	*p++ = '0' + e % 10;
+	return p;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+char* format_real( char* p, double v )
+{
+#if SCIENTIFIC_OUT
+	const int prec = 7;		// "%e"の有効桁数(整数部1桁+小数部6桁)
+#else
+	const int prec = 6;		// "%g"の有効桁数
+#endif
+	const long long mmin = (long long)s_pow10[prec-1];
+	const long long mmax = (long long)s_pow10[prec];
+
+	double a = std::fabs( v );
+	long long m = 0;
+	int e = 0;
+	bool fast = ( a == a ) && ( a - a == 0.0 ) && a != 0.0;
+	if( fast ) {
+		// 有効桁数の整数mと10進指数eを求める。log10の誤差は丸め後に補正する
+		e = (int)std::floor( std::log10( a ) );
+		for( int n=0; n<3 && fast; n++ ) {
+			fast = scaled_round( a, prec - 1 - e, &m );
+			if( m >= mmax ) e++;
+			else if( m < mmin ) e--;
+			else break;
+		}
+		fast = fast && m >= mmin && m < mmax;
+	}
+	if( !fast ) {
+		// 0、非数、無限大、極端な指数はprintf()に任せる
+#if SCIENTIFIC_OUT
+		int n = snprintf( p, MESH_WRITE_REAL_LEN, "%.6e", v );
+#else
+		int n = snprintf( p, MESH_WRITE_REAL_LEN, "%g", v );
+#endif
+		return p + n;
+	}
+
+	char d[8];
+	for( int i=prec-1; i>=0; i-- ) {
+		d[i] = '0' + (char)( m % 10 );
+		m /= 10;
+	}
+	if( v < 0 ) *p++ = '-';
+
+#if SCIENTIFIC_OUT
+	*p++ = d[0];
+	*p++ = '.';
+	for( int i=1; i<prec; i++ ) *p++ = d[i];
+	return put_exponent( p, e );
+#else
+	// 末尾の0は出力しない
+	int nd = prec;
+	while( nd > 1 && d[nd-1] == '0' ) nd--;
+	if( e < -4 || e >= prec ) {
+		*p++ = d[0];
+		if( nd > 1 ) {
+			*p++ = '.';
+			for( int i=1; i<nd; i++ ) *p++ = d[i];
+		}
+		return put_exponent( p, e );
+	}
+	if( e < 0 ) {
+		*p++ = '0';
+		*p++ = '.';
+		for( int i=0; i<-e-1; i++ ) *p++ = '0';
+		for( int i=0; i<nd; i++ ) *p++ = d[i];
+		return p;
+	}
+	for( int i=0; i<=e; i++ ) *p++ = d[i];
+	if( nd > e + 1 ) {
+		*p++ = '.';
+		for( int i=e+1; i<nd; i++ ) *p++ = d[i];
+	}
+	return p;
+#endif
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+char* format_long( char* p, long v )
+{
+	char tmp[MESH_WRITE_LONG_LEN];
+	unsigned long u = ( v < 0 ) ? 0UL - (unsigned long)v : (unsigned long)v;
+	int n = 0;
+	do {
+		tmp[n++] = '0' + (char)( u % 10 );
+		u /= 10;
+	} while( u != 0 );
+	if( v < 0 ) *p++ = '-';
+	while( n > 0 ) *p++ = tmp[--n];
+	return p;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+char* put_bytes( char* p, const void* data, int size, int inv )
+{
+	memcpy( p, data, size );
+	if( inv ) tt_invert_byte_order( p, size, 1 );
+	return p + size;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool write_records(
+	std::ostream&			os,
+	const RecordFormatter&	f,
+	size_t					n
+	)
+{
+	int nthread = 1;
+#ifdef _OPENMP
+	nthread = omp_get_max_threads();
+#endif
+	// 1回にスレッド数の2倍のブロックを作成し、順に書き出す
+	size_t nbuf = std::min( (size_t)nthread * 2, ( n + MESH_WRITE_BLOCK - 1 ) / MESH_WRITE_BLOCK );
+	if( nbuf == 0 ) return !os.fail();
+	size_t maxlen = f.max_length();
+	std::vector< std::vector<char> > bufs( nbuf );
+	std::vector<size_t> lens( nbuf );
+	for( size_t b=0; b<nbuf; b++ ) bufs[b].resize( MESH_WRITE_BLOCK * maxlen );
+
+	for( size_t head=0; head<n; head += nbuf * MESH_WRITE_BLOCK ) {
+		int nb = (int)std::min( nbuf, ( n - head + MESH_WRITE_BLOCK - 1 ) / MESH_WRITE_BLOCK );
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1)
+#endif
+		for( int b=0; b<nb; b++ ) {
+			size_t s = head + (size_t)b * MESH_WRITE_BLOCK;
+			size_t e = std::min( n, s + MESH_WRITE_BLOCK );
+			char* top = &bufs[b][0];
+			char* p = top;
+			for( size_t i=s; i<e; i++ ) p = f.format( i, p );
+			lens[b] = p - top;
+		}
+		for( int b=0; b<nb; b++ ) os.write( &bufs[b][0], lens[b] );
+		if( os.fail() ) return false;
+	}
+	return true;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT mesh_vertex_index(
+	VertexList*							vertex_list,
+	const std::vector<PrivateTriangle*>	*tri_list,
+	std::vector<int>					*tri_vidx
+	)
+{
+	// Vertex*の昇順に並べた(Vertex*,番号)の表を二分探索する
+	const std::vector<Vertex*>* vlist = vertex_list->get_vertex_lists();
+	int nvtx = vlist->size();
+	std::vector< std::pair<Vertex*,int> > table( nvtx );
+	for( int i=0; i<nvtx; i++ ) table[i] = std::make_pair( (*vlist)[i], i );
+	std::sort( table.begin(), table.end() );
+
+	int ntri = tri_list->size();
+	tri_vidx->resize( (size_t)ntri * 3 );
+	int nmiss = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:nmiss)
+#endif
+	for( int t=0; t<ntri; t++ ) {
+		Vertex** vtx = (*tri_list)[t]->get_vertex();
+		for( int j=0; j<3; j++ ) {
+			std::vector< std::pair<Vertex*,int> >::const_iterator it = std::lower_bound(
+				table.begin(), table.end(), std::make_pair( vtx[j], -1 ) );
+			if( it != table.end() && it->first == vtx[j] ) {
+				(*tri_vidx)[ (size_t)t*3+j ] = it->second;
+			}
+			else {
+				(*tri_vidx)[ (size_t)t*3+j ] = -1;
+				nmiss++;
+			}
+		}
+	}
+	if( nmiss != 0 ) {
+		PL_ERROSH << "[ERROR]mesh_write:mesh_vertex_index():" << nmiss
+			<< " vertices are not in the vertex list." << std::endl;
+		return PLSTAT_NG;
+	}
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void mesh_vertex_normals(
+	size_t								nvtx,
+	const std::vector<PrivateTriangle*>	*tri_list,
+	const std::vector<int>				&tri_vidx,
+	std::vector<PL_REAL>				*normals
+	)
+{
+	normals->assign( nvtx * 3, 0 );
+	PL_REAL* nml = normals->empty() ? NULL : &(*normals)[0];
+
+	// 頂点毎に面法線の合計(三角形の順に加算)
+	size_t ntri = tri_list->size();
+	for( size_t t=0; t<ntri; t++ ) {
+		Vec3<PL_REAL> n = (*tri_list)[t]->get_normal();
+		for( int j=0; j<3; j++ ) {
+			PL_REAL* q = nml + (size_t)tri_vidx[t*3+j] * 3;
+			q[0] += n[0];
+			q[1] += n[1];
+			q[2] += n[2];
+		}
+	}
+
+	long nv = nvtx;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for( long i=0; i<nv; i++ ) {
+		Vec3<PL_REAL> n( nml[i*3], nml[i*3+1], nml[i*3+2] );
+		n.normalize();
+		nml[i*3]   = n[0];
+		nml[i*3+1] = n[1];
+		nml[i*3+2] = n[2];
+	}
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+TextCoordFormatter::TextCoordFormatter(
+	const char*					prefix,
+	const std::vector<Vertex*>*	vlist
+	) : m_prefix(prefix), m_prefix_len(strlen(prefix)), m_vlist(vlist)
+{
+}
+
+size_t TextCoordFormatter::max_length() const
+{
+	return m_prefix_len + 3 * ( MESH_WRITE_REAL_LEN + 1 );
+}
+
+char* TextCoordFormatter::format( size_t i, char* p ) const
+{
+	const Vertex& v = *(*m_vlist)[i];
+	memcpy( p, m_prefix, m_prefix_len );
+	p += m_prefix_len;
+	p = format_real( p, v[0] );
+	*p++ = ' ';
+	p = format_real( p, v[1] );
+	*p++ = ' ';
+	p = format_real( p, v[2] );
+	*p++ = '\n';
+	return p;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+TextArrayFormatter::TextArrayFormatter(
+	const char*		prefix,
+	const PL_REAL*	data,
+	int				ncomp
+	) : m_prefix(prefix), m_prefix_len(strlen(prefix)), m_data(data), m_ncomp(ncomp)
+{
+}
+
+size_t TextArrayFormatter::max_length() const
+{
+	return m_prefix_len + m_ncomp * ( MESH_WRITE_REAL_LEN + 1 );
+}
+
+char* TextArrayFormatter::format( size_t i, char* p ) const
+{
+	const PL_REAL* d = m_data + i * m_ncomp;
+	memcpy( p, m_prefix, m_prefix_len );
+	p += m_prefix_len;
+	for( int j=0; j<m_ncomp; j++ ) {
+		if( j > 0 ) *p++ = ' ';
+		p = format_real( p, d[j] );
+	}
+	*p++ = '\n';
+	return p;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+BinaryCoordFormatter::BinaryCoordFormatter(
+	const std::vector<Vertex*>*	vlist,
+	bool						as_float,
+	int							inv
+	) : m_vlist(vlist), m_as_float(as_float), m_inv(inv)
+{
+}
+
+size_t BinaryCoordFormatter::max_length() const
+{
+	return 3 * ( m_as_float ? sizeof(float) : sizeof(PL_REAL) );
+}
+
+char* BinaryCoordFormatter::format( size_t i, char* p ) const
+{
+	const Vertex& v = *(*m_vlist)[i];
+	for( int j=0; j<3; j++ ) {
+		if( m_as_float ) {
+			float f = v[j];
+			p = put_bytes( p, &f, sizeof(float), m_inv );
+		}
+		else {
+			PL_REAL r = v[j];
+			p = put_bytes( p, &r, sizeof(PL_REAL), m_inv );
+		}
+	}
+	return p;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+BinaryArrayFormatter::BinaryArrayFormatter(
+	const PL_REAL*	data,
+	int				ncomp,
+	bool			as_float,
+	int				inv
+	) : m_data(data), m_ncomp(ncomp), m_as_float(as_float), m_inv(inv)
+{
+}
+
+size_t BinaryArrayFormatter::max_length() const
+{
+	return m_ncomp * ( m_as_float ? sizeof(float) : sizeof(PL_REAL) );
+}
+
+char* BinaryArrayFormatter::format( size_t i, char* p ) const
+{
+	const PL_REAL* d = m_data + i * m_ncomp;
+	for( int j=0; j<m_ncomp; j++ ) {
+		if( m_as_float ) {
+			float f = d[j];
+			p = put_bytes( p, &f, sizeof(float), m_inv );
+		}
+		else {
+			p = put_bytes( p, &d[j], sizeof(PL_REAL), m_inv );
+		}
+	}
+	return p;
+}
+
+} //namespace PolylibNS
@@ -36,6 +36,7 @@
 #include "file_io/TriMeshIO.h"
 #include "file_io/obj.h"
 #include "file_io/stl.h"
+#include "file_io/mesh_write.h"
 
 
 namespace PolylibNS {
@@ -78,7 +79,7 @@ POLYLIB_STAT obj_a_load(VertexList* vertex_list,
 	std::vector<PrivateTriangle*>*tri_list,
 	std::string	fname,
 	int	*total,
-	PL_REAL scale )
+	PL_REAL /*scale*/ )
 {
 	// PL_DBGOSH << "fname " <<fname<<std::endl;
 	std::ifstream is(fname.c_str());
@@ -223,6 +224,55 @@ POLYLIB_STAT obj_a_load(VertexList* vertex_list,
 
 
 
+//  OBJアスキーの面の行 "f i//i j//j k//k\n"(番号は1から)
+class ObjFaceFormatter : public RecordFormatter {
+public:
+	ObjFaceFormatter( const std::vector<int>& vidx ) : m_vidx(vidx) {}
+	size_t max_length() const {
+		return 2 + 3 * ( 2 * MESH_WRITE_LONG_LEN + 3 );
+	}
+	char* format( size_t i, char* p ) const {
+		*p++ = 'f';
+		for( int j=0; j<3; j++ ) {
+			long k = m_vidx[i*3+j] + 1;
+			*p++ = ' ';
+			p = format_long( p, k );
+			*p++ = '/';
+			*p++ = '/';
+			p = format_long( p, k );
+		}
+		*p++ = '\n';
+		return p;
+	}
+private:
+	const std::vector<int>& m_vidx;
+};
+
+//  OBJバイナリの面のレコード(long×3(番号は1から)+ushort exid)
+class ObjBinaryFaceFormatter : public RecordFormatter {
+public:
+	ObjBinaryFaceFormatter(
+		const std::vector<PrivateTriangle*>*	tri_list,
+		const std::vector<int>&					vidx,
+		int										inv
+		) : m_tri_list(tri_list), m_vidx(vidx), m_inv(inv) {}
+	size_t max_length() const {
+		return 3 * sizeof(long) + sizeof(ushort);
+	}
+	char* format( size_t i, char* p ) const {
+		for( int j=0; j<3; j++ ) {
+			long k = m_vidx[i*3+j] + 1;
+			p = put_bytes( p, &k, sizeof(long), m_inv );
+		}
+		ushort exid = (ushort)(*m_tri_list)[i]->get_exid();
+		return put_bytes( p, &exid, sizeof(ushort), m_inv );
+	}
+private:
+	const std::vector<PrivateTriangle*>*	m_tri_list;
+	const std::vector<int>&					m_vidx;
+	int										m_inv;
+};
+
 /////////////////////////////////////////////////////
 
 POLYLIB_STAT obj_a_save(
@@ -237,75 +287,32 @@ POLYLIB_STAT obj_a_save(
 			return PLSTAT_OBJ_IO_ERROR;
 		}
 
-		// 頂点 v 出力
-		const std::vector<Vertex*>* vlistout=vertex_list->get_vertex_lists();
-		for(int i=0;i<vlistout->size();++i){
-#if SCIENTIFIC_OUT
-			os << "v " << std::setprecision(6)<< scientific <<*((*vlistout)[i])<<std::endl;
-#else
-			os << "v " << std::setprecision(6) <<*((*vlistout)[i])<<std::endl;
-#endif
-		}
-
-		// 法線　vn 出力
-		std::map<Vertex*,Vec3<PL_REAL> > vnmap;
-		std::map<Vertex*,Vec3<PL_REAL> >::iterator vnmap_iter;
-		std::vector<PrivateTriangle*>::iterator itr;
-
-		for (itr = tri_list->begin(); itr != tri_list->end(); itr++) {
-			Vertex** tmpvtx=(*itr)->get_vertex();
-			Vec3<PL_REAL> normal=(*itr)->get_normal();
-			for(int i=0;i<3;++i){
-				// Vertex*  をkeyにして法線ベクトル（計算途中）を探し、無ければ加える。
-				vnmap_iter=vnmap.find(tmpvtx[i]);
-				if(vnmap_iter==vnmap.end()) {
-					Vec3<PL_REAL> newnormal(0,0,0);
-					vnmap[tmpvtx[i]]=newnormal;
-				}
-				// 頂点ごとに面法線の合計
-				vnmap[tmpvtx[i]]+=normal;
-			}
+		std::vector<int> vidx;
+		if (mesh_vertex_index(vertex_list, tri_list, &vidx) != PLSTAT_OK) {
+			PL_ERROSH << "[ERROR]obj:obj_a_save():wrong vertex id " << fname << std::endl;
+			return PLSTAT_OBJ_IO_ERROR;
 		}
+		const std::vector<Vertex*>* vlistout=vertex_list->get_vertex_lists();
+		size_t nvtx = vlistout->size();
 
-		for(vnmap_iter=vnmap.begin();
-			vnmap_iter!=vnmap.end();
-			vnmap_iter++){
-
-				Vec3<PL_REAL> out = (vnmap_iter->second).normalize();
+		// 頂点 v 出力
+		bool ok = write_records(os, TextCoordFormatter("v ", vlistout), nvtx);
 
-#if SCIENTIFIC_OUT
-				os << "vn " << std::setprecision(6)<< scientific << out <<std::endl;
-#else
-				os << "vn " << std::setprecision(6) << out <<std::endl;
-#endif
+		// 法線　vn 出力。頂点と同じ順に、頂点ごとの面法線の合計を正規化して出力する。
+		std::vector<PL_REAL> vnml;
+		mesh_vertex_normals(nvtx, tri_list, vidx, &vnml);
+		if (ok && nvtx > 0) {
+			ok = write_records(os, TextArrayFormatter("vn ", &vnml[0], 3), nvtx);
 		}
 
 		// 面 f 出力 すべての面を持っていない頂点（境界付近）は、
 		// 頂点法線が正しくない可能性があるので注意すること.
+		if (ok) ok = write_records(os, ObjFaceFormatter(vidx), tri_list->size());
 
-		for (itr = tri_list->begin(); itr != tri_list->end(); itr++) {
-			Vertex** tmpvtx=(*itr)->get_vertex();
-			int i0,i1,i2;
-			/* i0=vertex_list->ith(tmpvtx[0]); */
-			/* i1=vertex_list->ith(tmpvtx[1]); */
-			/* i2=vertex_list->ith(tmpvtx[2]); */
-			i0=vertex_list->vtx_index(tmpvtx[0]);
-			i1=vertex_list->vtx_index(tmpvtx[1]);
-			i2=vertex_list->vtx_index(tmpvtx[2]);
-
-
-			if(i0==-1 || i1==-1 || i2==-1) {
-				PL_ERROSH << "[ERROR]obj:obj_a_save():wrong vertex id "
-					<< i0 << " "<< i1 << " "<< i2 << " "<< std::endl;
-			}
-			os << "f "
-				<< (i0+1)<<"//"<< (i0+1) << " "
-				<< (i1+1)<<"//"<< (i1+1) << " "
-				<< (i2+1)<<"//"<< (i2+1) << std::endl;
+		if (!ok) {
+			PL_ERROSH << "[ERROR]obj:obj_a_save():Error in saving: " << fname << std::endl;
+			return PLSTAT_OBJ_IO_ERROR;
 		}
-
-		vertex_list->index_map_clear();
-
 		return PLSTAT_OK;
 }
 ///////////////////////////////////////////////////////////////
@@ -321,127 +328,35 @@ POLYLIB_STAT obj_b_save(
 			return PLSTAT_STL_IO_ERROR;
 		}
 		int inv = tt_check_machine_endian() == TT_LITTLE_ENDIAN ? 0 : 1;
-#ifdef DEBUG
-#undef DEBUG
-#endif
-		//#define DEBUG
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " in. "<<fname <<std::endl;
-#endif
+
+		std::vector<int> vidx;
+		if (mesh_vertex_index(vertex_list, tri_list, &vidx) != PLSTAT_OK) {
+			PL_ERROSH << "[ERROR]obj:obj_b_save():wrong vertex id " << fname << std::endl;
+			return PLSTAT_OBJ_IO_ERROR;
+		}
 
 		char buf[STL_HEAD];
 		for (int i = 0; i < STL_HEAD; i++) buf[i] = 0;
 		strcpy(buf, "OBJ_BIN TRIA COND_ID");
 		tt_write(ofs, buf, 1, STL_HEAD, inv);
 
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " write header"<< buf <<std::endl;
-#endif
-
-
 		ulong element_vertex = vertex_list->size();
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " write vertex size " << element_vertex<<std::endl;
-#endif
-
 		tt_write(ofs, &element_vertex, sizeof(ulong), 1, inv);
-
-
 		ulong element = tri_list->size();
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " write triangle size " << element<<std::endl;
-#endif
-
 		tt_write(ofs, &element, sizeof(ulong), 1, inv);
 
-
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " header:"<< buf <<std::endl;
-		PL_DBGOSH << __func__ << " element_vertex:"<< element_vertex <<std::endl;
-		PL_DBGOSH << __func__ << " element:"<< element <<std::endl;
-#endif
-
 		// 頂点 v 出力
 		const std::vector<Vertex*>* vlistout=vertex_list->get_vertex_lists();
-		for(int i=0;i< vlistout->size();++i){
-			Vertex*  vert_tmp=(*vlistout)[i];
-			float float_vertex[3];
-			float_vertex[0]=(*vert_tmp)[0];
-			float_vertex[1]=(*vert_tmp)[1];
-			float_vertex[2]=(*vert_tmp)[2];
-			tt_write(ofs, float_vertex, sizeof(float), 3, inv);
-#ifdef DEBUG
-			/* PL_DBGOSH << __func__ << " write vertecies " */
-			/* 	    <<float_vertex[0] << " " */
-			/* 	    <<float_vertex[1] << " " */
-			/* 	    <<float_vertex[2] << " " */
-			/* 	    <<std::endl; */
-#endif
-
+		bool ok = write_records(ofs, BinaryCoordFormatter(vlistout, true, inv), element_vertex);
 
-		}
-
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " write vertecies "<<std::endl;
-#endif
-
-		vertex_list->prepare_num_out();
 		// 面 f 出力
-		std::vector<PrivateTriangle*>::iterator itr;
-		for (itr = tri_list->begin(); itr != tri_list->end(); itr++) {
-			Vertex** tmpvtx=(*itr)->get_vertex();
-			long index[3];
-			// index[0]=vertex_list->ith(tmpvtx[0]);
-			// index[1]=vertex_list->ith(tmpvtx[1]);
-			// index[2]=vertex_list->ith(tmpvtx[2]);
-
-			index[0]=vertex_list->vtx_index(tmpvtx[0]);
-			index[1]=vertex_list->vtx_index(tmpvtx[1]);
-			index[2]=vertex_list->vtx_index(tmpvtx[2]);
-
-#ifdef DEBUG
-			// PL_DBGOSH<< __func__ <<" "<<index[0]
-			// 	      <<" "<<index[1]
-			// 	      <<" "<<index[2]
-			// 	      <<std::endl;
-#endif
-
-
-			if(index[0]==-1 || index[1]==-1 || index[2]==-1) {
-				PL_ERROSH << "[ERROR]obj:obj_b_save():wrong vertex id "
-					<< index[0] << " "<< index[1] << " "<< index[2] << " "<< std::endl;
-			}
-			// index starts from 1
-			++index[0]; ++index[1]; ++index[2];
-			tt_write(ofs, index , sizeof(long), 3, inv);
-
-			/* PL_DBGOSH << __func__ << " write face " */
-			/* 	    <<index[0] << " " */
-			/* 	    <<index[1] << " " */
-			/* 	    <<index[2] << " " */
-			/* 	    <<std::endl; */
-
-
-			int exid = (*itr)->get_exid();
-			tt_write(ofs, &exid, sizeof(ushort), 1, inv);
-
-		}
-
-		vertex_list->index_map_clear();
+		if (ok) ok = write_records(ofs, ObjBinaryFaceFormatter(tri_list, vidx, inv), element);
 
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " write faces and exid "<<std::endl;
-#endif
-
-
-		if (!ofs.eof() && ofs.fail()) {
+		if (!ok) {
 			PL_ERROSH << "[ERROR]obj:obj_b_save():Error in saving: " << fname << std::endl;
 			return PLSTAT_OBJ_IO_ERROR;
 		}
-
 		return PLSTAT_OK;
-
-		///#undef DEBUG
 }
 
 ///////////////////////////////////////////////////////////////
@@ -458,98 +373,41 @@ POLYLIB_STAT obj_bb_save(
 		}
 		int inv = tt_check_machine_endian() == TT_LITTLE_ENDIAN ? 0 : 1;
 
+		std::vector<int> vidx;
+		if (mesh_vertex_index(vertex_list, tri_list, &vidx) != PLSTAT_OK) {
+			PL_ERROSH << "[ERROR]obj:obj_bb_save():wrong vertex id " << fname << std::endl;
+			return PLSTAT_OBJ_IO_ERROR;
+		}
+
 		char buf[STL_HEAD];
 		for (int i = 0; i < STL_HEAD; i++) buf[i] = 0;
 		strcpy(buf, "OBJ_BIN TRIA V_NORMAL COND_ID");
 		tt_write(ofs, buf, 1, STL_HEAD, inv);
 
-		//uint element_vertex = vertex_list->size();
-		//tt_write(ofs, &element_vertex, sizeof(uint), 1, inv);
 		long element_vertex = vertex_list->size();
 		tt_write(ofs, &element_vertex, sizeof(long), 1, inv);
-		//  uint element = tri_list->size();
-		//tt_write(ofs, &element, sizeof(uint), 1, inv);
 		long element = tri_list->size();
 		tt_write(ofs, &element, sizeof(long), 1, inv);
 
 		// 頂点 v 出力
 		const std::vector<Vertex*>* vlistout=vertex_list->get_vertex_lists();
-		for(int i=0;i<vlistout->size();++i){
-			Vertex*  vert_tmp=(*vlistout)[i];
-			float float_vertex[3];
-			float_vertex[0]=(*vert_tmp)[0];
-			float_vertex[1]=(*vert_tmp)[1];
-			float_vertex[2]=(*vert_tmp)[2];
-			tt_write(ofs, float_vertex, sizeof(float), 3, inv);
-		}
-
-
-		// 法線　vn 出力
-		std::map<Vertex*,Vec3<PL_REAL> > vnmap;
-		std::map<Vertex*,Vec3<PL_REAL> >::iterator vnmap_iter;
-		std::vector<PrivateTriangle*>::iterator itr;
-
-		for (itr = tri_list->begin(); itr != tri_list->end(); itr++) {
-			Vertex** tmpvtx=(*itr)->get_vertex();
-			Vec3<PL_REAL> normal=(*itr)->get_normal();
-			for(int i=0;i<3;++i){
-				// Vertex*  をkeyにして法線ベクトル（計算途中）を探し、無ければ加える。
-				vnmap_iter=vnmap.find(tmpvtx[i]);
-				if(vnmap_iter==vnmap.end()) {
-					Vec3<PL_REAL> newnormal(0,0,0);
-					vnmap[tmpvtx[i]]=newnormal;
-				}
-				// 頂点ごとに面法線の合計
-				vnmap[tmpvtx[i]]+=normal;
-			}
-		}
-
-		for(vnmap_iter=vnmap.begin();
-			vnmap_iter!=vnmap.end();
-			vnmap_iter++){
-
-				Vec3<PL_REAL> out = (vnmap_iter->second).normalize();
-				float tmp[3];
-				tmp[0]=out[0];
-				tmp[1]=out[1];
-				tmp[2]=out[2];
-
-				tt_write(ofs, tmp, sizeof(float), 3, inv);
+		bool ok = write_records(ofs, BinaryCoordFormatter(vlistout, true, inv), element_vertex);
 
+		// 法線　vn 出力。頂点と同じ順・同じ個数
+		std::vector<PL_REAL> vnml;
+		mesh_vertex_normals(element_vertex, tri_list, vidx, &vnml);
+		if (ok && element_vertex > 0) {
+			ok = write_records(ofs, BinaryArrayFormatter(&vnml[0], 3, true, inv), element_vertex);
 		}
 
 		// 面 f 出力
-		//  std::vector<PrivateTriangle*>::iterator itr;
-		for (itr = tri_list->begin(); itr != tri_list->end(); itr++) {
-			Vertex** tmpvtx=(*itr)->get_vertex();
-			long index[3];
-			// index[0]=vertex_list->ith(tmpvtx[0]);
-			// index[1]=vertex_list->ith(tmpvtx[1]);
-			// index[2]=vertex_list->ith(tmpvtx[2]);
-			index[0]=vertex_list->vtx_index(tmpvtx[0]);
-			index[1]=vertex_list->vtx_index(tmpvtx[1]);
-			index[2]=vertex_list->vtx_index(tmpvtx[2]);
-
-			if(index[0]==-1 || index[1]==-1 || index[2]==-1) {
-				PL_ERROSH << "[ERROR]obj:obj_bb_save():wrong vertex id "
-					<< index[0] << " "<< index[1] << " "<< index[2] << " "<< std::endl;
-			}
-			// index starts from 1
-			++index[0]; ++index[1]; ++index[2];
-			tt_write(ofs, index , sizeof(long), 3, inv);
+		if (ok) ok = write_records(ofs, ObjBinaryFaceFormatter(tri_list, vidx, inv), element);
 
-			int exid = (*itr)->get_exid();
-			tt_write(ofs, &exid, sizeof(ushort), 1, inv);
-
-		}
-		// cleanup index table
-		vertex_list->index_map_clear();
-		if (!ofs.eof() && ofs.fail()) {
+		if (!ok) {
 			PL_ERROSH << "[ERROR]obj:obj_bb_save():Error in saving: " << fname << std::endl;
 			return PLSTAT_OBJ_IO_ERROR;
 		}
 		return PLSTAT_OK;
-		//#undef DEBUG
 }
 
 
@@ -564,7 +422,7 @@ POLYLIB_STAT obj_b_load(
 	std::vector<PrivateTriangle*> *tri_list,
 	std::string fname,
 	int	*total,
-	PL_REAL	scale
+	PL_REAL	/*scale*/
 	) {
 		std::ifstream ifs(fname.c_str(), std::ios::in | std::ios::binary);
 		if (ifs.fail()) {
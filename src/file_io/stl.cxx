@@ -17,6 +17,7 @@
 
 
 #include "file_io/stl.h"
+#include "file_io/mesh_write.h"
 #include <string>
 #include <fstream>
 #include <iostream>
@@ -52,23 +53,17 @@ bool is_stl_a(std::string path)
 }
 
 //////////////////////////////////////////////////////////////////////////////
-char *stl_get_fname(const std::string path) {
-	static char	fname[256];
-
-	int pos = path.find_last_of("."); // 拡張子の手前までの位置
-	memset(fname, 0, sizeof(fname));
-	path.copy(fname, pos, 0);
-	return fname;
+std::string stl_get_fname(const std::string path) {
+	std::string::size_type pos = path.find_last_of("."); // 拡張子の手前までの位置
+	if (pos == std::string::npos) return path;
+	return path.substr(0, pos);
 }
 
 //////////////////////////////////////////////////////////////////////////////
-char *stl_get_ext(const std::string path) {
-	static char ext[16];
-
-	int pos = path.find_last_of("."); // 拡張子の手前までの位置
-	memset(ext, 0, sizeof(ext));
-	path.copy(ext, path.length() - pos, pos + 1);
-	return ext;
+std::string stl_get_ext(const std::string path) {
+	std::string::size_type pos = path.find_last_of("."); // 拡張子の手前までの位置
+	if (pos == std::string::npos) return path;
+	return path.substr(pos + 1);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -234,6 +229,76 @@ POLYLIB_STAT stl_a_load(
 // new code
 //////////////////////////////////////////////////////////////////////////////
 
+//  STLアスキーの1三角形分のfacet
+class StlFacetFormatter : public RecordFormatter {
+public:
+	StlFacetFormatter( const std::vector<PrivateTriangle*>* tri_list )
+		: m_tri_list(tri_list) {}
+	size_t max_length() const {
+		return 80 + 4 * ( 3 * ( MESH_WRITE_REAL_LEN + 1 ) + 16 );
+	}
+	char* format( size_t i, char* p ) const {
+		const PrivateTriangle* t = (*m_tri_list)[i];
+		p = put_str( p, "  facet normal " );
+		p = put_vec3( p, t->get_normal() );
+		p = put_str( p, "\touter loop\n" );
+		Vertex** vtx = t->get_vertex();
+		for (int j = 0; j < 3; j++) {
+			p = put_str( p, "\t  vertex " );
+			p = put_vec3( p, *vtx[j] );
+		}
+		return put_str( p, "\tendloop\n  endfacet\n" );
+	}
+private:
+	static char* put_str( char* p, const char* s ) {
+		while (*s) *p++ = *s++;
+		return p;
+	}
+	static char* put_vec3( char* p, const Vec3<PL_REAL>& v ) {
+		p = format_real( p, v[0] );
+		*p++ = ' ';
+		p = format_real( p, v[1] );
+		*p++ = ' ';
+		p = format_real( p, v[2] );
+		*p++ = '\n';
+		return p;
+	}
+	const std::vector<PrivateTriangle*>* m_tri_list;
+};
+
+//  STLバイナリの1三角形分のレコード(float×12+ushort exid)
+class StlBinaryFacetFormatter : public RecordFormatter {
+public:
+	StlBinaryFacetFormatter( const std::vector<PrivateTriangle*>* tri_list, int inv )
+		: m_tri_list(tri_list), m_inv(inv) {}
+	size_t max_length() const {
+		return 12 * sizeof(float) + sizeof(ushort);
+	}
+	char* format( size_t i, char* p ) const {
+		const PrivateTriangle* t = (*m_tri_list)[i];
+		// one plane normal
+		Vec3<PL_REAL> normal = t->get_normal();
+		for (int k = 0; k < 3; k++) {
+			float f = normal[k];
+			p = put_bytes( p, &f, sizeof(float), m_inv );
+		}
+		// three vertices
+		Vertex** vtx = t->get_vertex();
+		for (int j = 0; j < 3; j++) {
+			for (int k = 0; k < 3; k++) {
+				float f = (*vtx[j])[k];
+				p = put_bytes( p, &f, sizeof(float), m_inv );
+			}
+		}
+		// ２バイト予備領域にユーザ定義IDを記録(Polylib-2.1より)
+		ushort exid = (ushort)t->get_exid();
+		return put_bytes( p, &exid, sizeof(ushort), m_inv );
+	}
+private:
+	const std::vector<PrivateTriangle*>*	m_tri_list;
+	int										m_inv;
+};
+
 POLYLIB_STAT stl_a_save(
 	std::vector<PrivateTriangle*> *tri_list,
 	std::string fname
@@ -246,29 +311,7 @@ POLYLIB_STAT stl_a_save(
 		}
 
 		os << "solid " << "model1" << std::endl;
-
-		std::vector<PrivateTriangle*>::iterator itr;
-		for (itr = tri_list->begin(); itr != tri_list->end(); itr++) {
-#if SCIENTIFIC_OUT
-			os	<< "  facet " << "normal " << std::setprecision(6) << scientific
-				<< (*itr)->get_normal() << std::endl;
-#else
-			os	<< "  facet " << "normal " << std::setprecision(6)
-				<< (*itr)->get_normal() << std::endl;
-#endif
-			os << "	outer " << "loop" << std::endl;
-			for (int j = 0; j < 3; j++) {
-#if SCIENTIFIC_OUT
-				os	<< "	  vertex " << std::setprecision(6) << scientific
-					<< *(((*itr)->get_vertex())[j]) << std::endl;
-#else
-				os	<< "	  vertex " << std::setprecision(6)
-					<< *(((*itr)->get_vertex())[j]) << std::endl;
-#endif
-			}
-			os << "	endloop" << std::endl;
-			os << "  endfacet" << std::endl;
-		}
+		write_records(os, StlFacetFormatter(tri_list), tri_list->size());
 		os << "endsolid " << "model1" << std::endl;
 
 		if (!os.eof() && os.fail()) {
@@ -418,59 +461,8 @@ POLYLIB_STAT stl_b_save(
 		tt_write(ofs, buf, 1, STL_HEAD, inv);
 		tt_write(ofs, &element, sizeof(uint), 1, inv);
 
-		std::vector<PrivateTriangle*>::iterator itr = tri_list->begin();
-		for (uint m = 0; m < element; m++,itr++) {
-			// one plane normal
-			//    tt_write(ofs, (*itr)->get_normal().ptr(), sizeof(PL_REAL), 3, inv);
-			Vec3<PL_REAL> normal=(*itr)->get_normal();
-			float float_normal[3];
-			float_normal[0]= normal[0];
-			float_normal[1]= normal[1];
-			float_normal[2]= normal[2];
-			tt_write(ofs, normal , sizeof(float), 3, inv);
-
-
-			// three vertices
-			Vertex** vert=(*itr)->get_vertex();
-			Vertex t_vert;
-			float float_vertex[3];
-
-			t_vert=*( vert[0] );
-			float_vertex[0]=  t_vert[0] ;
-			float_vertex[1]=  t_vert[1] ;
-			float_vertex[2]=  t_vert[2] ;
-
-			tt_write(ofs, float_vertex, sizeof(float), 3, inv);
-
-			t_vert=*( vert[1] );
-			float_vertex[0]=  t_vert[0] ;
-			float_vertex[1]=  t_vert[1] ;
-			float_vertex[2]=  t_vert[2] ;
-
-
-			tt_write(ofs, float_vertex, sizeof(float), 3, inv);
-
-			t_vert=*( vert[2] );
-			float_vertex[0]=  t_vert[0] ;
-			float_vertex[1]=  t_vert[1] ;
-			float_vertex[2]=  t_vert[2] ;
-
-			tt_write(ofs, float_vertex, sizeof(float), 3, inv);
-
-			// tt_write(ofs, (*itr)->get_vertex()[0], sizeof(PL_REAL), 3, inv);
-			// tt_write(ofs, (*itr)->get_vertex()[1], sizeof(PL_REAL), 3, inv);
-			// tt_write(ofs, (*itr)->get_vertex()[2], sizeof(PL_REAL), 3, inv);
-			// tt_write(ofs, (*itr)->get_vertex()[0].ptr(), sizeof(PL_REAL), 3, inv);
-			// tt_write(ofs, (*itr)->get_vertex()[1].ptr(), sizeof(PL_REAL), 3, inv);
-			// tt_write(ofs, (*itr)->get_vertex()[2].ptr(), sizeof(PL_REAL), 3, inv);
-
-			// ２バイト予備領域にユーザ定義IDを記録(Polylib-2.1より)
-			int exid = (*itr)->get_exid();
-			tt_write(ofs, &exid, sizeof(ushort), 1, inv);
-		}
-
-		if (!ofs.eof() && ofs.fail()) {
-			PL_ERROSH << "[ERROR]stl:stl_b_load():Error in saving: " << fname << std::endl;
+		if (!write_records(ofs, StlBinaryFacetFormatter(tri_list, inv), element)) {
+			PL_ERROSH << "[ERROR]stl:stl_b_save():Error in saving: " << fname << std::endl;
 			return PLSTAT_STL_IO_ERROR;
 		}
 
@@ -15,12 +15,303 @@
 ###################################################################################
  */
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
 #include "file_io/vtk.h"
 #include "file_io/stl.h"
+#include "file_io/mesh_write.h"
 
 namespace PolylibNS {
 
 
+//  VTKアスキーのセルの行 "3 i0 i1 i2\n"(番号は0から)
+class VtkCellFormatter : public RecordFormatter {
+public:
+	VtkCellFormatter( const std::vector<int>& vidx ) : m_vidx(vidx) {}
+	size_t max_length() const {
+		return 2 + 3 * ( MESH_WRITE_LONG_LEN + 1 );
+	}
+	char* format( size_t i, char* p ) const {
+		*p++ = '3';
+		for( int j=0; j<3; j++ ) {
+			*p++ = ' ';
+			p = format_long( p, m_vidx[i*3+j] );
+		}
+		*p++ = '\n';
+		return p;
+	}
+private:
+	const std::vector<int>& m_vidx;
+};
+
+//  VTKアスキーのセル型(三角形=5)。10個ごとに改行
+class VtkCellTypeFormatter : public RecordFormatter {
+public:
+	size_t max_length() const {
+		return 2;
+	}
+	char* format( size_t i, char* p ) const {
+		*p++ = '5';
+		*p++ = ( (i+1)%10 == 0 ) ? '\n' : ' ';
+		return p;
+	}
+};
+
+//  VTKバイナリのセルのレコード(size_type×4: 3,i0,i1,i2)
+class VtkBinaryCellFormatter : public RecordFormatter {
+public:
+	typedef std::vector<PrivateTriangle*>::size_type size_type;
+	VtkBinaryCellFormatter( const std::vector<int>& vidx, int inv )
+		: m_vidx(vidx), m_inv(inv) {}
+	size_t max_length() const {
+		return 4 * sizeof(size_type);
+	}
+	char* format( size_t i, char* p ) const {
+		size_type buff[4];
+		buff[0] = 3;
+		buff[1] = m_vidx[i*3];
+		buff[2] = m_vidx[i*3+1];
+		buff[3] = m_vidx[i*3+2];
+		for( int j=0; j<4; j++ ) p = put_bytes( p, &buff[j], sizeof(size_type), m_inv );
+		return p;
+	}
+private:
+	const std::vector<int>&	m_vidx;
+	int						m_inv;
+};
+
+//  VTKバイナリのセル型のレコード(int 5)
+class VtkBinaryCellTypeFormatter : public RecordFormatter {
+public:
+	VtkBinaryCellTypeFormatter( int inv ) : m_inv(inv) {}
+	size_t max_length() const {
+		return sizeof(int);
+	}
+	char* format( size_t /*i*/, char* p ) const {
+		int tmp = 5;
+		return put_bytes( p, &tmp, sizeof(int), m_inv );
+	}
+private:
+	int m_inv;
+};
+
+//  頂点データの種類数を求める。頂点がDVertexでない場合は0
+static void get_dvertex_info(
+	const std::vector<Vertex*>* vlistout,
+	int* nscalar,
+	int* nvector
+	)
+{
+	*nscalar = 0;
+	*nvector = 0;
+	if (vlistout->empty()) return;
+	DVertex* dv = dynamic_cast<DVertex*>(vlistout->at(0));
+	if (dv == NULL) return;
+	DVertexManager* dvm = dv->DVM();
+	*nscalar = dvm->nscalar();
+	*nvector = dvm->nvector();
+}
+
+//  i番目のスカラーデータを頂点順の配列に集める
+static void gather_scalar(
+	const std::vector<Vertex*>* vlistout,
+	int i,
+	std::vector<PL_REAL>* data
+	)
+{
+	long n = vlistout->size();
+	data->resize(n);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (long j = 0; j < n; ++j) {
+		DVertex *dv = dynamic_cast<DVertex*>( (*vlistout)[j] );
+		(*data)[j] = dv->get_scalar(i);
+	}
+}
+
+//  i番目のベクトルデータを頂点順の配列(x,y,zの順)に集める
+static void gather_vector(
+	const std::vector<Vertex*>* vlistout,
+	int i,
+	std::vector<PL_REAL>* data
+	)
+{
+	long n = vlistout->size();
+	data->resize(n * 3);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (long j = 0; j < n; ++j) {
+		DVertex *dv = dynamic_cast<DVertex*>( (*vlistout)[j] );
+		Vec3<PL_REAL> v;
+		dv->get_vector(i, &v);
+		(*data)[j*3]   = v[0];
+		(*data)[j*3+1] = v[1];
+		(*data)[j*3+2] = v[2];
+	}
+}
+
+//  実数型の名前
+static const char* real_type_name()
+{
+	if (sizeof(PL_REAL) == 4) return "float";
+	if (sizeof(PL_REAL) == 8) return "double";
+	return NULL;
+}
+
+//  VTU(XML)の実数型の名前
+static const char* vtu_real_type_name()
+{
+	if (sizeof(PL_REAL) == 4) return "Float32";
+	if (sizeof(PL_REAL) == 8) return "Float64";
+	return NULL;
+}
+
+//  VTUのセルの頂点番号のレコード(Int64×3)
+class VtuConnectivityFormatter : public RecordFormatter {
+public:
+	VtuConnectivityFormatter( const std::vector<int>& vidx ) : m_vidx(vidx) {}
+	size_t max_length() const {
+		return 3 * sizeof(long long);
+	}
+	char* format( size_t i, char* p ) const {
+		for( int j=0; j<3; j++ ) {
+			long long tmp = m_vidx[i*3+j];
+			p = put_bytes( p, &tmp, sizeof(long long), 0 );
+		}
+		return p;
+	}
+private:
+	const std::vector<int>& m_vidx;
+};
+
+//  VTUのセルの終端位置のレコード(Int64)
+class VtuOffsetFormatter : public RecordFormatter {
+public:
+	size_t max_length() const {
+		return sizeof(long long);
+	}
+	char* format( size_t i, char* p ) const {
+		long long tmp = 3 * ( (long long)i + 1 );
+		return put_bytes( p, &tmp, sizeof(long long), 0 );
+	}
+};
+
+//  VTUのセル型のレコード(UInt8 5)
+class VtuCellTypeFormatter : public RecordFormatter {
+public:
+	size_t max_length() const {
+		return 1;
+	}
+	char* format( size_t /*i*/, char* p ) const {
+		*p++ = 5;
+		return p;
+	}
+};
+
+//  VTUの三角形id/exidのレコード(Int32)
+class VtuTriIdFormatter : public RecordFormatter {
+public:
+	VtuTriIdFormatter( const std::vector<PrivateTriangle*>* tri_list, bool exid )
+		: m_tri_list(tri_list), m_exid(exid) {}
+	size_t max_length() const {
+		return sizeof(int);
+	}
+	char* format( size_t i, char* p ) const {
+		const PrivateTriangle* t = (*m_tri_list)[i];
+		int tmp = m_exid ? t->get_exid() : t->get_id();
+		return put_bytes( p, &tmp, sizeof(int), 0 );
+	}
+private:
+	const std::vector<PrivateTriangle*>*	m_tri_list;
+	bool									m_exid;
+};
+
+//  VTUのAppendedDataに置く配列
+struct VtuArray {
+	std::string	name;
+	const char*	type;
+	int			ncomp;
+	size_t		nbytes;
+};
+
+//  VTUの配列を追加する
+static void add_vtu_array(
+	std::vector<VtuArray>* arrays,
+	const std::string& name,
+	const char* type,
+	int ncomp,
+	size_t nbytes
+	)
+{
+	VtuArray a;
+	a.name = name;
+	a.type = type;
+	a.ncomp = ncomp;
+	a.nbytes = nbytes;
+	arrays->push_back(a);
+}
+
+//  VTU/PVTUのDataArray要素を出力する。offsetが負の場合はoffset属性を出さない
+static void write_vtu_array_tag(
+	std::ostream& os,
+	const char* elem,
+	const VtuArray& a,
+	long long offset
+	)
+{
+	os << "<" << elem << " type=\"" << a.type << "\"";
+	if (a.name != "") os << " Name=\"" << a.name << "\"";
+	if (a.ncomp != 1) os << " NumberOfComponents=\"" << a.ncomp << "\"";
+	if (offset >= 0) os << " format=\"appended\" offset=\"" << offset << "\"";
+	os << "/>" << std::endl;
+}
+
+//  VTKFile要素の開始タグ
+static void write_vtu_file_tag(
+	std::ostream& os,
+	const char* type
+	)
+{
+	const char* order = tt_check_machine_endian() == TT_LITTLE_ENDIAN ?
+		"LittleEndian" : "BigEndian";
+	os << "<?xml version=\"1.0\"?>" << std::endl;
+	os << "<VTKFile type=\"" << type << "\" version=\"1.0\" byte_order=\""
+		<< order << "\" header_type=\"UInt64\">" << std::endl;
+}
+
+//  VTUの配列(points, cells, point data, cell data)を順に並べる
+static void vtu_arrays(
+	size_t nvtx,
+	size_t ntri,
+	int nscalar,
+	int nvector,
+	std::vector<VtuArray>* arrays
+	)
+{
+	const char* type_name = vtu_real_type_name();
+	char name[64];
+	add_vtu_array(arrays, "", type_name, 3, nvtx * 3 * sizeof(PL_REAL));
+	add_vtu_array(arrays, "connectivity", "Int64", 1, ntri * 3 * sizeof(long long));
+	add_vtu_array(arrays, "offsets", "Int64", 1, ntri * sizeof(long long));
+	add_vtu_array(arrays, "types", "UInt8", 1, ntri);
+	for (int i = 0; i < nscalar; ++i) {
+		sprintf(name, "polylib_Scalar_data%d", i);
+		add_vtu_array(arrays, name, type_name, 1, nvtx * sizeof(PL_REAL));
+	}
+	for (int i = 0; i < nvector; ++i) {
+		sprintf(name, "polylib_Vector_data%d", i);
+		add_vtu_array(arrays, name, type_name, 3, nvtx * 3 * sizeof(PL_REAL));
+	}
+	add_vtu_array(arrays, "id", "Int32", 1, ntri * sizeof(int));
+	add_vtu_array(arrays, "exid", "Int32", 1, ntri * sizeof(int));
+}
+
 /////////////////////////////////////////////////////
 
 POLYLIB_STAT vtk_a_save(
@@ -29,20 +320,26 @@ POLYLIB_STAT vtk_a_save(
 	std::string fname
 	){
 
-		//#define DEBUG
-#ifdef DEBUG
-		PL_DBGOSH << __func__ <<fname <<std::endl;
-#endif // DEBUG
+		const char* type_name = real_type_name();
+		if (type_name == NULL) {
+			PL_ERROSH << "[ERROR]vtk:vtk_a_save():wrong data type sizeof(PL_REAL)="<<sizeof(PL_REAL) << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+
 		std::ofstream os(fname.c_str());
 		if (os.fail()) {
 			PL_ERROSH << "[ERROR]vtk:vtk_a_save():Can't open " << fname << std::endl;
 			return PLSTAT_VTK_IO_ERROR;
 		}
 
-
-#ifdef DEBUG
-		PL_DBGOSH << __func__ <<"Header" <<std::endl;
-#endif // DEBUG
+		std::vector<int> vidx;
+		if (mesh_vertex_index(vertex_list, tri_list, &vidx) != PLSTAT_OK) {
+			PL_ERROSH << "[ERROR]vtk:vtk_a_save():wrong vertex id " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		const std::vector<Vertex*>* vlistout=vertex_list->get_vertex_lists();
+		size_t nvtx = vlistout->size();
+		size_t ntri = tri_list->size();
 
 		//header
 
@@ -51,416 +348,1209 @@ POLYLIB_STAT vtk_a_save(
 		os << "ASCII"<<std::endl;
 		os << "DATASET UNSTRUCTURED_GRID"<<std::endl;
 
-#ifdef DEBUG
-		PL_DBGOSH << __func__ <<"POINTS" <<std::endl;
-#endif // DEBUG
-
-		os << "POINTS " << vertex_list->size();
-
-		if(sizeof(PL_REAL)==4){
-			os <<" float"<<std::endl;
-		} else if(sizeof(PL_REAL)==8) {
-			os << " double"<<std::endl;
-		} else {
-			PL_ERROSH << "[ERROR]vtk:vtk_a_save():wrong data type sizeof(PL_REAL)="<<sizeof(PL_REAL) << std::endl;
-			return PLSTAT_VTK_IO_ERROR;
-		}
-
-
-
-
 		// 頂点 v 出力
-		const std::vector<Vertex*>* vlistout=vertex_list->get_vertex_lists();
-		for(int i=0;i<vlistout->size();++i){
-#if SCIENTIFIC_OUT
-			os <<  std::setprecision(6)<< scientific <<*((*vlistout)[i])<<std::endl;
-#else
-			os << std::setprecision(6) <<*((*vlistout)[i])<<std::endl;
-#endif
-		}
-
-
-#ifdef DEBUG
-		PL_DBGOSH << __func__ <<"CELLS" <<std::endl;
-#endif // DEBUG
-
+		os << "POINTS " << nvtx << " " << type_name << std::endl;
+		write_records(os, TextCoordFormatter("", vlistout), nvtx);
 
 		// CELLS
-		os << "CELLS " << tri_list->size() << " "<< 4*tri_list->size()<<std::endl;
-		std::vector<PrivateTriangle*>::size_type index=0;
-		std::vector<PrivateTriangle*>::iterator itr;
-		for (itr = tri_list->begin(); itr != tri_list->end(); itr++) {
-			Vertex** tmpvtx=(*itr)->get_vertex();
-			int i0,i1,i2;
-			/* i0=vertex_list->ith(tmpvtx[0]); */
-			/* i1=vertex_list->ith(tmpvtx[1]); */
-			/* i2=vertex_list->ith(tmpvtx[2]); */
-			i0=vertex_list->vtx_index(tmpvtx[0]);
-			i1=vertex_list->vtx_index(tmpvtx[1]);
-			i2=vertex_list->vtx_index(tmpvtx[2]);
-
-
-			if(i0==-1 || i1==-1 || i2==-1) {
-				PL_ERROSH << "[ERROR]vtk:vtk_a_save():wrong vertex id "
-					<< i0 << " "<< i1 << " "<< i2 << " "<< std::endl;
-			}
-			// vertex indexes are start from 0
-			int n_points=3;
-			//os << index << " " << i0 << " "<< i1 << " "<< i2 << std::endl;
-			os << n_points << " " << i0 << " "<< i1 << " "<< i2 << std::endl;
-			index++;
-		}
-
-		//clear indexmap
-		vertex_list->index_map_clear();
+		// vertex indexes are start from 0
+		os << "CELLS " << ntri << " "<< 4*ntri<<std::endl;
+		write_records(os, VtkCellFormatter(vidx), ntri);
 
-
-#ifdef DEBUG
-		PL_DBGOSH << __func__ <<"CELLS_TYPES" <<std::endl;
-#endif // DEBUG
-
-		os << "CELL_TYPES " << tri_list->size() <<std::endl;
-
-		for(std::vector<PrivateTriangle*>::size_type i=0;
-			i<tri_list->size();i++){
-				os<< "5";
-				if ( (i+1)%10==0){
-					os<< std::endl;
-				} else {
-					os<<" ";
-				}
-
-		}
+		os << "CELL_TYPES " << ntri <<std::endl;
+		write_records(os, VtkCellTypeFormatter(), ntri);
 		os <<std::endl;
 
-
-#ifdef DEBUG
-		PL_DBGOSH << __func__ <<"SCALAR" <<std::endl;
-#endif // DEBUG
-
 		//SCALAR_DATA;
-		//  const std::vector<Vertex*>* vlistout=vertex_list->get_vertex_lists();
-
 		// should be a DVertex
-		DVertex* dv=NULL;
-		DVertexManager* dvm=NULL;
 		int nscalar_tmp=0;
 		int nvector_tmp=0;
-		if(tri_list->size()!=0){
-			DVertex* dv=dynamic_cast<DVertex*>(vlistout->at(0));
-			DVertexManager* dvm=dv->DVM();
-			nscalar_tmp=dvm->nscalar();
-			nvector_tmp=dvm->nvector();
-		}
+		if (ntri != 0) get_dvertex_info(vlistout, &nscalar_tmp, &nvector_tmp);
 
-		os << "POINT_DATA " << vertex_list->size() <<std::endl;
-#ifdef DEBUG
-		PL_DBGOSH << __func__ <<"SCALAR "<<nscalar_tmp <<std::endl;
-#endif // DEBUG
+		os << "POINT_DATA " << nvtx <<std::endl;
 
+		std::vector<PL_REAL> data;
 		for(int i=0;i<nscalar_tmp;++i){
-
-			os << "SCALARS polylib_Scalar_data"<<i;
-
-			if(sizeof(PL_REAL)==4){
-				os <<" float"<<std::endl;
-			} else if(sizeof(PL_REAL)==8) {
-				os << " double"<<std::endl;
-			} else {
-				PL_ERROSH << "[ERROR]vtk:vtk_a_save():wrong data type with sizeof(PL_REAL)="<<sizeof(PL_REAL) << std::endl;
-				return PLSTAT_VTK_IO_ERROR;
-			}
+			os << "SCALARS polylib_Scalar_data" << i << " " << type_name << std::endl;
 			os<<"LOOKUP_TABLE default"<<std::endl;
-
-
-			for(int j=0;j<vlistout->size();++j){
-				DVertex *dv=dynamic_cast<DVertex*>( (*vlistout)[j] );
-#if SCIENTIFIC_OUT
-				os <<  std::setprecision(6)<< scientific << dv->get_scalar(i) <<std::endl;
-#else
-				os << std::setprecision(6) << dv->get_scalar(i)<<std::endl;
-#endif
-			}
+			gather_scalar(vlistout, i, &data);
+			write_records(os, TextArrayFormatter("", &data[0], 1), nvtx);
 		}
 
-
-#ifdef DEBUG
-		PL_DBGOSH << __func__ <<"VECTOR" <<std::endl;
-#endif // DEBUG
-
-
 		for(int i=0;i<nvector_tmp;++i){
+			os << "VECTORS polylib_Vector_data" << i << " " << type_name << std::endl;
+			gather_vector(vlistout, i, &data);
+			write_records(os, TextArrayFormatter("", &data[0], 3), nvtx);
+		}
 
-#ifdef DEBUG
-			PL_DBGOSH << __func__ <<"VECTOR "<<i << " " << nvector_tmp<<std::endl;
-#endif // DEBUG
-
-			os << "VECTORS polylib_Vector_data"<<i;
+		if (os.fail()) {
+			PL_ERROSH << "[ERROR]vtk:vtk_a_save():Error in saving: " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		return PLSTAT_OK;
+}
+///////////////////////////////////////////////////////////////
 
-			if(sizeof(PL_REAL)==4){
-				os <<" float"<<std::endl;
-			} else if(sizeof(PL_REAL)==8) {
-				os << " double"<<std::endl;
-			} else {
-				PL_ERROSH << "[ERROR]vtk:vtk_a_save():wrong data type with sizeof(PL_REAL)="<<sizeof(PL_REAL) << std::endl;
-				return PLSTAT_VTK_IO_ERROR;
-			}
+POLYLIB_STAT vtk_b_save(
+	VertexList* vertex_list,
+	std::vector<PrivateTriangle*> *tri_list,
+	std::string fname){
 
-			//    os<<"LOOKUP_TABLE default"<<std::endl;
-			//vlistout=vertex_list->get_vertex_lists();
-			for(int j=0;j<vlistout->size();++j){
+		const char* type_name = real_type_name();
+		if (type_name == NULL) {
+			PL_ERROSH << "[ERROR]vtk:vtk_b_save():wrong data type sizeof(PL_REAL)="<<sizeof(PL_REAL) << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
 
-#ifdef DEBUG
-				PL_DBGOSH << __func__ <<"VECTOR "<<i << " " << nvector_tmp<<std::endl;
-#endif // DEBUG
+		std::ofstream ofs(fname.c_str(), std::ios::out | std::ios::binary);
+		if (ofs.fail()) {
+			PL_ERROSH << "[ERROR]vtk:vtk_b_save():Can't open " << fname << std::endl;
+			return PLSTAT_STL_IO_ERROR;
+		}
+		int inv = tt_check_machine_endian() == TT_LITTLE_ENDIAN ? 0 : 1;
 
-				DVertex *dv=dynamic_cast<DVertex *>((*vlistout)[j]);
+		std::vector<int> vidx;
+		if (mesh_vertex_index(vertex_list, tri_list, &vidx) != PLSTAT_OK) {
+			PL_ERROSH << "[ERROR]vtk:vtk_b_save():wrong vertex id " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		const std::vector<Vertex*>* vlistout=vertex_list->get_vertex_lists();
+		size_t nvtx = vlistout->size();
+		size_t ntri = tri_list->size();
 
-#ifdef DEBUG
-				PL_DBGOSH << __func__ <<"VECTOR "<<i << " " << dvm->nvector()<<std::endl;
-#endif // DEBUG
+		// header
 
-				Vec3<PL_REAL> v;
+		ofs << "# vtk DataFile Version 2.0" <<std::endl;
+		ofs << " title "<<std::endl;
+		ofs << "BINARY"<<std::endl;
+		ofs << "DATASET UNSTRUCTURED_GRID"<<std::endl;
 
-#ifdef DEBUG
-				PL_DBGOSH << __func__ <<"VECTOR "<<i << " " << dvm->nvector()<<std::endl;
-#endif // DEBUG
+		//points
+		ofs << "POINTS " << nvtx << " " << type_name << std::endl;
+		write_records(ofs, BinaryCoordFormatter(vlistout, false, inv), nvtx);
+		ofs << std::endl;
 
-				dv->get_vector(i,&v);
+		//cells
+		// vertex indexes are start from 0
+		ofs << "CELLS " << ntri << " "<< 4*ntri<<std::endl;
+		write_records(ofs, VtkBinaryCellFormatter(vidx, inv), ntri);
+		ofs <<std::endl;
 
-#ifdef DEBUG
-				PL_DBGOSH << __func__ <<"VECTOR "<<i << " " << v<<std::endl;
-#endif // DEBUG
+		//celltypes
+		ofs << "CELL_TYPES " << ntri <<std::endl;
+		write_records(ofs, VtkBinaryCellTypeFormatter(inv), ntri);
+		ofs <<std::endl;
 
-#if SCIENTIFIC_OUT
-				os <<  std::setprecision(6)<< scientific << v <<std::endl;
-#else
-				os <<  std::setprecision(6)<< v <<std::endl;
-#endif
+		//pointdata
+		int nscalar_tmp=0;
+		int nvector_tmp=0;
+		get_dvertex_info(vlistout, &nscalar_tmp, &nvector_tmp);
 
-#ifdef DEBUG
-				PL_DBGOSH << __func__ <<"VECTOR end"<<i <<std::endl;
-#endif // DEBUG
+		ofs << "POINT_DATA " << nvtx <<std::endl;
 
-			}
+		std::vector<PL_REAL> data;
+		for(int i=0;i<nscalar_tmp;++i){
+			ofs << "SCALARS polylib_Scalar_data" << i << " " << type_name << std::endl;
+			ofs<<"LOOKUP_TABLE default"<<std::endl;
+			gather_scalar(vlistout, i, &data);
+			write_records(ofs, BinaryArrayFormatter(&data[0], 1, false, inv), nvtx);
+			ofs <<std::endl;
 		}
 
+		for(int i=0;i<nvector_tmp;++i){
+			ofs << "VECTORS polylib_Vector_data" << i << " " << type_name << std::endl;
+			gather_vector(vlistout, i, &data);
+			write_records(ofs, BinaryArrayFormatter(&data[0], 3, false, inv), nvtx);
+			ofs <<std::endl;
+		}
 
-#ifdef DEBUG
-		PL_DBGOSH << __func__ <<"FINISH" <<std::endl;
-#endif // DEBUG
-
+		if (ofs.fail()) {
+			PL_ERROSH << "[ERROR]vtk:vtk_b_save():Error in saving: " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
 		return PLSTAT_OK;
-
-		//#undef DEBUG
 }
+
+
 ///////////////////////////////////////////////////////////////
 
-POLYLIB_STAT vtk_b_save(
+POLYLIB_STAT vtu_save(
 	VertexList* vertex_list,
 	std::vector<PrivateTriangle*> *tri_list,
-	std::string fname){
-
-#define DEBUG
-
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " start"<<std::endl;
-#endif
+	std::string fname,
+	int nscalar,
+	int nvector
+	){
 
+		if (vtu_real_type_name() == NULL) {
+			PL_ERROSH << "[ERROR]vtk:vtu_save():wrong data type sizeof(PL_REAL)="<<sizeof(PL_REAL) << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
 
 		std::ofstream ofs(fname.c_str(), std::ios::out | std::ios::binary);
 		if (ofs.fail()) {
-			PL_ERROSH << "[ERROR]vtk:vtk_b_save():Can't open " << fname << std::endl;
-			return PLSTAT_STL_IO_ERROR;
+			PL_ERROSH << "[ERROR]vtk:vtu_save():Can't open " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+
+		std::vector<int> vidx;
+		if (mesh_vertex_index(vertex_list, tri_list, &vidx) != PLSTAT_OK) {
+			PL_ERROSH << "[ERROR]vtk:vtu_save():wrong vertex id " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		const std::vector<Vertex*>* vlistout=vertex_list->get_vertex_lists();
+		size_t nvtx = vlistout->size();
+		size_t ntri = tri_list->size();
+
+		// 頂点データ数。頂点が持つ数を超える分は0を出力する
+		int nscalar_vtx=0;
+		int nvector_vtx=0;
+		get_dvertex_info(vlistout, &nscalar_vtx, &nvector_vtx);
+		if (nscalar < 0) nscalar = nscalar_vtx;
+		if (nvector < 0) nvector = nvector_vtx;
+
+		std::vector<VtuArray> arrays;
+		vtu_arrays(nvtx, ntri, nscalar, nvector, &arrays);
+		std::vector<long long> offsets(arrays.size());
+		long long offset = 0;
+		for (size_t a = 0; a < arrays.size(); ++a) {
+			offsets[a] = offset;
+			offset += sizeof(unsigned long long) + arrays[a].nbytes;
 		}
-		int inv = tt_check_machine_endian() == TT_LITTLE_ENDIAN ? 0 : 1;
 
 		// header
+		write_vtu_file_tag(ofs, "UnstructuredGrid");
+		ofs << "<UnstructuredGrid>" << std::endl;
+		ofs << "<Piece NumberOfPoints=\"" << nvtx << "\" NumberOfCells=\"" << ntri << "\">" << std::endl;
+		size_t a = 0;
+		ofs << "<Points>" << std::endl;
+		write_vtu_array_tag(ofs, "DataArray", arrays[a], offsets[a]); a++;
+		ofs << "</Points>" << std::endl;
+		ofs << "<Cells>" << std::endl;
+		for (int i = 0; i < 3; ++i, ++a) write_vtu_array_tag(ofs, "DataArray", arrays[a], offsets[a]);
+		ofs << "</Cells>" << std::endl;
+		ofs << "<PointData>" << std::endl;
+		for (int i = 0; i < nscalar + nvector; ++i, ++a) write_vtu_array_tag(ofs, "DataArray", arrays[a], offsets[a]);
+		ofs << "</PointData>" << std::endl;
+		ofs << "<CellData>" << std::endl;
+		for (int i = 0; i < 2; ++i, ++a) write_vtu_array_tag(ofs, "DataArray", arrays[a], offsets[a]);
+		ofs << "</CellData>" << std::endl;
+		ofs << "</Piece>" << std::endl;
+		ofs << "</UnstructuredGrid>" << std::endl;
+
+		// 配列本体。各配列の前にバイト数(UInt64)を置く
+		ofs << "<AppendedData encoding=\"raw\">" << std::endl << "_";
+		std::vector<PL_REAL> data;
+		for (a = 0; a < arrays.size(); ++a) {
+			unsigned long long nbytes = arrays[a].nbytes;
+			ofs.write((const char*)&nbytes, sizeof(nbytes));
+			if (a == 0) {
+				write_records(ofs, BinaryCoordFormatter(vlistout, false, 0), nvtx);
+			} else if (a == 1) {
+				write_records(ofs, VtuConnectivityFormatter(vidx), ntri);
+			} else if (a == 2) {
+				write_records(ofs, VtuOffsetFormatter(), ntri);
+			} else if (a == 3) {
+				write_records(ofs, VtuCellTypeFormatter(), ntri);
+			} else if (a < 4 + (size_t)nscalar) {
+				int i = a - 4;
+				if (i < nscalar_vtx) gather_scalar(vlistout, i, &data);
+				else data.assign(nvtx, 0.0);
+				if (nvtx > 0) write_records(ofs, BinaryArrayFormatter(&data[0], 1, false, 0), nvtx);
+			} else if (a < 4 + (size_t)(nscalar + nvector)) {
+				int i = a - 4 - nscalar;
+				if (i < nvector_vtx) gather_vector(vlistout, i, &data);
+				else data.assign(nvtx * 3, 0.0);
+				if (nvtx > 0) write_records(ofs, BinaryArrayFormatter(&data[0], 3, false, 0), nvtx);
+			} else {
+				bool exid = ( a == arrays.size() - 1 );
+				write_records(ofs, VtuTriIdFormatter(tri_list, exid), ntri);
+			}
+		}
+		ofs << std::endl << "</AppendedData>" << std::endl;
+		ofs << "</VTKFile>" << std::endl;
 
+		if (ofs.fail()) {
+			PL_ERROSH << "[ERROR]vtk:vtu_save():Error in saving: " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		return PLSTAT_OK;
+}
 
-		ofs << "# vtk DataFile Version 2.0" <<std::endl;
-		ofs << " title "<<std::endl;
-		ofs << "BINARY"<<std::endl;
-		ofs << "DATASET UNSTRUCTURED_GRID"<<std::endl;
+///////////////////////////////////////////////////////////////
 
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " end HEADER"<<std::endl;
-#endif
+POLYLIB_STAT pvtu_save(
+	std::string fname,
+	const std::vector<std::string>& pieces,
+	int nscalar,
+	int nvector
+	){
 
+		if (vtu_real_type_name() == NULL) {
+			PL_ERROSH << "[ERROR]vtk:pvtu_save():wrong data type sizeof(PL_REAL)="<<sizeof(PL_REAL) << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
 
-		//points
+		std::ofstream ofs(fname.c_str());
+		if (ofs.fail()) {
+			PL_ERROSH << "[ERROR]vtk:pvtu_save():Can't open " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
 
-		ofs << "POINTS " << vertex_list->size();
+		std::vector<VtuArray> arrays;
+		vtu_arrays(0, 0, nscalar, nvector, &arrays);
+
+		write_vtu_file_tag(ofs, "PUnstructuredGrid");
+		ofs << "<PUnstructuredGrid GhostLevel=\"0\">" << std::endl;
+		ofs << "<PPoints>" << std::endl;
+		write_vtu_array_tag(ofs, "PDataArray", arrays[0], -1);
+		ofs << "</PPoints>" << std::endl;
+		ofs << "<PPointData>" << std::endl;
+		for (int i = 0; i < nscalar + nvector; ++i) write_vtu_array_tag(ofs, "PDataArray", arrays[4+i], -1);
+		ofs << "</PPointData>" << std::endl;
+		ofs << "<PCellData>" << std::endl;
+		for (size_t a = arrays.size() - 2; a < arrays.size(); ++a) write_vtu_array_tag(ofs, "PDataArray", arrays[a], -1);
+		ofs << "</PCellData>" << std::endl;
+		for (size_t i = 0; i < pieces.size(); ++i) {
+			ofs << "<Piece Source=\"" << pieces[i] << "\"/>" << std::endl;
+		}
+		ofs << "</PUnstructuredGrid>" << std::endl;
+		ofs << "</VTKFile>" << std::endl;
 
-		if(sizeof(PL_REAL)==4){
-			ofs <<" float"<<std::endl;
-		} else if(sizeof(PL_REAL)==8) {
-			ofs << " double"<<std::endl;
-		} else {
-			PL_ERROSH << "[ERROR]vtk:vtk_a_save():wrong data type sizeof(PL_REAL)="<<sizeof(PL_REAL) << std::endl;
+		if (ofs.fail()) {
+			PL_ERROSH << "[ERROR]vtk:pvtu_save():Error in saving: " << fname << std::endl;
 			return PLSTAT_VTK_IO_ERROR;
 		}
+		return PLSTAT_OK;
+}
 
-		// 頂点 v 出力
-		const std::vector<Vertex*>* vlistout=vertex_list->get_vertex_lists();
-		for(int i=0;i<vlistout->size();++i){
-			PL_REAL buffer[3];
-			buffer[0]= (*((*vlistout)[i]))[0];
-			buffer[1]= (*((*vlistout)[i]))[1];
-			buffer[2]= (*((*vlistout)[i]))[2];
 
-			tt_write(ofs, buffer, sizeof(PL_REAL), 3, inv);
+//=======================================================================
+// 読み込み
+//=======================================================================
+
+//  VTKの値の型
+enum VtkValueType {
+	VT_NONE,
+	VT_INT8,
+	VT_UINT8,
+	VT_INT16,
+	VT_UINT16,
+	VT_INT32,
+	VT_UINT32,
+	VT_INT64,
+	VT_UINT64,
+	VT_FLOAT32,
+	VT_FLOAT64
+};
+
+//  値の型のバイト数
+static int vtk_type_size( VtkValueType t )
+{
+	switch( t ) {
+	case VT_INT8:		case VT_UINT8:		return 1;
+	case VT_INT16:		case VT_UINT16:		return 2;
+	case VT_INT32:		case VT_UINT32:		case VT_FLOAT32:	return 4;
+	case VT_INT64:		case VT_UINT64:		case VT_FLOAT64:	return 8;
+	default:			return 0;
+	}
+}
 
-		}
-		ofs << std::endl;
+//  レガシー形式の型名
+static VtkValueType vtk_legacy_type( const std::string& s )
+{
+	if( s == "char" )								return VT_INT8;
+	if( s == "unsigned_char" )						return VT_UINT8;
+	if( s == "short" )								return VT_INT16;
+	if( s == "unsigned_short" )						return VT_UINT16;
+	if( s == "int" )								return VT_INT32;
+	if( s == "unsigned_int" )						return VT_UINT32;
+	if( s == "long" || s == "vtktypeint64" )		return VT_INT64;
+	if( s == "unsigned_long" || s == "vtktypeuint64" )	return VT_UINT64;
+	if( s == "float" )								return VT_FLOAT32;
+	if( s == "double" )								return VT_FLOAT64;
+	return VT_NONE;
+}
 
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " end POINTS"<<std::endl;
+//  XML形式の型名
+static VtkValueType vtk_xml_type( const std::string& s )
+{
+	if( s == "Int8" )		return VT_INT8;
+	if( s == "UInt8" )		return VT_UINT8;
+	if( s == "Int16" )		return VT_INT16;
+	if( s == "UInt16" )		return VT_UINT16;
+	if( s == "Int32" )		return VT_INT32;
+	if( s == "UInt32" )		return VT_UINT32;
+	if( s == "Int64" )		return VT_INT64;
+	if( s == "UInt64" )		return VT_UINT64;
+	if( s == "Float32" )	return VT_FLOAT32;
+	if( s == "Float64" )	return VT_FLOAT64;
+	return VT_NONE;
+}
+
+//  ファイルから読み込んだ変換前の配列
+struct VtkRawArray {
+	std::string			name;
+	VtkValueType		type;
+	int					ncomp;
+	size_t				nvalue;
+	std::vector<char>	data;
+	bool				native;		// true:バイト順を変換しない(アスキーから作成)
+
+	VtkRawArray() : type(VT_NONE), ncomp(1), nvalue(0), native(true) {}
+	size_t ntuple() const { return nvalue / ncomp; }
+};
+
+//  1つのPiece(レガシー形式ではファイル全体)の配列
+struct VtkPiece {
+	size_t						npoints;
+	size_t						ncells;
+	size_t						cell_offset;	// セルデータ中の三角形セルの開始位置
+	bool						legacy_cells;	// true:connectivityが(n,i0,i1,...)の並び
+	bool						offsets_start;	// true:offsetsが0から始まる(セル数+1個)
+	VtkRawArray					points;
+	VtkRawArray					connectivity;
+	VtkRawArray					offsets;
+	VtkRawArray					types;			// 無い場合は頂点数だけで判定する
+	std::vector<VtkRawArray>	point_data;
+	std::vector<VtkRawArray>	cell_data;
+
+	VtkPiece() : npoints(0), ncells(0), cell_offset(0),
+		legacy_cells(false), offsets_start(false) {}
+};
+
+//  配列の値をS型として読み、D型に変換する
+template<class S, class D>
+static void vtk_convert( const char* src, long n, bool swap, D* dst )
+{
+#ifdef _OPENMP
+#pragma omp parallel for
 #endif
+	for( long i=0; i<n; i++ ) {
+		const char* p = src + i * sizeof(S);
+		char b[sizeof(S)];
+		for( size_t k=0; k<sizeof(S); k++ ) b[k] = swap ? p[sizeof(S)-1-k] : p[k];
+		S v;
+		memcpy( &v, b, sizeof(S) );
+		dst[i] = (D)v;
+	}
+}
 
+//  配列の値をD型に変換する
+template<class D>
+static void vtk_decode( const VtkRawArray& a, bool swap, std::vector<D>* out )
+{
+	long n = a.nvalue;
+	out->resize( n );
+	if( n == 0 ) return;
+	bool sw = swap && !a.native;
+	const char* p = &a.data[0];
+	D* d = &(*out)[0];
+	switch( a.type ) {
+	case VT_INT8:		vtk_convert<signed char,D>( p, n, sw, d );			break;
+	case VT_UINT8:		vtk_convert<unsigned char,D>( p, n, sw, d );		break;
+	case VT_INT16:		vtk_convert<short,D>( p, n, sw, d );				break;
+	case VT_UINT16:		vtk_convert<unsigned short,D>( p, n, sw, d );		break;
+	case VT_INT32:		vtk_convert<int,D>( p, n, sw, d );					break;
+	case VT_UINT32:		vtk_convert<unsigned int,D>( p, n, sw, d );		break;
+	case VT_INT64:		vtk_convert<long long,D>( p, n, sw, d );			break;
+	case VT_UINT64:		vtk_convert<unsigned long long,D>( p, n, sw, d );	break;
+	case VT_FLOAT32:	vtk_convert<float,D>( p, n, sw, d );				break;
+	case VT_FLOAT64:	vtk_convert<double,D>( p, n, sw, d );				break;
+	default:			break;
+	}
+}
 
-		//cells
+//  i番目の値を整数で取得する
+static long long vtk_value_at( const VtkRawArray& a, size_t i, bool swap )
+{
+	VtkRawArray one;
+	one.type = a.type;
+	one.native = a.native;
+	one.nvalue = 1;
+	int size = vtk_type_size( a.type );
+	one.data.assign( a.data.begin() + i * size, a.data.begin() + ( i + 1 ) * size );
+	std::vector<long long> v;
+	vtk_decode( one, swap, &v );
+	return v[0];
+}
 
-		ofs << "CELLS " << tri_list->size() << " "<< 4*tri_list->size()<<std::endl;
-		std::vector<PrivateTriangle*>::size_type index=0;
-		std::vector<PrivateTriangle*>::iterator itr;
-		for (itr = tri_list->begin(); itr != tri_list->end(); itr++) {
-			Vertex** tmpvtx=(*itr)->get_vertex();
-			int i0,i1,i2;
-			/* i0=vertex_list->ith(tmpvtx[0]); */
-			/* i1=vertex_list->ith(tmpvtx[1]); */
-			/* i2=vertex_list->ith(tmpvtx[2]); */
-			i0=vertex_list->vtx_index(tmpvtx[0]);
-			i1=vertex_list->vtx_index(tmpvtx[1]);
-			i2=vertex_list->vtx_index(tmpvtx[2]);
-
-
-			if(i0==-1 || i1==-1 || i2==-1) {
-				PL_ERROSH << "[ERROR]vtk:vtk_a_save():wrong vertex id "
-					<< i0 << " "<< i1 << " "<< i2 << " "<< std::endl;
-			}
-			// vertex indexes are start from 0
+//  アスキーの値をn個読み込み、Float64の配列とする
+static bool vtk_read_ascii_values( std::istream& is, size_t n, VtkRawArray* a )
+{
+	a->type = VT_FLOAT64;
+	a->native = true;
+	a->nvalue = n;
+	a->data.resize( n * sizeof(double) );
+	for( size_t i=0; i<n; i++ ) {
+		double v;
+		if( !( is >> v ) ) return false;
+		memcpy( &a->data[i * sizeof(double)], &v, sizeof(double) );
+	}
+	return true;
+}
 
-			std::vector<PrivateTriangle*>::size_type buff[4];
-			//    buff[0]=index;
-			buff[0]=3;
-			buff[1]=i0;
-			buff[2]=i1;
-			buff[3]=i2;
+//  アスキーの値を[p,end)から読み込み、Float64の配列とする
+static bool vtk_parse_ascii_values( const char* p, const char* end, VtkRawArray* a )
+{
+	std::vector<double> v;
+	while( p < end ) {
+		if( isspace( (unsigned char)*p ) ) { p++; continue; }
+		char* q;
+		double d = strtod( p, &q );
+		if( q == p ) return false;
+		v.push_back( d );
+		p = q;
+	}
+	a->type = VT_FLOAT64;
+	a->native = true;
+	a->nvalue = v.size();
+	a->data.resize( v.size() * sizeof(double) );
+	if( !v.empty() ) memcpy( &a->data[0], &v[0], a->data.size() );
+	return true;
+}
 
-			tt_write(ofs,buff,
-				sizeof(std::vector<PrivateTriangle*>::size_type),
-				4, inv);
+//  レガシー形式の値をn個読み込む
+static bool vtk_read_legacy_values(
+	std::istream& is,
+	bool binary,
+	VtkValueType type,
+	size_t n,
+	VtkRawArray* a
+	)
+{
+	if( !binary ) return vtk_read_ascii_values( is, n, a );
+	if( type == VT_NONE ) return false;
+	a->type = type;
+	a->native = false;
+	a->nvalue = n;
+	a->data.resize( n * vtk_type_size( type ) );
+	if( !a->data.empty() ) is.read( &a->data[0], a->data.size() );
+	return !is.fail();
+}
 
+//  空行を飛ばして1行読み、空白で区切る
+static bool vtk_next_line( std::istream& is, std::vector<std::string>* tokens )
+{
+	std::string line;
+	while( std::getline( is, line ) ) {
+		std::istringstream ss( line );
+		std::string t;
+		tokens->clear();
+		while( ss >> t ) tokens->push_back( t );
+		if( !tokens->empty() ) return true;
+	}
+	return false;
+}
 
-			index++;
+//  空白を飛ばした次の語がキーワード(英大文字と'_')ならそれを返す。
+//  読み込み位置は戻す。eofにはファイル終端までに空白しか無いかを返す
+static std::string vtk_peek_keyword( std::istream& is, bool* eof )
+{
+	std::streampos pos = is.tellg();
+	std::string s;
+	char c;
+	*eof = true;
+	while( is.get( c ) ) {
+		if( isspace( (unsigned char)c ) ) {
+			if( s.empty() ) continue;
+			break;
 		}
-		ofs <<std::endl;
-
+		*eof = false;
+		if( !( ( c >= 'A' && c <= 'Z' ) || c == '_' ) || s.size() > 32 ) {
+			s = "";
+			break;
+		}
+		s += c;
+	}
+	is.clear();
+	is.seekg( pos );
+	return s;
+}
 
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " end CELLS"<<std::endl;
+//  Pieceの内容をメッシュに追加する。firstは最初のPieceでtrue
+static POLYLIB_STAT vtk_append_piece(
+	const VtkPiece& piece,
+	bool swap,
+	PL_REAL scale,
+	bool first,
+	const std::string& fname,
+	VtkMesh* mesh
+	)
+{
+	size_t base = mesh->nvert();
+	size_t ntri_base = mesh->ntri();
+
+	// 頂点
+	std::vector<PL_REAL> pts;
+	vtk_decode( piece.points, swap, &pts );
+	if( pts.size() != piece.npoints * 3 ) {
+		PL_ERROSH << "[ERROR]vtk:wrong number of points: " << fname << std::endl;
+		return PLSTAT_VTK_IO_ERROR;
+	}
+	mesh->coords.resize( ( base + piece.npoints ) * 3 );
+	long np3 = pts.size();
+#ifdef _OPENMP
+#pragma omp parallel for
 #endif
-
-
-		//clear indexmap
-		vertex_list->index_map_clear();
-
-		//celltypes
-		ofs << "CELL_TYPES " << tri_list->size() <<std::endl;
-
-		for(std::vector<PrivateTriangle*>::size_type i=0;
-			i<tri_list->size();i++){
-				int tmp=5;
-				tt_write(ofs,&tmp,sizeof(int),1,inv);
-				//tt_write(ofs,tmp,sizeof(tmp),1,inv);
+	for( long i=0; i<np3; i++ ) mesh->coords[ base * 3 + i ] = pts[i] * scale;
+
+	// セル。三角形(セル型5)と3頂点の多角形(7)以外は読み飛ばす
+	std::vector<long long> conn, offs;
+	std::vector<int> types;
+	vtk_decode( piece.connectivity, swap, &conn );
+	if( piece.types.nvalue == piece.ncells ) vtk_decode( piece.types, swap, &types );
+	std::vector<size_t> tri_cells;
+	if( piece.legacy_cells ) {
+		size_t pos = 0;
+		for( size_t c=0; c<piece.ncells; c++ ) {
+			if( pos >= conn.size() || conn[pos] < 0 || pos + conn[pos] >= conn.size() ) {
+				PL_ERROSH << "[ERROR]vtk:wrong cell list: " << fname << std::endl;
+				return PLSTAT_VTK_IO_ERROR;
+			}
+			if( conn[pos] == 3 && ( types.empty() || types[c] == 5 || types[c] == 7 ) ) {
+				for( int j=1; j<=3; j++ ) mesh->index.push_back( (int)conn[pos+j] );
+				tri_cells.push_back( c );
+			}
+			pos += conn[pos] + 1;
 		}
-		ofs <<std::endl;
+	}
+	else {
+		vtk_decode( piece.offsets, swap, &offs );
+		if( piece.offsets_start && !offs.empty() ) offs.erase( offs.begin() );
+		if( offs.size() != piece.ncells ) {
+			PL_ERROSH << "[ERROR]vtk:wrong number of cells: " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		long long start = 0;
+		for( size_t c=0; c<piece.ncells; c++ ) {
+			long long end = offs[c];
+			if( end < start || end > (long long)conn.size() ) {
+				PL_ERROSH << "[ERROR]vtk:wrong cell offsets: " << fname << std::endl;
+				return PLSTAT_VTK_IO_ERROR;
+			}
+			if( end - start == 3 && ( types.empty() || types[c] == 5 || types[c] == 7 ) ) {
+				for( int j=0; j<3; j++ ) mesh->index.push_back( (int)conn[start+j] );
+				tri_cells.push_back( c );
+			}
+			start = end;
+		}
+	}
+	for( size_t i=ntri_base*3; i<mesh->index.size(); i++ ) {
+		if( mesh->index[i] < 0 || mesh->index[i] >= (long long)piece.npoints ) {
+			PL_ERROSH << "[ERROR]vtk:wrong vertex index " << mesh->index[i] << ": " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		mesh->index[i] += base;
+	}
+	if( tri_cells.size() != piece.ncells ) {
+		PL_DBGOSH << "vtk: " << piece.ncells - tri_cells.size()
+			<< " non-triangle cells are skipped: " << fname << std::endl;
+	}
+
+	// セルデータ id、exid
+	std::vector<int> cdata;
+	for( size_t a=0; a<piece.cell_data.size(); a++ ) {
+		const VtkRawArray& arr = piece.cell_data[a];
+		std::vector<int>* dst = NULL;
+		if( arr.name == "id" )			dst = &mesh->ids;
+		else if( arr.name == "exid" )	dst = &mesh->exids;
+		if( dst == NULL || arr.ncomp != 1 ) continue;
+		if( arr.ntuple() < piece.cell_offset + piece.ncells ) continue;
+		if( dst->size() != ntri_base ) continue;
+		vtk_decode( arr, swap, &cdata );
+		for( size_t i=0; i<tri_cells.size(); i++ ) {
+			dst->push_back( cdata[ piece.cell_offset + tri_cells[i] ] );
+		}
+	}
+
+	// 頂点データ。1成分はスカラー、3成分はベクトル
+	std::vector<const VtkRawArray*> sarr, varr;
+	for( size_t a=0; a<piece.point_data.size(); a++ ) {
+		const VtkRawArray& arr = piece.point_data[a];
+		if( arr.ntuple() != piece.npoints ) continue;
+		if( arr.ncomp == 1 )		sarr.push_back( &arr );
+		else if( arr.ncomp == 3 )	varr.push_back( &arr );
+	}
+	if( first ) {
+		mesh->nscalar = sarr.size();
+		mesh->nvector = varr.size();
+	}
+	else if( mesh->nscalar != (int)sarr.size() || mesh->nvector != (int)varr.size() ) {
+		PL_ERROSH << "[ERROR]vtk:point data differs between pieces: " << fname << std::endl;
+		return PLSTAT_VTK_IO_ERROR;
+	}
+	long np = piece.npoints;
+	int ns = mesh->nscalar;
+	int nv = mesh->nvector;
+	mesh->scalars.resize( ( base + np ) * ns );
+	mesh->vectors.resize( ( base + np ) * nv * 3 );
+	std::vector<PL_REAL> fdata;
+	for( int j=0; j<ns; j++ ) {
+		vtk_decode( *sarr[j], swap, &fdata );
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for( long i=0; i<np; i++ ) mesh->scalars[ ( base + i ) * ns + j ] = fdata[i];
+	}
+	for( int j=0; j<nv; j++ ) {
+		vtk_decode( *varr[j], swap, &fdata );
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for( long i=0; i<np; i++ ) {
+			for( int k=0; k<3; k++ ) {
+				mesh->vectors[ ( ( base + i ) * nv + j ) * 3 + k ] = fdata[ i * 3 + k ];
+			}
+		}
+	}
+	return PLSTAT_OK;
+}
 
+//  id、exidが一部のPieceにしか無い場合は使わない
+static void vtk_finish_mesh( VtkMesh* mesh )
+{
+	if( mesh->ids.size() != mesh->index.size() / 3 )	mesh->ids.clear();
+	if( mesh->exids.size() != mesh->index.size() / 3 )	mesh->exids.clear();
+}
 
+///////////////////////////////////////////////////////////////
 
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " end CELL_TYPES"<<std::endl;
-#endif
+bool is_vtk_a( std::string path )
+{
+	std::ifstream ifs( path.c_str() );
+	if( !ifs ) return false;
+	std::string line;
+	std::getline( ifs, line );	// # vtk DataFile Version
+	std::getline( ifs, line );	// タイトル
+	std::vector<std::string> tok;
+	if( !vtk_next_line( ifs, &tok ) ) return false;
+	return tok[0] == "ASCII";
+}
 
-		//pointdata
-		ofs << "POINT_DATA " << vertex_list->size() <<std::endl;
-		DVertex* dv=dynamic_cast<DVertex*>(vlistout->at(0));
-		DVertexManager* dvm=dv->DVM();
+///////////////////////////////////////////////////////////////
 
-		for(int i=0;i<dvm->nscalar();++i){
+POLYLIB_STAT vtk_read(
+	std::string fname,
+	VtkMesh* mesh,
+	PL_REAL scale
+	){
 
-			ofs << "SCALARS polylib_Scalar_data "<<i;
+		std::ifstream ifs(fname.c_str(), std::ios::in | std::ios::binary);
+		if (ifs.fail()) {
+			PL_ERROSH << "[ERROR]vtk:vtk_read():Can't open " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		*mesh = VtkMesh();
 
-			if(sizeof(PL_REAL)==4){
-				ofs <<" float"<<std::endl;
-			} else if(sizeof(PL_REAL)==8) {
-				ofs << " double"<<std::endl;
-			} else {
-				PL_ERROSH << "[ERROR]vtk:vtk_a_save():wrong data type with sizeof(PL_REAL)="<<sizeof(PL_REAL) << std::endl;
+		// header
+		std::string line;
+		std::vector<std::string> tok;
+		std::getline(ifs, line);
+		if (line.compare(0, 5, "# vtk") != 0) {
+			PL_ERROSH << "[ERROR]vtk:vtk_read():not a vtk file: " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		std::getline(ifs, line);
+		if (!vtk_next_line(ifs, &tok) || ( tok[0] != "ASCII" && tok[0] != "BINARY" )) {
+			PL_ERROSH << "[ERROR]vtk:vtk_read():unknown file type: " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		bool binary = ( tok[0] == "BINARY" );
+		if (!vtk_next_line(ifs, &tok) || tok.size() < 2 || tok[0] != "DATASET" ||
+			( tok[1] != "UNSTRUCTURED_GRID" && tok[1] != "POLYDATA" )) {
+			PL_ERROSH << "[ERROR]vtk:vtk_read():unsupported dataset: " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		bool polydata = ( tok[1] == "POLYDATA" );
+
+		VtkPiece piece;
+		std::vector<VtkRawArray>* section = NULL;
+		size_t ntuple = 0;
+		bool ok = true;
+		while (ok && vtk_next_line(ifs, &tok)) {
+			const std::string& kw = tok[0];
+			bool eof;
+
+			if (kw == "POINTS" && tok.size() >= 3) {
+				piece.npoints = atol(tok[1].c_str());
+				piece.points.ncomp = 3;
+				ok = vtk_read_legacy_values(ifs, binary, vtk_legacy_type(tok[2]),
+					piece.npoints * 3, &piece.points);
+			}
+			else if (( kw == "CELLS" && !polydata ) || ( kw == "POLYGONS" && polydata )) {
+				if (tok.size() < 3) { ok = false; break; }
+				size_t n = atol(tok[1].c_str());
+				size_t size = atol(tok[2].c_str());
+				if (vtk_peek_keyword(ifs, &eof) == "OFFSETS") {
+					// 5.1形式: OFFSETS(セル数+1個)とCONNECTIVITY
+					piece.ncells = ( n > 0 ) ? n - 1 : 0;
+					piece.offsets_start = true;
+					ok = vtk_next_line(ifs, &tok) && tok.size() >= 2 &&
+						vtk_read_legacy_values(ifs, binary, vtk_legacy_type(tok[1]), n, &piece.offsets) &&
+						vtk_next_line(ifs, &tok) && tok.size() >= 2 && tok[0] == "CONNECTIVITY" &&
+						vtk_read_legacy_values(ifs, binary, vtk_legacy_type(tok[1]), size, &piece.connectivity);
+				}
+				else {
+					// (頂点数,頂点番号...)の並び。vtk_b_save()は8バイト整数で出力している
+					piece.ncells = n;
+					piece.legacy_cells = true;
+					ok = vtk_read_legacy_values(ifs, binary, VT_INT32, size, &piece.connectivity);
+					if (ok && binary) {
+						std::string next = vtk_peek_keyword(ifs, &eof);
+						if (!eof && next.empty()) {
+							piece.connectivity.type = VT_INT64;
+							piece.connectivity.data.resize(size * 8);
+							if (size > 0) ifs.read(&piece.connectivity.data[size * 4], size * 4);
+							ok = !ifs.fail();
+						}
+					}
+				}
+			}
+			else if (kw == "CELL_TYPES" && tok.size() >= 2) {
+				ok = vtk_read_legacy_values(ifs, binary, VT_INT32, atol(tok[1].c_str()), &piece.types);
+			}
+			else if (polydata && ( kw == "VERTICES" || kw == "LINES" || kw == "TRIANGLE_STRIPS" )) {
+				if (tok.size() >= 2 && atol(tok[1].c_str()) != 0) {
+					PL_ERROSH << "[ERROR]vtk:vtk_read():" << kw << " is not supported: " << fname << std::endl;
+					return PLSTAT_VTK_IO_ERROR;
+				}
+			}
+			else if (( kw == "POINT_DATA" || kw == "CELL_DATA" ) && tok.size() >= 2) {
+				section = ( kw == "POINT_DATA" ) ? &piece.point_data : &piece.cell_data;
+				ntuple = atol(tok[1].c_str());
+			}
+			else if (kw == "SCALARS" && section != NULL && tok.size() >= 3) {
+				// SCALARS 名前 型 [成分数]。名前に空白を含む古い出力も受け付ける
+				VtkRawArray a;
+				a.name = tok[1];
+				size_t k = 2;
+				if (tok.size() >= 4 && vtk_legacy_type(tok[2]) == VT_NONE &&
+					vtk_legacy_type(tok[3]) != VT_NONE) {
+					a.name += tok[2];
+					k = 3;
+				}
+				VtkValueType type = vtk_legacy_type(tok[k]);
+				a.ncomp = ( tok.size() > k + 1 ) ? atoi(tok[k+1].c_str()) : 1;
+				if (a.ncomp <= 0) { ok = false; break; }
+				if (vtk_peek_keyword(ifs, &eof) == "LOOKUP_TABLE") vtk_next_line(ifs, &tok);
+				ok = vtk_read_legacy_values(ifs, binary, type, ntuple * a.ncomp, &a);
+				section->push_back(a);
+			}
+			else if (( kw == "VECTORS" || kw == "NORMALS" ) && section != NULL && tok.size() >= 3) {
+				VtkRawArray a;
+				a.name = tok[1];
+				a.ncomp = 3;
+				ok = vtk_read_legacy_values(ifs, binary, vtk_legacy_type(tok[2]), ntuple * 3, &a);
+				section->push_back(a);
+			}
+			else if (kw == "FIELD" && section != NULL && tok.size() >= 3) {
+				int narray = atoi(tok[2].c_str());
+				for (int i = 0; ok && i < narray; i++) {
+					if (!vtk_next_line(ifs, &tok) || tok.size() < 4) { ok = false; break; }
+					VtkRawArray a;
+					a.name = tok[0];
+					a.ncomp = atoi(tok[1].c_str());
+					if (a.ncomp <= 0) { ok = false; break; }
+					ok = vtk_read_legacy_values(ifs, binary, vtk_legacy_type(tok[3]),
+						atol(tok[2].c_str()) * a.ncomp, &a);
+					section->push_back(a);
+				}
+			}
+			else if (kw == "METADATA") {
+				// 空行まで読み飛ばす
+				while (std::getline(ifs, line) && line.find_first_not_of(" \t\r") != std::string::npos)
+					;
+			}
+			else {
+				PL_ERROSH << "[ERROR]vtk:vtk_read():unsupported keyword " << kw << ": " << fname << std::endl;
 				return PLSTAT_VTK_IO_ERROR;
 			}
-			ofs<<"LOOKUP_TABLE default"<<std::endl;
-			vlistout=vertex_list->get_vertex_lists();
-			for(int j=0;j<vlistout->size();++j){
-				DVertex *dv=dynamic_cast<DVertex*>( (*vlistout)[j] );
-				//      PL_REAL tmp=dv->get_scalar(i);
-				PL_REAL tmp=dv->get_scalar(i);
-
-#ifdef DEBUG
-				PL_DBGOSH << __func__ << " i,j "<<i<<" "<<j<<" "<<tmp <<std::endl;
-#endif
+		}
+		if (!ok) {
+			PL_ERROSH << "[ERROR]vtk:vtk_read():Error in loading: " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
 
-				tt_write(ofs, &tmp,sizeof(PL_REAL),1,inv);
+		// バイナリのバイト順。規格はビッグエンディアンだが、vtk_b_save()は
+		// マシンのバイト順で出力しているので、最初のセルから判定する
+		bool swap = false;
+		if (binary && piece.ncells > 0) {
+			long long v = 0;
+			if (piece.legacy_cells && piece.connectivity.nvalue > 0) {
+				v = vtk_value_at(piece.connectivity, 0, false);
 			}
-			ofs <<std::endl;
+			else if (!piece.legacy_cells && piece.offsets.nvalue > 1) {
+				v = vtk_value_at(piece.offsets, 1, false);
+			}
+			swap = ( v < 1 || v > 65536 );
 		}
 
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " end SCALARS"<<std::endl;
-#endif
+		POLYLIB_STAT ret = vtk_append_piece(piece, swap, scale, true, fname, mesh);
+		vtk_finish_mesh(mesh);
 
+		// vtk_a_save()、vtk_b_save()はidを出力しないので、読み込み側で振り直す
+		if (ret == PLSTAT_OK && mesh->ids.empty() && mesh->ntri() > 0) {
+			PL_ERROSH << "[WARNING]vtk:vtk_read():no \"id\" cell data, triangle ids are renumbered 0.."
+				<< mesh->ntri() - 1 << ": " << fname << std::endl;
+		}
+		return ret;
+}
 
+//  XMLのタグ
+struct VtkXmlTag {
+	std::string							name;	// 終了タグは'/'で始まる
+	std::map<std::string,std::string>	attrs;
+	bool								empty;	// <.../>
+};
+
+//  [*pos,len)から次のタグを読む。*posはタグの次の位置になる
+static bool vtk_xml_next_tag(
+	const char* buf,
+	size_t len,
+	size_t* pos,
+	VtkXmlTag* tag
+	)
+{
+	size_t p = *pos;
+	for (;;) {
+		while (p < len && buf[p] != '<') p++;
+		if (p + 1 >= len) return false;
+		if (buf[p+1] == '?' || buf[p+1] == '!') {
+			// 宣言、コメント
+			const char* term = ( buf[p+1] == '!' && p + 3 < len && buf[p+2] == '-' ) ? "-->" : ">";
+			const char* e = std::search(buf + p, buf + len, term, term + strlen(term));
+			if (e == buf + len) return false;
+			p = ( e - buf ) + strlen(term);
+			continue;
+		}
+		break;
+	}
+	p++;
+	tag->name.clear();
+	tag->attrs.clear();
+	tag->empty = false;
+	while (p < len && !isspace((unsigned char)buf[p]) && buf[p] != '>' &&
+		!( buf[p] == '/' && !tag->name.empty() )) {
+		tag->name += buf[p++];
+	}
+	for (;;) {
+		while (p < len && isspace((unsigned char)buf[p])) p++;
+		if (p >= len) return false;
+		if (buf[p] == '>') { p++; break; }
+		if (buf[p] == '/') { tag->empty = true; p++; continue; }
+		std::string key;
+		while (p < len && buf[p] != '=' && !isspace((unsigned char)buf[p]) && buf[p] != '>') key += buf[p++];
+		while (p < len && isspace((unsigned char)buf[p])) p++;
+		if (p >= len || buf[p] != '=') continue;
+		p++;
+		while (p < len && isspace((unsigned char)buf[p])) p++;
+		if (p >= len || ( buf[p] != '"' && buf[p] != '\'' )) return false;
+		char quote = buf[p++];
+		std::string value;
+		while (p < len && buf[p] != quote) value += buf[p++];
+		p++;
+		tag->attrs[key] = value;
+	}
+	*pos = p;
+	return true;
+}
 
-		for(int i=0;i<dvm->nvector();++i){
+//  属性値の取得。無い場合はdef
+static std::string vtk_xml_attr(
+	const VtkXmlTag& tag,
+	const char* key,
+	const char* def
+	)
+{
+	std::map<std::string,std::string>::const_iterator it = tag.attrs.find(key);
+	return ( it != tag.attrs.end() ) ? it->second : std::string(def);
+}
+
+//  base64の[p,end)を復号してoutに追加する。空白は無視する
+static const char* vtk_base64_decode(
+	const char* p,
+	const char* end,
+	size_t nchar,
+	std::vector<char>* out
+	)
+{
+	unsigned int acc = 0;
+	int nbits = 0;
+	size_t n = 0;
+	for (; p < end && n < nchar; p++) {
+		char c = *p;
+		int v;
+		if (c >= 'A' && c <= 'Z')		v = c - 'A';
+		else if (c >= 'a' && c <= 'z')	v = c - 'a' + 26;
+		else if (c >= '0' && c <= '9')	v = c - '0' + 52;
+		else if (c == '+')				v = 62;
+		else if (c == '/')				v = 63;
+		else if (c == '=')				{ n++; continue; }
+		else							continue;
+		n++;
+		acc = ( acc << 6 ) | v;
+		nbits += 6;
+		if (nbits >= 8) {
+			nbits -= 8;
+			out->push_back( (char)( ( acc >> nbits ) & 0xff ) );
+		}
+	}
+	return p;
+}
 
-			ofs << "VECTORS polylib_Vector_data"<<i;
+//  ヘッダ(配列のバイト数)の値
+static size_t vtk_xml_header_value(
+	const char* p,
+	int header_size,
+	bool swap
+	)
+{
+	VtkRawArray h;
+	h.type = ( header_size == 8 ) ? VT_UINT64 : VT_UINT32;
+	h.native = false;
+	h.nvalue = 1;
+	h.data.assign(p, p + header_size);
+	return (size_t)vtk_value_at(h, 0, swap);
+}
 
-			if(sizeof(PL_REAL)==4){
-				ofs <<" float"<<std::endl;
-			} else if(sizeof(PL_REAL)==8) {
-				ofs << " double"<<std::endl;
-			} else {
-				PL_ERROSH << "[ERROR]vtk:vtk_a_save():wrong data type with sizeof(PL_REAL)="<<sizeof(PL_REAL) << std::endl;
-				return PLSTAT_VTK_IO_ERROR;
+///////////////////////////////////////////////////////////////
+
+POLYLIB_STAT vtu_read(
+	std::string fname,
+	VtkMesh* mesh,
+	PL_REAL scale
+	){
+
+		std::ifstream ifs(fname.c_str(), std::ios::in | std::ios::binary);
+		if (ifs.fail()) {
+			PL_ERROSH << "[ERROR]vtk:vtu_read():Can't open " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		*mesh = VtkMesh();
+
+		// ファイル全体を読み込む
+		ifs.seekg(0, std::ios::end);
+		size_t len = ifs.tellg();
+		ifs.seekg(0, std::ios::beg);
+		std::vector<char> file(len + 1, '\0');
+		if (len > 0) ifs.read(&file[0], len);
+		if (ifs.fail()) {
+			PL_ERROSH << "[ERROR]vtk:vtu_read():Error in loading: " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		const char* buf = &file[0];
+
+		// AppendedDataの位置。タグ'>'の後の'_'の次から
+		const char app_tag[] = "<AppendedData";
+		const char* app = std::search(buf, buf + len, app_tag, app_tag + strlen(app_tag));
+		size_t limit = app - buf;
+		size_t app_base = len;
+		bool app_base64 = false;
+		if (limit < len) {
+			size_t p = limit;
+			VtkXmlTag tag;
+			if (!vtk_xml_next_tag(buf, len, &p, &tag)) p = len;
+			app_base64 = ( vtk_xml_attr(tag, "encoding", "raw") == "base64" );
+			while (p < len && buf[p] != '_') p++;
+			app_base = p + 1;
+		}
+
+		bool polydata = false;
+		bool swap = false;
+		int header_size = 4;
+		bool first = true;
+		VtkPiece piece;
+		std::string section;
+		size_t pos = 0;
+		VtkXmlTag tag;
+		while (vtk_xml_next_tag(buf, limit, &pos, &tag)) {
+			if (tag.name == "VTKFile") {
+				std::string type = vtk_xml_attr(tag, "type", "");
+				if (type != "UnstructuredGrid" && type != "PolyData") {
+					PL_ERROSH << "[ERROR]vtk:vtu_read():unsupported type " << type << ": " << fname << std::endl;
+					return PLSTAT_VTK_IO_ERROR;
+				}
+				if (vtk_xml_attr(tag, "compressor", "") != "") {
+					PL_ERROSH << "[ERROR]vtk:vtu_read():compressed data is not supported: " << fname << std::endl;
+					return PLSTAT_VTK_IO_ERROR;
+				}
+				polydata = ( type == "PolyData" );
+				bool big = ( vtk_xml_attr(tag, "byte_order", "LittleEndian") == "BigEndian" );
+				swap = big != ( tt_check_machine_endian() != TT_LITTLE_ENDIAN );
+				header_size = ( vtk_xml_attr(tag, "header_type", "UInt32") == "UInt64" ) ? 8 : 4;
 			}
-			//  ofs<<"LOOKUP_TABLE default"<<std::endl;
-			vlistout=vertex_list->get_vertex_lists();
-			for(int j=0;j<vlistout->size();++j){
-
-				DVertex *dv=dynamic_cast<DVertex*>( (*vlistout)[j] );
-				Vec3<PL_REAL> vec3 ;
-				dv->get_vector(i,&vec3);
-#ifdef DEBUG
-				PL_DBGOSH << __func__ << " i,j "<<i<<" "<<j<<" "<< vec3<<std::endl;
-#endif
+			else if (tag.name == "Piece") {
+				piece = VtkPiece();
+				piece.npoints = atol(vtk_xml_attr(tag, "NumberOfPoints", "0").c_str());
+				if (polydata) {
+					piece.ncells = atol(vtk_xml_attr(tag, "NumberOfPolys", "0").c_str());
+					// セルデータはVerts、Lines、Polys、Stripsの順
+					piece.cell_offset = atol(vtk_xml_attr(tag, "NumberOfVerts", "0").c_str()) +
+						atol(vtk_xml_attr(tag, "NumberOfLines", "0").c_str());
+				}
+				else {
+					piece.ncells = atol(vtk_xml_attr(tag, "NumberOfCells", "0").c_str());
+				}
+			}
+			else if (tag.name == "/Piece") {
+				POLYLIB_STAT ret = vtk_append_piece(piece, swap, scale, first, fname, mesh);
+				if (ret != PLSTAT_OK) return ret;
+				first = false;
+			}
+			else if (tag.name == "Points" || tag.name == "Cells" || tag.name == "Polys" ||
+				tag.name == "Verts" || tag.name == "Lines" || tag.name == "Strips" ||
+				tag.name == "PointData" || tag.name == "CellData") {
+				section = tag.empty ? "" : tag.name;
+			}
+			else if (tag.name[0] == '/' && tag.name != "/DataArray") {
+				section = "";
+			}
+			else if (tag.name == "DataArray") {
+				VtkRawArray a;
+				a.name = vtk_xml_attr(tag, "Name", "");
+				a.type = vtk_xml_type(vtk_xml_attr(tag, "type", ""));
+				a.ncomp = atoi(vtk_xml_attr(tag, "NumberOfComponents", "1").c_str());
+				a.native = false;
+				int size = vtk_type_size(a.type);
+				std::string format = vtk_xml_attr(tag, "format", "ascii");
+
+				// 要素の内容
+				const char* cbeg = buf + pos;
+				const char* cend = cbeg;
+				if (!tag.empty) {
+					const char end_tag[] = "</DataArray>";
+					cend = std::search(cbeg, buf + limit, end_tag, end_tag + strlen(end_tag));
+					pos = ( cend - buf ) + strlen(end_tag);
+				}
 
-				PL_REAL ovector[3];
-				ovector[0]=vec3[0];
-				ovector[1]=vec3[1];
-				ovector[2]=vec3[2];
-				tt_write(ofs, ovector,sizeof(PL_REAL),3,inv);
+				bool ok = ( size > 0 && a.ncomp > 0 );
+				if (ok && format == "appended") {
+					size_t off = app_base + atol(vtk_xml_attr(tag, "offset", "0").c_str());
+					if (!app_base64) {
+						ok = off + header_size <= len;
+						size_t nbytes = ok ? vtk_xml_header_value(buf + off, header_size, swap) : 0;
+						ok = ok && off + header_size + nbytes <= len;
+						if (ok) a.data.assign(buf + off + header_size, buf + off + header_size + nbytes);
+					}
+					else {
+						std::vector<char> h;
+						const char* p = vtk_base64_decode(buf + off, buf + len, ( header_size + 2 ) / 3 * 4, &h);
+						ok = ( (int)h.size() >= header_size );
+						size_t nbytes = ok ? vtk_xml_header_value(&h[0], header_size, swap) : 0;
+						if (ok) vtk_base64_decode(p, buf + len, ( nbytes + 2 ) / 3 * 4, &a.data);
+						if (a.data.size() > nbytes) a.data.resize(nbytes);
+						ok = ok && a.data.size() == nbytes;
+					}
+				}
+				else if (ok && format == "binary") {
+					// ヘッダとデータを別々に、または続けて符号化したもの
+					std::vector<char> h;
+					const char* p = vtk_base64_decode(cbeg, cend, ( header_size + 2 ) / 3 * 4, &h);
+					ok = ( (int)h.size() >= header_size );
+					size_t nbytes = ok ? vtk_xml_header_value(&h[0], header_size, swap) : 0;
+					if (ok) {
+						vtk_base64_decode(p, cend, ( nbytes + 2 ) / 3 * 4, &a.data);
+						if (a.data.size() < nbytes) {
+							a.data.clear();
+							vtk_base64_decode(cbeg, cend, len, &a.data);
+							if (a.data.size() >= header_size + nbytes) {
+								a.data.erase(a.data.begin(), a.data.begin() + header_size);
+							}
+						}
+						if (a.data.size() > nbytes) a.data.resize(nbytes);
+						ok = ( a.data.size() == nbytes );
+					}
+				}
+				else if (ok && format == "ascii") {
+					ok = vtk_parse_ascii_values(cbeg, cend, &a);
+					size = sizeof(double);
+				}
+				else {
+					ok = false;
+				}
+				if (!ok) {
+					PL_ERROSH << "[ERROR]vtk:vtu_read():wrong DataArray " << a.name << ": " << fname << std::endl;
+					return PLSTAT_VTK_IO_ERROR;
+				}
+				a.nvalue = a.data.size() / size;
+
+				if (section == "Points")						piece.points = a;
+				else if (section == "Cells" || section == "Polys") {
+					if (a.name == "connectivity")			piece.connectivity = a;
+					else if (a.name == "offsets")			piece.offsets = a;
+					else if (a.name == "types")				piece.types = a;
+				}
+				else if (section == "PointData")			piece.point_data.push_back(a);
+				else if (section == "CellData")			piece.cell_data.push_back(a);
 			}
-			ofs <<std::endl;
 		}
+		if (first) {
+			PL_ERROSH << "[ERROR]vtk:vtu_read():no Piece: " << fname << std::endl;
+			return PLSTAT_VTK_IO_ERROR;
+		}
+		vtk_finish_mesh(mesh);
+		return PLSTAT_OK;
+}
 
-
-#ifdef DEBUG
-		PL_DBGOSH << __func__ << " end VECTORS"<<std::endl;
+//  読み込んだメッシュをvertex_list、tri_listに追加する
+static void vtk_mesh_to_list(
+	const VtkMesh& mesh,
+	VertexList* vertex_list,
+	std::vector<PrivateTriangle*> *tri_list,
+	int *total
+	)
+{
+	int nvert = mesh.nvert();
+	int ntri = mesh.ntri();
+	std::vector<Vertex*> vlist(nvert);
+	for (int i = 0; i < nvert; i++) {
+		vlist[i] = new Vertex(Vec3<PL_REAL>(mesh.coords[i*3], mesh.coords[i*3+1], mesh.coords[i*3+2]));
+		vertex_list->vtx_add_nocheck(vlist[i]);
+	}
+	size_t tri_base = tri_list->size();
+	tri_list->resize(tri_base + ntri);
+#ifdef _OPENMP
+#pragma omp parallel for
 #endif
+	for (int i = 0; i < ntri; i++) {
+		Vertex* vtx[3];
+		for (int j = 0; j < 3; j++) vtx[j] = vlist[ mesh.index[i*3+j] ];
+		int exid = mesh.exids.empty() ? 0 : mesh.exids[i];
+		(*tri_list)[tri_base + i] = new PrivateTriangle(vtx, *total + i, exid);
+	}
+	*total += ntri;
+}
 
-#undef DEBUG
+///////////////////////////////////////////////////////////////
 
+POLYLIB_STAT vtk_load(
+	VertexList* vertex_list,
+	std::vector<PrivateTriangle*> *tri_list,
+	std::string fname,
+	int *total,
+	PL_REAL scale
+	){
+		VtkMesh mesh;
+		POLYLIB_STAT ret = vtk_read(fname, &mesh, scale);
+		if (ret != PLSTAT_OK) return ret;
+		vtk_mesh_to_list(mesh, vertex_list, tri_list, total);
+		return PLSTAT_OK;
+}
+
+///////////////////////////////////////////////////////////////
+
+POLYLIB_STAT vtu_load(
+	VertexList* vertex_list,
+	std::vector<PrivateTriangle*> *tri_list,
+	std::string fname,
+	int *total,
+	PL_REAL scale
+	){
+		VtkMesh mesh;
+		POLYLIB_STAT ret = vtu_read(fname, &mesh, scale);
+		if (ret != PLSTAT_OK) return ret;
+		vtk_mesh_to_list(mesh, vertex_list, tri_list, total);
 		return PLSTAT_OK;
 }
 
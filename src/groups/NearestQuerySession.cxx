@@ -0,0 +1,217 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#include "groups/NearestQuerySession.h"
+#include "groups/PolygonGroup.h"
+#include "polygons/PrivateTriangle.h"
+#include "polygons/Vertex.h"
+#include "Polylib.h"
+
+namespace PolylibNS {
+
+//  グループとその子孫のリーフグループを集める
+static void collect_leaves(
+	PolygonGroup				*pg,
+	std::vector<PolygonGroup*>	*leaves
+	)
+{
+	std::vector<PolygonGroup*>& children = pg->get_children();
+	if (children.empty()) {
+		leaves->push_back(pg);
+		return;
+	}
+	for (size_t i = 0; i < children.size(); i++) collect_leaves(children[i], leaves);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+NearestQuerySession::NearestQuerySession()
+{
+	m_nwarm = 0;
+	m_ncold = 0;
+	m_nsame = 0;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT NearestQuerySession::init(
+	const Polylib		*pl,
+	const std::string&	group_name,
+	int					npoints
+	)
+{
+	if (pl == NULL) return PLSTAT_ARGUMENT_NULL;
+	m_groups.clear();
+	m_entries.clear();
+	reset_stats();
+
+	PolygonGroup* pg = pl->get_group(group_name);
+	if (pg == NULL) {
+		PL_ERROSH << "[ERROR]NearestQuerySession::init():Group not found: "
+			<< group_name << std::endl;
+		return PLSTAT_GROUP_NOT_FOUND;
+	}
+	collect_leaves(pg, &m_groups);
+	m_entries.resize(npoints < 0 ? 0 : npoints);
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void NearestQuerySession::clear()
+{
+	for (size_t i = 0; i < m_entries.size(); i++) m_entries[i] = Entry();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void NearestQuerySession::reset_stats()
+{
+	m_nwarm = 0;
+	m_ncold = 0;
+	m_nsame = 0;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+const PrivateTriangle* NearestQuerySession::search(
+	int						i,
+	const Vec3<PL_REAL>&	pos,
+	Vec3<PL_REAL>*			foot,
+	PL_REAL					bary[3],
+	PL_REAL*				dist2
+	)
+{
+	long long stat[3] = { 0, 0, 0 };
+	const PrivateTriangle* tri = search_point(i, pos, foot, bary, dist2, stat);
+	__sync_fetch_and_add(&m_nwarm, stat[0]);
+	__sync_fetch_and_add(&m_ncold, stat[1]);
+	__sync_fetch_and_add(&m_nsame, stat[2]);
+	return tri;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT NearestQuerySession::search_all(
+	const PL_REAL			*pos,
+	const PrivateTriangle	**tris,
+	PL_REAL					*foot,
+	PL_REAL					*dist2
+	)
+{
+	if (pos == NULL || tris == NULL) return PLSTAT_ARGUMENT_NULL;
+
+	// 遅延読み込みは並列検索の前に済ませる
+	for (size_t g = 0; g < m_groups.size(); g++) {
+		POLYLIB_STAT ret = m_groups[g]->load_deferred();
+		if (ret != PLSTAT_OK) return ret;
+	}
+
+	int npoints = num_points();
+	long long nwarm = 0, ncold = 0, nsame = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,256) reduction(+:nwarm,ncold,nsame)
+#endif
+	for (int i = 0; i < npoints; i++) {
+		long long stat[3] = { 0, 0, 0 };
+		Vec3<PL_REAL> p(pos[i*3], pos[i*3+1], pos[i*3+2]);
+		Vec3<PL_REAL> f;
+		PL_REAL d2 = 0;
+		tris[i] = search_point(i, p, &f, NULL, &d2, stat);
+		if (foot != NULL) {
+			foot[i*3] = f[0];
+			foot[i*3+1] = f[1];
+			foot[i*3+2] = f[2];
+		}
+		if (dist2 != NULL) dist2[i] = d2;
+		nwarm += stat[0];
+		ncold += stat[1];
+		nsame += stat[2];
+	}
+	m_nwarm += nwarm;
+	m_ncold += ncold;
+	m_nsame += nsame;
+	return PLSTAT_OK;
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+const PrivateTriangle* NearestQuerySession::search_point(
+	int						i,
+	const Vec3<PL_REAL>&	pos,
+	Vec3<PL_REAL>*			foot,
+	PL_REAL					bary[3],
+	PL_REAL*				dist2,
+	long long				stat[3]
+	)
+{
+	Entry& e = m_entries[i];
+	const PrivateTriangle* tri_min = 0;
+	int group_min = -1;
+	PL_CALC_REAL bound2 = -1;
+	PL_REAL w[3] = { 0, 0, 0 };
+	PL_REAL d2_min = 0;
+
+	// 前回の三角形までの現在の距離を上限として始める
+	if (e.tri != 0 && m_groups[e.group]->get_tree_generation() == e.generation) {
+		PL_CALC_REAL d2;
+		e.tri->closest_point(m_groups[e.group]->to_local_pos(pos), w, &d2);
+		tri_min = e.tri;
+		group_min = e.group;
+		bound2 = d2;
+		d2_min = (PL_REAL)d2;
+		stat[0]++;
+	}
+	else {
+		stat[1]++;
+	}
+
+	// 上限より近い三角形があるグループだけが結果を返す
+	for (size_t g = 0; g < m_groups.size(); g++) {
+		PL_REAL gw[3], gd2;
+		const PrivateTriangle* tri =
+			m_groups[g]->search_nearest_surface_within(pos, bound2, NULL, gw, &gd2);
+		if (tri == NULL) continue;
+		tri_min = tri;
+		group_min = (int)g;
+		bound2 = gd2;
+		d2_min = gd2;
+		w[0] = gw[0]; w[1] = gw[1]; w[2] = gw[2];
+	}
+
+	if (e.tri != 0 && tri_min == e.tri && stat[0] != 0) stat[2]++;
+	e.tri = tri_min;
+	e.group = group_min;
+	e.generation = (group_min >= 0) ? m_groups[group_min]->get_tree_generation() : 0;
+	if (tri_min == 0) return NULL;
+
+	if (bary != NULL) {
+		bary[0] = w[0]; bary[1] = w[1]; bary[2] = w[2];
+	}
+	if (dist2 != NULL) *dist2 = d2_min;
+	if (foot != NULL) {
+		Vertex** v = tri_min->get_vertex();
+		Vec3<PL_REAL> f;
+		for (int k = 0; k < 3; k++) {
+			f[k] = w[0]*(*v[0])[k] + w[1]*(*v[1])[k] + w[2]*(*v[2])[k];
+		}
+		*foot = m_groups[group_min]->to_world_pos(f);
+	}
+	return tri_min;
+}
+
+} //namespace PolylibNS
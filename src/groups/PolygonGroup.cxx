@@ -21,16 +21,30 @@
 #include <string>
 #include <iomanip>
 #include <algorithm>
+#include <set>
+#include <cmath>
 
 #include <sstream>
+#include <fstream>
+#include <sched.h>
 #include "polygons/PrivateTriangle.h"
 
 #include "common/BBox.h"
 
 #include "polygons/TriMesh.h"
+#include "polygons/TriaIdIndex.h"
+#include "polygons/TriangleAdjacency.h"
+#include "polygons/TrianglePair.h"
+#include "polygons/VTree.h"
+#include "polygons/VertexList.h"
 #include "polygons/DVertexManager.h"
+#include "polygons/DVertex.h"
 #include "file_io/TriMeshIO.h"
 #include "file_io/triangle_id.h"
+#include "file_io/mesh_write.h"
+#include "file_io/CheckpointWriter.h"
+#include "file_io/mesh_cache.h"
+#include "util/PolylibProfiler.h"
 
 #include "Polylib.h"
 
@@ -38,6 +52,38 @@
 
 namespace PolylibNS {
 
+/// 遅延読み込みの状態(m_load_state)
+enum {
+	LOAD_DONE		= 0,	///< 読み込み済み(遅延読み込みでない)
+	LOAD_DEFERRED	= 1,	///< 未読み込み
+	LOAD_RUNNING	= 2		///< 読み込み中
+};
+
+// std::sort用ファンクタ
+struct TriaIdLess {
+	bool operator()( const PrivateTriangle *l, const PrivateTriangle *r ) const
+	{
+		return l->get_id() < r->get_id();
+	}
+};
+
+//  出力用にID順の三角形リストを返す。三角形リストは追加・削除により
+//  ID順とは限らないため、ID順でなければsortedへ並べ替えた複製を作る。
+static std::vector<PrivateTriangle*>* id_sorted_triangles(
+	std::vector<PrivateTriangle*>	*tri_list,
+	std::vector<PrivateTriangle*>	*sorted
+	)
+{
+	if( tri_list == NULL ) return tri_list;
+	for( size_t i=1; i<tri_list->size(); i++ ) {
+		if( (*tri_list)[i-1]->get_id() > (*tri_list)[i]->get_id() ) {
+			*sorted = *tri_list;
+			std::sort( sorted->begin(), sorted->end(), TriaIdLess() );
+			return sorted;
+		}
+	}
+	return tri_list;
+}
 
 ///
 /// 他クラスでも使用するXMLタグ
@@ -60,6 +106,12 @@ const char* PolygonGroup::ATT_NAME_TOLERANCE = "tolerance";
 #define ATT_NAME_LABEL		"label"
 // ユーザ定義タイプ追加 2013.07.17
 #define ATT_NAME_TYPE		"type"
+// 剛体インスタンシング追加
+#define ATT_NAME_INSTANCING	"instancing"
+// 空間充填曲線による並べ替え追加
+#define ATT_NAME_REORDER	"reorder"
+
+#define ATT_NAME_SNAPSHOT	"snapshot"
 
 //=======================================================================
 // Setter/Getter
@@ -205,6 +257,7 @@ void PolygonGroup::remove_child(PolygonGroup* p) {
 /// @return  頂点リスト
 ///
 VertexList* PolygonGroup::get_vertexlist() {
+	load_deferred();
 	return m_polygons->get_vtx_list();
 }
 
@@ -214,6 +267,7 @@ VertexList* PolygonGroup::get_vertexlist() {
 /// @return KD木ポリゴンリスト。
 ///
 VertKDT* PolygonGroup::get_vertkdt() {
+	load_deferred();
 	return m_polygons->get_vertkdt();
 }
 ///
@@ -222,6 +276,7 @@ VertKDT* PolygonGroup::get_vertkdt() {
 /// @return 三角形ポリゴンリスト。
 ///
 std::vector<PrivateTriangle*>* PolygonGroup::get_triangles() {
+	load_deferred();
 	return m_polygons->get_tri_list();
 }
 
@@ -231,6 +286,7 @@ std::vector<PrivateTriangle*>* PolygonGroup::get_triangles() {
 /// @return KD木ポリゴンリスト。
 ///
 VTree* PolygonGroup::get_vtree() {
+	load_deferred();
 	return m_polygons->get_vtree();
 }
 
@@ -284,13 +340,23 @@ int PolygonGroup::get_movable() {
 }
 
 ///
-/// move()による移動前三角形一時保存リストの個数を取得。
+/// move()による移動前頂点座標の一時保存数を取得。
 ///
-///  @return 一時保存リストサイズ。
+///  @return 一時保存した頂点数。
 ///
-size_t PolygonGroup::get_num_of_trias_before_move() {
-	if (m_trias_before_move == NULL)	return 0;
-	else	return m_trias_before_move->size();
+size_t PolygonGroup::get_num_of_vertices_before_move() {
+	return m_coords_before_move.size() / 3;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolygonGroup::memory_usage( PolylibMemoryUsage* p_usage ) const
+{
+	p_usage->m_other += sizeof(PolygonGroup)
+		+ m_children.capacity() * sizeof(PolygonGroup*)
+		+ m_coords_before_move.capacity() * sizeof(PL_REAL);
+	if( m_polygons != NULL ) m_polygons->memory_usage( p_usage );
+	m_snapshot_slot.memory_usage( p_usage );
 }
 
 
@@ -322,7 +388,21 @@ PolygonGroup::PolygonGroup() {
 	m_polygons	= new TriMesh();
 	m_movable	= false;
 	m_need_rebuild = false;
-	m_trias_before_move = NULL;
+	m_rigid_instancing = false;
+	m_reorder = SpaceFillingCurve::SFC_NONE;
+	m_snapshot_enabled = false;
+	m_load_state = LOAD_DONE;
+	m_deferred_stat = PLSTAT_OK;
+	m_deferred_with_id = false;
+	m_deferred_id_format = ID_BIN;
+	m_deferred_bbox_known = false;
+	m_load_scale = 1.0;
+	m_load_bbox.init();
+	m_cache_dir = "";
+	m_tree_generation = 0;
+	m_id = 0;
+	m_id_defined = false;
+	reset_rigid_frame();
 	///	m_DVM_ptr=NULL;
 }
 // public /////////////////////////////////////////////////////////////////////
@@ -332,8 +412,22 @@ PolygonGroup::PolygonGroup(PL_REAL tolerance) {
 	m_polygons	= new TriMesh(tolerance);
 	m_movable	= false;
 	m_need_rebuild = false;
-	m_trias_before_move = NULL;
 	m_tolerance=tolerance;
+	m_rigid_instancing = false;
+	m_reorder = SpaceFillingCurve::SFC_NONE;
+	m_snapshot_enabled = false;
+	m_load_state = LOAD_DONE;
+	m_deferred_stat = PLSTAT_OK;
+	m_deferred_with_id = false;
+	m_deferred_id_format = ID_BIN;
+	m_deferred_bbox_known = false;
+	m_load_scale = 1.0;
+	m_load_bbox.init();
+	m_cache_dir = "";
+	m_tree_generation = 0;
+	m_id = 0;
+	m_id_defined = false;
+	reset_rigid_frame();
 	//	m_DVM_ptr=NULL;
 }
 
@@ -345,12 +439,6 @@ PolygonGroup::~PolygonGroup()
 	PL_DBGOSH << "Delete PolygonGroup" << std::endl;
 #endif
 	delete m_polygons;
-	if( m_trias_before_move ) {
-		for( unsigned int i=0; i<m_trias_before_move->size(); i++ ) {
-			delete m_trias_before_move->at(i);
-		}
-		delete m_trias_before_move;
-	}
 
 	// if(m_DVM_ptr!=NULL){
 	//   delete m_DVM_ptr;
@@ -374,6 +462,8 @@ POLYLIB_STAT PolygonGroup::init(
 #endif
 
 
+		// 新しいメッシュはワールド座標系なので、保留中の剛体変換は破棄する
+		reset_rigid_frame();
 		m_polygons->init(vertlist,idlist,exidlist,n_start_tri,n_start_id,n_start_exid,n_tri);
 #ifdef DEBUG
 		PL_DBGOSH <<"PolygonGroup::" << __func__<<" end of Polygons::init."  <<std::endl;
@@ -410,6 +500,8 @@ POLYLIB_STAT PolygonGroup::init_dvertex(
 
 
 
+		// 新しいメッシュはワールド座標系なので、保留中の剛体変換は破棄する
+		reset_rigid_frame();
 		m_polygons->init_dvertex(vertlist,idlist,exidlist,scalarlist,vectorlist,
 			n_start_tri,n_start_id,n_start_exid,n_start_scalar,n_start_vector,
 			n_tri,n_scalar,n_vector);
@@ -423,6 +515,32 @@ POLYLIB_STAT PolygonGroup::init_dvertex(
 }
 
 
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::init_dvertex_indexed(
+	const PL_REAL* coords,
+	const int nvert,
+	const int* index,
+	const int ntri,
+	const int* idlist,
+	const int* exidlist,
+	const PL_REAL* scalarlist,
+	const PL_REAL* vectorlist,
+	const bool weld){
+
+		// 新しいメッシュはワールド座標系なので、保留中の剛体変換は破棄する
+		reset_rigid_frame();
+		POLYLIB_STAT ret = m_polygons->init_dvertex_indexed(coords,nvert,index,ntri,
+			idlist,exidlist,scalarlist,vectorlist,weld);
+		if (ret != PLSTAT_OK) {
+			PL_ERROSH << "[ERROR]PolygonGroup::init_dvertex_indexed():failed:"
+				<< m_name << std::endl;
+			return ret;
+		}
+		return build_polygon_tree();
+}
+
+
 // public /////////////////////////////////////////////////////////////////////
 
 POLYLIB_STAT PolygonGroup::add_dvertex(
@@ -448,6 +566,9 @@ POLYLIB_STAT PolygonGroup::add_dvertex(
 
 
 
+		// 追加する三角形はワールド座標なので、先に変換を頂点へ反映する
+		load_deferred();
+		bake_rigid_transform();
 		m_polygons->add_dvertex(vertlist,idlist,exidlist,scalarlist,vectorlist,
 			n_start_tri,n_start_id,n_start_exid,n_start_scalar,n_start_vector,
 			n_tri,n_scalar,n_vector);
@@ -475,6 +596,8 @@ POLYLIB_STAT PolygonGroup::init(
 		PL_DBGOSH <<"PolygonGroup::init :clear=" << clear << std::endl;
 #endif
 		if (clear == true) {
+			// 新しいメッシュはワールド座標系なので、保留中の剛体変換は破棄する
+			reset_rigid_frame();
 			m_polygons->init(tri_list);
 
 #ifdef DEBUG
@@ -663,11 +786,7 @@ POLYLIB_STAT PolygonGroup::build_group_tree(
 
 POLYLIB_STAT PolygonGroup::build_polygon_tree()
 {
-#ifdef BENCHMARK
-	double	st1, st2, ut1, ut2, tt1, tt2;
-	bool	ret1, ret2;
-	ret1 = getrusage_sec(&ut1, &st1, &tt1);
-#endif
+	PolylibProfileScope prof( PolylibProfiler::PH_BUILD );
 
 	//#define DEBUG
 #ifdef DEBUG
@@ -676,6 +795,15 @@ POLYLIB_STAT PolygonGroup::build_polygon_tree()
 	// before rebuild Polygon tree vertex_compaction first.
 	//m_polygons->vtx_compaction();
 
+	// 剛体インスタンシング時は、変換を頂点へ反映してから木を作る
+	bake_rigid_transform();
+
+	// 三角形と頂点を空間充填曲線に沿って並べ替え
+	if (m_reorder != SpaceFillingCurve::SFC_NONE) {
+		POLYLIB_STAT ret = m_polygons->reorder(m_reorder);
+		if (ret != PLSTAT_OK) return ret;
+	}
+
 	//木構造の生成
 	POLYLIB_STAT ret = m_polygons->build();
 #ifdef DEBUG
@@ -685,28 +813,51 @@ POLYLIB_STAT PolygonGroup::build_polygon_tree()
 
 	if (ret != PLSTAT_OK) return ret;
 
+	tree_built();
+
 #ifdef DEBUG
 	PL_DBGOSH << "PolygonGroup::build_polygon_tree() out." << std::endl;
-#endif
-#ifdef BENCHMARK
-	ret2 = getrusage_sec(&ut2,&st2,&tt2);
-	if (ret1 == false || ret2 == false) {
-		PL_DBGOSH << "Reading STL SYS Time Error" << std::endl;
-		PL_DBGOSH << "Reading STL CPU Time Error" << std::endl;
-		PL_DBGOSH << "Reading STL Total Time Error" << std::endl;
-	}
-	else{
-		cerr.setf(ios::scientific, ios::floatfield);
-		PL_DBGOSH << "Reading STL SYS   Time:" << st2 - st1 << std::endl;
-		PL_DBGOSH << "Reading STL CPU   Time:" << ut2 - ut1 << std::endl;
-		PL_DBGOSH << "Reading STL Total Time:" << tt2 - tt1 << std::endl;
-		cerr.unsetf(ios::scientific);
-	}
 #endif
 	//#undef DEBUG
 	return PLSTAT_OK;
 }
 
+// protected //////////////////////////////////////////////////////////////////
+
+void PolygonGroup::tree_built()
+{
+	// 三角形へのポインタを保持している検索結果を無効にする
+	m_tree_generation++;
+	m_need_rebuild = false;
+
+	// 構築した木の座標系を新しいローカル座標系とする
+	if (m_rigid_instancing) reset_rigid_frame();
+
+	// 新しい木の複製を公開(古い複製は参照が無くなった時点で解放される)
+	if (m_snapshot_enabled) publish_snapshot();
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+void PolygonGroup::publish_snapshot()
+{
+	double rt[12];
+	bool dirty = get_rigid_transform(rt);
+	m_snapshot_slot.publish( m_polygons->create_snapshot( dirty ? rt : NULL ) );
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+void PolygonGroup::publish_moved_snapshot()
+{
+	if (!m_snapshot_enabled || m_need_rebuild) return;
+	PolygonSnapshotHandle h = m_snapshot_slot.acquire();
+	if (!h.valid()) return;
+	double rt[12];
+	bool dirty = get_rigid_transform(rt);
+	m_snapshot_slot.publish( PolygonSnapshot::create_moved( h.get(), dirty ? rt : NULL ) );
+}
+
 // public /////////////////////////////////////////////////////////////////////
 
 POLYLIB_STAT PolygonGroup::load_stl_file( PL_REAL scale )
@@ -715,6 +866,24 @@ POLYLIB_STAT PolygonGroup::load_stl_file( PL_REAL scale )
 #ifdef DEBUG
 	PL_DBGOSH << "PolygonGroup:load_stl_file():IN" << std::endl;
 #endif
+	m_load_scale = scale;
+
+	// キャッシュがあれば頂点の併合とKD木の構築を省く
+	std::string cache_fname, cache_key;
+	if (!m_cache_dir.empty() && make_cache_key(scale, &cache_key)) {
+		cache_fname = mesh_cache_name(m_cache_dir, cache_key);
+		if (m_polygons->load_cache(cache_fname, cache_key) == PLSTAT_OK) {
+#ifdef DEBUG
+			PL_DBGOSH << "PolygonGroup:load_stl_file():cache hit " << cache_fname << std::endl;
+#endif
+			tree_built();
+			m_load_bbox = m_polygons->get_bbox();
+			return PLSTAT_OK;
+		}
+	}
+
+	// 読み込むメッシュはワールド座標系なので、保留中の剛体変換は破棄する
+	reset_rigid_frame();
 	POLYLIB_STAT ret = m_polygons->import(m_file_name, scale);
 
 #ifdef DEBUG
@@ -731,6 +900,15 @@ POLYLIB_STAT PolygonGroup::load_stl_file( PL_REAL scale )
 	if (ret != PLSTAT_OK) return ret;
 
 	POLYLIB_STAT result= build_polygon_tree();
+	m_load_bbox = m_polygons->get_bbox();
+
+	// キャッシュの作成に失敗しても読み込みは成功とする
+	if (result == PLSTAT_OK && !cache_fname.empty() && !m_polygons->hasDVertex()) {
+		if (m_polygons->save_cache(cache_fname, cache_key) != PLSTAT_OK) {
+			PL_ERROSH << "[WARNING]PolygonGroup::load_stl_file():Can't write cache "
+				<< cache_fname << std::endl;
+		}
+	}
 
 
 #ifdef DEBUG
@@ -774,6 +952,181 @@ POLYLIB_STAT PolygonGroup::load_id_file(
 		return load_id(m_polygons->get_tri_list(), fname, id_format);
 }
 
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::defer_load(
+	bool		with_id_file,
+	ID_FORMAT	id_format,
+	PL_REAL		scale
+	) {
+		m_deferred_with_id = with_id_file;
+		m_deferred_id_format = id_format;
+		m_load_scale = scale;
+		m_deferred_stat = PLSTAT_OK;
+
+		// 全ファイルの外接矩形ファイルが揃っている場合のみ矩形を使う。
+		// 作成後にポリゴンファイルが変わった(サイズ・更新時刻が異なる)ものは使わない
+		m_deferred_bbox.init();
+		m_deferred_bbox_known = !m_file_name.empty();
+		std::map<std::string, std::string>::iterator it;
+		for (it = m_file_name.begin(); it != m_file_name.end(); it++) {
+			std::ifstream ifs((it->first + ".bbox").c_str());
+			PL_REAL v[6];
+			std::string saved_identity, identity;
+			if (!(ifs >> v[0] >> v[1] >> v[2] >> v[3] >> v[4] >> v[5]) ||
+				!(ifs >> std::ws && std::getline(ifs, saved_identity)) ||
+				!mesh_cache_file_identity(it->first, &identity) ||
+				saved_identity != identity) {
+				if (ifs.is_open()) {
+					PL_DBGOSH << "PolygonGroup::defer_load():ignore stale "
+						<< it->first << ".bbox" << std::endl;
+				}
+				m_deferred_bbox_known = false;
+				break;
+			}
+			// 縮尺が負の場合も含め、両端の点を縮尺して加える
+			m_deferred_bbox.add(Vec3<PL_REAL>(v[0], v[1], v[2]) * scale);
+			m_deferred_bbox.add(Vec3<PL_REAL>(v[3], v[4], v[5]) * scale);
+		}
+		if (m_deferred_bbox_known) {
+			// 書き出し・縮尺の丸め誤差を吸収する
+			PL_REAL eps = m_deferred_bbox.diameter() * 1.0e-5 + 1.0e-20;
+			Vec3<PL_REAL> d(eps, eps, eps);
+			m_deferred_bbox.add(m_deferred_bbox.min - d);
+			m_deferred_bbox.add(m_deferred_bbox.max + d);
+		}
+
+#ifdef DEBUG
+		PL_DBGOSH << "PolygonGroup::defer_load():" << acq_fullpath()
+			<< " bbox_known=" << m_deferred_bbox_known << std::endl;
+#endif
+		__sync_synchronize();
+		m_load_state = LOAD_DEFERRED;
+		return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::load_deferred() const
+{
+	if (m_load_state == LOAD_DONE) {
+		__sync_synchronize();
+		return m_deferred_stat;
+	}
+
+	// 読み込みを始めたスレッドが読み込み、他のスレッドは終了を待つ
+	if (!__sync_bool_compare_and_swap(&m_load_state, LOAD_DEFERRED, LOAD_RUNNING)) {
+		while (m_load_state != LOAD_DONE) sched_yield();
+		__sync_synchronize();
+		return m_deferred_stat;
+	}
+
+	PolygonGroup* self = const_cast<PolygonGroup*>(this);
+#ifdef DEBUG
+	PL_DBGOSH << "PolygonGroup::load_deferred():" << self->acq_fullpath() << std::endl;
+#endif
+	// 読み込み前に設定された剛体変換は、読み込むメッシュ(ローカル座標系)に対するもの
+	double rt[12];
+	bool moved = self->get_rigid_transform(rt);
+	POLYLIB_STAT ret = self->load_stl_file(m_load_scale);
+	if (ret == PLSTAT_OK && m_deferred_with_id) {
+		ret = self->load_id_file(m_deferred_id_format);
+	}
+	if (ret == PLSTAT_OK && moved) self->restore_rigid_transform(rt);
+	if (ret != PLSTAT_OK) {
+		PL_ERROSH << "[ERROR]PolygonGroup::load_deferred():" << self->acq_fullpath()
+			<< " returns:" << PolylibStat2::String(ret) << std::endl;
+	}
+	m_deferred_stat = ret;
+
+	// 読み込んだ三角形を見せてから完了とする
+	__sync_synchronize();
+	m_load_state = LOAD_DONE;
+	return ret;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool PolygonGroup::is_load_deferred() const
+{
+	return m_load_state != LOAD_DONE;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolygonGroup::set_cache_dir(
+	std::string		dir
+	) {
+		m_cache_dir = dir;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+std::string PolygonGroup::get_cache_dir() const
+{
+	return m_cache_dir;
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+bool PolygonGroup::make_cache_key(
+	PL_REAL			scale,
+	std::string		*key
+	) const {
+		std::ostringstream oss;
+		std::map<std::string, std::string>::const_iterator it;
+		for (it = m_file_name.begin(); it != m_file_name.end(); it++) {
+			std::string identity;
+			if (!mesh_cache_file_identity(it->first, &identity)) return false;
+			oss << "file " << identity << " " << it->second << "\n";
+		}
+		oss << "scale " << std::setprecision(17) << (double)scale << "\n"
+			<< "reorder " << (int)m_reorder << "\n";
+		if (m_id_defined) oss << "exid " << m_id << "\n";
+		*key = oss.str();
+		return !m_file_name.empty();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::save_bbox_index()
+{
+	POLYLIB_STAT ret = load_deferred();
+	if (ret != PLSTAT_OK) return ret;
+
+	// 縮尺を掛ける前の座標に戻す
+	BBox bbox;
+	bbox.init();
+	if (m_load_scale != 0.0 && m_load_bbox.min[0] <= m_load_bbox.max[0]) {
+		bbox.add(m_load_bbox.min / m_load_scale);
+		bbox.add(m_load_bbox.max / m_load_scale);
+	}
+
+	std::map<std::string, std::string>::iterator it;
+	for (it = m_file_name.begin(); it != m_file_name.end(); it++) {
+		// 2行目にポリゴンファイルの識別情報(パス サイズ 更新時刻)を書く
+		std::string identity;
+		if (!mesh_cache_file_identity(it->first, &identity)) {
+			PL_ERROSH << "[ERROR]PolygonGroup::save_bbox_index():Can't stat "
+				<< it->first << std::endl;
+			return PLSTAT_NG;
+		}
+		std::string fname = it->first + ".bbox";
+		std::ofstream ofs(fname.c_str());
+		if (!ofs) {
+			PL_ERROSH << "[ERROR]PolygonGroup::save_bbox_index():Can't open "
+				<< fname << std::endl;
+			return PLSTAT_NG;
+		}
+		ofs << std::setprecision(9)
+			<< bbox.min[0] << " " << bbox.min[1] << " " << bbox.min[2] << " "
+			<< bbox.max[0] << " " << bbox.max[1] << " " << bbox.max[2] << std::endl
+			<< identity << std::endl;
+		if (!ofs) return PLSTAT_NG;
+	}
+	return PLSTAT_OK;
+}
+
 // TextParser でのsaveの為、save した stl ファイルを記憶しておく
 /////////////////////////////////////////////////////////////////////
 
@@ -784,14 +1137,131 @@ POLYLIB_STAT PolygonGroup::save_stl_file(
 	std::map<std::string,std::string>& stl_fname_map
 	) {
 
-		char	*fname = mk_stl_fname(rank_no, extend, &format,stl_fname_map);
+		std::string	fname = mk_stl_fname(rank_no, extend, &format,stl_fname_map);
 		//  std::cout <<__func__ <<format << std::endl;
 
+		load_deferred();
+
+		// 剛体インスタンシング時は出力中だけワールド座標にする
+		std::vector<PL_REAL> local;
+		apply_world_coords(&local);
+
 		//	return TriMeshIO::save(m_polygons->get_tri_list(), fname, format);
 
-		return TriMeshIO::save( m_polygons->get_vtx_list(),
-			m_polygons->get_tri_list(),
-			fname, format);
+		// 三角形はID順に出力する
+		std::vector<PrivateTriangle*> sorted;
+		std::vector<PrivateTriangle*>* tri_list =
+			id_sorted_triangles(m_polygons->get_tri_list(), &sorted);
+
+		// VTUは並列出力で全ピースの配列を揃えるため、頂点データ数をグループから与える
+		POLYLIB_STAT ret;
+		if (format == TriMeshIO::FMT_VTU) {
+			DVertexManager* dvm = get_DVM();
+			int nscalar = ( dvm != NULL ) ? dvm->nscalar() : 0;
+			int nvector = ( dvm != NULL ) ? dvm->nvector() : 0;
+			ret = vtu_save( m_polygons->get_vtx_list(), tri_list,
+				fname, nscalar, nvector);
+		}
+		else {
+			ret = TriMeshIO::save( m_polygons->get_vtx_list(), tri_list,
+				fname, format);
+		}
+
+		restore_local_coords(local);
+		return ret;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::save_pvtu_file(
+	int						maxrank,
+	const std::vector<int>&	ranks,
+	std::string				extend
+	) {
+		// ピース名。ランク番号の桁数はPolylib::save_with_rankno()に合わせる
+		char	rank_no[16];
+		int		fig = (maxrank > 0) ? (int)log10((double)maxrank) + 1 : 1;
+		std::vector<std::string> pieces;
+		for (size_t i = 0; i < ranks.size(); i++) {
+			snprintf(rank_no, sizeof(rank_no), "%0*d", fig, ranks[i]);
+			pieces.push_back( mk_stl_fname(rank_no, extend, TriMeshIO::FMT_VTU) );
+		}
+
+		// インデックスファイル名は グループ名のフルパス_自由文字列.pvtu
+		std::string fname = mk_stl_fname("", extend, TriMeshIO::FMT_VTU);
+		fname.insert(fname.size() - 3, "p");
+
+		DVertexManager* dvm = get_DVM();
+		int nscalar = ( dvm != NULL ) ? dvm->nscalar() : 0;
+		int nvector = ( dvm != NULL ) ? dvm->nvector() : 0;
+		return pvtu_save(fname, pieces, nscalar, nvector);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::snapshot_files(
+	std::string	rank_no,
+	std::string	extend,
+	std::string	format,
+	std::map<std::string,std::string>& stl_fname_map,
+	CheckpointPiece	*piece
+	) {
+		piece->fname = mk_stl_fname(rank_no, extend, &format, stl_fname_map);
+		piece->format = format;
+		piece->id_fname = mk_id_fname(rank_no, extend);
+
+		load_deferred();
+
+		VertexList* vertex_list = m_polygons->get_vtx_list();
+		std::vector<PrivateTriangle*> sorted;
+		std::vector<PrivateTriangle*>* tri_list =
+			id_sorted_triangles(m_polygons->get_tri_list(), &sorted);
+		VtkMesh& m = piece->mesh;
+		POLYLIB_STAT ret = mesh_vertex_index(vertex_list, tri_list, &m.index);
+		if (ret != PLSTAT_OK) return ret;
+
+		// 頂点座標と頂点データ
+		const std::vector<Vertex*>* vlist = vertex_list->get_vertex_lists();
+		int nvert = vlist->size();
+		DVertexManager* dvm = get_DVM();
+		m.nscalar = ( dvm != NULL ) ? dvm->nscalar() : 0;
+		m.nvector = ( dvm != NULL ) ? dvm->nvector() : 0;
+		m.coords.resize( (size_t)nvert * 3 );
+		m.scalars.assign( (size_t)nvert * m.nscalar, 0.0 );
+		m.vectors.assign( (size_t)nvert * m.nvector * 3, 0.0 );
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (int i = 0; i < nvert; i++) {
+			Vertex* v = (*vlist)[i];
+			// 剛体インスタンシング時はワールド座標で保存
+			Vec3<PL_REAL> p = to_world_pos(*v);
+			for (int j = 0; j < 3; j++) m.coords[ (size_t)i*3+j ] = p[j];
+			if (m.nscalar == 0 && m.nvector == 0) continue;
+			DVertex* dv = dynamic_cast<DVertex*>(v);
+			if (dv == NULL) continue;
+			for (int j = 0; j < m.nscalar; j++) {
+				m.scalars[ (size_t)i*m.nscalar+j ] = dv->get_scalar(j);
+			}
+			for (int j = 0; j < m.nvector; j++) {
+				Vec3<PL_REAL> vec;
+				dv->get_vector(j, &vec);
+				for (int k = 0; k < 3; k++) m.vectors[ ((size_t)i*m.nvector+j)*3+k ] = vec[k];
+			}
+		}
+
+		// 三角形のid、exid
+		int ntri = tri_list->size();
+		m.ids.resize(ntri);
+		m.exids.resize(ntri);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (int i = 0; i < ntri; i++) {
+			m.ids[i] = (*tri_list)[i]->get_id();
+			m.exids[i] = (*tri_list)[i]->get_exid();
+		}
+		return PLSTAT_OK;
 }
 
 // public /////////////////////////////////////////////////////////////////////
@@ -801,11 +1271,14 @@ POLYLIB_STAT PolygonGroup::save_id_file(
 	std::string		extend,
 	ID_FORMAT	id_format
 	) {
-		char	*fname = mk_id_fname(rank_no, extend);
+		std::string	fname = mk_id_fname(rank_no, extend);
 #ifdef DEBUG
 		PL_DBGOSH <<  "save_id_file:" << fname << std::endl;
 #endif
-		return save_id(m_polygons->get_tri_list(), fname, id_format);
+		load_deferred();
+		std::vector<PrivateTriangle*> sorted;
+		return save_id(id_sorted_triangles(m_polygons->get_tri_list(), &sorted),
+			fname, id_format);
 }
 
 
@@ -841,7 +1314,16 @@ const std::vector<PrivateTriangle*>* PolygonGroup::search(
 	BBox	*bbox,
 	bool	every
 	) const {
-		return m_polygons->search(bbox, every);
+		// 外接矩形と交差しなければ読み込まない
+		if (m_load_state != LOAD_DONE && m_deferred_bbox_known && !m_deferred_bbox.crossed(*bbox)) {
+			return new std::vector<PrivateTriangle*>;
+		}
+		if (load_deferred() != PLSTAT_OK) return NULL;
+		if (!m_rigid_dirty) return m_polygons->search(bbox, every);
+
+		std::vector<PrivateTriangle*> *tri_list = new std::vector<PrivateTriangle*>;
+		search(bbox, every, tri_list);
+		return tri_list;
 }
 
 // public /////////////////////////////////////////////////////////////////////
@@ -851,7 +1333,21 @@ POLYLIB_STAT PolygonGroup::search(
 	bool						every,
 	std::vector<PrivateTriangle*>	*tri_list
 	) const {
-		return m_polygons->search(bbox, every, tri_list);
+		// 外接矩形と交差しなければ読み込まない
+		if (m_load_state != LOAD_DONE && m_deferred_bbox_known && !m_deferred_bbox.crossed(*bbox)) {
+			return PLSTAT_OK;
+		}
+		POLYLIB_STAT ret = load_deferred();
+		if (ret != PLSTAT_OK) return ret;
+		if (!m_rigid_dirty) return m_polygons->search(bbox, every, tri_list);
+
+		// ローカル座標系で外包矩形と交差する三角形を候補として取得
+		BBox local_bbox = to_local_bbox(*bbox);
+		std::vector<PrivateTriangle*> candidates;
+		ret = m_polygons->search(&local_bbox, false, &candidates);
+		if (ret != PLSTAT_OK) return ret;
+		select_in_world(*bbox, every, candidates, tri_list);
+		return PLSTAT_OK;
 }
 
 // public /////////////////////////////////////////////////////////////////////
@@ -860,7 +1356,12 @@ const std::vector<PrivateTriangle*>* PolygonGroup::linear_search(
 	BBox	*bbox,
 	bool	every
 	) const {
-		return m_polygons->linear_search(bbox, every);
+		if (load_deferred() != PLSTAT_OK) return NULL;
+		if (!m_rigid_dirty) return m_polygons->linear_search(bbox, every);
+
+		std::vector<PrivateTriangle*> *tri_list = new std::vector<PrivateTriangle*>;
+		linear_search(bbox, every, tri_list);
+		return tri_list;
 }
 
 // public /////////////////////////////////////////////////////////////////////
@@ -870,7 +1371,48 @@ POLYLIB_STAT PolygonGroup::linear_search(
 	bool						every,
 	std::vector<PrivateTriangle*>	*tri_list
 	) const {
-		return m_polygons->linear_search(bbox, every, tri_list);
+		POLYLIB_STAT ret = load_deferred();
+		if (ret != PLSTAT_OK) return ret;
+		if (!m_rigid_dirty) return m_polygons->linear_search(bbox, every, tri_list);
+
+		BBox local_bbox = to_local_bbox(*bbox);
+		std::vector<PrivateTriangle*> candidates;
+		ret = m_polygons->linear_search(&local_bbox, false, &candidates);
+		if (ret != PLSTAT_OK) return ret;
+		select_in_world(*bbox, every, candidates, tri_list);
+		return PLSTAT_OK;
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+void PolygonGroup::select_in_world(
+	const BBox&							bbox,
+	bool								every,
+	const std::vector<PrivateTriangle*>&	candidates,
+	std::vector<PrivateTriangle*>		*tri_list
+	) const {
+		// 頂点座標はローカル座標系なので、ワールド座標へ変換して判定する
+		std::vector<PrivateTriangle*>::const_iterator itr;
+		for (itr = candidates.begin(); itr != candidates.end(); itr++) {
+			Vertex** vtx = (*itr)->get_vertex();
+			Vec3<PL_REAL> p[3];
+			for (int i = 0; i < 3; i++) p[i] = to_world_pos(*vtx[i]);
+			if (every == true) {
+				if (bbox.contain(p[0]) == true &&
+					bbox.contain(p[1]) == true &&
+					bbox.contain(p[2]) == true) {
+						tri_list->push_back(*itr);
+				}
+			}
+			else {
+				BBox e_bbox;
+				e_bbox.init();
+				for (int i = 0; i < 3; i++) e_bbox.add(p[i]);
+				if (e_bbox.crossed(bbox) == true) {
+					tri_list->push_back(*itr);
+				}
+			}
+		}
 }
 
 // public /////////////////////////////////////////////////////////////////////
@@ -911,29 +1453,30 @@ const std::vector<PrivateTriangle*>*
 #endif
 	std::vector<PrivateTriangle*> *p_trias;
 
-	// 除外IDリストを昇順ソート
-	std::sort( exclude_tria_ids->begin(), exclude_tria_ids->end() );
+	// 除外IDリストの索引(除外IDリスト自体は並べ替えない)
+	TriaIdIndex exclude_index;
+	exclude_index.reserve( exclude_tria_ids->size() );
+	for( size_t i=0; i<exclude_tria_ids->size(); i++ ) {
+		exclude_index.insert( (*exclude_tria_ids)[i], 0 );
+	}
 #ifdef DEBUG
 	PL_DBGOSH << "PolygonGroup::search_outbounded() neibour box " << neibour_bbox.min<<" " << neibour_bbox.max<<std::endl;
 #endif
 	// 隣接PE領域(ガイドセル含)に懸かる三角形を検索
 	p_trias = (std::vector<PrivateTriangle*>*)search( &neibour_bbox, false );
+	if( p_trias == NULL ) return NULL;	// 遅延読み込みに失敗
 #ifdef DEBUG
 	PL_DBGOSH << "p_trias org num:" << p_trias->size() << std::endl;
 #endif
 
-	// 検索結果から除外対象を除く
-	std::vector<PrivateTriangle*>::iterator itr;
-	for( itr=p_trias->begin(); itr!=p_trias->end(); ) {
-		int id = (*itr)->get_id();
-		if( std::binary_search(exclude_tria_ids->begin(),
-			exclude_tria_ids->end(), id) ) {
-				itr = p_trias->erase(itr);
-		}
-		else {
-			itr++;
+	// 検索結果から除外対象を除く(前詰めして最後に一度だけ縮める)
+	size_t n_keep = 0;
+	for( size_t i=0; i<p_trias->size(); i++ ) {
+		if( exclude_index.find( (*p_trias)[i]->get_id() ) < 0 ) {
+			(*p_trias)[n_keep++] = (*p_trias)[i];
 		}
 	}
+	p_trias->resize( n_keep );
 #ifdef DEBUG
 	PL_DBGOSH << "p_trias ret num:" << p_trias->size() << std::endl;
 #endif
@@ -964,7 +1507,11 @@ POLYLIB_STAT
 		PL_DBGOSH << __func__<< " add start" << std::endl;
 #endif
 
+		// 追加する三角形はワールド座標なので、先に変換を頂点へ反映する
+		load_deferred();
+		bake_rigid_transform();
 		m_polygons->add(vertlist, idlist, exidlist, n_start_tri, n_start_id, n_start_exid, n_tri);
+		m_tree_generation++;
 
 #ifdef DEBUG
 		PL_DBGOSH << __func__<< " add finished" << std::endl;
@@ -1000,7 +1547,11 @@ POLYLIB_STAT
 	PL_DBGOSH << "PolygonGroup::add_triangles() in. " << std::endl;
 #endif
 
+	// 追加する三角形はワールド座標なので、先に変換を頂点へ反映する
+	load_deferred();
+	bake_rigid_transform();
 	m_polygons->add( tri_list );
+	m_tree_generation++;
 #ifdef DEBUG
 	PL_DBGOSH << "PolygonGroup::add_triangles() end. " << std::endl;
 #endif
@@ -1085,6 +1636,7 @@ POLYLIB_STAT PolygonGroup::show_group_info(
 			return PLSTAT_TRIANGLE_NOT_EXIST;
 		}
 
+		load_deferred();
 		std::vector<PrivateTriangle*>* tmp_list = m_polygons->get_tri_list();
 
 		PL_DBGOSH << "  triangle list size: " << tmp_list->size() << std::endl;
@@ -1128,6 +1680,7 @@ PL_REAL PolygonGroup::get_group_area( void ) {
 
 	PL_REAL m_area=0.0, a;
 
+	load_deferred();
 	std::vector<PrivateTriangle*>* tmp_list = m_polygons->get_tri_list();
 
 	std::vector<PrivateTriangle*>::iterator it;
@@ -1142,6 +1695,7 @@ PL_REAL PolygonGroup::get_group_area( void ) {
 
 int PolygonGroup::get_group_num_tria( void ) {
 
+	load_deferred();
 	std::vector<PrivateTriangle*>* tmp_list = m_polygons->get_tri_list();
 
 	return (int)tmp_list->size();
@@ -1151,6 +1705,8 @@ int PolygonGroup::get_group_num_tria( void ) {
 
 POLYLIB_STAT PolygonGroup::rescale_polygons( PL_REAL scale )
 {
+	load_deferred();
+	bake_rigid_transform();
 	std::vector<PrivateTriangle*>* tmp_list = m_polygons->get_tri_list();
 	std::vector<PrivateTriangle*>::iterator it;
 	for (it = tmp_list->begin(); it != tmp_list->end(); it++) {
@@ -1199,6 +1755,7 @@ POLYLIB_STAT PolygonGroup::rescale_polygons( PL_REAL scale )
 
 POLYLIB_STAT PolygonGroup::set_all_exid_of_trias( int id )
 {
+	load_deferred();
 	m_id = id;           // keno 2013-07-20
 	m_id_defined = true; // keno 2013-07-20
 	return m_polygons->set_all_exid( id );
@@ -1206,10 +1763,235 @@ POLYLIB_STAT PolygonGroup::set_all_exid_of_trias( int id )
 
 // public /////////////////////////////////////////////////////////////////////
 
+POLYLIB_STAT PolygonGroup::build_adjacency(
+	TriangleAdjacency	*adj,
+	bool				set_shell
+	)
+{
+	if (adj == NULL) return PLSTAT_ARGUMENT_NULL;
+	// 外接矩形はワールド座標系で求める
+	VertexList* vertex_list = get_vertexlist();
+	POLYLIB_STAT ret = adj->build(vertex_list, m_polygons->get_tri_list());
+	if (ret != PLSTAT_OK) {
+		PL_ERROSH << "[ERROR]PolygonGroup::build_adjacency():" << m_name
+			<< " returns:" << PolylibStat2::String(ret) << std::endl;
+		return ret;
+	}
+	adj->label_shells(set_shell);
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
 const PrivateTriangle* PolygonGroup::search_nearest(
 	const Vec3<PL_REAL>&    pos
 	) const {
-		return m_polygons->search_nearest(pos);
+		load_deferred();
+
+		// 距離は剛体変換で不変なので、ローカル座標系で検索する
+		return m_polygons->search_nearest(to_local_pos(pos));
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+const PrivateTriangle* PolygonGroup::search_nearest_surface(
+	const Vec3<PL_REAL>&	pos,
+	Vec3<PL_REAL>*			foot,
+	PL_REAL					bary[3],
+	PL_REAL*				dist2
+	) const {
+		return search_nearest_surface_within(pos, -1, foot, bary, dist2);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+const PrivateTriangle* PolygonGroup::search_nearest_surface_within(
+	const Vec3<PL_REAL>&	pos,
+	PL_CALC_REAL			bound2,
+	Vec3<PL_REAL>*			foot,
+	PL_REAL					bary[3],
+	PL_REAL*				dist2
+	) const {
+		// 距離は剛体変換で不変なので、ローカル座標系で検索する
+		load_deferred();
+		PL_REAL w[3];
+		const PrivateTriangle* tri =
+			m_polygons->search_nearest_surface(to_local_pos(pos), w, dist2, bound2);
+		if (tri == NULL) return NULL;
+
+		if (bary != NULL) {
+			bary[0] = w[0]; bary[1] = w[1]; bary[2] = w[2];
+		}
+		if (foot != NULL) {
+			Vertex** v = tri->get_vertex();
+			Vec3<PL_REAL> f;
+			for (int i = 0; i < 3; i++) {
+				f[i] = w[0]*(*v[0])[i] + w[1]*(*v[1])[i] + w[2]*(*v[2])[i];
+			}
+			*foot = to_world_pos(f);
+		}
+		return tri;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::search_intersecting_pairs(
+	const PolygonGroup			*other,
+	std::vector<TrianglePair>	*pairs
+	) const {
+		if (other == NULL || pairs == NULL) return PLSTAT_ARGUMENT_NULL;
+		// 相手の木と三角形はrelでこのグループのローカル座標系へ変換する
+		load_deferred();
+		other->load_deferred();
+		VTree* tree = m_polygons->get_vtree();
+		VTree* other_tree = other->m_polygons->get_vtree();
+		if (tree == NULL || other_tree == NULL) return PLSTAT_OK;
+		PL_CALC_REAL rel[12];
+		return tree->search_pairs(other_tree, relative_transform(other, rel), -1, pairs);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::search_pairs_within(
+	const PolygonGroup			*other,
+	PL_REAL						dist,
+	std::vector<TrianglePair>	*pairs
+	) const {
+		if (other == NULL || pairs == NULL) return PLSTAT_ARGUMENT_NULL;
+		if (dist < 0) {
+			PL_ERROSH << "[ERROR]PolygonGroup::search_pairs_within():negative distance "
+				<< dist << std::endl;
+			return PLSTAT_NG;
+		}
+		load_deferred();
+		other->load_deferred();
+		VTree* tree = m_polygons->get_vtree();
+		VTree* other_tree = other->m_polygons->get_vtree();
+		if (tree == NULL || other_tree == NULL) return PLSTAT_OK;
+		PL_CALC_REAL rel[12];
+		return tree->search_pairs(other_tree, relative_transform(other, rel), dist, pairs);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::search_nearest_pair(
+	const PolygonGroup			*other,
+	TrianglePair				*pair
+	) const {
+		if (other == NULL || pair == NULL) return PLSTAT_ARGUMENT_NULL;
+		load_deferred();
+		other->load_deferred();
+		*pair = TrianglePair();
+		VTree* tree = m_polygons->get_vtree();
+		VTree* other_tree = other->m_polygons->get_vtree();
+		if (tree == NULL || other_tree == NULL) return PLSTAT_OK;
+		PL_CALC_REAL rel[12];
+		return tree->search_nearest_pair(other_tree, relative_transform(other, rel), pair);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::interpolate_DVertex(
+	const PL_REAL*	points,
+	int				npoints,
+	const int*		scalar_index,
+	int				nscalar,
+	const int*		vector_index,
+	int				nvector,
+	PL_REAL*		scalars,
+	PL_REAL*		vectors,
+	PL_REAL*		foot,
+	int*			tri_id
+	) const {
+		load_deferred();
+		DVertexManager* dvm = get_DVM();
+		if (dvm == NULL) {
+			PL_ERROSH << "[ERROR]PolygonGroup::interpolate_DVertex():group has no DVertex:"
+				<< m_name << std::endl;
+			return PLSTAT_NG;
+		}
+		if (npoints <= 0) return PLSTAT_OK;
+		if (points == NULL ||
+			(nscalar > 0 && (scalar_index == NULL || scalars == NULL)) ||
+			(nvector > 0 && (vector_index == NULL || vectors == NULL))) {
+			return PLSTAT_ARGUMENT_NULL;
+		}
+
+		// 補間対象フィールドの配列先頭を予め取得
+		std::vector<const PL_REAL*> sdata(nscalar), vdata(nvector);
+		for (int j = 0; j < nscalar; j++) {
+			if (scalar_index[j] < 0 || scalar_index[j] >= dvm->nscalar()) {
+				PL_ERROSH << "[ERROR]PolygonGroup::interpolate_DVertex():wrong scalar index:"
+					<< scalar_index[j] << std::endl;
+				return PLSTAT_NG;
+			}
+			sdata[j] = dvm->scalar_data(scalar_index[j]);
+		}
+		for (int j = 0; j < nvector; j++) {
+			if (vector_index[j] < 0 || vector_index[j] >= dvm->nvector()) {
+				PL_ERROSH << "[ERROR]PolygonGroup::interpolate_DVertex():wrong vector index:"
+					<< vector_index[j] << std::endl;
+				return PLSTAT_NG;
+			}
+			vdata[j] = dvm->vector_data(vector_index[j]);
+		}
+
+		int nmiss = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:nmiss)
+#endif
+		for (int i = 0; i < npoints; i++) {
+			Vec3<PL_REAL> pos(points[i*3], points[i*3+1], points[i*3+2]);
+			PL_REAL w[3];
+			const PrivateTriangle* tri =
+				m_polygons->search_nearest_surface(to_local_pos(pos), w, NULL);
+
+			int slot[3] = { -1, -1, -1 };
+			if (tri != NULL) {
+				Vertex** v = tri->get_vertex();
+				for (int k = 0; k < 3; k++) {
+					DVertex* dv = dynamic_cast<DVertex*>(v[k]);
+					if (dv != NULL && dv->DVM() == dvm) slot[k] = dv->slot();
+				}
+				if (foot != NULL) {
+					Vec3<PL_REAL> f;
+					for (int c = 0; c < 3; c++) {
+						f[c] = w[0]*(*v[0])[c] + w[1]*(*v[1])[c] + w[2]*(*v[2])[c];
+					}
+					f = to_world_pos(f);
+					for (int c = 0; c < 3; c++) foot[i*3+c] = f[c];
+				}
+			}
+			if (slot[0] < 0 || slot[1] < 0 || slot[2] < 0) {
+				for (int j = 0; j < nscalar; j++) scalars[i*nscalar+j] = 0.0;
+				for (int j = 0; j < nvector*3; j++) vectors[i*nvector*3+j] = 0.0;
+				if (foot != NULL && tri == NULL) {
+					foot[i*3] = pos[0]; foot[i*3+1] = pos[1]; foot[i*3+2] = pos[2];
+				}
+				if (tri_id != NULL) tri_id[i] = -1;
+				nmiss++;
+				continue;
+			}
+
+			for (int j = 0; j < nscalar; j++) {
+				const PL_REAL* s = sdata[j];
+				scalars[i*nscalar+j] = w[0]*s[slot[0]] + w[1]*s[slot[1]] + w[2]*s[slot[2]];
+			}
+			for (int j = 0; j < nvector; j++) {
+				const PL_REAL* s = vdata[j];
+				for (int c = 0; c < 3; c++) {
+					vectors[(i*nvector+j)*3+c] = w[0]*s[slot[0]*3+c]
+						+ w[1]*s[slot[1]*3+c] + w[2]*s[slot[2]*3+c];
+				}
+			}
+			if (tri_id != NULL) tri_id[i] = tri->get_id();
+		}
+
+#ifdef DEBUG
+		PL_DBGOSH << "PolygonGroup::interpolate_DVertex() points:" << npoints
+			<< " missed:" << nmiss << std::endl;
+#endif
+		return PLSTAT_OK;
 }
 
 // TextParser Version
@@ -1276,6 +2058,28 @@ POLYLIB_STAT PolygonGroup::setup_attribute (
 			//<<std::endl;
 		}
 
+		// 空間充填曲線による並べ替え
+		leaf_iter = find(leaves.begin(),leaves.end(),ATT_NAME_REORDER);
+
+		if(leaf_iter!=leaves.end()) {
+			std::string reorder_string;
+			tp_error=tp->getValue((*leaf_iter),reorder_string);
+			if (!SpaceFillingCurve::parse(reorder_string, &m_reorder)) {
+				PL_ERROSH << "[ERROR]PolygonGroup::setup_attribute():invalid reorder value:"
+					<< reorder_string << std::endl;
+				return PLSTAT_CONFIG_ERROR;
+			}
+		}
+
+		// 読み取り専用の複製を公開するか?
+		leaf_iter = find(leaves.begin(),leaves.end(),ATT_NAME_SNAPSHOT);
+
+		if(leaf_iter!=leaves.end()) {
+			std::string snapshot_string;
+			tp_error=tp->getValue((*leaf_iter),snapshot_string);
+			m_snapshot_enabled = tp->convertBool(snapshot_string,&ierror);
+		}
+
 		// moveメソッドにより移動するグループか?
 		if (this->whoami() == this->get_class_name()) {
 			// 基本クラスの場合はmovableの設定は不要
@@ -1291,6 +2095,15 @@ POLYLIB_STAT PolygonGroup::setup_attribute (
 				//PL_DBGOS << __func__ << " is movavle ? true or false  "
 				//<< m_movable <<std::endl;
 			}
+
+			// 剛体インスタンシングを行うか?
+			std::string instancing_string;
+			leaf_iter = find(leaves.begin(),leaves.end(),ATT_NAME_INSTANCING);
+
+			if(leaf_iter!=leaves.end()) {
+				tp_error=tp->getValue((*leaf_iter),instancing_string);
+				m_rigid_instancing = tp->convertBool(instancing_string,&ierror);
+			}
 		}
 
 		// グループ名が重複していないか確認
@@ -1410,16 +2223,28 @@ POLYLIB_STAT
 #ifdef DEBUG
 	PL_DBGOSH << "PolygonGroup::init_check_leaped() in. " << std::endl;
 #endif
-
-	std::vector<PrivateTriangle*>* p_trias = get_triangles();
+	m_coords_before_move.clear();
 
 	// 動かないポリゴングループならば何もしないで終了
-	if( !m_movable || p_trias==NULL || p_trias->size()==0 ) return PLSTAT_OK;
+	if( !m_movable ) return PLSTAT_OK;
+
+	VertexList* vlist = get_vertexlist();
+	if( vlist==NULL || vlist->size()==0 ) return PLSTAT_OK;
 
-	// move後と比較するために三角形ポリゴンリストのディープコピーを保存
-	m_trias_before_move = new std::vector<PrivateTriangle*>;
-	for( unsigned int i=0; i<p_trias->size(); i++ ) {
-		m_trias_before_move->push_back( new PrivateTriangle(*(p_trias->at(i))) );
+	// move後と比較するために頂点座標(ワールド座標)だけを連続領域へ保存
+	const std::vector<Vertex*>* vertices = vlist->get_vertex_lists();
+	long nvtx = (long)vertices->size();
+	m_coords_before_move.resize( nvtx*3 );
+	PL_REAL* coords = &m_coords_before_move[0];
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for( long i=0; i<nvtx; i++ ) {
+		Vec3<PL_REAL> p = to_world_pos( *(*vertices)[i] );
+		coords[i*3  ] = p[0];
+		coords[i*3+1] = p[1];
+		coords[i*3+2] = p[2];
 	}
 	return PLSTAT_OK;
 }
@@ -1429,41 +2254,111 @@ POLYLIB_STAT
 POLYLIB_STAT
 	PolygonGroup::check_leaped(
 	Vec3<PL_REAL> origin,
-	Vec3<PL_REAL> cell_size
+	Vec3<PL_REAL> cell_size,
+	LeapCheckResult* result
 	)
 {
 #ifdef DEBUG
 	PL_DBGOSH << "PolygonGroup::check_leaped() in. " << std::endl;
 #endif
-	unsigned int i, j;
-	std::vector<PrivateTriangle*>* p_trias = get_triangles();
+	LeapCheckResult local_result;
+	LeapCheckResult* res = (result != NULL) ? result : &local_result;
+	res->m_num_vertices = 0;
+	res->m_num_leaped_vertices = 0;
+	res->m_max_displacement = 0.0;
+	res->m_leaped_tria_ids.clear();
+
+	// 動かないポリゴングループ、または前処理をしていなければ何もしないで終了
+	if( !m_movable || m_coords_before_move.empty() ) return PLSTAT_OK;
+
+	VertexList* vlist = get_vertexlist();
+	if( vlist==NULL ) return PLSTAT_OK;
+	const std::vector<Vertex*>* vertices = vlist->get_vertex_lists();
+
+	// 前処理後に追加された頂点は比較対象外
+	long nvtx = (long)(m_coords_before_move.size() / 3);
+	if( nvtx > (long)vertices->size() ) nvtx = (long)vertices->size();
+	const PL_REAL* before = &m_coords_before_move[0];
+
+	// 頂点毎の判定結果
+	std::vector<char> leaped( nvtx, 0 );
+	double max_d2 = 0.0;
+	long nleaped = 0;
+
+	// 移動前の座標が属するボクセルの隣接ボクセルまで含んだ範囲から、
+	// 移動後の座標がはみ出していれば違反 (is_far()と同じ判定)
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+	{
+		double my_max_d2 = 0.0;
+		long my_nleaped = 0;
+#ifdef _OPENMP
+#pragma omp for
+#endif
+		for( long i=0; i<nvtx; i++ ) {
+			Vec3<PL_REAL> v = to_world_pos( *(*vertices)[i] );
+			double d2 = 0.0;
+			bool is_leaped = false;
+			for( int k=0; k<3; k++ ) {
+				double pos1 = before[i*3+k];
+				double pos2 = v[k];
+				double cs = cell_size[k];
+				double p = origin[k] + floor( (pos1 - origin[k]) / cs ) * cs;
+				if( pos2 < p - cs || pos2 > p + cs * 2 ) is_leaped = true;
+				d2 += (pos2 - pos1) * (pos2 - pos1);
+			}
+			if( is_leaped ) {
+				leaped[i] = 1;
+				my_nleaped++;
+			}
+			if( d2 > my_max_d2 ) my_max_d2 = d2;
+		}
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+		{
+			if( my_max_d2 > max_d2 ) max_d2 = my_max_d2;
+			nleaped += my_nleaped;
+		}
+	}
 
-	// 動かないポリゴングループならば何もしないで終了
-	if( !m_movable || p_trias==NULL || p_trias->size()==0 ) return PLSTAT_OK;
-
-	// move前の三角形と座標を比較。
-	for( i=0; i<p_trias->size(); i++ ) {
-
-		for( j=0; j<3; j++ ) {
-			// 隣接セルより遠方へ移動してたらcerrにメッセージを出力。
-			if( is_far( origin, cell_size,
-			            (*(*p_trias->at(i)->get_vertex()))[j],
-			            (*(*m_trias_before_move->at(i)->get_vertex()))[j] )
-			) {
-				PL_ERROSH << "[ERROR]PolygonGroup::check_leaped():Leaped Vertex"
-						<< " Detected. GroupID:" << m_internal_id
-						<< " TriaID:" << p_trias->at(i)->get_id()
-						<< " before:(" << m_trias_before_move->at(i)->get_vertex()[j]
-					<< ") after:(" << p_trias->at(i)->get_vertex()[j]
-					<< ")" << std::endl;
+	res->m_num_vertices = nvtx;
+	res->m_num_leaped_vertices = nleaped;
+	res->m_max_displacement = sqrt( max_d2 );
+
+	// 違反頂点を持つ三角形IDを集める（違反がある時だけ）
+	if( nleaped > 0 ) {
+		std::set<const Vertex*> leaped_vertices;
+		for( long i=0; i<nvtx; i++ ) {
+			if( leaped[i] ) leaped_vertices.insert( (*vertices)[i] );
+		}
+		std::vector<PrivateTriangle*>* p_trias = get_triangles();
+		std::vector<PrivateTriangle*>::iterator itr;
+		for( itr=p_trias->begin(); itr!=p_trias->end(); itr++ ) {
+			Vertex** vtx = (*itr)->get_vertex();
+			if( leaped_vertices.count(vtx[0]) || leaped_vertices.count(vtx[1]) ||
+				leaped_vertices.count(vtx[2]) ) {
+				res->m_leaped_tria_ids.push_back( (*itr)->get_id() );
 			}
 		}
-		// 移動前三角形インスタンスはもう不要なので削除
-		delete m_trias_before_move->at(i);
+		std::sort( res->m_leaped_tria_ids.begin(), res->m_leaped_tria_ids.end() );
+		res->m_leaped_tria_ids.erase(
+			std::unique( res->m_leaped_tria_ids.begin(), res->m_leaped_tria_ids.end() ),
+			res->m_leaped_tria_ids.end() );
+
+		if( result == NULL ) {
+			PL_ERROSH << "[ERROR]PolygonGroup::check_leaped():Leaped Vertex"
+				<< " Detected. GroupID:" << m_internal_id
+				<< " vertices:" << res->m_num_leaped_vertices
+				<< " triangles:" << res->m_leaped_tria_ids.size()
+				<< " max displacement:" << res->m_max_displacement
+				<< std::endl;
+		}
 	}
 
 	// あとしまつ
-	delete m_trias_before_move;
+	m_coords_before_move.clear();
 
 	return PLSTAT_OK;
 }
@@ -1506,23 +2401,20 @@ bool
 
 // protected //////////////////////////////////////////////////////////////////
 
-char *PolygonGroup::mk_stl_fname(
+std::string PolygonGroup::mk_stl_fname(
 	std::string		rank_no,
 	std::string		extend,
 	std::string		format
 	) {
-		char		fname1[1024];
 		std::string		prefix;
-		static char	fname2[1024];
+		std::string		fname2;
 
 		// グループ名のフルパスを取得して、/を_に置き換え
-		strcpy(fname1, acq_fullpath().c_str());
+		std::string		fname1 = acq_fullpath();
 
 		//cout << __func__ << " acq_fullpath() " <<acq_fullpath()<<std::endl;
 
-		for (int i = 0; i < (int)strlen(fname1); i++) {
-			if (fname1[i] == '/')	fname1[i] = '_';
-		}
+		std::replace(fname1.begin(), fname1.end(), '/', '_');
 
 #ifdef DEBUG
 		PL_DBGOS << __func__ << " fname1 " <<fname1<<std::endl;
@@ -1539,17 +2431,19 @@ char *PolygonGroup::mk_stl_fname(
 			//		prefix = "stla";
 			prefix = "obj";
 		}
+		else if (format == TriMeshIO::FMT_VTU) {
+			prefix = "vtu";
+		}
 
 		else {
 			prefix = "stl";
 		}
 
 		if (rank_no == "") {
-			sprintf(fname2, "%s_%s.%s", fname1, extend.c_str(), prefix.c_str());
+			fname2 = fname1 + "_" + extend + "." + prefix;
 		}
 		else {
-			sprintf(fname2, "%s_%s_%s.%s", fname1, rank_no.c_str(), extend.c_str(),
-				prefix.c_str());
+			fname2 = fname1 + "_" + rank_no + "_" + extend + "." + prefix;
 		}
 		//#define DEBUG
 #ifdef DEBUG
@@ -1566,18 +2460,17 @@ char *PolygonGroup::mk_stl_fname(
 
 // protected //////////////////////////////////////////////////////////////////
 
-char *PolygonGroup::mk_stl_fname(
+std::string PolygonGroup::mk_stl_fname(
 	std::string		rank_no,
 	std::string		extend,
 	std::string		*format,
 	std::map<std::string,std::string>& stl_fname_map
 	) {
-		char		fname1[1024];
 		std::string		prefix;
-		static char	fname2[1024];
+		std::string		fname2;
 
 		// グループ名のフルパスを取得して、/を_に置き換え
-		strcpy(fname1, acq_fullpath().c_str());
+		std::string		fname1 = acq_fullpath();
 
 		// std::cout <<__func__ <<"else" <<TriMeshIO::FMT_VTK_A <<" "<<*format
 		// 	    << " " << ( TriMeshIO::FMT_VTK_A == *format)
@@ -1587,9 +2480,7 @@ char *PolygonGroup::mk_stl_fname(
 
 		//cout << __func__ << " acq_fullpath() " <<acq_fullpath()<<std::endl;
 
-		for (int i = 0; i < (int)strlen(fname1); i++) {
-			if (fname1[i] == '/')	fname1[i] = '_';
-		}
+		std::replace(fname1.begin(), fname1.end(), '/', '_');
 
 		//cout << __func__ << " fname1 " <<fname1<<std::endl;
 
@@ -1614,6 +2505,9 @@ char *PolygonGroup::mk_stl_fname(
 			// }
 
 		}
+		else if (*format == TriMeshIO::FMT_VTU) {
+			prefix = "vtu";
+		}
 
 
 		else {
@@ -1624,11 +2518,10 @@ char *PolygonGroup::mk_stl_fname(
 		}
 
 		if (rank_no == "") {
-			sprintf(fname2, "%s_%s.%s", fname1, extend.c_str(), prefix.c_str());
+			fname2 = fname1 + "_" + extend + "." + prefix;
 		}
 		else {
-			sprintf(fname2, "%s_%s_%s.%s", fname1, rank_no.c_str(), extend.c_str(),
-				prefix.c_str());
+			fname2 = fname1 + "_" + rank_no + "_" + extend + "." + prefix;
 		}
 
 
@@ -1643,47 +2536,337 @@ char *PolygonGroup::mk_stl_fname(
 		PL_DBGOS << __func__ << " acq_fullpath() " <<acq_fullpath()<<std::endl;
 #endif //  DEBUG
 		//#undef DEBUG
-		std::string tmp_fname = fname2;
-		stl_fname_map.insert(std::map<std::string,std::string>::value_type(acq_fullpath(),tmp_fname));
+		stl_fname_map.insert(std::map<std::string,std::string>::value_type(acq_fullpath(),fname2));
 
 		return fname2;
 }
 
 // protected //////////////////////////////////////////////////////////////////
 
-char* PolygonGroup::mk_id_fname(
+std::string PolygonGroup::mk_id_fname(
 	std::string		rank_no,
 	std::string		extend
 	) {
-		char		fname1[1024];
-		static char	fname2[1024];
-
 		// グループ名のフルパスを取得して、/を_に置き換え
-		strcpy(fname1, acq_fullpath().c_str());
-		for (int i = 0; i < (int)strlen(fname1); i++) {
-			if (fname1[i] == '/')	fname1[i] = '_';
-		}
+		std::string	fname1 = acq_fullpath();
+		std::replace(fname1.begin(), fname1.end(), '/', '_');
 
 		if (rank_no == "") {
-			sprintf(fname2, "%s_%s.id", fname1, extend.c_str());
+			return fname1 + "_" + extend + ".id";
 		}
 		else {
-			sprintf(fname2, "%s_%s_%s.id", fname1, rank_no.c_str(), extend.c_str());
+			return fname1 + "_" + rank_no + "_" + extend + ".id";
 		}
-		return fname2;
 }
 
 // protected //////////////////////////////////////////////////////////////////
 
 int PolygonGroup::create_global_id() {
-	static int global_id = 0;
-	return global_id++;
+	// グループは並列読み込みのスレッドからも作られる
+	static volatile int global_id = 0;
+	return __sync_fetch_and_add(&global_id, 1);
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::set_rigid_instancing(
+	bool flag
+	) {
+		if (flag == m_rigid_instancing) return PLSTAT_OK;
+
+		if (flag) {
+			// 現在の木の座標系をローカル座標系とする
+			m_rigid_instancing = true;
+			reset_rigid_frame();
+			return PLSTAT_OK;
+		}
+
+		// 現在の変換を頂点へ反映し、ワールド座標系で木を作り直す
+		POLYLIB_STAT ret = materialize_vertices();
+		m_rigid_instancing = false;
+		return ret;
 }
 
+// public /////////////////////////////////////////////////////////////////////
+
+bool PolygonGroup::is_rigid_instanced() const {
+	return m_rigid_instancing;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolygonGroup::set_rigid_transform(
+	const PL_REAL			rot[9],
+	const Vec3<PL_REAL>&	trans
+	) {
+		if (!m_rigid_instancing) return;
+		m_rigid_rotated = false;
+		for (int i = 0; i < 9; i++) {
+			if (rot[i] != ((i % 4 == 0) ? 1.0 : 0.0)) m_rigid_rotated = true;
+			m_rigid_rot[i] = rot[i];
+		}
+		for (int i = 0; i < 3; i++) m_rigid_trans[i] = trans[i];
+		m_rigid_dirty = true;
+		publish_moved_snapshot();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolygonGroup::apply_rigid_motion(
+	const PL_REAL			rot[9],
+	const Vec3<PL_REAL>&	trans
+	) {
+		if (!m_rigid_instancing) return;
+		if (rot != NULL) {
+			// R' = rot * R, t' = rot * t
+			double r[9], t[3];
+			for (int i = 0; i < 3; i++) {
+				for (int j = 0; j < 3; j++) {
+					r[i*3+j] = rot[i*3+0] * m_rigid_rot[0*3+j]
+						+ rot[i*3+1] * m_rigid_rot[1*3+j]
+						+ rot[i*3+2] * m_rigid_rot[2*3+j];
+				}
+				t[i] = rot[i*3+0] * m_rigid_trans[0]
+					+ rot[i*3+1] * m_rigid_trans[1]
+					+ rot[i*3+2] * m_rigid_trans[2];
+			}
+			for (int i = 0; i < 9; i++) m_rigid_rot[i] = r[i];
+			for (int i = 0; i < 3; i++) m_rigid_trans[i] = t[i];
+			m_rigid_rotated = true;
+		}
+		for (int i = 0; i < 3; i++) m_rigid_trans[i] += trans[i];
+		m_rigid_dirty = true;
+		publish_moved_snapshot();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolygonGroup::get_rigid_transform(
+	PL_REAL			rot[9],
+	Vec3<PL_REAL>&	trans
+	) const {
+		for (int i = 0; i < 9; i++) rot[i] = m_rigid_rot[i];
+		trans.assign(m_rigid_trans[0], m_rigid_trans[1], m_rigid_trans[2]);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool PolygonGroup::get_rigid_transform(
+	double	rt[12]
+	) const {
+		for (int i = 0; i < 9; i++) rt[i] = m_rigid_rot[i];
+		for (int i = 0; i < 3; i++) rt[9+i] = m_rigid_trans[i];
+		return m_rigid_dirty;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::materialize_vertices(
+	bool	rebuild
+	) {
+		if (!m_rigid_instancing || !m_rigid_dirty) return PLSTAT_OK;
+
+#ifdef DEBUG
+		PL_DBGOSH << "PolygonGroup::materialize_vertices() in.:" << m_name << std::endl;
+#endif
+		load_deferred();
+		bake_rigid_transform();
+		if (!rebuild) return PLSTAT_OK;
+		return rebuild_polygons();
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+void PolygonGroup::bake_rigid_transform()
+{
+	if (!m_rigid_instancing || !m_rigid_dirty) return;
+
+	std::vector<PL_REAL> local;
+	apply_world_coords(&local);
+	reset_rigid_frame();
+
+	// KD木のbboxはローカル座標系のまま
+	m_need_rebuild = true;
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+bool PolygonGroup::apply_world_coords(
+	std::vector<PL_REAL>	*local
+	) {
+		local->clear();
+		if (!m_rigid_instancing || !m_rigid_dirty || m_polygons == NULL) return false;
+		VertexList* vlist = m_polygons->get_vtx_list();
+		if (vlist == NULL) return false;
+		std::vector<Vertex*>* vertices = vlist->get_vertex_lists_mod();
+
+		const double* r = m_rigid_rot;
+		const double* t = m_rigid_trans;
+		long nvtx = (long)vertices->size();
+		local->resize(nvtx * 3);
+		PL_REAL* l = &(*local)[0];
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (long i = 0; i < nvtx; i++) {
+			Vertex* v = (*vertices)[i];
+			PL_REAL* li = l + i*3;
+			li[0] = (*v)[0]; li[1] = (*v)[1]; li[2] = (*v)[2];
+			(*v)[0] = r[0]*li[0] + r[1]*li[1] + r[2]*li[2] + t[0];
+			(*v)[1] = r[3]*li[0] + r[4]*li[1] + r[5]*li[2] + t[1];
+			(*v)[2] = r[6]*li[0] + r[7]*li[1] + r[8]*li[2] + t[2];
+		}
+
+		// 回転した場合のみ法線を再計算（面積は不変）
+		if (m_rigid_rotated) {
+			std::vector<PrivateTriangle*>* tri_list = m_polygons->get_tri_list();
+			long ntri = (long)tri_list->size();
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+			for (long i = 0; i < ntri; i++) {
+				PrivateTriangle* tri = (*tri_list)[i];
+				tri->set_vertexes( tri->get_vertex(), true, false );
+			}
+		}
+		return true;
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+void PolygonGroup::restore_local_coords(
+	const std::vector<PL_REAL>&	local
+	) {
+		if (local.empty()) return;
+		std::vector<Vertex*>* vertices = m_polygons->get_vtx_list()->get_vertex_lists_mod();
+		long nvtx = (long)(local.size() / 3);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (long i = 0; i < nvtx; i++) {
+			Vertex* v = (*vertices)[i];
+			(*v)[0] = local[i*3];
+			(*v)[1] = local[i*3+1];
+			(*v)[2] = local[i*3+2];
+		}
+		if (m_rigid_rotated) {
+			std::vector<PrivateTriangle*>* tri_list = m_polygons->get_tri_list();
+			long ntri = (long)tri_list->size();
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+			for (long i = 0; i < ntri; i++) {
+				PrivateTriangle* tri = (*tri_list)[i];
+				tri->set_vertexes( tri->get_vertex(), true, false );
+			}
+		}
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+void PolygonGroup::restore_rigid_transform(
+	const double	rt[12]
+	) {
+		if (!m_rigid_instancing) return;
+		m_rigid_rotated = false;
+		for (int i = 0; i < 9; i++) {
+			if (rt[i] != ((i % 4 == 0) ? 1.0 : 0.0)) m_rigid_rotated = true;
+			m_rigid_rot[i] = rt[i];
+		}
+		for (int i = 0; i < 3; i++) m_rigid_trans[i] = rt[9+i];
+		m_rigid_dirty = true;
+		publish_moved_snapshot();
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+void PolygonGroup::reset_rigid_frame()
+{
+	for (int i = 0; i < 9; i++) m_rigid_rot[i] = (i % 4 == 0) ? 1.0 : 0.0;
+	for (int i = 0; i < 3; i++) m_rigid_trans[i] = 0.0;
+	m_rigid_dirty = false;
+	m_rigid_rotated = false;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+Vec3<PL_REAL> PolygonGroup::to_world_pos(
+	const Vec3<PL_REAL>&	pos
+	) const {
+		if (!m_rigid_dirty) return pos;
+		// x_world = R x_local + t
+		const double* r = m_rigid_rot;
+		const double* t = m_rigid_trans;
+		return Vec3<PL_REAL>(
+			r[0]*pos[0] + r[1]*pos[1] + r[2]*pos[2] + t[0],
+			r[3]*pos[0] + r[4]*pos[1] + r[5]*pos[2] + t[1],
+			r[6]*pos[0] + r[7]*pos[1] + r[8]*pos[2] + t[2] );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+Vec3<PL_REAL> PolygonGroup::to_local_pos(
+	const Vec3<PL_REAL>&	pos
+	) const {
+		if (!m_rigid_dirty) return pos;
+		// x_local = R^T (x_world - t)
+		const double* r = m_rigid_rot;
+		double d[3];
+		for (int i = 0; i < 3; i++) d[i] = pos[i] - m_rigid_trans[i];
+		return Vec3<PL_REAL>(
+			r[0]*d[0] + r[3]*d[1] + r[6]*d[2],
+			r[1]*d[0] + r[4]*d[1] + r[7]*d[2],
+			r[2]*d[0] + r[5]*d[1] + r[8]*d[2] );
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+const PL_CALC_REAL* PolygonGroup::relative_transform(
+	const PolygonGroup	*other,
+	PL_CALC_REAL		rel[12]
+	) const {
+		if (!m_rigid_dirty && !other->m_rigid_dirty) return NULL;
+
+		// x_this = Ra^T (Rb x_other + tb - ta)
+		const double* ra = m_rigid_rot;
+		const double* rb = other->m_rigid_rot;
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				rel[i*3+j] = ra[i]*rb[j] + ra[3+i]*rb[3+j] + ra[6+i]*rb[6+j];
+			}
+			rel[9+i] = ra[i]*(other->m_rigid_trans[0] - m_rigid_trans[0])
+				+ ra[3+i]*(other->m_rigid_trans[1] - m_rigid_trans[1])
+				+ ra[6+i]*(other->m_rigid_trans[2] - m_rigid_trans[2]);
+		}
+		return rel;
+}
+
+// protected //////////////////////////////////////////////////////////////////
+
+BBox PolygonGroup::to_local_bbox(
+	const BBox&	bbox
+	) const {
+		// 8頂点を逆変換して外包する。 x_local = R^T (x_world - t)
+		const double* r = m_rigid_rot;
+		BBox local_bbox;
+		local_bbox.init();
+		for (int n = 0; n < 8; n++) {
+			Vec3<PL_REAL> p = bbox.getPoint(n);
+			double d[3];
+			for (int i = 0; i < 3; i++) d[i] = p[i] - m_rigid_trans[i];
+			local_bbox.add( Vec3<PL_REAL>(
+				r[0]*d[0] + r[3]*d[1] + r[6]*d[2],
+				r[1]*d[0] + r[4]*d[1] + r[7]*d[2],
+				r[2]*d[0] + r[5]*d[1] + r[8]*d[2] ) );
+		}
+		return local_bbox;
+}
 
 // public //
 
 POLYLIB_STAT PolygonGroup::replace_DVertex(int nscalar,int nvector){
+	load_deferred();
 	return m_polygons->replace_DVertex(nscalar,nvector);
 }
 // public //
@@ -1719,6 +2902,9 @@ DVertexTriangle* PolygonGroup::add_DVertex_Triangle(Vec3<PL_REAL>* v){
 	<< std::endl;
 #endif
 
+	// 追加する三角形はワールド座標なので、先に変換を頂点へ反映する
+	load_deferred();
+	bake_rigid_transform();
 	return m_polygons->add_DVertex_Triangle(v);
 	//#undef DEBUG
 }
@@ -1728,4 +2914,72 @@ void PolygonGroup::finalize_DVertex(){
 	m_polygons->finalize_DVertex();
 }
 
+DVertexManager* PolygonGroup::get_DVM() const {
+	if( m_polygons == NULL ) return NULL;
+	return m_polygons->DVM();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolygonGroup::set_reorder(
+	SpaceFillingCurve::Type type
+	) {
+		m_reorder = type;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+SpaceFillingCurve::Type PolygonGroup::get_reorder() const {
+	return m_reorder;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PrivateTriangle* PolygonGroup::find_triangle(
+	int id
+	) {
+		load_deferred();
+		return m_polygons->find_triangle(id);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonGroup::remove_triangle(
+	int id
+	) {
+		load_deferred();
+		POLYLIB_STAT ret = m_polygons->remove_triangle(id);
+		if( ret != PLSTAT_OK ) return ret;
+		m_tree_generation++;
+
+		// KD木要再構築フラグを立てる
+		m_need_rebuild = true;
+		return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolygonGroup::set_snapshot(
+	bool enable
+	) {
+		m_snapshot_enabled = enable;
+
+		// 有効にした時点の三角形をすぐに公開する
+		if (enable) publish_snapshot();
+		else		m_snapshot_slot.publish( NULL );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool PolygonGroup::get_snapshot() const {
+	return m_snapshot_enabled;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolygonSnapshotHandle PolygonGroup::acquire_snapshot() const {
+	load_deferred();
+	return m_snapshot_slot.acquire();
+}
+
 } //namespace PolylibNS
@@ -15,3 +15,160 @@
 ###################################################################################
 */
 #include "polygons/DVertexManager.h"
+#include "polygons/DVertex.h"
+
+#include <cstring>
+
+namespace PolylibNS{
+
+// public /////////////////////////////////////////////////////////////////////
+
+int DVertexManager::alloc_slot()
+{
+	int slot;
+	if( !m_free_slot.empty() ) {
+		slot = m_free_slot.back();
+		m_free_slot.pop_back();
+	} else {
+		slot = (int)m_nslot++;
+		for( int i=0; i<m_nscalar; i++ ) m_scalar[i].resize( m_nslot );
+		for( int i=0; i<m_nvector; i++ ) m_vector[i].resize( m_nslot*3 );
+		return slot;
+	}
+	for( int i=0; i<m_nscalar; i++ ) m_scalar[i][slot] = 0.0;
+	for( int i=0; i<m_nvector; i++ ) {
+		m_vector[i][slot*3]   = 0.0;
+		m_vector[i][slot*3+1] = 0.0;
+		m_vector[i][slot*3+2] = 0.0;
+	}
+	return slot;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+void DVertexManager::free_slot(int slot)
+{
+	if( slot < 0 || (size_t)slot >= m_nslot ) return;
+	if( (size_t)slot == m_nslot-1 && m_free_slot.empty() ) {
+		// 末尾なら配列ごと縮める
+		m_nslot--;
+		for( int i=0; i<m_nscalar; i++ ) m_scalar[i].resize( m_nslot );
+		for( int i=0; i<m_nvector; i++ ) m_vector[i].resize( m_nslot*3 );
+		return;
+	}
+	m_free_slot.push_back( slot );
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+void DVertexManager::reserve(size_t n)
+{
+	for( int i=0; i<m_nscalar; i++ ) m_scalar[i].reserve( n );
+	for( int i=0; i<m_nvector; i++ ) m_vector[i].reserve( n*3 );
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+void DVertexManager::repack(const std::vector<DVertex*>& order)
+{
+	size_t n = order.size();
+
+	for( int i=0; i<m_nscalar; i++ ) {
+		std::vector<PL_REAL> tmp( n );
+		for( size_t k=0; k<n; k++ ) tmp[k] = m_scalar[i][ order[k]->m_slot ];
+		m_scalar[i].swap( tmp );
+	}
+	for( int i=0; i<m_nvector; i++ ) {
+		std::vector<PL_REAL> tmp( n*3 );
+		for( size_t k=0; k<n; k++ ) {
+			const PL_REAL* src = &m_vector[i][ (size_t)order[k]->m_slot*3 ];
+			tmp[k*3]   = src[0];
+			tmp[k*3+1] = src[1];
+			tmp[k*3+2] = src[2];
+		}
+		m_vector[i].swap( tmp );
+	}
+	for( size_t k=0; k<n; k++ ) order[k]->m_slot = (int)k;
+
+	m_nslot = n;
+	m_free_slot.clear();
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT DVertexManager::set_scalar_array(int i, const PL_REAL* data, size_t n)
+{
+	if( i < 0 || i >= m_nscalar || n > m_nslot ) {
+		PL_ERROSH << "[ERROR]DVertexManager::set_scalar_array():invalid index or size. index "
+			<< i << " n " << n << " nslot " << m_nslot << std::endl;
+		return PLSTAT_NG;
+	}
+	if( n > 0 ) memcpy( &m_scalar[i][0], data, n*sizeof(PL_REAL) );
+	return PLSTAT_OK;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT DVertexManager::get_scalar_array(int i, PL_REAL* data, size_t n) const
+{
+	if( i < 0 || i >= m_nscalar || n > m_nslot ) {
+		PL_ERROSH << "[ERROR]DVertexManager::get_scalar_array():invalid index or size. index "
+			<< i << " n " << n << " nslot " << m_nslot << std::endl;
+		return PLSTAT_NG;
+	}
+	if( n > 0 ) memcpy( data, &m_scalar[i][0], n*sizeof(PL_REAL) );
+	return PLSTAT_OK;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT DVertexManager::set_vector_array(int i, const PL_REAL* data, size_t n)
+{
+	if( i < 0 || i >= m_nvector || n > m_nslot ) {
+		PL_ERROSH << "[ERROR]DVertexManager::set_vector_array():invalid index or size. index "
+			<< i << " n " << n << " nslot " << m_nslot << std::endl;
+		return PLSTAT_NG;
+	}
+	if( n > 0 ) memcpy( &m_vector[i][0], data, n*3*sizeof(PL_REAL) );
+	return PLSTAT_OK;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT DVertexManager::get_vector_array(int i, PL_REAL* data, size_t n) const
+{
+	if( i < 0 || i >= m_nvector || n > m_nslot ) {
+		PL_ERROSH << "[ERROR]DVertexManager::get_vector_array():invalid index or size. index "
+			<< i << " n " << n << " nslot " << m_nslot << std::endl;
+		return PLSTAT_NG;
+	}
+	if( n > 0 ) memcpy( data, &m_vector[i][0], n*3*sizeof(PL_REAL) );
+	return PLSTAT_OK;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+void DVertexManager::memory_usage(PolylibMemoryUsage* p_usage) const
+{
+	unsigned long long size = sizeof(DVertexManager);
+	size += m_scalar.capacity() * sizeof(std::vector<PL_REAL>);
+	for( size_t i=0; i<m_scalar.size(); i++ ) {
+		size += m_scalar[i].capacity() * sizeof(PL_REAL);
+	}
+	size += m_vector.capacity() * sizeof(std::vector<PL_REAL>);
+	for( size_t i=0; i<m_vector.size(); i++ ) {
+		size += m_vector[i].capacity() * sizeof(PL_REAL);
+	}
+	size += m_free_slot.capacity() * sizeof(int);
+	p_usage->m_fields += size;
+}
+
+} //namespace PolylibNS
@@ -46,6 +46,23 @@ DVertexTriangle::DVertexTriangle(
 		m_dvertex_ptr[2]=vertex_ptr[2];
 }
 
+///
+/// コンストラクタ。
+///
+/// @param[in] vertex_ptr	ポリゴンの頂点(DVertex)へのポインタ。
+/// @param[in] id		三角形ポリゴンID。
+/// @param[in] exid		三角形ポリゴンのユーザ定義ID。
+///
+DVertexTriangle::DVertexTriangle(
+	DVertex*	vertex_ptr[3] ,
+	int		id,
+	int		exid
+	) : PrivateTriangle( (Vertex**)vertex_ptr,id,exid) {
+		m_dvertex_ptr[0]=vertex_ptr[0];
+		m_dvertex_ptr[1]=vertex_ptr[1];
+		m_dvertex_ptr[2]=vertex_ptr[2];
+}
+
 ///
 /// コンストラクタ。
 ///
@@ -107,8 +124,11 @@ DVertexTriangle::DVertexTriangle(
 ///
 DVertexTriangle::DVertexTriangle(
 	const DVertexTriangle &tri
-	) : PrivateTriangle(tri.get_vertex(), tri.get_normal(),tri.get_id()) {
-
+	) : PrivateTriangle(tri) {
+		// exid,面積を含めて複製し、頂点は共有する
+		for(int i=0;i<3;i++){
+			m_dvertex_ptr[i]=dynamic_cast<DVertex*>(this->m_vertex_ptr[i]);
+		}
 }
 
 ///
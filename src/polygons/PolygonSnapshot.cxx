@@ -0,0 +1,493 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#include <algorithm>
+#include <sched.h>
+#if !defined(__GNUC__)
+#include <pthread.h>
+#endif
+
+#include "polygons/PolygonSnapshot.h"
+#include "polygons/VTree.h"
+#include "common/PolylibCommon.h"
+
+namespace PolylibNS {
+
+#if !defined(__GNUC__)
+/// 不可分操作の代替に用いる排他
+static pthread_mutex_t s_atomic_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+//  整数へ加算し、加算後の値を返す。前後の読み書きを追い越さない。
+static int atomic_add( volatile int* p, int n )
+{
+#if defined(__GNUC__)
+	return __sync_add_and_fetch( p, n );
+#else
+	pthread_mutex_lock( &s_atomic_mutex );
+	int v = ( *p += n );
+	pthread_mutex_unlock( &s_atomic_mutex );
+	return v;
+#endif
+}
+
+//  ポインタを読む。前後の読み書きを追い越さない。
+static PolygonSnapshot* atomic_load( PolygonSnapshot* volatile* p )
+{
+#if defined(__GNUC__)
+	return __sync_val_compare_and_swap( p, (PolygonSnapshot*)NULL, (PolygonSnapshot*)NULL );
+#else
+	pthread_mutex_lock( &s_atomic_mutex );
+	PolygonSnapshot* v = *p;
+	pthread_mutex_unlock( &s_atomic_mutex );
+	return v;
+#endif
+}
+
+//  ポインタを差し替え、差し替え前の値を返す。前後の読み書きを追い越さない。
+static PolygonSnapshot* atomic_exchange( PolygonSnapshot* volatile* p, PolygonSnapshot* v )
+{
+#if defined(__GNUC__)
+	// __sync_lock_test_and_setは取得バリアのみなので前に完全バリアを置く
+	__sync_synchronize();
+	PolygonSnapshot* old = __sync_lock_test_and_set( p, v );
+	__sync_synchronize();
+	return old;
+#else
+	pthread_mutex_lock( &s_atomic_mutex );
+	PolygonSnapshot* old = *p;
+	*p = v;
+	pthread_mutex_unlock( &s_atomic_mutex );
+	return old;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// クラス:PolygonSnapshotGeometry
+/// PolygonSnapshotが共有する頂点・三角形・KD木。参照カウントで管理する。
+///
+////////////////////////////////////////////////////////////////////////////
+class PolygonSnapshotGeometry {
+public:
+	PolygonSnapshotGeometry() : m_vtree(NULL), m_refs(0) {
+		m_bbox.init();
+	}
+
+	~PolygonSnapshotGeometry() {
+		delete m_vtree;
+	}
+
+	void add_ref() {
+		atomic_add( &m_refs, 1 );
+	}
+
+	void release() {
+		if( atomic_add( &m_refs, -1 ) == 0 ) delete this;
+	}
+
+	/// 複製した頂点(連続領域)
+	std::vector<Vertex>				m_vertices;
+
+	/// 複製した三角形(連続領域)。頂点はm_verticesを参照する。
+	std::vector<PrivateTriangle>	m_triangles;
+
+	/// m_trianglesへのポインタのリスト(KD木の元)。複製元と同じ並び。
+	std::vector<PrivateTriangle*>	m_tri_list;
+
+	/// KD木。三角形が無い場合NULL。
+	VTree*							m_vtree;
+
+	/// 全三角形を外包するBoundingBox(ローカル座標系)
+	BBox							m_bbox;
+
+	/// 参照カウント
+	volatile int					m_refs;
+
+private:
+	PolygonSnapshotGeometry( const PolygonSnapshotGeometry& );
+	PolygonSnapshotGeometry& operator=( const PolygonSnapshotGeometry& );
+};
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolygonSnapshot* PolygonSnapshot::create(
+	const std::vector<PrivateTriangle*>	*tri_list,
+	const VTree							*tree,
+	int									max_elem,
+	const double						*rigid
+	)
+{
+	PolygonSnapshotGeometry* geom = new PolygonSnapshotGeometry();
+	size_t ntri = ( tri_list == NULL ) ? 0 : tri_list->size();
+	if( ntri == 0 ) return new PolygonSnapshot( geom, rigid );
+
+	// 三角形が参照する頂点を重複なく集める
+	std::vector<Vertex*> src_vtx;
+	src_vtx.reserve( ntri * 3 );
+	for( size_t i=0; i<ntri; i++ ) {
+		Vertex** v = (*tri_list)[i]->get_vertex();
+		src_vtx.push_back( v[0] );
+		src_vtx.push_back( v[1] );
+		src_vtx.push_back( v[2] );
+	}
+	std::sort( src_vtx.begin(), src_vtx.end() );
+	src_vtx.erase( std::unique( src_vtx.begin(), src_vtx.end() ), src_vtx.end() );
+
+	// 頂点座標の複製(DVertexのデータは複製しない)
+	geom->m_vertices.reserve( src_vtx.size() );
+	for( size_t i=0; i<src_vtx.size(); i++ ) {
+		Vec3<PL_REAL> pos = (Vec3<PL_REAL>)( *src_vtx[i] );
+		geom->m_vertices.push_back( Vertex( pos ) );
+		geom->m_bbox.add( pos );
+	}
+
+	// 三角形の複製。法線・面積・IDは元の値を引き継ぐ
+	geom->m_triangles.reserve( ntri );
+	for( size_t i=0; i<ntri; i++ ) {
+		const PrivateTriangle* src = (*tri_list)[i];
+		Vertex** v = src->get_vertex();
+		Vertex* vtx[3];
+		for( int j=0; j<3; j++ ) {
+			size_t k = std::lower_bound( src_vtx.begin(), src_vtx.end(), v[j] ) - src_vtx.begin();
+			vtx[j] = &( geom->m_vertices[k] );
+		}
+		geom->m_triangles.push_back( PrivateTriangle( *src ) );
+		geom->m_triangles.back().set_vertexes( vtx, false, false );
+	}
+
+	// 連続領域が確定してからポインタを取る
+	geom->m_tri_list.resize( ntri );
+	for( size_t i=0; i<ntri; i++ ) geom->m_tri_list[i] = &( geom->m_triangles[i] );
+
+	// 構築済みの木の構造を写す(三角形の振り分けをやり直さない)。
+	// 木の構築後に三角形が増減している場合は作り直す
+	std::vector<VTreeNodeImage> nodes;
+	std::vector<int> elems;
+	if( tree != NULL && tree->export_image( tri_list, &nodes, &elems ) == PLSTAT_OK
+		&& elems.size() == ntri ) {
+		geom->m_vtree = new VTree( max_elem, &nodes[0], (int)nodes.size(),
+			elems.empty() ? NULL : &elems[0], (int)elems.size(), &( geom->m_tri_list ) );
+	}
+	else {
+		geom->m_vtree = new VTree( max_elem, geom->m_bbox, &( geom->m_tri_list ) );
+	}
+	return new PolygonSnapshot( geom, rigid );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolygonSnapshot* PolygonSnapshot::create_moved(
+	const PolygonSnapshot	*base,
+	const double			*rigid
+	)
+{
+	return new PolygonSnapshot( base->m_geom, rigid );
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+PolygonSnapshot::PolygonSnapshot(
+	PolygonSnapshotGeometry	*geom,
+	const double			*rigid
+	)
+	: m_geom(geom), m_rigid_dirty(rigid != NULL), m_generation(0), m_refs(0)
+{
+	m_geom->add_ref();
+	for( int i=0; i<9; i++ ) m_rigid_rot[i] = rigid ? rigid[i] : ( (i % 4 == 0) ? 1.0 : 0.0 );
+	for( int i=0; i<3; i++ ) m_rigid_trans[i] = rigid ? rigid[9+i] : 0.0;
+
+	// ワールド座標系の外包矩形は8頂点を変換して求める
+	m_bbox.init();
+	if( m_geom->m_tri_list.empty() ) return;
+	if( !m_rigid_dirty ) {
+		m_bbox = m_geom->m_bbox;
+		return;
+	}
+	for( int n=0; n<8; n++ ) m_bbox.add( to_world_pos( m_geom->m_bbox.getPoint(n) ) );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolygonSnapshot::~PolygonSnapshot()
+{
+	m_geom->release();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+std::vector<PrivateTriangle*>* PolygonSnapshot::search(
+	BBox	*bbox,
+	bool	every
+	) const
+{
+	std::vector<PrivateTriangle*>* tri_list = new std::vector<PrivateTriangle*>;
+	search( bbox, every, tri_list );
+	return tri_list;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolygonSnapshot::search(
+	BBox							*bbox,
+	bool							every,
+	std::vector<PrivateTriangle*>	*tri_list
+	) const
+{
+	if( tri_list == NULL ) return PLSTAT_ARGUMENT_NULL;
+	if( m_geom->m_vtree == NULL ) return PLSTAT_OK;
+	if( !m_rigid_dirty ) return m_geom->m_vtree->search( bbox, every, tri_list );
+
+	// ローカル座標系で外包矩形と交差する三角形を候補とし、ワールド座標で判定する
+	BBox local_bbox;
+	local_bbox.init();
+	for( int n=0; n<8; n++ ) local_bbox.add( to_local_pos( bbox->getPoint(n) ) );
+	std::vector<PrivateTriangle*> candidates;
+	POLYLIB_STAT ret = m_geom->m_vtree->search( &local_bbox, false, &candidates );
+	if( ret != PLSTAT_OK ) return ret;
+
+	for( size_t i=0; i<candidates.size(); i++ ) {
+		Vertex** vtx = candidates[i]->get_vertex();
+		Vec3<PL_REAL> p[3];
+		for( int j=0; j<3; j++ ) p[j] = to_world_pos( *vtx[j] );
+		if( every ) {
+			if( bbox->contain( p[0] ) && bbox->contain( p[1] ) && bbox->contain( p[2] ) ) {
+				tri_list->push_back( candidates[i] );
+			}
+		}
+		else {
+			BBox e_bbox;
+			e_bbox.init();
+			for( int j=0; j<3; j++ ) e_bbox.add( p[j] );
+			if( e_bbox.crossed( *bbox ) ) tri_list->push_back( candidates[i] );
+		}
+	}
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+const PrivateTriangle* PolygonSnapshot::search_nearest(
+	const Vec3<PL_REAL>&	pos
+	) const
+{
+	if( m_geom->m_vtree == NULL ) return NULL;
+	return m_geom->m_vtree->search_nearest( to_local_pos( pos ) );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+const PrivateTriangle* PolygonSnapshot::search_nearest_surface(
+	const Vec3<PL_REAL>&	pos,
+	PL_REAL					bary[3],
+	PL_REAL*				dist2
+	) const
+{
+	if( m_geom->m_vtree == NULL ) return NULL;
+	// 剛体変換は距離を保つので、ローカル座標系での距離をそのまま返す
+	return m_geom->m_vtree->search_nearest_surface( to_local_pos( pos ), bary, dist2 );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+const std::vector<PrivateTriangle*>* PolygonSnapshot::get_triangles() const
+{
+	return &( m_geom->m_tri_list );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool PolygonSnapshot::get_rigid_transform(
+	double	rt[12]
+	) const
+{
+	for( int i=0; i<9; i++ ) rt[i] = m_rigid_rot[i];
+	for( int i=0; i<3; i++ ) rt[9+i] = m_rigid_trans[i];
+	return m_rigid_dirty;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+Vec3<PL_REAL> PolygonSnapshot::to_world_pos(
+	const Vec3<PL_REAL>&	pos
+	) const
+{
+	if( !m_rigid_dirty ) return pos;
+	// x_world = R x_local + t
+	const double* r = m_rigid_rot;
+	const double* t = m_rigid_trans;
+	return Vec3<PL_REAL>(
+		r[0]*pos[0] + r[1]*pos[1] + r[2]*pos[2] + t[0],
+		r[3]*pos[0] + r[4]*pos[1] + r[5]*pos[2] + t[1],
+		r[6]*pos[0] + r[7]*pos[1] + r[8]*pos[2] + t[2] );
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+Vec3<PL_REAL> PolygonSnapshot::to_local_pos(
+	const Vec3<PL_REAL>&	pos
+	) const
+{
+	if( !m_rigid_dirty ) return pos;
+	// x_local = R^T (x_world - t)
+	const double* r = m_rigid_rot;
+	double d[3];
+	for( int i=0; i<3; i++ ) d[i] = pos[i] - m_rigid_trans[i];
+	return Vec3<PL_REAL>(
+		r[0]*d[0] + r[3]*d[1] + r[6]*d[2],
+		r[1]*d[0] + r[4]*d[1] + r[7]*d[2],
+		r[2]*d[0] + r[5]*d[1] + r[8]*d[2] );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolygonSnapshot::memory_usage( PolylibMemoryUsage* p_usage ) const
+{
+	p_usage->m_other     += sizeof(PolygonSnapshot) + sizeof(PolygonSnapshotGeometry);
+	p_usage->m_vertices  += m_geom->m_vertices.capacity() * sizeof(Vertex);
+	p_usage->m_triangles += m_geom->m_triangles.capacity() * sizeof(PrivateTriangle)
+		+ m_geom->m_tri_list.capacity() * sizeof(PrivateTriangle*);
+	if( m_geom->m_vtree != NULL ) m_geom->m_vtree->memory_usage( p_usage );
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+void PolygonSnapshot::add_ref()
+{
+	atomic_add( &m_refs, 1 );
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+void PolygonSnapshot::release()
+{
+	if( atomic_add( &m_refs, -1 ) == 0 ) delete this;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolygonSnapshotHandle::PolygonSnapshotHandle() : m_snapshot(NULL)
+{
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+PolygonSnapshotHandle::PolygonSnapshotHandle( PolygonSnapshot* snapshot )
+	: m_snapshot(snapshot)
+{
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolygonSnapshotHandle::PolygonSnapshotHandle( const PolygonSnapshotHandle& other )
+	: m_snapshot(other.m_snapshot)
+{
+	if( m_snapshot != NULL ) m_snapshot->add_ref();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolygonSnapshotHandle& PolygonSnapshotHandle::operator=( const PolygonSnapshotHandle& other )
+{
+	if( other.m_snapshot != NULL ) other.m_snapshot->add_ref();
+	if( m_snapshot != NULL ) m_snapshot->release();
+	m_snapshot = other.m_snapshot;
+	return *this;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolygonSnapshotHandle::~PolygonSnapshotHandle()
+{
+	reset();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolygonSnapshotHandle::reset()
+{
+	if( m_snapshot != NULL ) m_snapshot->release();
+	m_snapshot = NULL;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolygonSnapshotSlot::PolygonSnapshotSlot()
+	: m_current(NULL), m_epoch(0), m_generation(0)
+{
+	m_readers[0] = 0;
+	m_readers[1] = 0;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolygonSnapshotSlot::~PolygonSnapshotSlot()
+{
+	publish( NULL );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolygonSnapshotSlot::publish( PolygonSnapshot* snapshot )
+{
+	// 公開場所自身が1つ参照を持つ
+	if( snapshot != NULL ) {
+		snapshot->m_generation = ++m_generation;
+		snapshot->add_ref();
+	}
+
+	// 複製の内容を書き終えてから差し替える
+	PolygonSnapshot* old = atomic_exchange( &m_current, snapshot );
+
+	// エポックを進め、差し替え前のエポックでacquire()中のスレッドが
+	// 参照カウントを増やし終えるのを待つ。以後のacquire()は新しいエポックに
+	// 入り、差し替え後のポインタしか読まないので待つ対象にならない。
+	int e = atomic_add( &m_epoch, 1 ) - 1;
+	while( atomic_add( &m_readers[e & 1], 0 ) != 0 ) sched_yield();
+
+	if( old != NULL ) old->release();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolygonSnapshotHandle PolygonSnapshotSlot::acquire() const
+{
+	// 現在のエポックの枠で数えてからポインタを読む。数えている間にエポックが
+	// 進んだ場合は数え直す(そのエポックを終えるpublish()が数えた枠を待つ)。
+	int e = atomic_add( &m_epoch, 0 );
+	for( ;; ) {
+		atomic_add( &m_readers[e & 1], 1 );
+		int now = atomic_add( &m_epoch, 0 );
+		if( now == e ) break;
+		atomic_add( &m_readers[e & 1], -1 );
+		e = now;
+	}
+	PolygonSnapshot* snap = atomic_load( &m_current );
+	if( snap != NULL ) snap->add_ref();
+	atomic_add( &m_readers[e & 1], -1 );
+	return PolygonSnapshotHandle( snap );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolygonSnapshotSlot::memory_usage( PolylibMemoryUsage* p_usage ) const
+{
+	PolygonSnapshotHandle h = acquire();
+	if( h.valid() ) h->memory_usage( p_usage );
+}
+
+} //namespace PolylibNS
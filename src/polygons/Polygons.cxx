@@ -97,6 +97,72 @@ void Polygons::finalize_DVertex(){
 	//do nothing?
 }
 
+///
+/// 三角形と頂点を空間充填曲線に沿って並べ替える。
+///
+/// @param[in] type 曲線の種類
+///
+POLYLIB_STAT Polygons::reorder(SpaceFillingCurve::Type /*type*/){
+	return PLSTAT_OK;
+}
+
+///
+/// IDを指定して三角形を取得する。
+///
+/// @param[in] id 三角形ID
+///
+PrivateTriangle* Polygons::find_triangle(int id) const {
+	if( m_tri_list == NULL ) return NULL;
+	for( size_t i=0; i<m_tri_list->size(); i++ ) {
+		if( (*m_tri_list)[i]->get_id() == id ) return (*m_tri_list)[i];
+	}
+	return NULL;
+}
+
+///
+/// IDを指定して三角形を削除する。
+///
+/// @param[in] id 三角形ID
+///
+POLYLIB_STAT Polygons::remove_triangle(int id) {
+	if( m_tri_list == NULL ) return PLSTAT_TRIANGLE_NOT_EXIST;
+	for( size_t i=0; i<m_tri_list->size(); i++ ) {
+		if( (*m_tri_list)[i]->get_id() == id ) {
+			delete (*m_tri_list)[i];
+			m_tri_list->erase( m_tri_list->begin() + i );
+			return PLSTAT_OK;
+		}
+	}
+	return PLSTAT_TRIANGLE_NOT_EXIST;
+}
+
+///
+/// 三角形とKD木の読み取り専用の複製を作成する。
+///
+PolygonSnapshot* Polygons::create_snapshot(const double* /*rigid*/) const {
+	return NULL;
+}
+
+///
+/// 頂点・三角形とKD木をキャッシュファイルに保存する。
+///
+POLYLIB_STAT Polygons::save_cache(
+	const std::string&	/*fname*/,
+	const std::string&	/*key*/
+	) const {
+	return PLSTAT_NG;
+}
+
+///
+/// キャッシュファイルから頂点・三角形とKD木を復元する。
+///
+POLYLIB_STAT Polygons::load_cache(
+	const std::string&	/*fname*/,
+	const std::string&	/*key*/
+	) {
+	return PLSTAT_NG;
+}
+
 
 
 
@@ -20,6 +20,8 @@
 
 
 #include <algorithm>
+#include <climits>
+#include <sstream>
 #include "file_io/TriMeshIO.h"
 #include "polygons/VertKDT.h"
 #include "polygons/DVertexManager.h"
@@ -27,6 +29,10 @@
 #include "polygons/Triangle.h"
 #include "polygons/DVertexTriangle.h"
 #include "polygons/VTree.h"
+#include "polygons/PolygonSnapshot.h"
+#include "file_io/mesh_write.h"
+#include "file_io/mesh_cache.h"
+#include "util/PolylibProfiler.h"
 
 
 #define M_MAX_ELEMENTS 15	/// VTreeのノードが持つ最大要素数
@@ -52,6 +58,53 @@ struct PrivTriaEqual{
 	}
 };
 
+//  一括作成用の三角形IDの検査。IDの重複があればPLSTAT_NGを返す。
+//  *sortedには与えられたIDが昇順に並んでいるかを返す。
+static POLYLIB_STAT check_indexed_ids(
+	const int* idlist,
+	const int ntri,
+	const char* func,
+	bool* sorted
+	)
+{
+	*sorted = true;
+	if( idlist == NULL ) return PLSTAT_OK;	// 0からの連番
+	for( int i=1; i<ntri; i++ ) {
+		if( idlist[i-1] >= idlist[i] ) { *sorted = false; break; }
+	}
+	if( *sorted ) return PLSTAT_OK;
+
+	std::vector<int> ids( idlist, idlist+ntri );
+	std::sort( ids.begin(), ids.end() );
+	std::vector<int>::iterator dup = std::adjacent_find( ids.begin(), ids.end() );
+	if( dup != ids.end() ) {
+		PL_ERROSH << "[ERROR]TriMesh::" << func << "():duplicate triangle id:"
+			<< *dup << std::endl;
+		return PLSTAT_NG;
+	}
+	return PLSTAT_OK;
+}
+
+// 頂点座標とDVertexのデータを複製したDVertexを作成する。
+// srcがDVertexでない場合はデータ0で作成する。
+static DVertex* copy_dvertex( DVertexManager* dvm, Vertex* src )
+{
+	DVertex* dv = new DVertex( dvm );
+	Vertex* v = dv;
+	*v = *src;
+
+	DVertex* src_dv = dynamic_cast<DVertex*>( src );
+	for( int i=0; i<dvm->nscalar(); i++ ) {
+		dv->set_scalar( i, (src_dv != NULL) ? src_dv->get_scalar(i) : 0.0 );
+	}
+	for( int i=0; i<dvm->nvector(); i++ ) {
+		Vec3<PL_REAL> vec;
+		if( src_dv != NULL ) src_dv->get_vector( i, &vec );
+		dv->set_vector( i, vec );
+	}
+	return dv;
+}
+
 // public /////////////////////////////////////////////////////////////////////
 
 TriMesh::TriMesh()
@@ -65,6 +118,7 @@ TriMesh::TriMesh()
 	m_max_elements = M_MAX_ELEMENTS;
 	m_tolerance = 1.0e-10; // tempolary
 	m_DVM_ptr=NULL;
+	m_id_indexed = 0;
 }
 // public /////////////////////////////////////////////////////////////////////
 
@@ -79,6 +133,7 @@ TriMesh::TriMesh(PL_REAL tolerance)
 	m_max_elements = M_MAX_ELEMENTS;
 	m_tolerance = tolerance;
 	m_DVM_ptr=NULL;
+	m_id_indexed = 0;
 }
 
 // public /////////////////////////////////////////////////////////////////////
@@ -165,6 +220,7 @@ void TriMesh::init(const PL_REAL* vertlist,
 	//  POLYLIB_STAT status = vtx_compaction();
 
 	vtx_compaction();
+	rebuild_id_index();
 
 #ifdef DEBUG
 	PL_DBGOSH << "TriMesh::"<<__func__<< " end of vtx_comaction"<<std::endl;
@@ -222,9 +278,9 @@ void TriMesh::init_dvertex(const PL_REAL* vertlist,
 				scalarindex++;
 			}
 			for(int ivector=0;ivector<m_DVM_ptr->nvector();ivector++){
-				Vec3<PL_REAL> data_vec(vectorlist[n_start_scalar+scalarindex],
-					vectorlist[n_start_scalar+scalarindex+1],
-					vectorlist[n_start_scalar+scalarindex+2]);
+				Vec3<PL_REAL> data_vec(vectorlist[n_start_vector+vectorindex],
+					vectorlist[n_start_vector+vectorindex+1],
+					vectorlist[n_start_vector+vectorindex+2]);
 				dv->set_vector(ivector,data_vec);
 				vectorindex+=3;
 			}
@@ -249,6 +305,7 @@ void TriMesh::init_dvertex(const PL_REAL* vertlist,
 	//  POLYLIB_STAT status = vtx_compaction();
 
 	vtx_compaction();
+	rebuild_id_index();
 
 #ifdef DEBUG
 	PL_DBGOSH << "TriMesh::"<<__func__<< " end of vtx_comaction"<<std::endl;
@@ -258,6 +315,165 @@ void TriMesh::init_dvertex(const PL_REAL* vertlist,
 
 
 
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT TriMesh::init_indexed(const PL_REAL* coords,
+	const int nvert,
+	const int* index,
+	const int ntri,
+	const int* idlist,
+	const int* exidlist
+	)
+{
+#ifdef DEBUG
+	PL_DBGOSH << "TriMesh::"<<__func__<< " in. nvert="<<nvert<<" ntri="<<ntri<<std::endl;
+#endif
+	if( nvert < 0 || ntri < 0 ) return PLSTAT_NG;
+	if( (nvert > 0 && coords == NULL) || (ntri > 0 && index == NULL) ) {
+		return PLSTAT_ARGUMENT_NULL;
+	}
+	for( int i=0; i<ntri*3; i++ ) {
+		if( index[i] < 0 || index[i] >= nvert ) {
+			PL_ERROSH << "[ERROR]TriMesh::init_indexed():wrong vertex index:"
+				<< index[i] << " triangle:" << i/3 << std::endl;
+			return PLSTAT_NG;
+		}
+	}
+	bool sorted;
+	POLYLIB_STAT ret = check_indexed_ids( idlist, ntri, "init_indexed", &sorted );
+	if( ret != PLSTAT_OK ) return ret;
+
+	init_tri_list();
+	init_vertex_list();
+	std::vector<Vertex*> vlist( nvert );
+	for( int i=0; i<nvert; i++ ) {
+		vlist[i] = new Vertex( Vec3<PL_REAL>( coords[i*3],
+			coords[i*3+1], coords[i*3+2] ) );
+		this->m_vertex_list->vtx_add_nocheck( vlist[i] );
+	}
+	this->m_tri_list->resize( ntri );
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for( int i=0; i<ntri; i++ ) {
+		Vertex* vtx[3];
+		for( int j=0; j<3; j++ ) vtx[j] = vlist[ index[i*3+j] ];
+		int id = ( idlist != NULL ) ? idlist[i] : i;
+		int exid = ( exidlist != NULL ) ? exidlist[i] : 0;
+		(*this->m_tri_list)[i] = new PrivateTriangle( vtx, id, exid );
+	}
+	// 三角形リストはID順に揃える
+	if( !sorted ) {
+		std::sort( this->m_tri_list->begin(), this->m_tri_list->end(), PrivTriaLess() );
+	}
+	rebuild_id_index();
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT TriMesh::init_dvertex_indexed(const PL_REAL* coords,
+	const int nvert,
+	const int* index,
+	const int ntri,
+	const int* idlist,
+	const int* exidlist,
+	const PL_REAL* scalarlist,
+	const PL_REAL* vectorlist,
+	const bool weld
+	)
+{
+#ifdef DEBUG
+	PL_DBGOSH << "TriMesh::"<<__func__<< " in. nvert="<<nvert<<" ntri="<<ntri<<std::endl;
+#endif
+	if( m_DVM_ptr == NULL ) {
+		PL_ERROSH << "[ERROR]TriMesh::init_dvertex_indexed():DVertex is not prepared."
+			<< std::endl;
+		return PLSTAT_NG;
+	}
+	if( nvert < 0 || ntri < 0 ) return PLSTAT_NG;
+	if( (nvert > 0 && coords == NULL) || (ntri > 0 && index == NULL) ) {
+		return PLSTAT_ARGUMENT_NULL;
+	}
+	for( int i=0; i<ntri*3; i++ ) {
+		if( index[i] < 0 || index[i] >= nvert ) {
+			PL_ERROSH << "[ERROR]TriMesh::init_dvertex_indexed():wrong vertex index:"
+				<< index[i] << " triangle:" << i/3 << std::endl;
+			return PLSTAT_NG;
+		}
+	}
+	bool sorted;
+	POLYLIB_STAT ret = check_indexed_ids( idlist, ntri, "init_dvertex_indexed", &sorted );
+	if( ret != PLSTAT_OK ) return ret;
+
+	init_tri_list();
+	init_vertex_list();
+
+	// 空のDVertexManagerに作り直し、頂点番号=スロット番号とする
+	int nscalar = m_DVM_ptr->nscalar();
+	int nvector = m_DVM_ptr->nvector();
+	delete m_DVM_ptr;
+	m_DVM_ptr = new DVertexManager(nscalar,nvector);
+	m_DVM_ptr->reserve(nvert);
+
+	// スロットの確保はスレッドセーフでないので逐次で行う
+	std::vector<DVertex*> dvlist(nvert);
+	for(int i=0;i<nvert;++i) {
+		dvlist[i] = new DVertex(m_DVM_ptr);
+	}
+
+	// 頂点座標とデータの設定(確保済みスロットへの書き込みは並列可)
+	std::vector<PL_REAL*> sdata(nscalar), vdata(nvector);
+	for(int j=0;j<nscalar;++j) sdata[j] = m_DVM_ptr->scalar_data(j);
+	for(int j=0;j<nvector;++j) vdata[j] = m_DVM_ptr->vector_data(j);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for(int i=0;i<nvert;++i) {
+		Vertex* v = dvlist[i];
+		*v = Vec3<PL_REAL>(coords[i*3],coords[i*3+1],coords[i*3+2]);
+		int slot = dvlist[i]->slot();
+		if( scalarlist != NULL ) {
+			for(int j=0;j<nscalar;++j) sdata[j][slot] = scalarlist[i*nscalar+j];
+		}
+		if( vectorlist != NULL ) {
+			for(int j=0;j<nvector;++j) {
+				for(int k=0;k<3;++k) {
+					vdata[j][slot*3+k] = vectorlist[(i*nvector+j)*3+k];
+				}
+			}
+		}
+	}
+	for(int i=0;i<nvert;++i) {
+		this->m_vertex_list->vtx_add_nocheck(dvlist[i]);
+	}
+
+	// 三角形の生成(法線・面積の計算を含む)
+	this->m_tri_list->resize(ntri);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for(int i=0;i<ntri;++i) {
+		DVertex* vtx_tri[3];
+		for(int j=0;j<3;++j) vtx_tri[j] = dvlist[index[i*3+j]];
+		int id = (idlist != NULL) ? idlist[i] : i;
+		int exid = (exidlist != NULL) ? exidlist[i] : 0;
+		(*this->m_tri_list)[i] = new DVertexTriangle(vtx_tri,id,exid);
+	}
+	// 三角形リストはID順に揃える
+	if( !sorted ) {
+		std::sort( this->m_tri_list->begin(), this->m_tri_list->end(), PrivTriaLess() );
+	}
+
+	if( weld ) vtx_compaction();
+	rebuild_id_index();
+
+#ifdef DEBUG
+	PL_DBGOSH << "TriMesh::"<<__func__<< " end."<<std::endl;
+#endif
+	return PLSTAT_OK;
+}
+
 // public /////////////////////////////////////////////////////////////////////
 
 void TriMesh::add_dvertex(const PL_REAL* vertlist,
@@ -300,7 +516,18 @@ void TriMesh::add_dvertex(const PL_REAL* vertlist,
 	PL_DBGOSH << "TriMesh::"<<__func__<< " create vertex and triangle nvtx_before "<< this->m_vertex_list->size()<<std::endl;
 #endif
 
+	// ID重複はID索引で判定する(三角形リスト全体のソートは行わない)
+	sync_id_index();
+	m_id_index.reserve( this->m_tri_list->size() + n_tri );
+
 	for(int i=0;i<n_tri;++i) {
+		// 既存IDの三角形は追加しない(頂点データは読み飛ばす)
+		if( m_id_index.find( idlist[n_start_id+i] ) >= 0 ) {
+			scalarindex += 3*m_DVM_ptr->nscalar();
+			vectorindex += 3*m_DVM_ptr->nvector()*3;
+			continue;
+		}
+
 		int id=n_start_tri+i*9;
 		DVertex* vtx_tri[3];
 		for(int j=0;j<3;++j){
@@ -322,9 +549,9 @@ void TriMesh::add_dvertex(const PL_REAL* vertlist,
 				scalarindex++;
 			}
 			for(int ivector=0;ivector<m_DVM_ptr->nvector();ivector++){
-				Vec3<PL_REAL> data_vec(vectorlist[n_start_scalar+vectorindex],
-					vectorlist[n_start_scalar+vectorindex+1],
-					vectorlist[n_start_scalar+vectorindex+2]);
+				Vec3<PL_REAL> data_vec(vectorlist[n_start_vector+vectorindex],
+					vectorlist[n_start_vector+vectorindex+1],
+					vectorlist[n_start_vector+vectorindex+2]);
 
 #ifdef DEBUG
 				PL_DBGOSH << "TriMesh::"<<__func__
@@ -350,7 +577,9 @@ void TriMesh::add_dvertex(const PL_REAL* vertlist,
 		int id3=n_start_exid+i;
 		DVertexTriangle* tri=new DVertexTriangle(vtx_tri,idlist[id2],exidlist[id3]);
 		//      PrivateTriangle* tri=new PrivateTriangle(vtx_tri,idlist[id2]);
+		m_id_index.insert( tri->get_id(), (int)this->m_tri_list->size() );
 		this->m_tri_list->push_back((PrivateTriangle*)tri);
+		m_id_indexed = this->m_tri_list->size();
 	}
 
 
@@ -371,18 +600,14 @@ void TriMesh::add_dvertex(const PL_REAL* vertlist,
 	PL_DBGOSH << "TriMesh::"<<__func__<< " sort"<<std::endl;
 #endif
 
-	// 三角形リストをID順にソート
-	std::sort( this->m_tri_list->begin(),
-		this->m_tri_list->end(),
-		PrivTriaLess() );
+	// 三角形リストは追加順のまま(IDによる参照はID索引で行う)
 
 #ifdef DEBUG
 	PL_DBGOSH << "TriMesh::"<<__func__<< " erase"<<std::endl;
 #endif
 
 
-	//DVertexの場合は行わない。
-	// ID重複ぶんを削除
+	// ID重複ぶんは追加時に除いている
 	// this->m_tri_list->erase(
 	// 			    std::unique(this->m_tri_list->begin(), this->m_tri_list->end(), PrivTriaEqual()),
 	// 			    this->m_tri_list->end());
@@ -438,6 +663,23 @@ void TriMesh::init(const std::vector<PrivateTriangle*>* trias)
 			//      PL_DBGOSH<< "TriMesh::" << __func__ << " get_vertex "<< tmpvert <<std::endl;
 			Vertex* tmpvert_in[3];
 
+			// DVertexを持つ場合はデータごと複製し、DVertexTriangleとする
+			if( m_DVM_ptr != NULL ) {
+				DVertex* tmpdvert_in[3];
+				for( int j=0; j<3; j++ ) {
+					tmpdvert_in[j] = copy_dvertex( m_DVM_ptr, tmpvert[j] );
+					new_vertex_list->vtx_add_nocheck( tmpdvert_in[j] );
+				}
+				DVertexTriangle* dvtri = new DVertexTriangle( tmpdvert_in,
+					(*itr)->get_normal(),
+					(*itr)->get_area(),
+					(*itr)->get_id()
+					);
+				dvtri->set_exid((*itr)->get_exid());
+				this->m_tri_list->push_back( dvtri );
+				continue;
+			}
+
 			// make deep copy!
 			Vertex* tmp = new Vertex(*(tmpvert[0]));
 			//      PL_DBGOSH<< "TriMesh::" << __func__ << " make new Vertex 0 "<< tmp <<std::endl;
@@ -490,6 +732,7 @@ void TriMesh::init(const std::vector<PrivateTriangle*>* trias)
 	//  POLYLIB_STAT status = TriMeshIO::vtx_compaction(new_vertex_list, this->m_tri_list);
 	//  POLYLIB_STAT status = vtx_compaction();
 	vtx_compaction();
+	rebuild_id_index();
 	//#undef DEBUG
 }
 
@@ -519,7 +762,14 @@ void TriMesh::add(const PL_REAL* vertlist,
 	PL_DBGOSH << "TriMesh::add VertexList and PrivateTriangle is ready."<<std::endl;
 #endif
 
+	// ID重複はID索引で判定する(三角形リスト全体のソートは行わない)
+	sync_id_index();
+	m_id_index.reserve( this->m_tri_list->size() + n_tri );
+
 	for(int i=0;i<n_tri;++i) {
+		// 既存IDの三角形は追加しない
+		if( m_id_index.find( idlist[n_start_id+i] ) >= 0 ) continue;
+
 		int id=n_start_tri+i*9;
 		Vertex* vtx_tri[3];
 		for(int j=0;j<3;++j){
@@ -553,40 +803,15 @@ void TriMesh::add(const PL_REAL* vertlist,
 		/* PL_DBGOSH << "TriMesh::add Triangle. triangle "<< i  */
 		/* 		 << " id "<<idlist[id2]<<std::endl; */
 
+		m_id_index.insert( tri->get_id(), (int)this->m_tri_list->size() );
 		this->m_tri_list->push_back(tri);
+		m_id_indexed = this->m_tri_list->size();
 
 		/* PL_DBGOSH << "TriMesh::add Triangle. triangle "<< i <<std::endl; */
 		/* // */
 	}
 
-	//PL_DBGOSH << "TriMesh::add Triangle. add vtx"<<std::endl;
-
-	// 三角形リストをID順にソート
-	std::sort( this->m_tri_list->begin(), this->m_tri_list->end(), PrivTriaLess() );
-#ifdef DEBUG
-	PL_DBGOSH << "TriMesh::add Triangle. sort"<<std::endl;
-#endif
-	// Comment
-	// Vertex および PrivateTriangle が delete されていない。
-	// 2013-Jan.-10th T. Suzuki
-
-#ifdef DEBUG
-	for(int i=0;i<this->m_tri_list->size();++i){
-		PL_DBGOSH << " before id "<<(*this->m_tri_list)[i]->get_id() <<std::endl;
-	}
-#endif
-
-	// ID重複ぶんを削除
-	this->m_tri_list->erase(
-		std::unique(this->m_tri_list->begin(),
-		this->m_tri_list->end(),
-		PrivTriaEqual()),
-		this->m_tri_list->end());
-
 #ifdef DEBUG
-	for(int i=0;i<this->m_tri_list->size();++i){
-		PL_DBGOSH << " after id "<<(*this->m_tri_list)[i]->get_id() <<std::endl;
-	}
 	PL_DBGOSH << "TriMesh::add end"<<std::endl;
 #endif
 
@@ -613,18 +838,22 @@ void
 		this->m_vertex_list = new VertexList;
 	}
 
-	// ひとまず全部追加
+	// ID重複はID索引で判定する(三角形リスト全体のソートは行わない)
+	sync_id_index();
+	m_id_index.reserve( this->m_tri_list->size() + trias->size() );
+
+	// 未登録IDの三角形だけを末尾へ追加。DVertexTriangleは型を保ったまま複製する
 	for( i=0; i<trias->size(); i++ ) {
-		this->m_tri_list->push_back( new PrivateTriangle( *(trias->at(i)) ) );
+		const PrivateTriangle* src = trias->at(i);
+		if( !m_id_index.insert( src->get_id(), (int)this->m_tri_list->size() ) ) continue;
+		const DVertexTriangle* p_dvtri = dynamic_cast<const DVertexTriangle*>( src );
+		if( p_dvtri != NULL ) {
+			this->m_tri_list->push_back( new DVertexTriangle( *p_dvtri ) );
+		} else {
+			this->m_tri_list->push_back( new PrivateTriangle( *src ) );
+		}
+		m_id_indexed = this->m_tri_list->size();
 	}
-
-	// 三角形リストをID順にソート
-	std::sort( this->m_tri_list->begin(), this->m_tri_list->end(), PrivTriaLess() );
-
-	// ID重複ぶんを削除
-	this->m_tri_list->erase(
-		std::unique(this->m_tri_list->begin(), this->m_tri_list->end(), PrivTriaEqual()),
-		this->m_tri_list->end());
 #ifdef DEBUG
 	PL_DBGOSH << "TriMesh<T>::add_triangles() in." << std::endl;
 #endif
@@ -639,6 +868,13 @@ POLYLIB_STAT TriMesh::import(const std::map<std::string, std::string> fmap, PL_R
 
 	//      PL_DBGOSH << __func__ << " scale "<< scale <<std::endl;
 
+	PolylibProfileScope prof( PolylibProfiler::PH_LOAD );
+
+	// VTK/VTUファイル1つの場合は頂点番号形式のまま読み込む
+	if( fmap.size() == 1 && TriMeshIO::is_indexed_format( fmap.begin()->second ) ) {
+		return import_indexed( fmap.begin()->first, fmap.begin()->second, scale );
+	}
+
 	init_tri_list();
 	//PL_DBGOSH << __func__ << " scale 1 "<< scale <<std::endl;
 	init_vertex_list();
@@ -649,6 +885,7 @@ POLYLIB_STAT TriMesh::import(const std::map<std::string, std::string> fmap, PL_R
 	if(ret!=PLSTAT_OK) return ret;
 
 	vtx_compaction();
+	rebuild_id_index();
 
 	return ret;
 
@@ -656,6 +893,63 @@ POLYLIB_STAT TriMesh::import(const std::map<std::string, std::string> fmap, PL_R
 }
 
 
+// private ////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT TriMesh::import_indexed(
+	const std::string	&fname,
+	const std::string	&fmt,
+	PL_REAL				scale
+	)
+{
+	VtkMesh mesh;
+	POLYLIB_STAT ret = TriMeshIO::load_indexed( fname, fmt, &mesh, scale );
+	if( ret != PLSTAT_OK ) return ret;
+
+	int nvert = mesh.nvert();
+	int ntri = mesh.ntri();
+	const int* ids = mesh.ids.empty() ? NULL : &mesh.ids[0];
+	const int* exids = mesh.exids.empty() ? NULL : &mesh.exids[0];
+
+	// 頂点データが無い場合はVertex、PrivateTriangleで作成
+	if( m_DVM_ptr == NULL && mesh.nscalar == 0 && mesh.nvector == 0 ) {
+		return init_indexed( nvert > 0 ? &mesh.coords[0] : NULL, nvert,
+			ntri > 0 ? &mesh.index[0] : NULL, ntri, ids, exids );
+	}
+
+	if( m_DVM_ptr == NULL ) {
+		prepare_DVertex( mesh.nscalar, mesh.nvector );
+	}
+
+	// ファイルのデータをDVertexManagerの構成に合わせる
+	int nscalar = m_DVM_ptr->nscalar();
+	int nvector = m_DVM_ptr->nvector();
+	if( nscalar != mesh.nscalar ) {
+		std::vector<PL_REAL> s( (size_t)nvert * nscalar, 0.0 );
+		int n = std::min( nscalar, mesh.nscalar );
+		for( int i=0; i<nvert; i++ ) {
+			for( int j=0; j<n; j++ ) s[ (size_t)i*nscalar+j ] = mesh.scalars[ (size_t)i*mesh.nscalar+j ];
+		}
+		mesh.scalars.swap( s );
+	}
+	if( nvector != mesh.nvector ) {
+		std::vector<PL_REAL> v( (size_t)nvert * nvector * 3, 0.0 );
+		int n = std::min( nvector, mesh.nvector );
+		for( int i=0; i<nvert; i++ ) {
+			for( int j=0; j<n*3; j++ ) v[ (size_t)i*nvector*3+j ] = mesh.vectors[ (size_t)i*mesh.nvector*3+j ];
+		}
+		mesh.vectors.swap( v );
+	}
+#ifdef DEBUG
+	PL_DBGOSH << "TriMesh::import_indexed():" << fname << " nvert=" << nvert
+		<< " ntri=" << ntri << " nscalar=" << mesh.nscalar << " nvector=" << mesh.nvector << std::endl;
+#endif
+
+	return init_dvertex_indexed( nvert > 0 ? &mesh.coords[0] : NULL, nvert,
+		ntri > 0 ? &mesh.index[0] : NULL, ntri, ids, exids,
+		mesh.scalars.empty() ? NULL : &mesh.scalars[0],
+		mesh.vectors.empty() ? NULL : &mesh.vectors[0], false );
+}
+
 // public /////////////////////////////////////////////////////////////////////
 
 POLYLIB_STAT TriMesh::build()
@@ -665,6 +959,8 @@ POLYLIB_STAT TriMesh::build()
 	PL_DBGOSH << "TriMesh::build() start" << std::endl;
 #endif // DEBUG
 
+	PolylibProfileScope prof( PolylibProfiler::PH_BUILD );
+
 	BBox bbox;
 
 	//	BBox bbox=this->m_vertex_list->get_bbox();
@@ -736,6 +1032,9 @@ POLYLIB_STAT TriMesh::build()
 	// 木構造作成
 	if (m_vtree != NULL) delete m_vtree;
 	m_vtree = new VTree(m_max_elements, m_bbox, this->m_tri_list);
+
+	// 三角形リストは外部からも変更されるので(id読み込み、PE間移動等)ID索引も作り直す
+	rebuild_id_index();
 	// if (m_vertKDT!=NULL) delete m_vertKDT;
 	// m_vertKDT = new VertKDT(m_max_elements, m_bbox, this->m_vertex_list);
 #ifdef DEBUG
@@ -766,6 +1065,8 @@ const std::vector<PrivateTriangle*> *TriMesh::search(
 		PL_DBGOSH << "TriMesh::search:min=(" <<min<< "),max=(" <<max<< ")" << std::endl;
 #endif
 
+		PolylibProfileScope prof( PolylibProfiler::PH_SEARCH );
+		PolylibProfiler::count( PolylibProfiler::CT_SEARCH_QUERIES, 1 );
 		return m_vtree->search(bbox, every);
 		//#undef DEBUG
 }
@@ -777,6 +1078,8 @@ POLYLIB_STAT TriMesh::search(
 	bool						every,
 	std::vector<PrivateTriangle*>	*tri_list
 	) const {
+		PolylibProfileScope prof( PolylibProfiler::PH_SEARCH );
+		PolylibProfiler::count( PolylibProfiler::CT_SEARCH_QUERIES, 1 );
 		return m_vtree->search(bbox, every, tri_list);
 }
 
@@ -886,11 +1189,27 @@ POLYLIB_STAT TriMesh::linear_search(
 const PrivateTriangle* TriMesh::search_nearest(
 	const Vec3<PL_REAL>&    pos
 	) const {
+		PolylibProfileScope prof( PolylibProfiler::PH_SEARCH );
+		PolylibProfiler::count( PolylibProfiler::CT_SEARCH_QUERIES, 1 );
 		return m_vtree->search_nearest(pos);
 }
 
 // public /////////////////////////////////////////////////////////////////////
 
+const PrivateTriangle* TriMesh::search_nearest_surface(
+	const Vec3<PL_REAL>&	pos,
+	PL_REAL					bary[3],
+	PL_REAL*				dist2,
+	PL_CALC_REAL			bound2
+	) const {
+		if( m_vtree == NULL ) return NULL;
+		PolylibProfileScope prof( PolylibProfiler::PH_SEARCH );
+		PolylibProfiler::count( PolylibProfiler::CT_SEARCH_QUERIES, 1 );
+		return m_vtree->search_nearest_surface(pos, bary, dist2, bound2);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
 POLYLIB_STAT TriMesh::set_all_exid(
 	const int    id
 	) const {
@@ -922,6 +1241,8 @@ void TriMesh::init_tri_list()
 		this->m_tri_list->clear();
 
 	}
+	m_id_index.clear();
+	m_id_indexed = 0;
 	if(m_vtree!=NULL) {
 		delete m_vtree;
 		m_vtree=NULL;
@@ -1025,6 +1346,8 @@ void TriMesh::vtx_compaction()
 	PL_DBGOSH << "vtx_compaction" <<std::endl;
 #endif
 
+	PolylibProfileScope prof( PolylibProfiler::PH_WELD );
+
 	std::map<Vertex*,Vertex*>* vtx_map=new  std::map<Vertex*,Vertex*>;
 	;
 	this->m_vertex_list->vertex_compaction(vtx_map);
@@ -1084,8 +1407,26 @@ void TriMesh::vtx_compaction()
 #endif
 	}
 
+	// DVertexのデータを頂点リストの並びに詰め直す
+	repack_dvertex();
+
 	//#undef DEBUG
 }
+
+// private ////////////////////////////////////////////////////////////////////
+
+void TriMesh::repack_dvertex()
+{
+	if( m_DVM_ptr == NULL ) return;
+	const std::vector<Vertex*>* vlist = this->m_vertex_list->get_vertex_lists();
+	std::vector<DVertex*> order;
+	order.reserve( vlist->size() );
+	for( size_t i=0; i<vlist->size(); i++ ) {
+		DVertex* dv = dynamic_cast<DVertex*>( vlist->at(i) );
+		if( dv != NULL && dv->DVM() == m_DVM_ptr ) order.push_back( dv );
+	}
+	if( order.size() == vlist->size() ) m_DVM_ptr->repack( order );
+}
 //// public ///////////////////////////////
 
 POLYLIB_STAT TriMesh::replace_DVertex(int nscalar,int nvector){
@@ -1094,6 +1435,7 @@ POLYLIB_STAT TriMesh::replace_DVertex(int nscalar,int nvector){
 	PL_DBGOSH << __func__ << std::endl;
 #endif
 
+	DVertexManager* old_DVM = m_DVM_ptr;
 	m_DVM_ptr = new DVertexManager(nscalar,nvector);
 	std::map<Vertex*,Vertex*> ptr_map;
 #ifdef DEBUG
@@ -1203,7 +1545,7 @@ POLYLIB_STAT TriMesh::replace_DVertex(int nscalar,int nvector){
 			PL_DBGOSH << __func__ << " 4 3"<<std::endl;
 #endif
 
-			DVertexTriangle* new_dv_tri= new DVertexTriangle(tmpdvert,(*itr)->get_id());
+			DVertexTriangle* new_dv_tri= new DVertexTriangle(tmpdvert,(*itr)->get_id(),(*itr)->get_exid());
 #ifdef DEBUG
 			PL_DBGOSH << __func__ << " 4 4"<<std::endl;
 #endif
@@ -1222,6 +1564,7 @@ POLYLIB_STAT TriMesh::replace_DVertex(int nscalar,int nvector){
 
 	init_vertex_list();
 	this->m_vertex_list=new_dv;
+	if( old_DVM != NULL ) delete old_DVM;
 
 
 	init_tri_list();
@@ -1245,6 +1588,7 @@ POLYLIB_STAT TriMesh::prepare_DVertex(int nscalar,int nvector){
 #endif
 	init_tri_list();
 	init_vertex_list();
+	if( m_DVM_ptr != NULL ) delete m_DVM_ptr;
 	m_DVM_ptr = new DVertexManager(nscalar,nvector);
 #ifdef DEBUG
 	PL_DBGOSH << __func__
@@ -1371,6 +1715,291 @@ void TriMesh::finalize_DVertex()
 
 
 
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT TriMesh::reorder(SpaceFillingCurve::Type type)
+{
+#ifdef DEBUG
+	PL_DBGOSH << "TriMesh::reorder() in. type:" << SpaceFillingCurve::name(type) << std::endl;
+#endif
+	if( type == SpaceFillingCurve::SFC_NONE ) return PLSTAT_OK;
+	if( this->m_tri_list == NULL || this->m_vertex_list == NULL ) return PLSTAT_OK;
+
+	std::vector<Vertex*>* vlist = this->m_vertex_list->get_vertex_lists_mod();
+	std::vector<PrivateTriangle*>* tlist = this->m_tri_list;
+	size_t nvtx = vlist->size();
+	size_t ntri = tlist->size();
+
+	// キーの量子化範囲は全頂点を外包するBoundingBox
+	BBox bbox;
+	bbox.init();
+	for( size_t i=0; i<nvtx; i++ ) bbox.add( (Vec3<PL_REAL>)(*(*vlist)[i]) );
+
+	// 頂点をキー順に並べ替え(キーが同じ場合は元の順)
+	std::vector<std::pair<unsigned long long, size_t> > keys( nvtx );
+	for( size_t i=0; i<nvtx; i++ ) {
+		keys[i].first = SpaceFillingCurve::key( type, *(*vlist)[i], bbox );
+		keys[i].second = i;
+	}
+	std::sort( keys.begin(), keys.end() );
+	bool vmoved = false;
+	for( size_t i=0; i<nvtx; i++ ) {
+		if( keys[i].second != i ) { vmoved = true; break; }
+	}
+	if( vmoved ) {
+		std::vector<Vertex*> vsorted( nvtx );
+		for( size_t i=0; i<nvtx; i++ ) vsorted[i] = (*vlist)[ keys[i].second ];
+		vlist->swap( vsorted );
+		repack_dvertex();
+	}
+
+	// 三角形リストを重心のキー順に並べ替える(三角形のアドレスは変わらない)
+	keys.resize( ntri );
+	for( size_t i=0; i<ntri; i++ ) {
+		Vertex** v = (*tlist)[i]->get_vertex();
+		Vec3<PL_REAL> c = ( (Vec3<PL_REAL>)(*v[0]) + (Vec3<PL_REAL>)(*v[1])
+			+ (Vec3<PL_REAL>)(*v[2]) ) / 3.0;
+		keys[i].first = SpaceFillingCurve::key( type, c, bbox );
+		keys[i].second = i;
+	}
+	std::sort( keys.begin(), keys.end() );
+	bool tmoved = false;
+	for( size_t i=0; i<ntri; i++ ) {
+		if( keys[i].second != i ) { tmoved = true; break; }
+	}
+	if( !tmoved ) return PLSTAT_OK;
+
+	std::vector<PrivateTriangle*> tsorted( ntri );
+	for( size_t i=0; i<ntri; i++ ) tsorted[i] = (*tlist)[ keys[i].second ];
+	tlist->swap( tsorted );
+
+	// KD木の葉は三角形リスト上の番号を持つので破棄
+	if( m_vtree != NULL ) {
+		delete m_vtree;
+		m_vtree = NULL;
+	}
+
+	// 三角形リストの位置が変わったのでID索引を作り直す
+	rebuild_id_index();
+
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PrivateTriangle* TriMesh::find_triangle(int id) const
+{
+	if( this->m_tri_list == NULL || this->m_tri_list->empty() ) return NULL;
+	const std::vector<PrivateTriangle*>& tlist = *(this->m_tri_list);
+
+	// 索引は参照のみ(更新は変更操作とbuild()で行う)
+	int pos = m_id_index.find( id );
+	if( pos >= 0 && pos < (int)tlist.size() && tlist[pos]->get_id() == id ) {
+		return tlist[pos];
+	}
+	if( m_id_indexed == tlist.size() && pos < 0 ) return NULL;
+
+	// 三角形リストが索引の外で変更された場合は線形探索
+	for( size_t i=0; i<tlist.size(); i++ ) {
+		if( tlist[i]->get_id() == id ) return tlist[i];
+	}
+	return NULL;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT TriMesh::remove_triangle(int id)
+{
+	if( this->m_tri_list == NULL ) return PLSTAT_TRIANGLE_NOT_EXIST;
+	std::vector<PrivateTriangle*>& tlist = *(this->m_tri_list);
+
+	sync_id_index();
+	PrivateTriangle* tri = find_triangle( id );
+	if( tri == NULL ) return PLSTAT_TRIANGLE_NOT_EXIST;
+	int pos = m_id_index.find( id );
+	if( pos < 0 || tlist[pos] != tri ) {
+		rebuild_id_index();
+		pos = m_id_index.find( id );
+	}
+
+	// 末尾の三角形を削除位置へ移す
+	int last = (int)tlist.size() - 1;
+	if( pos != last ) {
+		tlist[pos] = tlist[last];
+		m_id_index.update( tlist[pos]->get_id(), pos );
+	}
+	tlist.pop_back();
+	m_id_index.erase( id );
+	m_id_indexed = tlist.size();
+	delete tri;
+
+	// 削除した三角形を参照しているKD木は破棄
+	if( m_vtree != NULL ) {
+		delete m_vtree;
+		m_vtree = NULL;
+	}
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolygonSnapshot* TriMesh::create_snapshot(const double* rigid) const
+{
+	return PolygonSnapshot::create( this->m_tri_list, m_vtree, m_max_elements, rigid );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT TriMesh::save_cache(
+	const std::string	&fname,
+	const std::string	&key
+	) const
+{
+	if( m_DVM_ptr != NULL || m_vtree == NULL || this->m_tri_list == NULL ) return PLSTAT_NG;
+
+	const std::vector<PrivateTriangle*>& tlist = *(this->m_tri_list);
+	int ntri = tlist.size();
+	std::vector<int> index;
+	POLYLIB_STAT ret = mesh_vertex_index( this->m_vertex_list, this->m_tri_list, &index );
+	if( ret != PLSTAT_OK ) return ret;
+
+	const std::vector<Vertex*>* vlist = this->m_vertex_list->get_vertex_lists();
+	int nvert = vlist->size();
+	std::vector<PL_REAL> coords( (size_t)nvert * 3 );
+	for( int i=0; i<nvert; i++ ) {
+		for( int j=0; j<3; j++ ) coords[ (size_t)i*3+j ] = (*(*vlist)[i])[j];
+	}
+
+	// 法線はファイルの値を使う形式があるので、頂点から求め直さずに保存する
+	std::vector<int> ids( ntri ), exids( ntri );
+	std::vector<PL_REAL> normals( (size_t)ntri * 3 ), areas( ntri );
+	for( int i=0; i<ntri; i++ ) {
+		ids[i] = tlist[i]->get_id();
+		exids[i] = tlist[i]->get_exid();
+		Vec3<PL_REAL> n = tlist[i]->get_normal();
+		for( int j=0; j<3; j++ ) normals[ (size_t)i*3+j ] = n[j];
+		areas[i] = tlist[i]->get_area();
+	}
+
+	std::vector<VTreeNodeImage> nodes;
+	std::vector<int> elems;
+	ret = m_vtree->export_image( this->m_tri_list, &nodes, &elems );
+	if( ret != PLSTAT_OK ) return ret;
+
+	MeshCacheView v;
+	v.nvert = nvert;
+	v.ntri = ntri;
+	v.nnode = nodes.size();
+	v.nelem = elems.size();
+	v.max_elements = m_max_elements;
+	v.coords = coords.empty() ? NULL : &coords[0];
+	v.index = index.empty() ? NULL : &index[0];
+	v.ids = ids.empty() ? NULL : &ids[0];
+	v.exids = exids.empty() ? NULL : &exids[0];
+	v.normals = normals.empty() ? NULL : &normals[0];
+	v.areas = areas.empty() ? NULL : &areas[0];
+	v.nodes = nodes.empty() ? NULL : &nodes[0];
+	v.elems = elems.empty() ? NULL : &elems[0];
+	for( int j=0; j<3; j++ ) {
+		v.bbox[j] = m_bbox.min[j];
+		v.bbox[j+3] = m_bbox.max[j];
+	}
+	return mesh_cache_write( fname, full_cache_key( key ), v );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT TriMesh::load_cache(
+	const std::string	&fname,
+	const std::string	&key
+	)
+{
+	if( m_DVM_ptr != NULL ) return PLSTAT_NG;
+
+	MeshCacheFile cache;
+	POLYLIB_STAT ret = cache.open( fname, full_cache_key( key ) );
+	if( ret != PLSTAT_OK ) return ret;
+	const MeshCacheView& v = cache.view();
+
+	PolylibProfileScope prof( PolylibProfiler::PH_LOAD );
+
+	init_tri_list();
+	init_vertex_list();
+	std::vector<Vertex*> vlist( v.nvert );
+	for( int i=0; i<v.nvert; i++ ) {
+		vlist[i] = new Vertex( Vec3<PL_REAL>( v.coords[i*3],
+			v.coords[i*3+1], v.coords[i*3+2] ) );
+		this->m_vertex_list->vtx_add_nocheck( vlist[i] );
+	}
+	this->m_tri_list->resize( v.ntri );
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for( int i=0; i<v.ntri; i++ ) {
+		Vertex* vtx[3];
+		for( int j=0; j<3; j++ ) vtx[j] = vlist[ v.index[i*3+j] ];
+		Vec3<PL_REAL> n( v.normals[i*3], v.normals[i*3+1], v.normals[i*3+2] );
+		PrivateTriangle* tri = new PrivateTriangle( vtx, n, v.areas[i], v.ids[i] );
+		tri->set_exid( v.exids[i] );
+		(*this->m_tri_list)[i] = tri;
+	}
+
+	m_bbox = BBox( v.bbox[0], v.bbox[1], v.bbox[2], v.bbox[3], v.bbox[4], v.bbox[5] );
+	m_vtree = new VTree( v.max_elements, v.nodes, v.nnode, v.elems, v.nelem,
+		this->m_tri_list );
+	rebuild_id_index();
+
+#ifdef DEBUG
+	PL_DBGOSH << "TriMesh::load_cache():" << fname << " nvert=" << v.nvert
+		<< " ntri=" << v.ntri << std::endl;
+#endif
+	return PLSTAT_OK;
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+std::string TriMesh::full_cache_key(
+	const std::string	&key
+	) const
+{
+	std::ostringstream oss;
+	oss << key << "tolerance " << std::setprecision(17) << (double)m_tolerance << "\n"
+		<< "max_elements " << m_max_elements << "\n"
+		<< "real " << sizeof(PL_REAL) << "\n"
+		<< "calc_real " << sizeof(PL_CALC_REAL) << "\n";
+	return oss.str();
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+void TriMesh::sync_id_index()
+{
+	if( this->m_tri_list == NULL ) return;
+	const std::vector<PrivateTriangle*>& tlist = *(this->m_tri_list);
+
+	// 三角形リストが索引の外で縮んだ場合は作り直す
+	if( m_id_indexed > tlist.size() ) {
+		rebuild_id_index();
+		return;
+	}
+	if( m_id_indexed == tlist.size() ) return;
+
+	m_id_index.reserve( tlist.size() );
+	for( size_t i=m_id_indexed; i<tlist.size(); i++ ) {
+		m_id_index.insert( tlist[i]->get_id(), (int)i );
+	}
+	m_id_indexed = tlist.size();
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+void TriMesh::rebuild_id_index()
+{
+	m_id_index.clear();
+	m_id_indexed = 0;
+	sync_id_index();
+}
+
 
 //=======================================================================
 // Setter/Getter
@@ -1420,26 +2049,49 @@ bool TriMesh::hasDVertex() const
 
 void TriMesh::print_memory_size() const
 {
-	unsigned int memsize_vtree=m_vtree->memory_size();
-	unsigned int memsize_vkdt=m_vertKDT->memory_size();
-	unsigned int memsize_pt_list=
-		(sizeof(PrivateTriangle)+sizeof(PrivateTriangle*))
-		*(this->m_tri_list->size());
-	unsigned int memsize_vt_list=(sizeof(Vertex)+sizeof(Vertex*))
-		*(this->m_vertex_list->size());
-	unsigned int memsize_all=
-		memsize_vt_list+memsize_pt_list+memsize_vkdt+memsize_vtree;
+	PolylibMemoryUsage usage;
+	memory_usage( &usage );
 #ifdef WIN32
 	PL_DBGOSH<< "TriMesh::"<<__FUNCTION__<<std::endl;
 #else
 	PL_DBGOSH<< "TriMesh::"<<__func__<<std::endl;
 #endif
-	PL_DBGOSH<< "size of VertexList      "<< memsize_vt_list<<std::endl;
-	PL_DBGOSH<< "size of VertKDT         "<<memsize_vkdt<<std::endl;
-	PL_DBGOSH<< "size of PrivateTriangle "<<memsize_pt_list<<std::endl;
-	PL_DBGOSH<< "size of VTree           "<<memsize_vtree<<std::endl;
+	PL_DBGOSH<< "size of vertices        "<< usage.m_vertices<<std::endl;
+	PL_DBGOSH<< "size of triangles       "<< usage.m_triangles<<std::endl;
+	PL_DBGOSH<< "size of tree nodes      "<< usage.m_tree_nodes<<std::endl;
+	PL_DBGOSH<< "size of tree elements   "<< usage.m_tree_elements<<std::endl;
+	PL_DBGOSH<< "size of DVertex fields  "<< usage.m_fields<<std::endl;
 	PL_DBGOSH<< "---------------------------------------------"<<std::endl;
-	PL_DBGOSH<< "total size                 "<<memsize_all<<std::endl;
+	PL_DBGOSH<< "total size                 "<< usage.total()<<std::endl;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void TriMesh::memory_usage( PolylibMemoryUsage* p_usage ) const
+{
+	p_usage->m_other += sizeof(TriMesh);
+
+	// 三角形(DVertex化されている場合はDVertexTriangle)
+	if( m_tri_list != NULL ) {
+		size_t tri_size = m_DVM_ptr != NULL ? sizeof(DVertexTriangle) : sizeof(PrivateTriangle);
+		p_usage->m_triangles += sizeof(std::vector<PrivateTriangle*>)
+			+ m_tri_list->capacity() * sizeof(PrivateTriangle*)
+			+ m_tri_list->size() * tri_size;
+	}
+	p_usage->m_triangles += m_id_index.memory_size() - sizeof(TriaIdIndex);
+
+	// 頂点
+	if( m_vertex_list != NULL ) {
+		m_vertex_list->memory_usage( p_usage,
+			m_DVM_ptr != NULL ? sizeof(DVertex) : sizeof(Vertex) );
+	}
+
+	// KD木
+	if( m_vtree != NULL )    m_vtree->memory_usage( p_usage );
+	if( m_vertKDT != NULL )  m_vertKDT->memory_usage( p_usage );
+
+	// DVertexのフィールド配列
+	if( m_DVM_ptr != NULL )  m_DVM_ptr->memory_usage( p_usage );
 }
 
 
@@ -0,0 +1,523 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#include "polygons/TriaCodec.h"
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+#include "common/PolylibCommon.h"
+#include "polygons/DVertex.h"
+#include "polygons/DVertexManager.h"
+
+//#define DEBUG
+
+namespace PolylibNS{
+
+// 圧縮形式の識別子とバージョン
+static const unsigned char TRIACODEC_MAGIC[4] = { 'P', 'L', 'Q', 2 };
+
+// 量子化値の上限(doubleで正確に表せる範囲)
+static const double TRIACODEC_QMAX = 4.0e15;
+
+// 符号なし可変長整数(7bit単位)を追加
+static void put_uvarint( std::vector<unsigned char>* p_buf, unsigned long long v )
+{
+	while( v >= 0x80 ) {
+		p_buf->push_back( (unsigned char)((v & 0x7f) | 0x80) );
+		v >>= 7;
+	}
+	p_buf->push_back( (unsigned char)v );
+}
+
+// 符号付き可変長整数(zigzag変換)を追加
+static void put_svarint( std::vector<unsigned char>* p_buf, long long v )
+{
+	put_uvarint( p_buf, ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63) );
+}
+
+// doubleをそのままのバイト列で追加
+static void put_double( std::vector<unsigned char>* p_buf, double v )
+{
+	unsigned char tmp[sizeof(double)];
+	memcpy( tmp, &v, sizeof(double) );
+	p_buf->insert( p_buf->end(), tmp, tmp+sizeof(double) );
+}
+
+// PL_REAL配列をそのままのバイト列で追加
+static void put_reals( std::vector<unsigned char>* p_buf, const PL_REAL* p, size_t n )
+{
+	if( n == 0 ) return;
+	const unsigned char* b = (const unsigned char*)p;
+	p_buf->insert( p_buf->end(), b, b + n*sizeof(PL_REAL) );
+}
+
+// 符号なし可変長整数を取り出す。データ不足時false
+static bool get_uvarint( const unsigned char* p_buf, size_t size, size_t* p_pos,
+	unsigned long long* p_v )
+{
+	unsigned long long v = 0;
+	int shift = 0;
+	while( *p_pos < size && shift < 64 ) {
+		unsigned char c = p_buf[(*p_pos)++];
+		v |= (unsigned long long)(c & 0x7f) << shift;
+		if( (c & 0x80) == 0 ) {
+			*p_v = v;
+			return true;
+		}
+		shift += 7;
+	}
+	return false;
+}
+
+// 符号付き可変長整数を取り出す。データ不足時false
+static bool get_svarint( const unsigned char* p_buf, size_t size, size_t* p_pos,
+	long long* p_v )
+{
+	unsigned long long u;
+	if( !get_uvarint( p_buf, size, p_pos, &u ) ) return false;
+	*p_v = (long long)(u >> 1) ^ -(long long)(u & 1);
+	return true;
+}
+
+// doubleを取り出す。データ不足時false
+static bool get_double( const unsigned char* p_buf, size_t size, size_t* p_pos,
+	double* p_v )
+{
+	if( *p_pos + sizeof(double) > size ) return false;
+	memcpy( p_v, p_buf + *p_pos, sizeof(double) );
+	*p_pos += sizeof(double);
+	return true;
+}
+
+
+// PL_REAL配列を取り出す。データ不足時false
+static bool get_reals( const unsigned char* p_buf, size_t size, size_t* p_pos,
+	PL_REAL* p, size_t n )
+{
+	if( n > (size - *p_pos) / sizeof(PL_REAL) ) return false;
+	if( n == 0 ) return true;
+	memcpy( p, p_buf + *p_pos, n*sizeof(PL_REAL) );
+	*p_pos += n*sizeof(PL_REAL);
+	return true;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+void TriaCodecGroup::expand_trias( std::vector<PL_REAL>* p_vec ) const
+{
+	p_vec->reserve( p_vec->size() + m_index.size()*3 );
+	for( size_t i=0; i<m_index.size(); i++ ) {
+		const PL_REAL* p = &m_vertices[ (size_t)m_index[i]*3 ];
+		p_vec->push_back( p[0] );
+		p_vec->push_back( p[1] );
+		p_vec->push_back( p[2] );
+	}
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+TriaCodec::TriaCodec( PL_REAL error_bound )
+{
+	m_step = 2.0 * (double)error_bound;
+	m_origin[0] = m_origin[1] = m_origin[2] = 0.0;
+	m_overflow = false;
+	m_num_trias = 0;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+void TriaCodec::begin( const BBox& frame )
+{
+	m_origin[0] = frame.min[0];
+	m_origin[1] = frame.min[1];
+	m_origin[2] = frame.min[2];
+	m_overflow = false;
+	m_num_trias = 0;
+	m_groups.clear();
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT TriaCodec::add_group(
+	int group_id,
+	const std::vector<PrivateTriangle*>* p_trias,
+	const double* rigid
+	)
+{
+	if( !(m_step >= 0.0) ) {
+		PL_ERROSH << "[ERROR]TriaCodec::add_group():invalid error bound:"
+			<< m_step*0.5 << std::endl;
+		return PLSTAT_NG;
+	}
+
+	m_groups.push_back( Group() );
+	Group& grp = m_groups.back();
+	grp.m_group_id = group_id;
+	grp.m_nscalar = 0;
+	grp.m_nvector = 0;
+	if( p_trias == NULL || p_trias->size() == 0 ) return PLSTAT_OK;
+
+	// DVertexのデータ構成はグループ内共通
+	DVertex* dv0 = dynamic_cast<DVertex*>( p_trias->at(0)->get_vertex()[0] );
+	if( dv0 != NULL && dv0->DVM() != NULL ) {
+		grp.m_nscalar = dv0->DVM()->nscalar();
+		grp.m_nvector = dv0->DVM()->nvector();
+	}
+	bool lossless = ( m_step == 0.0 );
+	bool has_fields = ( grp.m_nscalar > 0 || grp.m_nvector > 0 );
+
+	size_t ntri = p_trias->size();
+	size_t ncorner = ntri*3;
+	grp.m_index.resize( ncorner );
+	grp.m_ids.reserve( ntri );
+	grp.m_exids.reserve( ntri );
+
+	// 頂点ポインタ→グループ内頂点番号(初出順)の開番地ハッシュ表
+	size_t cap = 16;
+	while( cap < ncorner*2 ) cap <<= 1;
+	std::vector<Vertex*> keys( cap, (Vertex*)NULL );
+	std::vector<int> vals( cap );
+	double inv_step = lossless ? 0.0 : 1.0 / m_step;
+	int next_new = 0;
+
+	for( size_t i=0; i<ntri; i++ ) {
+		PrivateTriangle* p_tri = p_trias->at(i);
+		Vertex** vlist = p_tri->get_vertex();
+		for( int j=0; j<3; j++ ) {
+			Vertex* v = vlist[j];
+			size_t h = ( (size_t)v >> 4 ) * 2654435761u & (cap-1);
+			while( keys[h] != NULL && keys[h] != v ) h = (h+1) & (cap-1);
+			if( keys[h] == NULL ) {
+				keys[h] = v;
+				vals[h] = next_new++;
+				double x[3];
+				for( int k=0; k<3; k++ ) x[k] = (*v)[k];
+				if( rigid != NULL ) {
+					for( int k=0; k<3; k++ ) {
+						x[k] = rigid[k*3]*(*v)[0] + rigid[k*3+1]*(*v)[1]
+							+ rigid[k*3+2]*(*v)[2] + rigid[9+k];
+					}
+				}
+				for( int k=0; k<3; k++ ) {
+					if( lossless ) {
+						grp.m_rvertices.push_back( (PL_REAL)x[k] );
+						continue;
+					}
+					double q = floor( (x[k] - m_origin[k]) * inv_step + 0.5 );
+					if( fabs(q) > TRIACODEC_QMAX ) m_overflow = true;
+					grp.m_qvertices.push_back( (long long)q );
+				}
+				if( has_fields ) {
+					DVertex* dv = dynamic_cast<DVertex*>( v );
+					if( dv == NULL ) {
+						PL_ERROSH << "[ERROR]TriaCodec::add_group():Vertex and DVertex are mixed."
+							<< " group_id:" << group_id << std::endl;
+						return PLSTAT_NG;
+					}
+					for( int k=0; k<grp.m_nscalar; k++ ) {
+						grp.m_fields.push_back( dv->get_scalar(k) );
+					}
+					for( int k=0; k<grp.m_nvector; k++ ) {
+						Vec3<PL_REAL> vec;
+						dv->get_vector( k, &vec );
+						grp.m_fields.push_back( vec[0] );
+						grp.m_fields.push_back( vec[1] );
+						grp.m_fields.push_back( vec[2] );
+					}
+				}
+			}
+			grp.m_index[i*3+j] = vals[h];
+		}
+		grp.m_ids.push_back( p_tri->get_id() );
+		grp.m_exids.push_back( p_tri->get_exid() );
+	}
+	m_num_trias += ntri;
+
+	if( m_overflow ) {
+		PL_ERROSH << "[ERROR]TriaCodec::add_group():vertex out of quantization range."
+			<< " group_id:" << group_id << std::endl;
+		return PLSTAT_NG;
+	}
+	return PLSTAT_OK;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT TriaCodec::encode( std::vector<unsigned char>* p_buf ) const
+{
+	if( p_buf == NULL ) return PLSTAT_ARGUMENT_NULL;
+	if( m_overflow ) return PLSTAT_NG;
+
+	// 頂点座標6byte/頂点、その他5byte/三角形程度と無損失分を見込んで確保
+	size_t estimate = 64 + m_groups.size()*16 + m_num_trias*8;
+	for( size_t g=0; g<m_groups.size(); g++ ) {
+		estimate += ( m_groups[g].m_rvertices.size() + m_groups[g].m_fields.size() )
+			* sizeof(PL_REAL);
+	}
+	p_buf->clear();
+	p_buf->reserve( estimate );
+	p_buf->insert( p_buf->end(), TRIACODEC_MAGIC, TRIACODEC_MAGIC+4 );
+	put_double( p_buf, m_origin[0] );
+	put_double( p_buf, m_origin[1] );
+	put_double( p_buf, m_origin[2] );
+	put_double( p_buf, m_step );
+	p_buf->push_back( (unsigned char)sizeof(PL_REAL) );
+	put_uvarint( p_buf, m_groups.size() );
+
+	for( size_t g=0; g<m_groups.size(); g++ ) {
+		const Group& grp = m_groups[g];
+		size_t nvert = ( grp.m_qvertices.size() + grp.m_rvertices.size() ) / 3;
+		size_t ntri = grp.m_ids.size();
+
+		put_svarint( p_buf, grp.m_group_id );
+		put_uvarint( p_buf, ntri );
+		put_uvarint( p_buf, nvert );
+		put_uvarint( p_buf, grp.m_nscalar );
+		put_uvarint( p_buf, grp.m_nvector );
+
+		if( m_step == 0.0 ) {
+			// 頂点座標: 無損失
+			put_reals( p_buf, grp.m_rvertices.empty() ? NULL : &grp.m_rvertices[0],
+				grp.m_rvertices.size() );
+		} else {
+			// 頂点座標: 直前の頂点との差分
+			long long prev[3] = { 0, 0, 0 };
+			for( size_t i=0; i<nvert; i++ ) {
+				for( int k=0; k<3; k++ ) {
+					long long q = grp.m_qvertices[i*3+k];
+					put_svarint( p_buf, q - prev[k] );
+					prev[k] = q;
+				}
+			}
+		}
+
+		// DVertexのデータ: 共有頂点ごとに無損失
+		put_reals( p_buf, grp.m_fields.empty() ? NULL : &grp.m_fields[0],
+			grp.m_fields.size() );
+
+		// 頂点番号: 次に初出となる番号からの差(初出の頂点は0)
+		int next_new = 0;
+		for( size_t i=0; i<grp.m_index.size(); i++ ) {
+			int idx = grp.m_index[i];
+			put_uvarint( p_buf, (unsigned long long)(next_new - idx) );
+			if( idx == next_new ) next_new++;
+		}
+
+		// 三角形ID,ユーザ定義ID: 直前の三角形との差分
+		long long prev_id = 0;
+		long long prev_exid = 0;
+		for( size_t i=0; i<ntri; i++ ) {
+			put_svarint( p_buf, (long long)grp.m_ids[i] - prev_id );
+			prev_id = grp.m_ids[i];
+		}
+		for( size_t i=0; i<ntri; i++ ) {
+			put_svarint( p_buf, (long long)grp.m_exids[i] - prev_exid );
+			prev_exid = grp.m_exids[i];
+		}
+	}
+
+#ifdef DEBUG
+	PL_DBGOSH << "TriaCodec::encode() trias:" << m_num_trias
+		<< " raw:" << raw_size() << " packed:" << p_buf->size() << std::endl;
+#endif
+	return PLSTAT_OK;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+size_t TriaCodec::raw_size() const
+{
+	size_t size = m_groups.size() * 2 * sizeof(int)
+		+ m_num_trias * ( 2*sizeof(int) + 9*sizeof(PL_REAL) );
+
+	// DVertexのデータは三角形の頂点ごとに送る
+	for( size_t g=0; g<m_groups.size(); g++ ) {
+		const Group& grp = m_groups[g];
+		size += grp.m_ids.size() * 3
+			* ( grp.m_nscalar + grp.m_nvector*3 ) * sizeof(PL_REAL);
+	}
+	return size;
+}
+
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT TriaCodec::decode(
+	const unsigned char* p_buf,
+	size_t size,
+	std::vector<TriaCodecGroup>* p_groups
+	)
+{
+	if( p_groups == NULL ) return PLSTAT_ARGUMENT_NULL;
+	p_groups->clear();
+
+	size_t pos = 0;
+	double origin[3], step;
+	unsigned long long ngroups;
+	unsigned char real_size = 0;
+
+	if( size < 4 || memcmp( p_buf, TRIACODEC_MAGIC, 4 ) != 0 ) {
+		PL_ERROSH << "[ERROR]TriaCodec::decode():unknown format." << std::endl;
+		return PLSTAT_NG;
+	}
+	pos = 4;
+	if( !get_double( p_buf, size, &pos, &origin[0] ) ||
+		!get_double( p_buf, size, &pos, &origin[1] ) ||
+		!get_double( p_buf, size, &pos, &origin[2] ) ||
+		!get_double( p_buf, size, &pos, &step ) ||
+		pos >= size ) {
+		PL_ERROSH << "[ERROR]TriaCodec::decode():truncated header." << std::endl;
+		return PLSTAT_NG;
+	}
+	real_size = p_buf[pos++];
+	if( real_size != sizeof(PL_REAL) ) {
+		PL_ERROSH << "[ERROR]TriaCodec::decode():PL_REAL size mismatch:"
+			<< (int)real_size << std::endl;
+		return PLSTAT_NG;
+	}
+	if( !get_uvarint( p_buf, size, &pos, &ngroups ) ) {
+		PL_ERROSH << "[ERROR]TriaCodec::decode():truncated header." << std::endl;
+		return PLSTAT_NG;
+	}
+	bool lossless = ( step == 0.0 );
+
+	p_groups->resize( ngroups );
+	for( size_t g=0; g<ngroups; g++ ) {
+		TriaCodecGroup& grp = p_groups->at(g);
+		long long gid;
+		unsigned long long ntri, nvert, nscalar, nvector;
+		if( !get_svarint( p_buf, size, &pos, &gid ) ||
+			!get_uvarint( p_buf, size, &pos, &ntri ) ||
+			!get_uvarint( p_buf, size, &pos, &nvert ) ||
+			!get_uvarint( p_buf, size, &pos, &nscalar ) ||
+			!get_uvarint( p_buf, size, &pos, &nvector ) ) {
+			PL_ERROSH << "[ERROR]TriaCodec::decode():truncated group header." << std::endl;
+			return PLSTAT_NG;
+		}
+		// 各要素は最低1バイトなので、残りバイト数を超える個数は不正
+		size_t remain = size - pos;
+		if( ntri > remain || nvert > remain || nscalar > remain || nvector > remain ||
+			nvert*3 + ntri*5 > remain ) {
+			PL_ERROSH << "[ERROR]TriaCodec::decode():invalid group size." << std::endl;
+			return PLSTAT_NG;
+		}
+		grp.m_group_id = (int)gid;
+		grp.m_nscalar = (int)nscalar;
+		grp.m_nvector = (int)nvector;
+		grp.m_vertices.resize( nvert*3 );
+		grp.m_index.resize( ntri*3 );
+		grp.m_ids.resize( ntri );
+		grp.m_exids.resize( ntri );
+
+		if( lossless ) {
+			if( !get_reals( p_buf, size, &pos,
+					nvert ? &grp.m_vertices[0] : NULL, nvert*3 ) ) {
+				PL_ERROSH << "[ERROR]TriaCodec::decode():truncated vertices." << std::endl;
+				return PLSTAT_NG;
+			}
+		} else {
+			long long q[3] = { 0, 0, 0 };
+			for( size_t i=0; i<nvert; i++ ) {
+				for( int k=0; k<3; k++ ) {
+					long long d;
+					if( !get_svarint( p_buf, size, &pos, &d ) ) {
+						PL_ERROSH << "[ERROR]TriaCodec::decode():truncated vertices." << std::endl;
+						return PLSTAT_NG;
+					}
+					q[k] += d;
+					grp.m_vertices[i*3+k] = (PL_REAL)( origin[k] + (double)q[k] * step );
+				}
+			}
+		}
+
+		// DVertexのデータ: 頂点ごとにスカラー、ベクターの順
+		size_t nfield = nscalar + nvector*3;
+		if( nfield > 0 ) {
+			std::vector<PL_REAL> fields;
+			if( nvert > (size - pos) / sizeof(PL_REAL) / nfield ) {
+				PL_ERROSH << "[ERROR]TriaCodec::decode():truncated vertex data." << std::endl;
+				return PLSTAT_NG;
+			}
+			fields.resize( nvert*nfield );
+			get_reals( p_buf, size, &pos, nvert ? &fields[0] : NULL, nvert*nfield );
+			grp.m_scalars.resize( nvert*nscalar );
+			grp.m_vectors.resize( nvert*nvector*3 );
+			for( size_t i=0; i<nvert; i++ ) {
+				const PL_REAL* f = &fields[i*nfield];
+				for( size_t k=0; k<nscalar; k++ ) {
+					grp.m_scalars[i*nscalar+k] = f[k];
+				}
+				for( size_t k=0; k<nvector*3; k++ ) {
+					grp.m_vectors[i*nvector*3+k] = f[nscalar+k];
+				}
+			}
+		}
+
+		long long next_new = 0;
+		for( size_t i=0; i<ntri*3; i++ ) {
+			unsigned long long d;
+			if( !get_uvarint( p_buf, size, &pos, &d ) || (long long)d > next_new ) {
+				PL_ERROSH << "[ERROR]TriaCodec::decode():invalid vertex index." << std::endl;
+				return PLSTAT_NG;
+			}
+			long long idx = next_new - (long long)d;
+			if( idx >= (long long)nvert ) {
+				PL_ERROSH << "[ERROR]TriaCodec::decode():vertex index out of range." << std::endl;
+				return PLSTAT_NG;
+			}
+			grp.m_index[i] = (int)idx;
+			if( d == 0 ) next_new++;
+		}
+
+		long long id = 0;
+		for( size_t i=0; i<ntri; i++ ) {
+			long long d;
+			if( !get_svarint( p_buf, size, &pos, &d ) ) {
+				PL_ERROSH << "[ERROR]TriaCodec::decode():truncated ids." << std::endl;
+				return PLSTAT_NG;
+			}
+			id += d;
+			grp.m_ids[i] = (int)id;
+		}
+		long long exid = 0;
+		for( size_t i=0; i<ntri; i++ ) {
+			long long d;
+			if( !get_svarint( p_buf, size, &pos, &d ) ) {
+				PL_ERROSH << "[ERROR]TriaCodec::decode():truncated exids." << std::endl;
+				return PLSTAT_NG;
+			}
+			exid += d;
+			grp.m_exids[i] = (int)exid;
+		}
+	}
+
+	if( pos != size ) {
+		PL_ERROSH << "[ERROR]TriaCodec::decode():trailing data:" << size-pos << std::endl;
+		return PLSTAT_NG;
+	}
+	return PLSTAT_OK;
+}
+
+} //namespace PolylibNS
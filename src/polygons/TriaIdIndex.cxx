@@ -0,0 +1,171 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#include "polygons/TriaIdIndex.h"
+
+namespace PolylibNS{
+
+/// 表の最小の大きさ
+#define TRIA_ID_INDEX_MIN_SLOTS 16
+
+// public /////////////////////////////////////////////////////////////////////
+
+TriaIdIndex::TriaIdIndex() : m_size(0), m_used(0)
+{
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void TriaIdIndex::clear()
+{
+	for( size_t i=0; i<m_slots.size(); i++ ) m_slots[i].m_pos = EMPTY;
+	m_size = 0;
+	m_used = 0;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void TriaIdIndex::reserve( size_t n )
+{
+	// 使用率を1/2以下に保つ
+	size_t nslot = TRIA_ID_INDEX_MIN_SLOTS;
+	while( nslot < n * 2 ) nslot <<= 1;
+	if( nslot > m_slots.size() ) rehash( nslot );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool TriaIdIndex::insert( int id, int pos )
+{
+	if( (m_used + 1) * 2 > m_slots.size() ) {
+		// 削除済み枠が多い場合は同じ大きさで入れ直す
+		size_t nslot = m_slots.empty() ? TRIA_ID_INDEX_MIN_SLOTS : m_slots.size();
+		if( (m_size + 1) * 4 > nslot ) nslot <<= 1;
+		rehash( nslot );
+	}
+
+	size_t mask = m_slots.size() - 1;
+	size_t i = first_slot( id );
+	size_t tomb = m_slots.size();
+	while( m_slots[i].m_pos != EMPTY ) {
+		if( m_slots[i].m_pos == DELETED ) {
+			if( tomb == m_slots.size() ) tomb = i;
+		}
+		else if( m_slots[i].m_id == id ) {
+			return false;
+		}
+		i = (i + 1) & mask;
+	}
+	if( tomb != m_slots.size() ) {
+		i = tomb;
+	}
+	else {
+		m_used++;
+	}
+	m_slots[i].m_id = id;
+	m_slots[i].m_pos = pos;
+	m_size++;
+	return true;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool TriaIdIndex::update( int id, int pos )
+{
+	if( m_slots.empty() ) return false;
+	size_t mask = m_slots.size() - 1;
+	for( size_t i = first_slot( id ); m_slots[i].m_pos != EMPTY; i = (i + 1) & mask ) {
+		if( m_slots[i].m_pos != DELETED && m_slots[i].m_id == id ) {
+			m_slots[i].m_pos = pos;
+			return true;
+		}
+	}
+	return false;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+int TriaIdIndex::find( int id ) const
+{
+	if( m_slots.empty() ) return -1;
+	size_t mask = m_slots.size() - 1;
+	for( size_t i = first_slot( id ); m_slots[i].m_pos != EMPTY; i = (i + 1) & mask ) {
+		if( m_slots[i].m_pos != DELETED && m_slots[i].m_id == id ) {
+			return m_slots[i].m_pos;
+		}
+	}
+	return -1;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool TriaIdIndex::erase( int id )
+{
+	if( m_slots.empty() ) return false;
+	size_t mask = m_slots.size() - 1;
+	for( size_t i = first_slot( id ); m_slots[i].m_pos != EMPTY; i = (i + 1) & mask ) {
+		if( m_slots[i].m_pos != DELETED && m_slots[i].m_id == id ) {
+			m_slots[i].m_pos = DELETED;
+			m_size--;
+			return true;
+		}
+	}
+	return false;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+size_t TriaIdIndex::memory_size() const
+{
+	return sizeof(TriaIdIndex) + m_slots.capacity() * sizeof(Slot);
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+size_t TriaIdIndex::first_slot( int id ) const
+{
+	// 連番IDが隣接枠に固まらないよう、乗算ハッシュで散らす
+	unsigned int h = (unsigned int)id * 2654435761u;
+	h ^= h >> 16;
+	return (size_t)h & (m_slots.size() - 1);
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+void TriaIdIndex::rehash( size_t nslot )
+{
+	std::vector<Slot> old;
+	old.swap( m_slots );
+	Slot empty;
+	empty.m_id = 0;
+	empty.m_pos = EMPTY;
+	m_slots.assign( nslot, empty );
+	m_size = 0;
+	m_used = 0;
+
+	size_t mask = nslot - 1;
+	for( size_t k=0; k<old.size(); k++ ) {
+		if( old[k].m_pos < 0 ) continue;
+		size_t i = first_slot( old[k].m_id );
+		while( m_slots[i].m_pos != EMPTY ) i = (i + 1) & mask;
+		m_slots[i] = old[k];
+		m_size++;
+		m_used++;
+	}
+}
+
+} //namespace PolylibNS
@@ -217,6 +217,103 @@ int Triangle::get_shell() const {
 	return m_shell;
 }
 
+///
+/// 指定位置に最も近い三角形上の点を求める。
+/// 頂点・辺・面のどの領域に射影されるかをボロノイ領域で判定する。
+///
+/// @param[in]  pos		指定位置
+/// @param[out] bary	最近点の重心座標。NULL可。
+/// @return 三角形上の最近点
+///
+template <typename C>
+Vec3<PL_REAL> Triangle::closest_point_as(
+	const Vec3<PL_REAL>&	pos,
+	PL_REAL					bary[3],
+	C*						dist2
+	) const {
+	const Vertex& a = *m_vertex_ptr[0];
+	const Vertex& b = *m_vertex_ptr[1];
+	const Vertex& c = *m_vertex_ptr[2];
+	C ab[3], ac[3], ap[3], bp[3], cp[3];
+	for( int i=0; i<3; i++ ) {
+		ab[i] = (C)b[i] - a[i];
+		ac[i] = (C)c[i] - a[i];
+		ap[i] = (C)pos[i] - a[i];
+		bp[i] = (C)pos[i] - b[i];
+		cp[i] = (C)pos[i] - c[i];
+	}
+#define PL_DOT(x,y) ((x)[0]*(y)[0]+(x)[1]*(y)[1]+(x)[2]*(y)[2])
+	C d1 = PL_DOT(ab,ap), d2 = PL_DOT(ac,ap);
+	C d3 = PL_DOT(ab,bp), d4 = PL_DOT(ac,bp);
+	C d5 = PL_DOT(ab,cp), d6 = PL_DOT(ac,cp);
+#undef PL_DOT
+	C u, v, w;	// 頂点0,1,2の重み
+
+	if( d1 <= 0.0 && d2 <= 0.0 ) {
+		u = 1.0; v = 0.0; w = 0.0;				// 頂点0
+	} else if( d3 >= 0.0 && d4 <= d3 ) {
+		u = 0.0; v = 1.0; w = 0.0;				// 頂点1
+	} else if( d6 >= 0.0 && d5 <= d6 ) {
+		u = 0.0; v = 0.0; w = 1.0;				// 頂点2
+	} else {
+		C vc = d1*d4 - d3*d2;
+		C vb = d5*d2 - d1*d6;
+		C va = d3*d6 - d5*d4;
+		if( vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0 ) {
+			v = d1 / (d1 - d3);					// 辺01
+			u = 1.0 - v; w = 0.0;
+		} else if( vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0 ) {
+			w = d2 / (d2 - d6);					// 辺02
+			u = 1.0 - w; v = 0.0;
+		} else if( va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0 ) {
+			w = (d4 - d3) / ((d4 - d3) + (d5 - d6));	// 辺12
+			v = 1.0 - w; u = 0.0;
+		} else {
+			C sum = va + vb + vc;				// 面内
+			if( sum == 0.0 ) {
+				// 縮退三角形
+				u = 1.0; v = 0.0; w = 0.0;
+			} else {
+				v = vb / sum;
+				w = vc / sum;
+				u = 1.0 - v - w;
+			}
+		}
+	}
+
+	if( bary != NULL ) {
+		bary[0] = (PL_REAL)u;
+		bary[1] = (PL_REAL)v;
+		bary[2] = (PL_REAL)w;
+	}
+	C foot[3];
+	for( int i=0; i<3; i++ ) foot[i] = u*a[i] + v*b[i] + w*c[i];
+	if( dist2 != NULL ) {
+		*dist2 = 0.0;
+		for( int i=0; i<3; i++ ) {
+			C d = foot[i] - pos[i];
+			*dist2 += d*d;
+		}
+	}
+	return Vec3<PL_REAL>( (PL_REAL)foot[0], (PL_REAL)foot[1], (PL_REAL)foot[2] );
+}
+
+template Vec3<PL_REAL> Triangle::closest_point_as<float>(
+	const Vec3<PL_REAL>&, PL_REAL[3], float* ) const;
+template Vec3<PL_REAL> Triangle::closest_point_as<double>(
+	const Vec3<PL_REAL>&, PL_REAL[3], double* ) const;
+
+///
+/// 指定位置に最も近い三角形上の点を求める(演算型PL_CALC_REAL)。
+///
+Vec3<PL_REAL> Triangle::closest_point(
+	const Vec3<PL_REAL>&	pos,
+	PL_REAL					bary[3],
+	PL_CALC_REAL*			dist2
+	) const {
+	return closest_point_as<PL_CALC_REAL>( pos, bary, dist2 );
+}
+
 
 ///
 /// 法線ベクトル算出。
@@ -224,15 +321,16 @@ int Triangle::get_shell() const {
 void Triangle::calc_normal() {
 
 	// double演算に変更 2013.10.10 tkawanab
+	// (演算型PL_CALC_REALで評価。既定はdouble)
 
-	Vec3<double> vd[3];
+	Vec3<PL_CALC_REAL> vd[3];
 	vd[0].assign( m_vertex_ptr[0]->x, m_vertex_ptr[0]->y, m_vertex_ptr[0]->z );
 	vd[1].assign( m_vertex_ptr[1]->x, m_vertex_ptr[1]->y, m_vertex_ptr[1]->z );
 	vd[2].assign( m_vertex_ptr[2]->x, m_vertex_ptr[2]->y, m_vertex_ptr[2]->z );
 
-	Vec3<double> ad = vd[1] - vd[0];
-	Vec3<double> bd = vd[2] - vd[0];
-	Vec3<double> normald = (cross(ad,bd)).normalize();
+	Vec3<PL_CALC_REAL> ad = vd[1] - vd[0];
+	Vec3<PL_CALC_REAL> bd = vd[2] - vd[0];
+	Vec3<PL_CALC_REAL> normald = (cross(ad,bd)).normalize();
 	m_normal[0] = normald[0];
 	m_normal[1] = normald[1];
 	m_normal[2] = normald[2];
@@ -242,16 +340,16 @@ void Triangle::calc_normal() {
 /// 面積算出。 double に変更 2015-02-21 keno
 ///
 void Triangle::calc_area() {
-  Vec3<double> vd[3];
+  Vec3<PL_CALC_REAL> vd[3];
   vd[0].assign( m_vertex_ptr[0]->x, m_vertex_ptr[0]->y, m_vertex_ptr[0]->z );
   vd[1].assign( m_vertex_ptr[1]->x, m_vertex_ptr[1]->y, m_vertex_ptr[1]->z );
   vd[2].assign( m_vertex_ptr[2]->x, m_vertex_ptr[2]->y, m_vertex_ptr[2]->z );
 
-  Vec3<double> a = vd[1] - vd[0];
-  Vec3<double> b = vd[2] - vd[0];
+  Vec3<PL_CALC_REAL> a = vd[1] - vd[0];
+  Vec3<PL_CALC_REAL> b = vd[2] - vd[0];
 
-	double ab = dot(a,b);
-	double f = a.lengthSquared()*b.lengthSquared() - ab*ab;
+	PL_CALC_REAL ab = dot(a,b);
+	PL_CALC_REAL f = a.lengthSquared()*b.lengthSquared() - ab*ab;
 	if (f<0.0) f=0.0;
 
 	m_area = (PL_REAL)0.5*sqrt(f);
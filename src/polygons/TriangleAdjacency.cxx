@@ -0,0 +1,349 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#include <algorithm>
+#include <utility>
+
+#include "polygons/TriangleAdjacency.h"
+#include "polygons/PrivateTriangle.h"
+#include "polygons/VertexList.h"
+#include "polygons/Vertex.h"
+#include "file_io/mesh_write.h"
+
+namespace PolylibNS {
+
+//  union-findの根を求める(経路半減)。
+//  parent[x] <= x を保つので、根は連結成分の最小の番号になる。
+static int uf_find( volatile int* parent, int x )
+{
+	while( true ) {
+		int p = parent[x];
+		if( p == x ) return x;
+		int gp = parent[p];
+		if( p != gp ) __sync_bool_compare_and_swap( &parent[x], p, gp );
+		x = gp;
+	}
+}
+
+//  aとbの連結成分を併合する。大きい方の根を小さい方の根へつなぐ。
+//  つなぐ前に根が変わっていればやり直すので、複数スレッドから呼んでよい。
+static void uf_union( volatile int* parent, int a, int b )
+{
+	while( true ) {
+		a = uf_find( parent, a );
+		b = uf_find( parent, b );
+		if( a == b ) return;
+		if( a < b ) std::swap( a, b );
+		if( __sync_bool_compare_and_swap( &parent[a], a, b ) ) return;
+	}
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+TriangleAdjacency::TriangleAdjacency()
+{
+	m_nvert = 0;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT TriangleAdjacency::build(
+	VertexList*								vertex_list,
+	const std::vector<PrivateTriangle*>		*tri_list
+	)
+{
+	clear();
+	if( vertex_list == NULL || tri_list == NULL ) return PLSTAT_ARGUMENT_NULL;
+
+	POLYLIB_STAT ret = mesh_vertex_index( vertex_list, tri_list, &m_tri_vidx );
+	if( ret != PLSTAT_OK ) {
+		clear();
+		return ret;
+	}
+	m_nvert = vertex_list->get_vertex_lists()->size();
+	m_triangles = *tri_list;
+	int ntri = tri_list->size();
+	int nvert = m_nvert;
+	const int* vidx = m_tri_vidx.empty() ? NULL : &m_tri_vidx[0];
+
+	// 辺を小さい方の頂点番号で分類する(計数ソート)
+	std::vector<int> voff( nvert + 1, 0 );
+	volatile int* vcount = &voff[0];
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for( int t=0; t<ntri; t++ ) {
+		for( int k=0; k<3; k++ ) {
+			int a = vidx[ t*3+k ];
+			int b = vidx[ t*3+(k+1)%3 ];
+			if( a == b ) continue;
+			__sync_fetch_and_add( &vcount[ std::min( a, b ) + 1 ], 1 );
+		}
+	}
+	for( int v=0; v<nvert; v++ ) voff[v+1] += voff[v];
+	int nuse = voff[nvert];
+
+	// 分類先には(大きい方の頂点番号, 三角形番号*3+辺番号)を詰める
+	std::vector< std::pair<int,int> > bucket( nuse );
+	std::vector<int> vpos( voff.begin(), voff.end() - 1 );
+	volatile int* pos = vpos.empty() ? NULL : &vpos[0];
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for( int t=0; t<ntri; t++ ) {
+		for( int k=0; k<3; k++ ) {
+			int a = vidx[ t*3+k ];
+			int b = vidx[ t*3+(k+1)%3 ];
+			if( a == b ) continue;
+			int slot = __sync_fetch_and_add( &pos[ std::min( a, b ) ], 1 );
+			bucket[slot] = std::make_pair( std::max( a, b ), t*3+k );
+		}
+	}
+
+	// 頂点毎に並べ替え、稜線(大きい方の頂点番号が異なる組)を数える。
+	// 分類時の順序はスレッドにより変わるが、並べ替え後は一意に決まる
+	std::vector<int> eoff( nvert + 1, 0 );
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1024)
+#endif
+	for( int v=0; v<nvert; v++ ) {
+		std::sort( bucket.begin() + voff[v], bucket.begin() + voff[v+1] );
+		int n = 0;
+		for( int i=voff[v]; i<voff[v+1]; i++ ) {
+			if( i == voff[v] || bucket[i].first != bucket[i-1].first ) n++;
+		}
+		eoff[v+1] = n;
+	}
+	for( int v=0; v<nvert; v++ ) eoff[v+1] += eoff[v];
+	int nedge = eoff[nvert];
+
+	m_edge_vtx.resize( (size_t)nedge * 2 );
+	m_edge_offsets.resize( nedge + 1 );
+	m_edge_uses.resize( nuse );
+	m_tri_edge.assign( (size_t)ntri * 3, -1 );
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1024)
+#endif
+	for( int v=0; v<nvert; v++ ) {
+		int e = eoff[v] - 1;
+		for( int i=voff[v]; i<voff[v+1]; i++ ) {
+			if( i == voff[v] || bucket[i].first != bucket[i-1].first ) {
+				e++;
+				m_edge_vtx[ (size_t)e*2 ] = v;
+				m_edge_vtx[ (size_t)e*2+1 ] = bucket[i].first;
+				m_edge_offsets[e] = i;
+			}
+			m_edge_uses[i] = bucket[i].second;
+			m_tri_edge[ bucket[i].second ] = e;
+		}
+	}
+	m_edge_offsets[nedge] = nuse;
+
+#ifdef DEBUG
+	PL_DBGOSH << "TriangleAdjacency::build():triangles:" << ntri
+		<< " vertices:" << nvert << " edges:" << nedge << std::endl;
+#endif
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+int TriangleAdjacency::label_shells(
+	bool	set_triangles
+	)
+{
+	int ntri = num_triangles();
+	int nedge = num_edges();
+
+	std::vector<int> parent( ntri );
+	volatile int* p = parent.empty() ? NULL : &parent[0];
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for( int t=0; t<ntri; t++ ) p[t] = t;
+
+	// 稜線を共有する三角形を併合する
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,4096)
+#endif
+	for( int e=0; e<nedge; e++ ) {
+		int t0 = m_edge_uses[ m_edge_offsets[e] ] / 3;
+		for( int i=m_edge_offsets[e]+1; i<m_edge_offsets[e+1]; i++ ) {
+			uf_union( p, t0, m_edge_uses[i] / 3 );
+		}
+	}
+
+	// 根(連結成分の最小の三角形番号)の昇順にシェル番号を付ける
+	m_tri_shell.resize( ntri );
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for( int t=0; t<ntri; t++ ) m_tri_shell[t] = uf_find( p, t );
+
+	int nshell = 0;
+	for( int t=0; t<ntri; t++ ) {
+		if( m_tri_shell[t] == t ) parent[t] = nshell++;
+	}
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for( int t=0; t<ntri; t++ ) m_tri_shell[t] = parent[ m_tri_shell[t] ];
+
+	// シェル毎の三角形数・外接矩形
+	m_shell_ntri.assign( nshell, 0 );
+	m_shell_bbox.assign( nshell, BBox() );
+	for( int s=0; s<nshell; s++ ) m_shell_bbox[s].init();
+	for( int t=0; t<ntri; t++ ) {
+		int s = m_tri_shell[t];
+		m_shell_ntri[s]++;
+		Vertex** vtx = m_triangles[t]->get_vertex();
+		for( int k=0; k<3; k++ ) m_shell_bbox[s].add( *vtx[k] );
+	}
+
+	// 境界・非多様体・向きの揃っていない稜線を含むシェルは閉じていない
+	m_shell_closed.assign( nshell, 1 );
+	for( int e=0; e<nedge; e++ ) {
+		if( edge_valence( e ) == 2 && is_oriented_edge( e ) ) continue;
+		m_shell_closed[ m_tri_shell[ edge_use( e, 0 ) / 3 ] ] = 0;
+	}
+
+	if( set_triangles ) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for( int t=0; t<ntri; t++ ) m_triangles[t]->set_shell( m_tri_shell[t] );
+	}
+
+#ifdef DEBUG
+	PL_DBGOSH << "TriangleAdjacency::label_shells():shells:" << nshell << std::endl;
+#endif
+	return nshell;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void TriangleAdjacency::clear()
+{
+	m_nvert = 0;
+	std::vector<int>().swap( m_tri_vidx );
+	std::vector<int>().swap( m_tri_edge );
+	std::vector<int>().swap( m_edge_vtx );
+	std::vector<int>().swap( m_edge_offsets );
+	std::vector<int>().swap( m_edge_uses );
+	std::vector<PrivateTriangle*>().swap( m_triangles );
+	std::vector<int>().swap( m_tri_shell );
+	std::vector<int>().swap( m_shell_ntri );
+	std::vector<BBox>().swap( m_shell_bbox );
+	std::vector<char>().swap( m_shell_closed );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+int TriangleAdjacency::neighbor( int t, int k ) const
+{
+	int e = triangle_edge( t, k );
+	if( e < 0 || edge_valence( e ) != 2 ) return -1;
+	int u0 = edge_use( e, 0 );
+	// 同じ三角形が稜線を2回使う場合もあるので、辺で比較する
+	if( u0 == t*3+k ) return edge_use( e, 1 ) / 3;
+	return u0 / 3;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void TriangleAdjacency::boundary_edges(
+	std::vector<int>	*edges
+	) const
+{
+	edges->clear();
+	int nedge = num_edges();
+	for( int e=0; e<nedge; e++ ) {
+		if( edge_valence( e ) == 1 ) edges->push_back( e );
+	}
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void TriangleAdjacency::nonmanifold_edges(
+	std::vector<int>	*edges
+	) const
+{
+	edges->clear();
+	int nedge = num_edges();
+	for( int e=0; e<nedge; e++ ) {
+		if( edge_valence( e ) > 2 ) edges->push_back( e );
+	}
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void TriangleAdjacency::misoriented_edges(
+	std::vector<int>	*edges
+	) const
+{
+	edges->clear();
+	int nedge = num_edges();
+	for( int e=0; e<nedge; e++ ) {
+		if( edge_valence( e ) == 2 && !is_oriented_edge( e ) ) edges->push_back( e );
+	}
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool TriangleAdjacency::is_closed() const
+{
+	int nedge = num_edges();
+	int nbad = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:nbad)
+#endif
+	for( int e=0; e<nedge; e++ ) {
+		if( edge_valence( e ) != 2 || !is_oriented_edge( e ) ) nbad++;
+	}
+	return nbad == 0;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+size_t TriangleAdjacency::memory_size() const
+{
+	return sizeof(TriangleAdjacency)
+		+ m_tri_vidx.capacity() * sizeof(int)
+		+ m_tri_edge.capacity() * sizeof(int)
+		+ m_edge_vtx.capacity() * sizeof(int)
+		+ m_edge_offsets.capacity() * sizeof(int)
+		+ m_edge_uses.capacity() * sizeof(int)
+		+ m_triangles.capacity() * sizeof(PrivateTriangle*)
+		+ m_tri_shell.capacity() * sizeof(int)
+		+ m_shell_ntri.capacity() * sizeof(int)
+		+ m_shell_bbox.capacity() * sizeof(BBox)
+		+ m_shell_closed.capacity() * sizeof(char);
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+bool TriangleAdjacency::is_oriented_edge( int e ) const
+{
+	// 辺kは頂点k→頂点(k+1)%3。小さい番号の頂点から出る辺を順方向とする
+	int u0 = edge_use( e, 0 );
+	int u1 = edge_use( e, 1 );
+	bool f0 = m_tri_vidx[u0] == m_edge_vtx[ (size_t)e*2 ];
+	bool f1 = m_tri_vidx[u1] == m_edge_vtx[ (size_t)e*2 ];
+	return f0 != f1;
+}
+
+} //namespace PolylibNS
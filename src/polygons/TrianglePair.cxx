@@ -0,0 +1,255 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#include <algorithm>
+
+#include "polygons/TrianglePair.h"
+#include "polygons/Triangle.h"
+#include "polygons/Vertex.h"
+
+namespace PolylibNS {
+
+#define PL_DOT(x,y) ((x)[0]*(y)[0]+(x)[1]*(y)[1]+(x)[2]*(y)[2])
+
+static inline void cross3(
+	const PL_CALC_REAL	u[3],
+	const PL_CALC_REAL	v[3],
+	PL_CALC_REAL		w[3]
+	)
+{
+	w[0] = u[1]*v[2] - u[2]*v[1];
+	w[1] = u[2]*v[0] - u[0]*v[2];
+	w[2] = u[0]*v[1] - u[1]*v[0];
+}
+
+//  軸dへの投影区間が重ならなければ1。dが0ベクトルの場合は0(重なる)
+static inline int separated_on(
+	const PL_CALC_REAL	d[3],
+	const PL_CALC_REAL	*a,
+	const PL_CALC_REAL	*b
+	)
+{
+	PL_CALC_REAL a0 = PL_DOT(d,a), a1 = PL_DOT(d,a+3), a2 = PL_DOT(d,a+6);
+	PL_CALC_REAL b0 = PL_DOT(d,b), b1 = PL_DOT(d,b+3), b2 = PL_DOT(d,b+6);
+	PL_CALC_REAL amin = std::min( a0, std::min( a1, a2 ) );
+	PL_CALC_REAL amax = std::max( a0, std::max( a1, a2 ) );
+	PL_CALC_REAL bmin = std::min( b0, std::min( b1, b2 ) );
+	PL_CALC_REAL bmax = std::max( b0, std::max( b1, b2 ) );
+	return ( amax < bmin ) | ( bmax < amin );
+}
+
+//  分離軸のいずれかで投影区間が重ならなければ1。
+//  早期終了の分岐を持たない(一括判定のSIMD化のため)
+static inline int separated(
+	const PL_CALC_REAL	*a,
+	const PL_CALC_REAL	*b
+	)
+{
+	PL_CALC_REAL ea[3][3], eb[3][3], na[3], nb[3], d[3];
+	for( int k=0; k<3; k++ ) {
+		int k1 = ( k + 1 ) % 3;
+		for( int i=0; i<3; i++ ) {
+			ea[k][i] = a[k1*3+i] - a[k*3+i];
+			eb[k][i] = b[k1*3+i] - b[k*3+i];
+		}
+	}
+	cross3( ea[0], ea[1], na );
+	cross3( eb[0], eb[1], nb );
+
+	int sep = separated_on( na, a, b ) | separated_on( nb, a, b );
+	for( int i=0; i<3; i++ ) {
+		for( int j=0; j<3; j++ ) {
+			cross3( ea[i], eb[j], d );
+			sep |= separated_on( d, a, b );
+		}
+	}
+	// 同一平面上の三角形用の、面内で辺に直交する軸
+	for( int i=0; i<3; i++ ) {
+		cross3( na, ea[i], d );
+		sep |= separated_on( d, a, b );
+		cross3( nb, eb[i], d );
+		sep |= separated_on( d, a, b );
+	}
+	return sep;
+}
+
+//  点pと三角形tの距離の2乗。Triangle::closest_point()と同じ領域判定
+static PL_CALC_REAL point_tri_dist2(
+	const PL_CALC_REAL	*p,
+	const PL_CALC_REAL	*t
+	)
+{
+	const PL_CALC_REAL* a = t;
+	const PL_CALC_REAL* b = t + 3;
+	const PL_CALC_REAL* c = t + 6;
+	PL_CALC_REAL ab[3], ac[3], ap[3], bp[3], cp[3];
+	for( int i=0; i<3; i++ ) {
+		ab[i] = b[i] - a[i];
+		ac[i] = c[i] - a[i];
+		ap[i] = p[i] - a[i];
+		bp[i] = p[i] - b[i];
+		cp[i] = p[i] - c[i];
+	}
+	PL_CALC_REAL d1 = PL_DOT(ab,ap), d2 = PL_DOT(ac,ap);
+	PL_CALC_REAL d3 = PL_DOT(ab,bp), d4 = PL_DOT(ac,bp);
+	PL_CALC_REAL d5 = PL_DOT(ab,cp), d6 = PL_DOT(ac,cp);
+	PL_CALC_REAL v, w;	// 頂点1,2の重み
+
+	if( d1 <= 0.0 && d2 <= 0.0 ) {
+		v = 0.0; w = 0.0;
+	} else if( d3 >= 0.0 && d4 <= d3 ) {
+		v = 1.0; w = 0.0;
+	} else if( d6 >= 0.0 && d5 <= d6 ) {
+		v = 0.0; w = 1.0;
+	} else {
+		PL_CALC_REAL vc = d1*d4 - d3*d2;
+		PL_CALC_REAL vb = d5*d2 - d1*d6;
+		PL_CALC_REAL va = d3*d6 - d5*d4;
+		if( vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0 ) {
+			v = d1 / (d1 - d3); w = 0.0;
+		} else if( vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0 ) {
+			v = 0.0; w = d2 / (d2 - d6);
+		} else if( va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0 ) {
+			w = (d4 - d3) / ((d4 - d3) + (d5 - d6)); v = 1.0 - w;
+		} else {
+			PL_CALC_REAL sum = va + vb + vc;
+			// 縮退三角形は頂点0とする(辺上の最近点は辺と辺の距離で求まる)
+			if( sum == 0.0 ) { v = 0.0; w = 0.0; }
+			else { v = vb / sum; w = vc / sum; }
+		}
+	}
+	PL_CALC_REAL d[3];
+	for( int i=0; i<3; i++ ) d[i] = a[i] + ab[i]*v + ac[i]*w - p[i];
+	return PL_DOT(d,d);
+}
+
+//  線分p1-q1と線分p2-q2の距離の2乗
+static PL_CALC_REAL seg_seg_dist2(
+	const PL_CALC_REAL	*p1,
+	const PL_CALC_REAL	*q1,
+	const PL_CALC_REAL	*p2,
+	const PL_CALC_REAL	*q2
+	)
+{
+	PL_CALC_REAL d1[3], d2[3], r[3];
+	for( int i=0; i<3; i++ ) {
+		d1[i] = q1[i] - p1[i];
+		d2[i] = q2[i] - p2[i];
+		r[i] = p1[i] - p2[i];
+	}
+	PL_CALC_REAL a = PL_DOT(d1,d1);
+	PL_CALC_REAL e = PL_DOT(d2,d2);
+	PL_CALC_REAL f = PL_DOT(d2,r);
+	PL_CALC_REAL s, t;
+	if( a <= 0.0 && e <= 0.0 ) {
+		s = 0.0; t = 0.0;
+	} else if( a <= 0.0 ) {
+		s = 0.0;
+		t = std::min( std::max( f / e, (PL_CALC_REAL)0.0 ), (PL_CALC_REAL)1.0 );
+	} else {
+		PL_CALC_REAL c = PL_DOT(d1,r);
+		if( e <= 0.0 ) {
+			t = 0.0;
+			s = std::min( std::max( -c / a, (PL_CALC_REAL)0.0 ), (PL_CALC_REAL)1.0 );
+		} else {
+			PL_CALC_REAL b = PL_DOT(d1,d2);
+			PL_CALC_REAL denom = a*e - b*b;
+			// 平行な場合は端点から求める
+			s = ( denom > 0.0 ) ?
+				std::min( std::max( (b*f - c*e) / denom, (PL_CALC_REAL)0.0 ), (PL_CALC_REAL)1.0 ) : 0.0;
+			t = ( b*s + f ) / e;
+			if( t < 0.0 ) {
+				t = 0.0;
+				s = std::min( std::max( -c / a, (PL_CALC_REAL)0.0 ), (PL_CALC_REAL)1.0 );
+			} else if( t > 1.0 ) {
+				t = 1.0;
+				s = std::min( std::max( (b - c) / a, (PL_CALC_REAL)0.0 ), (PL_CALC_REAL)1.0 );
+			}
+		}
+	}
+	PL_CALC_REAL d[3];
+	for( int i=0; i<3; i++ ) d[i] = ( p1[i] + d1[i]*s ) - ( p2[i] + d2[i]*t );
+	return PL_DOT(d,d);
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void tri_pair_coords(
+	const Triangle*		tri,
+	PL_CALC_REAL		c[9]
+	)
+{
+	Vertex** vtx = tri->get_vertex();
+	for( int k=0; k<3; k++ ) {
+		for( int i=0; i<3; i++ ) c[k*3+i] = (*vtx[k])[i];
+	}
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool tri_tri_intersect(
+	const PL_CALC_REAL	a[9],
+	const PL_CALC_REAL	b[9]
+	)
+{
+	return separated( a, b ) == 0;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void tri_tri_intersect_batch(
+	const PL_CALC_REAL	a[9],
+	const PL_CALC_REAL	*b,
+	int					n,
+	char				*hit
+	)
+{
+#if defined(_OPENMP) && _OPENMP >= 201307
+#pragma omp simd
+#endif
+	for( int j=0; j<n; j++ ) {
+		hit[j] = (char)( separated( a, b + (size_t)j*9 ) == 0 );
+	}
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PL_CALC_REAL tri_tri_dist2(
+	const PL_CALC_REAL	a[9],
+	const PL_CALC_REAL	b[9]
+	)
+{
+	if( separated( a, b ) == 0 ) return 0.0;
+
+	PL_CALC_REAL d2 = point_tri_dist2( a, b );
+	for( int k=0; k<3; k++ ) {
+		if( k > 0 ) d2 = std::min( d2, point_tri_dist2( a+k*3, b ) );
+		d2 = std::min( d2, point_tri_dist2( b+k*3, a ) );
+	}
+	for( int i=0; i<3; i++ ) {
+		int i1 = ( i + 1 ) % 3;
+		for( int j=0; j<3; j++ ) {
+			int j1 = ( j + 1 ) % 3;
+			d2 = std::min( d2, seg_seg_dist2( a+i*3, a+i1*3, b+j*3, b+j1*3 ) );
+		}
+	}
+	return d2;
+}
+
+#undef PL_DOT
+
+} //namespace PolylibNS
@@ -57,6 +57,13 @@ VElement::VElement(
 			m_bbox.add( (Vec3<PL_REAL>) (*(tmp[i])) );
 		}
 		m_pos = m_bbox.center();
+		Vec3<PL_REAL> v0,v1,v2;
+		v0=*(tmp[0]);
+		v1=*(tmp[1]);
+		v2=*(tmp[2]);
+		m_centroid.assign( (v0[0]+v1[0]+v2[0])/3.0,
+			(v0[1]+v1[1]+v2[1])/3.0,
+			(v0[2]+v1[2]+v2[2])/3.0 );
 }
 
 //=======================================================================
@@ -77,6 +84,13 @@ Vec3<PL_REAL> VElement::get_pos() const {
 	return m_pos;
 }
 
+///
+/// Centroid of triangle (木構築時の座標系)。
+///
+Vec3<PL_REAL> VElement::get_centroid() const {
+	return m_centroid;
+}
+
 
 
 } //namespace PolylibNS
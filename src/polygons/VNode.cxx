@@ -72,6 +72,26 @@ void VNode::set_bbox_search(const VElement *p) {
 	m_bbox_search.add(p->get_bbox().max);
 }
 
+///
+/// 検索用BBoxを設定。
+///
+/// @param[in] bbox 検索用bbox。
+///
+void VNode::set_bbox_search(const BBox& bbox) {
+	m_bbox_search = bbox;
+}
+
+///
+/// 子供ノードを設定。
+///
+/// @param[in] left  左のNode。
+/// @param[in] right 右のNode。
+///
+void VNode::set_children(VNode* left, VNode* right) {
+	m_left = left;
+	m_right = right;
+}
+
 ///
 /// 左のNodeを取得。
 ///
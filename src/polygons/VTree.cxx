@@ -19,7 +19,17 @@
 #include "polygons/PrivateTriangle.h"
 #include "polygons/VNode.h"
 #include "polygons/VElement.h"
+#include "polygons/TrianglePair.h"
+#include "util/PolylibProfiler.h"
 #include <string>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 //#define DEBUG_VTREE
 namespace PolylibNS {
@@ -50,6 +60,40 @@ VTree::VTree(
 
 // public /////////////////////////////////////////////////////////////////////
 
+VTree::VTree(
+	int							max_elem,
+	const VTreeNodeImage		*nodes,
+	int							nnode,
+	const int					*elems,
+	int							/*nelem*/,
+	std::vector<PrivateTriangle*>	*tri_list
+	) {
+		m_root = NULL;
+		m_max_elements = max_elem;
+		if (nnode <= 0) return;
+
+		std::vector<VNode*> vn(nnode);
+		for (int i = 0; i < nnode; i++) vn[i] = new VNode();
+		for (int i = 0; i < nnode; i++) {
+			const VTreeNodeImage& img = nodes[i];
+			vn[i]->set_bbox( BBox(img.bbox[0], img.bbox[1], img.bbox[2],
+				img.bbox[3], img.bbox[4], img.bbox[5]) );
+			vn[i]->set_bbox_search( BBox(img.bbox_search[0], img.bbox_search[1],
+				img.bbox_search[2], img.bbox_search[3], img.bbox_search[4],
+				img.bbox_search[5]) );
+			vn[i]->set_axis( (AxisEnum)img.axis );
+			if (img.left >= 0) vn[i]->set_children( vn[img.left], vn[img.right] );
+			std::vector<VElement*>& vlist = vn[i]->get_vlist();
+			vlist.resize( img.elem_count );
+			for (int j = 0; j < img.elem_count; j++) {
+				vlist[j] = new VElement( (*tri_list)[ elems[img.elem_begin + j] ] );
+			}
+		}
+		m_root = vn[0];
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
 VTree::~VTree()
 {
 	destroy();
@@ -182,35 +226,105 @@ POLYLIB_STAT VTree::search(
 
 // public /////////////////////////////////////////////////////////////////////
 
-unsigned int VTree::memory_size() {
-	VNode			*vnode;
-	unsigned int	node_cnt = 1;		// ノード数
-	unsigned int	poly_cnt = 0;		// ポリゴン数
-	unsigned int	size;
+unsigned long long VTree::memory_size() {
+	PolylibMemoryUsage usage;
+	memory_usage( &usage );
+	return usage.total();
+}
 
-	if ((vnode = m_root->get_left()) != NULL) {;
-	node_count(vnode, &node_cnt, &poly_cnt);
-	}
-#ifdef DEBUG_VTREE
-	PL_DBGOSH << "VTree::memory_size1():node,poly=" << node_cnt << ","
-		<< poly_cnt << std::endl;
-#endif
+// ノードとノード内要素の利用メモリ量を加算
+static void node_memory_usage( VNode* vn, PolylibMemoryUsage* p_usage )
+{
+	if( vn == NULL ) return;
+	p_usage->m_tree_nodes += sizeof(VNode) + vn->get_vlist().capacity() * sizeof(VElement*);
+	p_usage->m_tree_elements += vn->get_vlist().size() * sizeof(VElement);
+	node_memory_usage( vn->get_left(), p_usage );
+	node_memory_usage( vn->get_right(), p_usage );
+}
 
-	if ((vnode = m_root->get_right()) != NULL) {;
-	node_count(vnode, &node_cnt, &poly_cnt);
-	}
-#ifdef DEBUG_VTREE
-	PL_DBGOSH << "VTree::memory_size2():node,poly=" << node_cnt << ","
-		<< poly_cnt << std::endl;
-#endif
+// public /////////////////////////////////////////////////////////////////////
+
+void VTree::memory_usage( PolylibMemoryUsage* p_usage ) const {
+	p_usage->m_tree_nodes += sizeof(VTree);
+	node_memory_usage( m_root, p_usage );
+}
 
-	size  = sizeof(VTree);
-	size += sizeof(VNode)	 * node_cnt;
-	size += sizeof(VElement) * poly_cnt;
+// ノードを行きがけ順に書き出し、そのノードの番号を返す
+static int export_node(
+	VNode*													vn,
+	const std::vector< std::pair<const PrivateTriangle*,int> >&	order,
+	std::vector<VTreeNodeImage>*							nodes,
+	std::vector<int>*										elems,
+	bool*													ok
+	)
+{
+	int idx = nodes->size();
+	nodes->push_back( VTreeNodeImage() );
+	VTreeNodeImage img;
+	BBox bbox = vn->get_bbox();
+	BBox bbox_search = vn->get_bbox_search();
+	for (int i = 0; i < 3; i++) {
+		img.bbox[i] = bbox.min[i];
+		img.bbox[i+3] = bbox.max[i];
+		img.bbox_search[i] = bbox_search.min[i];
+		img.bbox_search[i+3] = bbox_search.max[i];
+	}
+	img.axis = vn->get_axis();
+	img.left = -1;
+	img.right = -1;
+	img.pad = 0;
+
+	// 要素の三角形をtri_list上の番号に置き換える
+	img.elem_begin = elems->size();
+	img.elem_count = vn->get_vlist().size();
+	std::vector<VElement*>::const_iterator itr;
+	for (itr = vn->get_vlist().begin(); itr != vn->get_vlist().end(); itr++) {
+		std::pair<const PrivateTriangle*,int> key( (*itr)->get_triangle(), -1 );
+		std::vector< std::pair<const PrivateTriangle*,int> >::const_iterator it =
+			std::lower_bound( order.begin(), order.end(), key );
+		if (it == order.end() || it->first != key.first) {
+			*ok = false;
+			elems->push_back( 0 );
+		}
+		else {
+			elems->push_back( it->second );
+		}
+	}
 
-	return size;
+	if (!vn->is_leaf()) {
+		img.left = export_node( vn->get_left(), order, nodes, elems, ok );
+		img.right = export_node( vn->get_right(), order, nodes, elems, ok );
+	}
+	(*nodes)[idx] = img;
+	return idx;
+}
 
+// public /////////////////////////////////////////////////////////////////////
 
+POLYLIB_STAT VTree::export_image(
+	const std::vector<PrivateTriangle*>	*tri_list,
+	std::vector<VTreeNodeImage>			*nodes,
+	std::vector<int>					*elems
+	) const {
+		nodes->clear();
+		elems->clear();
+		if (m_root == NULL) return PLSTAT_ROOT_NODE_NOT_EXIST;
+
+		// 三角形のポインタから番号を引く表
+		std::vector< std::pair<const PrivateTriangle*,int> > order( tri_list->size() );
+		for (size_t i = 0; i < tri_list->size(); i++) {
+			order[i] = std::make_pair( (const PrivateTriangle*)(*tri_list)[i], (int)i );
+		}
+		std::sort( order.begin(), order.end() );
+
+		bool ok = true;
+		elems->reserve( tri_list->size() );
+		export_node( m_root, order, nodes, elems, &ok );
+		if (!ok) {
+			PL_ERROSH << "[ERROR]VTree::export_image():triangle not in the list." << std::endl;
+			return PLSTAT_NG;
+		}
+		return PLSTAT_OK;
 }
 
 // public /////////////////////////////////////////////////////////////////////
@@ -235,29 +349,17 @@ const PrivateTriangle* VTree::search_nearest_recursive(
 		if (vn->is_leaf()) {
 			const PrivateTriangle* tri_min = 0;
 			//float dist2_min = 0.0;
-			PL_REAL dist2_min = 0.0;
+			PL_CALC_REAL dist2_min = 0.0;
 
 			// ノード内のポリゴンから最も近い物を探す(リニアサーチ)
 			std::vector<VElement*>::const_iterator itr = vn->get_vlist().begin();
 			for (; itr != vn->get_vlist().end(); itr++) {
 				const PrivateTriangle* tri = (*itr)->get_triangle();
-
-				//const Vec3<PL_REAL> *v = tri->get_vertex();
-				// Vec3<PL_REAL> c((v[0][0]+v[1][0]+v[2][0])/3.0,
-				// 		(v[0][1]+v[1][1]+v[2][1])/3.0,
-				// 		(v[0][2]+v[1][2]+v[2][2])/3.0);
-
-				Vertex** vtx = tri->get_vertex();
-				Vec3<PL_REAL> v0,v1,v2;
-				v0=*(vtx[0]);
-				v1=*(vtx[1]);
-				v2=*(vtx[2]);
-
-				Vec3<PL_REAL> c((v0[0]+v1[0]+v2[0])/3.0,
-					(v0[1]+v1[1]+v2[1])/3.0,
-					(v0[2]+v1[2]+v2[2])/3.0);
+				// 重心は木構築時にVElementへ保持したものを使う。
+				// (剛体インスタンシング時も木と同じ座標系で比較するため)
+				Vec3<PL_REAL> c = (*itr)->get_centroid();
 				//float dist2 = (c - pos).lengthSquared();
-				PL_REAL dist2 = (c - pos).lengthSquared();
+				PL_CALC_REAL dist2 = distanceSquaredAs<PL_CALC_REAL>(c, pos);
 				if (tri_min == 0 || dist2 < dist2_min) {
 					tri_min = tri;
 					dist2_min = dist2;
@@ -286,6 +388,546 @@ const PrivateTriangle* VTree::search_nearest_recursive(
 		}
 }
 
+// search_nearest_surface()の再帰部。*dist2_min以上の三角形・bboxは検索しない
+static void search_nearest_surface_recursive(
+	VNode*					vn,
+	const Vec3<PL_REAL>&	pos,
+	const PrivateTriangle**	tri_min,
+	PL_CALC_REAL*			dist2_min,
+	PL_REAL					bary_min[3],
+	long long				nvisit[2]
+	)
+{
+	nvisit[0]++;
+	if( vn->is_leaf() ) {
+		std::vector<VElement*>::const_iterator itr = vn->get_vlist().begin();
+		for (; itr != vn->get_vlist().end(); itr++) {
+			// 要素bboxで枝刈りしてから三角形との距離を求める
+			if( (*itr)->get_bbox().distance2As<PL_CALC_REAL>( pos ) >= *dist2_min ) continue;
+			const PrivateTriangle* tri = (*itr)->get_triangle();
+			nvisit[1]++;
+			PL_REAL bary[3];
+			PL_CALC_REAL d2;
+			tri->closest_point( pos, bary, &d2 );
+			if( d2 < *dist2_min ) {
+				*tri_min = tri;
+				*dist2_min = d2;
+				bary_min[0] = bary[0];
+				bary_min[1] = bary[1];
+				bary_min[2] = bary[2];
+			}
+		}
+		return;
+	}
+
+	// 近い方の子から検索し、現在の最短距離より遠いbboxは検索しない
+	VNode* vn1 = vn->get_left();
+	VNode* vn2 = vn->get_right();
+	PL_CALC_REAL d1 = vn1->get_bbox_search().distance2As<PL_CALC_REAL>( pos );
+	PL_CALC_REAL d2 = vn2->get_bbox_search().distance2As<PL_CALC_REAL>( pos );
+	if( d2 < d1 ) {
+		std::swap( vn1, vn2 );
+		std::swap( d1, d2 );
+	}
+	if( d1 < *dist2_min ) {
+		search_nearest_surface_recursive( vn1, pos, tri_min, dist2_min, bary_min, nvisit );
+	}
+	if( d2 < *dist2_min ) {
+		search_nearest_surface_recursive( vn2, pos, tri_min, dist2_min, bary_min, nvisit );
+	}
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+const PrivateTriangle* VTree::search_nearest_surface(
+	const Vec3<PL_REAL>&	pos,
+	PL_REAL					bary[3],
+	PL_REAL*				dist2,
+	PL_CALC_REAL			bound2
+	) const {
+		if (m_root == 0) {
+			std::cerr << "Polylib::vtree::Error" << std::endl;
+			return 0;
+		}
+
+		const PrivateTriangle* tri_min = 0;
+		PL_CALC_REAL dist2_min = ( bound2 < 0 ) ? std::numeric_limits<PL_CALC_REAL>::max() : bound2;
+		PL_REAL bary_min[3] = { 0.0, 0.0, 0.0 };
+		long long nvisit[2] = { 0, 0 };
+		search_nearest_surface_recursive( m_root, pos, &tri_min, &dist2_min, bary_min, nvisit );
+
+		// 訪問ノード数と判定三角形数はまとめて加算する(並列検索時の競合を避けるため)
+		if( PolylibProfiler::enabled() ) {
+			PolylibProfiler::count( PolylibProfiler::CT_NODES_VISITED, nvisit[0] );
+			PolylibProfiler::count( PolylibProfiler::CT_TRIAS_TESTED, nvisit[1] );
+		}
+
+		if( bary != NULL ) {
+			bary[0] = bary_min[0];
+			bary[1] = bary_min[1];
+			bary[2] = bary_min[2];
+		}
+		if( dist2 != NULL ) *dist2 = (PL_REAL)dist2_min;
+		return tri_min;
+}
+
+// 二重木探索のノードの組と、その検索用bboxどうしの距離の2乗
+struct VNodePair {
+	VNode*			a;
+	VNode*			b;
+	PL_CALC_REAL	d2;
+};
+
+// 二重木探索の条件
+struct PairSearchParam {
+	/// 相手の木の座標系からこの木の座標系への剛体変換。NULLは恒等変換
+	const PL_CALC_REAL*	rel;
+
+	/// search_pairs():距離の2乗の上限
+	PL_CALC_REAL		lim2;
+
+	/// search_pairs():交差する組を求める
+	bool				intersect;
+
+	/// search_nearest_pair():全スレッドで見つけた最短距離の2乗(doubleのビット列)。
+	/// 非負のdoubleはビット列を整数として比較しても大小が同じ
+	volatile long long	bound;
+};
+
+// 二重木探索のスレッド毎の作業領域と結果
+struct PairSearchThread {
+	std::vector<PL_CALC_REAL>	pack;
+	std::vector<PL_CALC_REAL>	box;
+	std::vector<char>			hit;
+	std::vector<TrianglePair>	pairs;
+	TrianglePair				nearest;
+	PL_CALC_REAL				nearest_d2;
+	long long					nvisit[2];
+
+	PairSearchThread() : nearest_d2( std::numeric_limits<PL_CALC_REAL>::max() ) {
+		nvisit[0] = nvisit[1] = 0;
+	}
+};
+
+static long long dist_bits( double d )
+{
+	long long b;
+	memcpy( &b, &d, sizeof(b) );
+	return b;
+}
+
+static double bits_dist( long long b )
+{
+	double d;
+	memcpy( &d, &b, sizeof(d) );
+	return d;
+}
+
+// 最短距離の2乗をdとの小さい方に更新する
+static void bound_min( volatile long long* bound, double d )
+{
+	long long nb = dist_bits( d );
+	long long ob = *bound;
+	while( nb < ob ) {
+		long long prev = __sync_val_compare_and_swap( bound, ob, nb );
+		if( prev == ob ) break;
+		ob = prev;
+	}
+}
+
+// ノードの検索用bbox(lo x,y,z、hi x,y,z)。相手の木のノードはrelで変換して
+// 外包する。空のbboxはfalse
+static bool node_box( VNode* vn, const PL_CALC_REAL* rel, PL_CALC_REAL box[6] )
+{
+	BBox b = vn->get_bbox_search();
+	if( b.min[0] > b.max[0] ) return false;
+	if( rel == NULL ) {
+		for( int i=0; i<3; i++ ) {
+			box[i] = b.min[i];
+			box[i+3] = b.max[i];
+		}
+		return true;
+	}
+	PL_CALC_REAL c[3], e[3];
+	for( int i=0; i<3; i++ ) {
+		c[i] = 0.5 * ( (PL_CALC_REAL)b.min[i] + b.max[i] );
+		e[i] = 0.5 * ( (PL_CALC_REAL)b.max[i] - b.min[i] );
+	}
+	for( int i=0; i<3; i++ ) {
+		const PL_CALC_REAL* r = rel + i*3;
+		PL_CALC_REAL nc = rel[9+i] + r[0]*c[0] + r[1]*c[1] + r[2]*c[2];
+		PL_CALC_REAL ne = std::fabs(r[0])*e[0] + std::fabs(r[1])*e[1] + std::fabs(r[2])*e[2];
+		// 変換の丸め誤差の分広げる
+		PL_CALC_REAL pad = ( std::fabs(nc) + ne ) * 4 * std::numeric_limits<PL_REAL>::epsilon();
+		box[i] = nc - ne - pad;
+		box[i+3] = nc + ne + pad;
+	}
+	return true;
+}
+
+// bboxどうしの距離の2乗
+static PL_CALC_REAL box_dist2( const PL_CALC_REAL* a, const PL_CALC_REAL* b )
+{
+	PL_CALC_REAL d2 = 0.0;
+	for( int i=0; i<3; i++ ) {
+		PL_CALC_REAL d = std::max( (PL_CALC_REAL)0.0, std::max( b[i] - a[i+3], a[i] - b[i+3] ) );
+		d2 += d*d;
+	}
+	return d2;
+}
+
+// ノードの組の検索用bboxどうしの距離の2乗。空のノードを含む場合は無限遠
+static PL_CALC_REAL node_pair_dist2( VNode* va, VNode* vb, const PL_CALC_REAL* rel )
+{
+	PL_CALC_REAL ba[6], bb[6];
+	if( !node_box( va, NULL, ba ) || !node_box( vb, rel, bb ) ) {
+		return std::numeric_limits<PL_CALC_REAL>::max();
+	}
+	return box_dist2( ba, bb );
+}
+
+// 先に分割するノード。リーフでない方、両方ともリーフでなければ大きい方
+static bool split_a( VNode* va, VNode* vb )
+{
+	if( va->is_leaf() ) return false;
+	if( vb->is_leaf() ) return true;
+	return va->get_bbox_search().diameter() >= vb->get_bbox_search().diameter();
+}
+
+// 三角形の頂点座標と外接矩形をまとめる。頂点座標はrelで変換する
+static void pack_leaf(
+	std::vector<VElement*>&		vlist,
+	const PL_CALC_REAL*			rel,
+	std::vector<PL_CALC_REAL>	*pack,
+	std::vector<PL_CALC_REAL>	*box
+	)
+{
+	size_t n = vlist.size();
+	pack->resize( n * 9 );
+	box->resize( n * 6 );
+	for( size_t j=0; j<n; j++ ) {
+		PL_CALC_REAL* c = &(*pack)[ j*9 ];
+		PL_CALC_REAL* b = &(*box)[ j*6 ];
+		tri_pair_coords( vlist[j]->get_triangle(), c );
+		if( rel != NULL ) {
+			for( int v=0; v<3; v++ ) {
+				PL_CALC_REAL* p = c + v*3;
+				PL_CALC_REAL q[3];
+				for( int i=0; i<3; i++ ) {
+					const PL_CALC_REAL* r = rel + i*3;
+					q[i] = rel[9+i] + r[0]*p[0] + r[1]*p[1] + r[2]*p[2];
+				}
+				p[0] = q[0]; p[1] = q[1]; p[2] = q[2];
+			}
+		}
+		for( int i=0; i<3; i++ ) {
+			b[i] = std::min( c[i], std::min( c[3+i], c[6+i] ) );
+			b[i+3] = std::max( c[i], std::max( c[3+i], c[6+i] ) );
+		}
+	}
+}
+
+// 三角形の組の順序。IDの小さい順で、同じIDでは三角形のアドレス順
+static bool pair_less( const TrianglePair& x, const TrianglePair& y )
+{
+	if( x.tri_a->get_id() != y.tri_a->get_id() ) return x.tri_a->get_id() < y.tri_a->get_id();
+	if( x.tri_b->get_id() != y.tri_b->get_id() ) return x.tri_b->get_id() < y.tri_b->get_id();
+	if( x.tri_a != y.tri_a ) return x.tri_a < y.tri_a;
+	return x.tri_b < y.tri_b;
+}
+
+// search_pairs()の再帰部
+static void search_pairs_recursive(
+	VNode*					va,
+	VNode*					vb,
+	const PairSearchParam&	param,
+	PairSearchThread*		th
+	)
+{
+	th->nvisit[0]++;
+	if( node_pair_dist2( va, vb, param.rel ) > param.lim2 ) return;
+
+	if( !va->is_leaf() || !vb->is_leaf() ) {
+		if( split_a( va, vb ) ) {
+			search_pairs_recursive( va->get_left(), vb, param, th );
+			search_pairs_recursive( va->get_right(), vb, param, th );
+		}
+		else {
+			search_pairs_recursive( va, vb->get_left(), param, th );
+			search_pairs_recursive( va, vb->get_right(), param, th );
+		}
+		return;
+	}
+
+	std::vector<VElement*>& la = va->get_vlist();
+	std::vector<VElement*>& lb = vb->get_vlist();
+	int nb = lb.size();
+	if( la.empty() || nb == 0 ) return;
+	pack_leaf( lb, param.rel, &th->pack, &th->box );
+	th->hit.resize( nb );
+	for( size_t i=0; i<la.size(); i++ ) {
+		const PrivateTriangle* ta = la[i]->get_triangle();
+		PL_CALC_REAL ca[9], ba[6];
+		tri_pair_coords( ta, ca );
+		for( int k=0; k<3; k++ ) {
+			ba[k] = std::min( ca[k], std::min( ca[3+k], ca[6+k] ) );
+			ba[k+3] = std::max( ca[k], std::max( ca[3+k], ca[6+k] ) );
+		}
+		th->nvisit[1] += nb;
+		if( param.intersect ) {
+			tri_tri_intersect_batch( ca, &th->pack[0], nb, &th->hit[0] );
+			for( int j=0; j<nb; j++ ) {
+				if( th->hit[j] ) th->pairs.push_back( TrianglePair( ta, lb[j]->get_triangle(), 0 ) );
+			}
+			continue;
+		}
+		for( int j=0; j<nb; j++ ) {
+			if( box_dist2( ba, &th->box[ (size_t)j*6 ] ) > param.lim2 ) continue;
+			PL_CALC_REAL d2 = tri_tri_dist2( ca, &th->pack[ (size_t)j*9 ] );
+			if( d2 <= param.lim2 ) {
+				th->pairs.push_back( TrianglePair( ta, lb[j]->get_triangle(), d2 ) );
+			}
+		}
+	}
+}
+
+// search_nearest_pair()の再帰部。近いノードの組から検索する
+static void search_nearest_pair_recursive(
+	VNode*				va,
+	VNode*				vb,
+	PL_CALC_REAL		d2_node,
+	PairSearchParam&	param,
+	PairSearchThread*	th
+	)
+{
+	th->nvisit[0]++;
+	// 最短距離と同じ距離の組は残す(IDの小さい組を選ぶため)
+	if( d2_node > bits_dist( param.bound ) ) return;
+
+	if( !va->is_leaf() || !vb->is_leaf() ) {
+		VNodePair c[2];
+		if( split_a( va, vb ) ) {
+			c[0].a = va->get_left();  c[0].b = vb;
+			c[1].a = va->get_right(); c[1].b = vb;
+		}
+		else {
+			c[0].a = va; c[0].b = vb->get_left();
+			c[1].a = va; c[1].b = vb->get_right();
+		}
+		for( int k=0; k<2; k++ ) c[k].d2 = node_pair_dist2( c[k].a, c[k].b, param.rel );
+		if( c[1].d2 < c[0].d2 ) std::swap( c[0], c[1] );
+		for( int k=0; k<2; k++ ) {
+			search_nearest_pair_recursive( c[k].a, c[k].b, c[k].d2, param, th );
+		}
+		return;
+	}
+
+	std::vector<VElement*>& la = va->get_vlist();
+	std::vector<VElement*>& lb = vb->get_vlist();
+	int nb = lb.size();
+	if( la.empty() || nb == 0 ) return;
+	pack_leaf( lb, param.rel, &th->pack, &th->box );
+	for( size_t i=0; i<la.size(); i++ ) {
+		const PrivateTriangle* ta = la[i]->get_triangle();
+		PL_CALC_REAL ca[9], ba[6];
+		tri_pair_coords( ta, ca );
+		for( int k=0; k<3; k++ ) {
+			ba[k] = std::min( ca[k], std::min( ca[3+k], ca[6+k] ) );
+			ba[k+3] = std::max( ca[k], std::max( ca[3+k], ca[6+k] ) );
+		}
+		for( int j=0; j<nb; j++ ) {
+			// 三角形の外接矩形で枝刈りしてから距離を求める
+			PL_CALC_REAL bound = bits_dist( param.bound );
+			if( box_dist2( ba, &th->box[ (size_t)j*6 ] ) > bound ) continue;
+			th->nvisit[1]++;
+			PL_CALC_REAL d2 = tri_tri_dist2( ca, &th->pack[ (size_t)j*9 ] );
+			if( d2 > th->nearest_d2 ) continue;
+			TrianglePair p( ta, lb[j]->get_triangle(), d2 );
+			if( d2 < th->nearest_d2 || pair_less( p, th->nearest ) ) {
+				th->nearest_d2 = d2;
+				th->nearest = p;
+				bound_min( &param.bound, d2 );
+			}
+		}
+	}
+}
+
+// 並列に処理するノードの組を作る。根の組から幅優先で分割し、組の数が
+// target以上になるか全てリーフの組になったら終了する。距離の2乗が
+// lim2を超える組は除く
+static void split_node_pairs(
+	VNode*					ra,
+	VNode*					rb,
+	const PL_CALC_REAL*		rel,
+	PL_CALC_REAL			lim2,
+	size_t					target,
+	std::vector<VNodePair>	*tasks
+	)
+{
+	tasks->clear();
+	VNodePair p;
+	p.a = ra;
+	p.b = rb;
+	p.d2 = node_pair_dist2( ra, rb, rel );
+	if( p.d2 > lim2 ) return;
+	tasks->push_back( p );
+
+	while( tasks->size() < target ) {
+		std::vector<VNodePair> next;
+		bool split = false;
+		for( size_t i=0; i<tasks->size(); i++ ) {
+			VNodePair t = (*tasks)[i];
+			if( t.a->is_leaf() && t.b->is_leaf() ) {
+				next.push_back( t );
+				continue;
+			}
+			split = true;
+			VNodePair c[2];
+			if( split_a( t.a, t.b ) ) {
+				c[0].a = t.a->get_left();  c[0].b = t.b;
+				c[1].a = t.a->get_right(); c[1].b = t.b;
+			}
+			else {
+				c[0].a = t.a; c[0].b = t.b->get_left();
+				c[1].a = t.a; c[1].b = t.b->get_right();
+			}
+			for( int k=0; k<2; k++ ) {
+				c[k].d2 = node_pair_dist2( c[k].a, c[k].b, rel );
+				if( c[k].d2 <= lim2 ) next.push_back( c[k] );
+			}
+		}
+		tasks->swap( next );
+		if( !split ) break;
+	}
+}
+
+static bool task_nearer( const VNodePair& x, const VNodePair& y )
+{
+	return x.d2 < y.d2;
+}
+
+// 並列に処理する組の数の目安
+static size_t pair_task_target()
+{
+	int nthread = 1;
+#ifdef _OPENMP
+	nthread = omp_get_max_threads();
+#endif
+	return (size_t)nthread * 32;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT VTree::search_pairs(
+	const VTree					*other,
+	const PL_CALC_REAL			*rel,
+	PL_REAL						dist,
+	std::vector<TrianglePair>	*pairs
+	) const {
+		if (other == NULL || pairs == NULL) return PLSTAT_ARGUMENT_NULL;
+		if (m_root == 0 || other->m_root == 0) return PLSTAT_OK;
+
+		PairSearchParam param;
+		param.rel = rel;
+		param.intersect = ( dist < 0 );
+		param.lim2 = param.intersect ? 0.0 : (PL_CALC_REAL)dist * dist;
+		param.bound = 0;
+
+		std::vector<VNodePair> tasks;
+		split_node_pairs( m_root, other->m_root, rel, param.lim2, pair_task_target(), &tasks );
+		int ntask = tasks.size();
+		size_t nbase = pairs->size();
+		long long nvisit[2] = { 0, 0 };
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+		{
+			PairSearchThread th;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,1)
+#endif
+			for( int i=0; i<ntask; i++ ) {
+				search_pairs_recursive( tasks[i].a, tasks[i].b, param, &th );
+			}
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+			{
+				pairs->insert( pairs->end(), th.pairs.begin(), th.pairs.end() );
+				nvisit[0] += th.nvisit[0];
+				nvisit[1] += th.nvisit[1];
+			}
+		}
+
+		// スレッド数によらない順にする
+		std::sort( pairs->begin() + nbase, pairs->end(), pair_less );
+
+		if( PolylibProfiler::enabled() ) {
+			PolylibProfiler::count( PolylibProfiler::CT_NODES_VISITED, nvisit[0] );
+			PolylibProfiler::count( PolylibProfiler::CT_TRIAS_TESTED, nvisit[1] );
+		}
+		return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT VTree::search_nearest_pair(
+	const VTree					*other,
+	const PL_CALC_REAL			*rel,
+	TrianglePair				*pair
+	) const {
+		if (other == NULL || pair == NULL) return PLSTAT_ARGUMENT_NULL;
+		*pair = TrianglePair();
+		if (m_root == 0 || other->m_root == 0) return PLSTAT_OK;
+
+		PairSearchParam param;
+		param.rel = rel;
+		param.intersect = false;
+		param.lim2 = std::numeric_limits<PL_CALC_REAL>::max();
+		param.bound = dist_bits( std::numeric_limits<double>::max() );
+
+		// 近い組から処理して、早く最短距離を絞り込む
+		std::vector<VNodePair> tasks;
+		split_node_pairs( m_root, other->m_root, rel, param.lim2, pair_task_target(), &tasks );
+		std::stable_sort( tasks.begin(), tasks.end(), task_nearer );
+		int ntask = tasks.size();
+		PL_CALC_REAL best_d2 = std::numeric_limits<PL_CALC_REAL>::max();
+		long long nvisit[2] = { 0, 0 };
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+		{
+			PairSearchThread th;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,1)
+#endif
+			for( int i=0; i<ntask; i++ ) {
+				search_nearest_pair_recursive( tasks[i].a, tasks[i].b, tasks[i].d2, param, &th );
+			}
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+			{
+				// 同じ距離の組はIDの小さい方
+				if( th.nearest.tri_a != 0 && ( pair->tri_a == 0 || th.nearest_d2 < best_d2 ||
+					( th.nearest_d2 == best_d2 && pair_less( th.nearest, *pair ) ) ) ) {
+					*pair = th.nearest;
+					best_d2 = th.nearest_d2;
+				}
+				nvisit[0] += th.nvisit[0];
+				nvisit[1] += th.nvisit[1];
+			}
+		}
+
+		if( PolylibProfiler::enabled() ) {
+			PolylibProfiler::count( PolylibProfiler::CT_NODES_VISITED, nvisit[0] );
+			PolylibProfiler::count( PolylibProfiler::CT_TRIAS_TESTED, nvisit[1] );
+		}
+		return PLSTAT_OK;
+}
+
 // private ////////////////////////////////////////////////////////////////////
 
 void VTree::traverse(VNode* vn, VElement* elm, VNode** vnode) const
@@ -346,7 +988,10 @@ void VTree::search_recursive(
 			PL_DBGOSH << "VTree::search_recursive:@@@----------------------@@@ "
 				<< vn << " " << vn->get_left() << " "<< vn->get_right()<< std::endl;
 #endif
+			PolylibProfiler::count( PolylibProfiler::CT_NODES_VISITED, 1 );
+
 			if (vn->is_leaf()) {
+				PolylibProfiler::count( PolylibProfiler::CT_TRIAS_TESTED, vn->get_vlist().size() );
 #ifdef DEBUG_VTREE
 				PL_DBGOSH << "VTree::search_recursive:@@@--------at leaf----------@@@"
 					<< vn << " " << vn->get_left() << " "<< vn->get_right()<< std::endl;
@@ -377,12 +1022,13 @@ void VTree::search_recursive(
 #endif
 
 					// determine between bbox and 3 vertices of each triangle.
+					// (演算型PL_CALC_REALで判定する)
 					if (every == true) {
 						bool iscontain = true;
 						//const Vec3<PL_REAL> *temp = (*itr)->get_triangle()->get_vertex();
 						Vertex** temp=(*itr)->get_triangle()->get_vertex();
 						for (int i = 0; i < 3; i++) {
-							if (bbox.contain( (Vec3<PL_REAL>) *(temp[i]) ) == false)  {
+							if (bbox.containAs<PL_CALC_REAL>( (Vec3<PL_REAL>) *(temp[i]) ) == false)  {
 								iscontain = false;
 								break;
 							}
@@ -398,7 +1044,7 @@ void VTree::search_recursive(
 						PL_DBGOSH << "VTree::search_recursive: every == false " <<std::endl;
 #endif
 						BBox e_bbox = (*itr)->get_bbox();
-						if (e_bbox.crossed(bbox) == true) {
+						if (e_bbox.crossedAs<PL_CALC_REAL>(bbox) == true) {
 #ifdef DEBUG_VTREE
 							PL_DBGOSH << "VTree::search_recursive: crossed true " <<std::endl;
 #endif
@@ -449,14 +1095,14 @@ void VTree::search_recursive(
 			BBox lbox = vn->get_left()->get_bbox_search();
 			BBox rbox = vn->get_right()->get_bbox_search();
 
-			if (lbox.crossed(bbox) == true) {
+			if (lbox.crossedAs<PL_CALC_REAL>(bbox) == true) {
 #ifdef USE_DEPTH
 				PL_DBGOSH << "VTree::search_recursive:left=" << vn->get_depth() << std::endl;
 #endif
 				search_recursive(vn->get_left(), bbox, every, vlist);
 			}
 
-			if (rbox.crossed(bbox) == true) {
+			if (rbox.crossedAs<PL_CALC_REAL>(bbox) == true) {
 #ifdef USE_DEPTH
 				PL_DBGOSH << "VTree::search_recursive:right=" << vn->get_depth() << std::endl;
 #endif
@@ -218,34 +218,27 @@ void VertKDT::destroy()
 
 // public /////////////////////////////////////////////////////////////////////
 
-unsigned int VertKDT::memory_size() {
-	VertKDTNode			*vnode;
-	unsigned int	node_cnt = 1;		// ノード数
-	unsigned int	poly_cnt = 0;		// ポリゴン数
-	unsigned int	size;
-
-	if ((vnode = m_root->get_left()) != NULL) {;
-	node_count(vnode, &node_cnt, &poly_cnt);
-	}
-	//#define DEBUG_VTREE
-#ifdef DEBUG_VTREE
-	PL_DBGOSH << "VertKDT::memory_size1():node,poly=" << node_cnt << ","
-		<< poly_cnt << std::endl;
-#endif
+unsigned long long VertKDT::memory_size() {
+	PolylibMemoryUsage usage;
+	memory_usage( &usage );
+	return usage.total();
+}
 
-	if ((vnode = m_root->get_right()) != NULL) {;
-	node_count(vnode, &node_cnt, &poly_cnt);
-	}
-#ifdef DEBUG_VTREE
-	PL_DBGOSH << "VertKDT::memory_size2():node,poly=" << node_cnt << ","
-		<< poly_cnt << std::endl;
-#endif
+// ノードとノード内要素の利用メモリ量を加算
+static void node_memory_usage( VertKDTNode* vn, PolylibMemoryUsage* p_usage )
+{
+	if( vn == NULL ) return;
+	p_usage->m_tree_nodes += sizeof(VertKDTNode) + vn->get_vlist().capacity() * sizeof(VertKDTElem*);
+	p_usage->m_tree_elements += vn->get_vlist().size() * sizeof(VertKDTElem);
+	node_memory_usage( vn->get_left(), p_usage );
+	node_memory_usage( vn->get_right(), p_usage );
+}
+
+// public /////////////////////////////////////////////////////////////////////
 
-	size  = sizeof(VertKDT);
-	size += sizeof(VertKDTNode)	 * node_cnt;
-	size += sizeof(VertKDTElem) * poly_cnt;
-	return size;
-	//#undef DEBUG_VTREE
+void VertKDT::memory_usage( PolylibMemoryUsage* p_usage ) const {
+	p_usage->m_tree_nodes += sizeof(VertKDT);
+	node_memory_usage( m_root, p_usage );
 }
 
 // public /////////////////////////////////////////////////////////////////////
@@ -277,14 +270,14 @@ const Vertex* VertKDT::search_nearest_recursive(
 	if (vn->is_leaf()) {
 		const Vertex* tri_min = 0;
 		//float dist2_min = 0.0;
-		PL_REAL dist2_min = 0.0;
+		PL_CALC_REAL dist2_min = 0.0;
 
 		// ノード内のポリゴンから最も近い物を探す(リニアサーチ)
 		std::vector<VertKDTElem*>::const_iterator itr = vn->get_vlist().begin();
 		for (; itr != vn->get_vlist().end(); itr++) {
 			const Vertex* tri = (*itr)->get_vertex();
 			Vec3<PL_REAL> c = (Vec3<PL_REAL>) (*tri);
-			PL_REAL dist2 = (c - pos).lengthSquared();
+			PL_CALC_REAL dist2 = distanceSquaredAs<PL_CALC_REAL>(c, pos);
 			if (tri_min == 0 || dist2 < dist2_min) {
 				tri_min = tri;
 				dist2_min = dist2;
@@ -108,7 +108,8 @@ PL_REAL Vertex::distanceSquared(Vertex v)
 #endif // DEBUG
 
 
-	return vdis.lengthSquared();
+	// 差は演算型で求める
+	return (PL_REAL)distanceSquaredAs<PL_CALC_REAL>( (Vec3<PL_REAL>)(*this), (Vec3<PL_REAL>)v );
 }
 
 ///距離
@@ -45,7 +45,7 @@ VertexList::VertexList(PL_REAL tolerance)
 VertexList::VertexList(VertKDT* vkdt,PL_REAL tolerance){
 	m_vkdt = vkdt;
 	m_tolerance = tolerance;
-	m_tolerance_2=m_tolerance*m_tolerance;
+	m_tolerance_2=(PL_CALC_REAL)m_tolerance*m_tolerance;
 	m_bbox.init();
 	m_vertex_list= new std::vector<Vertex*>;
 	m_num_map=NULL;
@@ -214,6 +214,24 @@ void VertexList::print() const
 	}
 }
 
+///  利用メモリ量
+void VertexList::memory_usage(PolylibMemoryUsage* p_usage, size_t vertex_size) const
+{
+	unsigned long long size = sizeof(VertexList);
+	if( m_vertex_list != NULL ) {
+		size += sizeof(std::vector<Vertex*>);
+		size += m_vertex_list->capacity() * sizeof(Vertex*);
+		size += m_vertex_list->size() * vertex_size;
+	}
+	// 番号検索用mapは要素ごとに木のノード(ポインタ3つと色)を持つ
+	if( m_num_map != NULL ) {
+		size += sizeof(*m_num_map);
+		size += m_num_map->size() *
+			( sizeof(std::pair<Vertex* const, std::vector<Vertex*>::size_type>) + 4*sizeof(void*) );
+	}
+	p_usage->m_vertices += size;
+}
+
 // setter and getter  for tolerance
 
 
@@ -416,7 +434,7 @@ Vertex* VertexList::vtx_add_KDT(Vertex* v)
 			}
 		} else {
 			//std::cout << __func__ << " nearest vertex found. " <<max<<std::endl;
-			PL_REAL distance = ((Vec3<PL_REAL>) (*nearest) - (Vec3<PL_REAL>) (*v)).lengthSquared();
+			PL_CALC_REAL distance = distanceSquaredAs<PL_CALC_REAL>( (Vec3<PL_REAL>) (*nearest), (Vec3<PL_REAL>) (*v) );
 			// std::cout << "nearest "<< *nearest  << " add " << *v <<std::endl;
 			// std::cout << __func__ << " check distance "<<distance
 			// 	      <<" "<< m_tolerance <<std::endl;
@@ -555,7 +573,7 @@ POLYLIB_STAT
 #endif
 					//	PL_DBGOSH<< __func__<< " nearest point is found. "<< nearest <<std::endl;
 
-					PL_REAL distance2 = ((Vec3<PL_REAL>) (*nearest) - (Vec3<PL_REAL>) *(*vtx_itr)).lengthSquared();
+					PL_CALC_REAL distance2 = distanceSquaredAs<PL_CALC_REAL>( (Vec3<PL_REAL>) (*nearest), (Vec3<PL_REAL>) *(*vtx_itr) );
 					if (distance2< m_tolerance_2){ // 同一頂点
 						remove_vtx_list->push_back( *vtx_itr);
 						(*vertex_map)[(*vtx_itr)] = const_cast<Vertex*>(nearest);
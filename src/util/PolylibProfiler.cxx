@@ -0,0 +1,519 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <time.h>
+#include <pthread.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "common/PolylibCommon.h"
+#include "util/PolylibProfiler.h"
+
+namespace PolylibNS {
+
+//  環境変数POLYLIB_PROFILEの値を判定
+static bool profile_env( bool trace )
+{
+	const char* env = getenv( "POLYLIB_PROFILE" );
+	if( env == NULL || *env == '\0' || strcmp( env, "0" ) == 0 ) return false;
+	if( trace ) return strcmp( env, "trace" ) == 0;
+	return true;
+}
+
+bool	PolylibProfiler::s_enabled = profile_env( false );
+bool	PolylibProfiler::s_trace   = profile_env( true );
+double	PolylibProfiler::s_origin  = 0.0;
+
+// 計測値
+static double		s_time[PolylibProfiler::PH_NUM];
+static long long	s_calls[PolylibProfiler::PH_NUM];
+static double		s_start[PolylibProfiler::PH_NUM];
+static int			s_depth[PolylibProfiler::PH_NUM];
+static long long	s_count[PolylibProfiler::CT_NUM];
+static std::map<int, std::pair<long long, long long> >	s_neighbour;
+static std::vector<PolylibProfiler::Event>				s_events;
+
+// フェーズを計測するスレッド。フェーズの状態(s_start,s_depth,s_events)は
+// このスレッドからのみ更新する。
+static pthread_t		s_owner;
+static bool				s_has_owner = false;
+static pthread_mutex_t	s_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//  呼び出しスレッドを計測スレッドにする
+static void set_owner()
+{
+	pthread_mutex_lock( &s_mutex );
+	s_owner = pthread_self();
+	s_has_owner = true;
+	pthread_mutex_unlock( &s_mutex );
+}
+
+//  呼び出しスレッドが計測スレッドか判定する。未設定の場合は呼び出しスレッドを設定する。
+static bool is_owner()
+{
+	pthread_mutex_lock( &s_mutex );
+	if( !s_has_owner ) {
+		s_owner = pthread_self();
+		s_has_owner = true;
+	}
+	bool ret = pthread_equal( s_owner, pthread_self() ) != 0;
+	pthread_mutex_unlock( &s_mutex );
+	return ret;
+}
+
+static const char* s_phase_names[PolylibProfiler::PH_NUM] = {
+	"load", "weld", "build", "search", "move", "distribute",
+	"migrate", "migrate_pack", "migrate_send", "migrate_recv", "migrate_unpack"
+};
+
+static const char* s_counter_names[PolylibProfiler::CT_NUM] = {
+	"nodes_visited", "trias_tested", "search_queries",
+	"bytes_sent", "bytes_recv", "trias_sent", "trias_recv"
+};
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolylibProfiler::Record::Record() : m_rank(0)
+{
+	for( int i=0; i<PH_NUM; i++ ) {
+		m_time[i] = 0.0;
+		m_calls[i] = 0;
+	}
+	for( int i=0; i<CT_NUM; i++ ) m_count[i] = 0;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+PolylibProfiler::Summary::Summary() : m_nrank(0)
+{
+	for( int i=0; i<PH_NUM; i++ ) {
+		m_time_min[i] = m_time_max[i] = m_time_sum[i] = 0.0;
+		m_calls_sum[i] = 0;
+	}
+	for( int i=0; i<CT_NUM; i++ ) {
+		m_count_min[i] = m_count_max[i] = m_count_sum[i] = 0;
+	}
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolylibProfiler::enable( bool flag, bool trace )
+{
+	if( flag ) {
+		set_owner();
+		if( !s_enabled ) {
+			// 無効化前のイベントは基準時刻が異なるので破棄する
+			s_origin = now();
+			s_events.clear();
+			for( int i=0; i<PH_NUM; i++ ) s_depth[i] = 0;
+		}
+	}
+	s_enabled = flag;
+	s_trace = trace;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolylibProfiler::reset()
+{
+	for( int i=0; i<PH_NUM; i++ ) {
+		s_time[i] = 0.0;
+		s_calls[i] = 0;
+		s_depth[i] = 0;
+	}
+	for( int i=0; i<CT_NUM; i++ ) s_count[i] = 0;
+	s_neighbour.clear();
+	s_events.clear();
+	s_origin = now();
+	set_owner();
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+double PolylibProfiler::now()
+{
+#ifdef WIN32
+	return (double)clock() / CLOCKS_PER_SEC;
+#else
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + (double)tv.tv_usec*1.e-6;
+#endif
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+bool PolylibProfiler::begin_phase( Phase phase )
+{
+#ifdef _OPENMP
+	if( omp_in_parallel() ) return false;
+#endif
+	if( !is_owner() ) return false;
+	if( s_origin == 0.0 ) s_origin = now();
+	if( s_depth[phase]++ == 0 ) s_start[phase] = now();
+	return true;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolylibProfiler::end( Phase phase )
+{
+	if( !is_owner() ) return;
+	if( s_depth[phase] <= 0 ) return;
+	if( --s_depth[phase] > 0 ) return;
+
+	double t = now();
+	s_time[phase] += t - s_start[phase];
+	s_calls[phase]++;
+
+	if( s_trace && s_events.size() < MAX_EVENTS ) {
+		Event ev;
+		ev.m_phase = phase;
+		ev.m_begin = s_start[phase];
+		ev.m_end   = t;
+		s_events.push_back( ev );
+	}
+}
+
+// private ////////////////////////////////////////////////////////////////////
+
+void PolylibProfiler::add_count( Counter counter, long long n )
+{
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+	s_count[counter] += n;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolylibProfiler::count_neighbour( int rank, long long sent, long long recv )
+{
+	if( !s_enabled ) return;
+	pthread_mutex_lock( &s_mutex );
+	std::pair<long long, long long>& p = s_neighbour[rank];
+	p.first  += sent;
+	p.second += recv;
+	pthread_mutex_unlock( &s_mutex );
+	add_count( CT_BYTES_SENT, sent );
+	add_count( CT_BYTES_RECV, recv );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+double PolylibProfiler::phase_time( Phase phase )
+{
+	return s_time[phase];
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+long long PolylibProfiler::phase_calls( Phase phase )
+{
+	return s_calls[phase];
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+long long PolylibProfiler::counter( Counter counter )
+{
+	return s_count[counter];
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+const char* PolylibProfiler::phase_name( int phase )
+{
+	if( phase < 0 || phase >= PH_NUM ) return "unknown";
+	return s_phase_names[phase];
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+const char* PolylibProfiler::counter_name( int counter )
+{
+	if( counter < 0 || counter >= CT_NUM ) return "unknown";
+	return s_counter_names[counter];
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolylibProfiler::get_record( Record* p_rec, int rank )
+{
+	p_rec->m_rank = rank;
+	for( int i=0; i<PH_NUM; i++ ) {
+		p_rec->m_time[i]  = s_time[i];
+		p_rec->m_calls[i] = s_calls[i];
+	}
+	for( int i=0; i<CT_NUM; i++ ) p_rec->m_count[i] = s_count[i];
+	p_rec->m_neighbour = s_neighbour;
+	p_rec->m_events = s_events;
+}
+
+// バイト列への書き込み/読み込み
+template <typename T>
+static void put( std::vector<char>* p_buf, const T& v )
+{
+	const char* p = reinterpret_cast<const char*>( &v );
+	p_buf->insert( p_buf->end(), p, p + sizeof(T) );
+}
+
+template <typename T>
+static bool get( const char* p_buf, size_t size, size_t* p_pos, T* v )
+{
+	if( *p_pos + sizeof(T) > size ) return false;
+	memcpy( v, p_buf + *p_pos, sizeof(T) );
+	*p_pos += sizeof(T);
+	return true;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolylibProfiler::pack_record( const Record& rec, std::vector<char>* p_buf )
+{
+	p_buf->clear();
+	put( p_buf, rec.m_rank );
+	for( int i=0; i<PH_NUM; i++ ) put( p_buf, rec.m_time[i] );
+	for( int i=0; i<PH_NUM; i++ ) put( p_buf, rec.m_calls[i] );
+	for( int i=0; i<CT_NUM; i++ ) put( p_buf, rec.m_count[i] );
+
+	put( p_buf, (long long)rec.m_neighbour.size() );
+	std::map<int, std::pair<long long, long long> >::const_iterator itr;
+	for( itr = rec.m_neighbour.begin(); itr != rec.m_neighbour.end(); itr++ ) {
+		put( p_buf, itr->first );
+		put( p_buf, itr->second.first );
+		put( p_buf, itr->second.second );
+	}
+
+	put( p_buf, (long long)rec.m_events.size() );
+	for( size_t i=0; i<rec.m_events.size(); i++ ) {
+		put( p_buf, rec.m_events[i].m_phase );
+		put( p_buf, rec.m_events[i].m_begin );
+		put( p_buf, rec.m_events[i].m_end );
+	}
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+size_t PolylibProfiler::unpack_record( const char* p_buf, size_t size, Record* p_rec )
+{
+	size_t pos = 0;
+	long long n;
+	bool ok = get( p_buf, size, &pos, &p_rec->m_rank );
+	for( int i=0; ok && i<PH_NUM; i++ ) ok = get( p_buf, size, &pos, &p_rec->m_time[i] );
+	for( int i=0; ok && i<PH_NUM; i++ ) ok = get( p_buf, size, &pos, &p_rec->m_calls[i] );
+	for( int i=0; ok && i<CT_NUM; i++ ) ok = get( p_buf, size, &pos, &p_rec->m_count[i] );
+
+	p_rec->m_neighbour.clear();
+	ok = ok && get( p_buf, size, &pos, &n );
+	for( long long i=0; ok && i<n; i++ ) {
+		int rank;
+		std::pair<long long, long long> p;
+		ok = get( p_buf, size, &pos, &rank ) &&
+			get( p_buf, size, &pos, &p.first ) &&
+			get( p_buf, size, &pos, &p.second );
+		if( ok ) p_rec->m_neighbour[rank] = p;
+	}
+
+	p_rec->m_events.clear();
+	ok = ok && get( p_buf, size, &pos, &n );
+	for( long long i=0; ok && i<n; i++ ) {
+		Event ev;
+		ok = get( p_buf, size, &pos, &ev.m_phase ) &&
+			get( p_buf, size, &pos, &ev.m_begin ) &&
+			get( p_buf, size, &pos, &ev.m_end );
+		if( ok ) p_rec->m_events.push_back( ev );
+	}
+
+	if( !ok ) {
+		PL_ERROSH << "[ERROR]PolylibProfiler::unpack_record():invalid data." << std::endl;
+		return 0;
+	}
+	return pos;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void PolylibProfiler::summarize( const std::vector<Record>& recs, Summary* p_sum )
+{
+	*p_sum = Summary();
+	p_sum->m_nrank = (int)recs.size();
+	for( size_t r=0; r<recs.size(); r++ ) {
+		const Record& rec = recs[r];
+		for( int i=0; i<PH_NUM; i++ ) {
+			if( r == 0 || rec.m_time[i] < p_sum->m_time_min[i] ) p_sum->m_time_min[i] = rec.m_time[i];
+			if( r == 0 || rec.m_time[i] > p_sum->m_time_max[i] ) p_sum->m_time_max[i] = rec.m_time[i];
+			p_sum->m_time_sum[i] += rec.m_time[i];
+			p_sum->m_calls_sum[i] += rec.m_calls[i];
+		}
+		for( int i=0; i<CT_NUM; i++ ) {
+			if( r == 0 || rec.m_count[i] < p_sum->m_count_min[i] ) p_sum->m_count_min[i] = rec.m_count[i];
+			if( r == 0 || rec.m_count[i] > p_sum->m_count_max[i] ) p_sum->m_count_max[i] = rec.m_count[i];
+			p_sum->m_count_sum[i] += rec.m_count[i];
+		}
+	}
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolylibProfiler::write_json(
+	const std::string& fname,
+	const Summary& sum,
+	const std::vector<Record>& recs
+	)
+{
+	std::ofstream ofs( fname.c_str() );
+	if( !ofs ) {
+		PL_ERROSH << "[ERROR]PolylibProfiler::write_json():Can't open " << fname << std::endl;
+		return PLSTAT_NG;
+	}
+	ofs << std::setprecision(9);
+
+	int nrank = sum.m_nrank > 0 ? sum.m_nrank : 1;
+	ofs << "{\n  \"nrank\": " << sum.m_nrank << ",\n";
+
+	// 集計値
+	ofs << "  \"phases\": {\n";
+	for( int i=0; i<PH_NUM; i++ ) {
+		ofs << "    \"" << s_phase_names[i] << "\": {"
+			<< "\"calls\": " << sum.m_calls_sum[i]
+			<< ", \"min\": " << sum.m_time_min[i]
+			<< ", \"max\": " << sum.m_time_max[i]
+			<< ", \"avg\": " << sum.m_time_sum[i] / nrank
+			<< ", \"sum\": " << sum.m_time_sum[i] << "}"
+			<< ( i+1 < PH_NUM ? ",\n" : "\n" );
+	}
+	ofs << "  },\n";
+	ofs << "  \"counters\": {\n";
+	for( int i=0; i<CT_NUM; i++ ) {
+		ofs << "    \"" << s_counter_names[i] << "\": {"
+			<< "\"min\": " << sum.m_count_min[i]
+			<< ", \"max\": " << sum.m_count_max[i]
+			<< ", \"sum\": " << sum.m_count_sum[i] << "}"
+			<< ( i+1 < CT_NUM ? ",\n" : "\n" );
+	}
+	ofs << "  },\n";
+
+	// プロセスごとの計測値
+	ofs << "  \"ranks\": [\n";
+	for( size_t r=0; r<recs.size(); r++ ) {
+		const Record& rec = recs[r];
+		ofs << "    {\"rank\": " << rec.m_rank << ",\n";
+		ofs << "     \"phases\": {";
+		for( int i=0; i<PH_NUM; i++ ) {
+			ofs << "\"" << s_phase_names[i] << "\": [" << rec.m_time[i]
+				<< ", " << rec.m_calls[i] << "]" << ( i+1 < PH_NUM ? ", " : "" );
+		}
+		ofs << "},\n";
+		ofs << "     \"counters\": {";
+		for( int i=0; i<CT_NUM; i++ ) {
+			ofs << "\"" << s_counter_names[i] << "\": " << rec.m_count[i]
+				<< ( i+1 < CT_NUM ? ", " : "" );
+		}
+		ofs << "},\n";
+		ofs << "     \"neighbours\": [";
+		std::map<int, std::pair<long long, long long> >::const_iterator itr;
+		for( itr = rec.m_neighbour.begin(); itr != rec.m_neighbour.end(); itr++ ) {
+			if( itr != rec.m_neighbour.begin() ) ofs << ", ";
+			ofs << "{\"rank\": " << itr->first
+				<< ", \"bytes_sent\": " << itr->second.first
+				<< ", \"bytes_recv\": " << itr->second.second << "}";
+		}
+		ofs << "]}" << ( r+1 < recs.size() ? ",\n" : "\n" );
+	}
+	ofs << "  ]\n}\n";
+
+	if( !ofs ) {
+		PL_ERROSH << "[ERROR]PolylibProfiler::write_json():write failed " << fname << std::endl;
+		return PLSTAT_NG;
+	}
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolylibProfiler::write_chrome_trace(
+	const std::string& fname,
+	const std::vector<Record>& recs,
+	double origin
+	)
+{
+	std::ofstream ofs( fname.c_str() );
+	if( !ofs ) {
+		PL_ERROSH << "[ERROR]PolylibProfiler::write_chrome_trace():Can't open " << fname << std::endl;
+		return PLSTAT_NG;
+	}
+	ofs << std::fixed << std::setprecision(3);
+
+	// 時刻はマイクロ秒単位。プロセス名をメタデータとして出力する
+	ofs << "{\"traceEvents\": [\n";
+	bool first = true;
+	for( size_t r=0; r<recs.size(); r++ ) {
+		const Record& rec = recs[r];
+		ofs << ( first ? "" : ",\n" )
+			<< "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << rec.m_rank
+			<< ", \"args\": {\"name\": \"rank " << rec.m_rank << "\"}}";
+		first = false;
+		for( size_t i=0; i<rec.m_events.size(); i++ ) {
+			const Event& ev = rec.m_events[i];
+			ofs << ",\n{\"name\": \"" << phase_name( ev.m_phase )
+				<< "\", \"cat\": \"polylib\", \"ph\": \"X\", \"pid\": " << rec.m_rank
+				<< ", \"tid\": 0, \"ts\": " << ( ev.m_begin - origin ) * 1.0e6
+				<< ", \"dur\": " << ( ev.m_end - ev.m_begin ) * 1.0e6 << "}";
+		}
+	}
+	ofs << "\n], \"displayTimeUnit\": \"ms\"}\n";
+
+	if( !ofs ) {
+		PL_ERROSH << "[ERROR]PolylibProfiler::write_chrome_trace():write failed " << fname << std::endl;
+		return PLSTAT_NG;
+	}
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT PolylibProfiler::write_profile(
+	const std::string& json_file,
+	const std::string& trace_file
+	)
+{
+	std::vector<Record> recs( 1 );
+	get_record( &recs[0] );
+
+	Summary sum;
+	summarize( recs, &sum );
+
+	POLYLIB_STAT ret = write_json( json_file, sum, recs );
+	if( ret != PLSTAT_OK ) return ret;
+	if( trace_file.empty() ) return PLSTAT_OK;
+	return write_chrome_trace( trace_file, recs, s_origin );
+}
+
+} //namespace PolylibNS
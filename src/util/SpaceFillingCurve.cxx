@@ -0,0 +1,144 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#include <cctype>
+
+#include "util/SpaceFillingCurve.h"
+
+namespace PolylibNS {
+
+const int SpaceFillingCurve::BITS;
+
+//  座標を範囲[lo,hi]でBITS bitの整数に量子化
+static unsigned int quantize( double v, double lo, double hi )
+{
+	const unsigned int maxq = (1u << SpaceFillingCurve::BITS) - 1;
+	if( !(hi > lo) ) return 0;
+	double t = ( v - lo ) / ( hi - lo );
+	if( t <= 0.0 ) return 0;
+	if( t >= 1.0 ) return maxq;
+	return (unsigned int)( t * maxq );
+}
+
+//  3つの整数のbitを上位からx,y,zの順に交互に並べる
+static unsigned long long interleave(
+	unsigned int x,
+	unsigned int y,
+	unsigned int z
+	)
+{
+	unsigned long long k = 0;
+	for( int b=SpaceFillingCurve::BITS-1; b>=0; b-- ) {
+		k = (k << 3)
+			| ( (unsigned long long)((x >> b) & 1u) << 2 )
+			| ( (unsigned long long)((y >> b) & 1u) << 1 )
+			|   (unsigned long long)((z >> b) & 1u);
+	}
+	return k;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+unsigned long long SpaceFillingCurve::key(
+	Type					type,
+	const Vec3<PL_REAL>&	pos,
+	const BBox&				bbox
+	)
+{
+	if( type == SFC_NONE ) return 0;
+	unsigned int q[3];
+	for( int i=0; i<3; i++ ) q[i] = quantize( pos[i], bbox.min[i], bbox.max[i] );
+	if( type == SFC_HILBERT ) return hilbert_key( q[0], q[1], q[2] );
+	return morton_key( q[0], q[1], q[2] );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+unsigned long long SpaceFillingCurve::morton_key(
+	unsigned int x,
+	unsigned int y,
+	unsigned int z
+	)
+{
+	return interleave( x, y, z );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+unsigned long long SpaceFillingCurve::hilbert_key(
+	unsigned int x,
+	unsigned int y,
+	unsigned int z
+	)
+{
+	// J. Skilling, "Programming the Hilbert curve" (2004) のAxesToTranspose。
+	// 座標を転置形式のHilbert番号へ変換し、bitを交互に並べるとキーになる。
+	unsigned int X[3] = { x, y, z };
+	const unsigned int M = 1u << (BITS-1);
+	unsigned int P, Q, t;
+	int i;
+
+	// 逆回転
+	for( Q=M; Q>1; Q>>=1 ) {
+		P = Q - 1;
+		for( i=0; i<3; i++ ) {
+			if( X[i] & Q ) {
+				X[0] ^= P;
+			}
+			else {
+				t = ( X[0] ^ X[i] ) & P;
+				X[0] ^= t;
+				X[i] ^= t;
+			}
+		}
+	}
+
+	// グレイ符号化
+	for( i=1; i<3; i++ ) X[i] ^= X[i-1];
+	t = 0;
+	for( Q=M; Q>1; Q>>=1 ) {
+		if( X[2] & Q ) t ^= Q - 1;
+	}
+	for( i=0; i<3; i++ ) X[i] ^= t;
+
+	return interleave( X[0], X[1], X[2] );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+bool SpaceFillingCurve::parse( const std::string& str, Type* p_type )
+{
+	std::string s;
+	for( size_t i=0; i<str.size(); i++ ) s += (char)tolower( str[i] );
+	if( s == "none" || s == "false" || s.empty() ) { *p_type = SFC_NONE; return true; }
+	if( s == "morton" ) { *p_type = SFC_MORTON; return true; }
+	if( s == "hilbert" ) { *p_type = SFC_HILBERT; return true; }
+	return false;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+const char* SpaceFillingCurve::name( Type type )
+{
+	switch( type ) {
+	case SFC_MORTON:	return "morton";
+	case SFC_HILBERT:	return "hilbert";
+	default:			return "none";
+	}
+}
+
+} //namespace PolylibNS
@@ -0,0 +1,257 @@
+/*
+###################################################################################
+#
+# Polylib - Polygon Management Library
+#
+# Copyright (c) 2010-2011 VCAD System Research Program, RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2012-2015 Advanced Institute for Computational Science (AICS), RIKEN.
+# All rights reserved.
+#
+# Copyright (c) 2016-2018 Research Institute for Information Technology (RIIT), Kyushu University.
+# All rights reserved.
+#
+###################################################################################
+*/
+
+#include <cmath>
+#include <algorithm>
+
+#include "util/TriangleBins.h"
+#include "polygons/Triangle.h"
+#include "polygons/Vertex.h"
+
+namespace PolylibNS {
+
+//  三角形の3頂点をPL_CALC_REALで取り出す。rigidがNULLでなければ剛体変換する
+static void get_coords( const Triangle* t, const double* rigid, PL_CALC_REAL v[3][3] )
+{
+	Vertex** vtx = t->get_vertex();
+	for( int i=0; i<3; i++ ) {
+		if( rigid == NULL ) {
+			for( int j=0; j<3; j++ ) v[i][j] = (*vtx[i])[j];
+			continue;
+		}
+		for( int j=0; j<3; j++ ) {
+			v[i][j] = rigid[j*3]*(*vtx[i])[0] + rigid[j*3+1]*(*vtx[i])[1]
+				+ rigid[j*3+2]*(*vtx[i])[2] + rigid[9+j];
+		}
+	}
+}
+
+//  三角形を外包する矩形と重なるセル範囲[lo,hi]を求める。
+//  格子と重ならない場合false。
+static bool cell_range(
+	const CellGrid&		grid,
+	const PL_CALC_REAL	v[3][3],
+	int					lo[3],
+	int					hi[3]
+	)
+{
+	for( int a=0; a<3; a++ ) {
+		PL_CALC_REAL bmin = std::min( v[0][a], std::min( v[1][a], v[2][a] ) );
+		PL_CALC_REAL bmax = std::max( v[0][a], std::max( v[1][a], v[2][a] ) );
+		PL_CALC_REAL o = grid.m_origin[a];
+		PL_CALC_REAL h = grid.m_cell_size[a];
+		int n = grid.m_dims[a];
+		// セルiは[o+i*h, o+(i+1)*h]。端点で接するセルも含める
+		PL_CALC_REAL fl = std::ceil( ( bmin - o ) / h ) - 1;
+		PL_CALC_REAL fh = std::floor( ( bmax - o ) / h );
+		int l = ( fl < -1 ) ? -1 : ( fl > n ) ? n : (int)fl;
+		int u = ( fh < -1 ) ? -1 : ( fh > n ) ? n : (int)fh;
+		// 除算の丸めで境界上の判定がずれないよう、セル境界と直接比較して補正
+		while( l > 0 && o + l * h >= bmin ) l--;
+		while( l < n && o + ( l + 1 ) * h < bmin ) l++;
+		while( u < n - 1 && o + ( u + 1 ) * h <= bmax ) u++;
+		while( u >= 0 && o + u * h > bmax ) u--;
+		lo[a] = std::max( l, 0 );
+		hi[a] = std::min( u, n - 1 );
+		if( lo[a] > hi[a] ) return false;
+	}
+	return true;
+}
+
+//  投影区間[p0,p1,p2]が[-r,r]と重ならない場合true
+static bool separated(
+	PL_CALC_REAL p0,
+	PL_CALC_REAL p1,
+	PL_CALC_REAL p2,
+	PL_CALC_REAL r
+	)
+{
+	PL_CALC_REAL pmin = std::min( p0, std::min( p1, p2 ) );
+	PL_CALC_REAL pmax = std::max( p0, std::max( p1, p2 ) );
+	return pmin > r || pmax < -r;
+}
+
+//  三角形と矩形(中心c、半幅h)が重なるか(分離軸判定)。接する場合も重なるとする。
+static bool tri_box_overlap(
+	const PL_CALC_REAL	tv[3][3],
+	const PL_CALC_REAL	c[3],
+	const PL_CALC_REAL	h[3]
+	)
+{
+	PL_CALC_REAL v[3][3], e[3][3];
+	for( int i=0; i<3; i++ ) {
+		for( int a=0; a<3; a++ ) v[i][a] = tv[i][a] - c[a];
+	}
+	for( int i=0; i<3; i++ ) {
+		for( int a=0; a<3; a++ ) e[i][a] = v[(i+1)%3][a] - v[i][a];
+	}
+
+	// 矩形の3軸
+	for( int a=0; a<3; a++ ) {
+		if( separated( v[0][a], v[1][a], v[2][a], h[a] ) ) return false;
+	}
+
+	// 三角形の面の法線
+	PL_CALC_REAL n[3];
+	n[0] = e[0][1]*e[1][2] - e[0][2]*e[1][1];
+	n[1] = e[0][2]*e[1][0] - e[0][0]*e[1][2];
+	n[2] = e[0][0]*e[1][1] - e[0][1]*e[1][0];
+	PL_CALC_REAL s = n[0]*v[0][0] + n[1]*v[0][1] + n[2]*v[0][2];
+	PL_CALC_REAL r = h[0]*std::fabs(n[0]) + h[1]*std::fabs(n[1]) + h[2]*std::fabs(n[2]);
+	if( std::fabs(s) > r ) return false;
+
+	// 辺と矩形の軸の外積9軸
+	for( int i=0; i<3; i++ ) {
+		for( int a=0; a<3; a++ ) {
+			int b = (a+1)%3, d = (a+2)%3;
+			// 軸 = e[i] x (a軸の単位ベクトル)。a成分は0
+			PL_CALC_REAL ax_b = e[i][d];
+			PL_CALC_REAL ax_d = -e[i][b];
+			PL_CALC_REAL p0 = ax_b*v[0][b] + ax_d*v[0][d];
+			PL_CALC_REAL p1 = ax_b*v[1][b] + ax_d*v[1][d];
+			PL_CALC_REAL p2 = ax_b*v[2][b] + ax_d*v[2][d];
+			PL_CALC_REAL rr = h[b]*std::fabs(ax_b) + h[d]*std::fabs(ax_d);
+			if( separated( p0, p1, p2, rr ) ) return false;
+		}
+	}
+	return true;
+}
+
+//  三角形が重なるセルを数え、cellsがNULLでなければセル番号を格納する
+static size_t bin_triangle(
+	const CellGrid&		grid,
+	const Triangle*		t,
+	const double*		rigid,
+	bool				exact,
+	size_t*				cells
+	)
+{
+	PL_CALC_REAL v[3][3];
+	get_coords( t, rigid, v );
+	int lo[3], hi[3];
+	if( !cell_range( grid, v, lo, hi ) ) return 0;
+
+	PL_CALC_REAL h[3], c[3];
+	for( int a=0; a<3; a++ ) h[a] = (PL_CALC_REAL)grid.m_cell_size[a] * 0.5;
+
+	size_t n = 0;
+	for( int k=lo[2]; k<=hi[2]; k++ ) {
+		c[2] = grid.m_origin[2] + ( k + 0.5 ) * (PL_CALC_REAL)grid.m_cell_size[2];
+		for( int j=lo[1]; j<=hi[1]; j++ ) {
+			c[1] = grid.m_origin[1] + ( j + 0.5 ) * (PL_CALC_REAL)grid.m_cell_size[1];
+			for( int i=lo[0]; i<=hi[0]; i++ ) {
+				if( exact ) {
+					c[0] = grid.m_origin[0] + ( i + 0.5 ) * (PL_CALC_REAL)grid.m_cell_size[0];
+					if( !tri_box_overlap( v, c, h ) ) continue;
+				}
+				if( cells != NULL ) {
+					cells[n] = ( (size_t)k * grid.m_dims[1] + j ) * grid.m_dims[0] + i;
+				}
+				n++;
+			}
+		}
+	}
+	return n;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+TriangleBins::TriangleBins()
+{
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+POLYLIB_STAT TriangleBins::build(
+	const CellGrid&					grid,
+	const std::vector<Triangle*>&	trias,
+	bool							exact,
+	const std::vector<const double*>* rigid
+	)
+{
+	clear();
+	for( int a=0; a<3; a++ ) {
+		if( grid.m_dims[a] <= 0 || !( grid.m_cell_size[a] > 0 ) ) {
+			PL_ERROSH << "[ERROR]TriangleBins::build():invalid grid." << std::endl;
+			return PLSTAT_NG;
+		}
+	}
+	m_grid = grid;
+	m_triangles = trias;
+	size_t ncell = (size_t)grid.m_dims[0] * grid.m_dims[1] * grid.m_dims[2];
+	int ntri = trias.size();
+
+	// 三角形毎の(三角形,セル)組の数
+	std::vector<size_t> tri_offsets( ntri + 1, 0 );
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,256)
+#endif
+	for( int t=0; t<ntri; t++ ) {
+		tri_offsets[t+1] = bin_triangle( grid, trias[t], rigid ? (*rigid)[t] : NULL, exact, NULL );
+	}
+	for( int t=0; t<ntri; t++ ) tri_offsets[t+1] += tri_offsets[t];
+
+	// 三角形毎にセル番号を格納
+	std::vector<size_t> pair_cells( tri_offsets[ntri] );
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,256)
+#endif
+	for( int t=0; t<ntri; t++ ) {
+		if( tri_offsets[t+1] == tri_offsets[t] ) continue;
+		bin_triangle( grid, trias[t], rigid ? (*rigid)[t] : NULL, exact, &pair_cells[ tri_offsets[t] ] );
+	}
+
+	// セル番号で計数ソート。三角形順に詰めるのでセル内は昇順になる
+	m_offsets.assign( ncell + 1, 0 );
+	for( size_t p=0; p<pair_cells.size(); p++ ) m_offsets[ pair_cells[p] + 1 ]++;
+	for( size_t c=0; c<ncell; c++ ) m_offsets[c+1] += m_offsets[c];
+	std::vector<size_t> pos( m_offsets.begin(), m_offsets.end() - 1 );
+	m_indices.resize( pair_cells.size() );
+	for( int t=0; t<ntri; t++ ) {
+		for( size_t p=tri_offsets[t]; p<tri_offsets[t+1]; p++ ) {
+			m_indices[ pos[ pair_cells[p] ]++ ] = t;
+		}
+	}
+
+#ifdef DEBUG
+	PL_DBGOSH << "TriangleBins::build():cells=" << ncell << " triangles=" << ntri
+		<< " entries=" << m_indices.size() << std::endl;
+#endif
+	return PLSTAT_OK;
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+void TriangleBins::clear()
+{
+	m_grid = CellGrid();
+	std::vector<size_t>().swap( m_offsets );
+	std::vector<int>().swap( m_indices );
+	std::vector<Triangle*>().swap( m_triangles );
+}
+
+// public /////////////////////////////////////////////////////////////////////
+
+size_t TriangleBins::memory_size() const
+{
+	return sizeof(TriangleBins)
+		+ m_offsets.capacity() * sizeof(size_t)
+		+ m_indices.capacity() * sizeof(int)
+		+ m_triangles.capacity() * sizeof(Triangle*);
+}
+
+} //namespace PolylibNS